@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "../include/nn_from_scratch.h"
+
+/* Benchmark of the inference and training paths for a synthetic model of any shape, results are printed as JSON.
+    Built and run for several shapes by run_benchmarks.py, see there for the options.
+*/
+
+#define MAX_LAYERS 32
+
+// batches trained between restoring the initial parameters, the scalar loss derivative keeps pushing the weights
+// in one direction so long runs would end in inf and NaN
+#define RESTORE_INTERVAL 8
+
+typedef struct
+{
+    int sizes[MAX_LAYERS + 1]; // input size followed by the layer sizes
+    int n_layers;
+    int packed;
+    int latency_repeats;
+    int batch_samples;
+    double min_time; // seconds each throughput measurement runs for at least
+    uint32_t seed;
+} BenchmarkConfig;
+
+typedef struct
+{
+    float *samples_x;
+    float *samples_y;
+    int n_batches;
+    float *saved_weights[MAX_LAYERS];
+    float *saved_biases[MAX_LAYERS];
+} BenchmarkData;
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random_state;
+
+static float random_uniform(float low, float high)
+{
+    uint32_t x = random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state = x;
+    return low + (high - low) * (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static int parse_shape(const char *text, BenchmarkConfig *config)
+{
+    int n = 0;
+    const char *p = text;
+    while (*p != '\0' && n <= MAX_LAYERS)
+    {
+        char *end;
+        long size = strtol(p, &end, 10);
+        if (end == p || size <= 0)
+        {
+            return -1;
+        }
+        config->sizes[n++] = (int)size;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    config->n_layers = n - 1;
+    return (n >= 2 && *p == '\0') ? 0 : -1;
+}
+
+static int parse_args(int argc, char **argv, BenchmarkConfig *config)
+{
+    config->n_layers = 0;
+    config->packed = 0;
+    config->latency_repeats = 2000;
+    config->batch_samples = 256;
+    config->min_time = 0.2;
+    config->seed = 1;
+    for (int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--shape") == 0 && has_value)
+        {
+            if (parse_shape(argv[++i], config) != 0)
+            {
+                fprintf(stderr, "Error benchmark: invalid shape %s, expected sizes like 16,64,4\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--packed") == 0)
+        {
+            config->packed = 1;
+        }
+        else if (strcmp(argv[i], "--latency_repeats") == 0 && has_value)
+        {
+            config->latency_repeats = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--batch_samples") == 0 && has_value)
+        {
+            config->batch_samples = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--min_time") == 0 && has_value)
+        {
+            config->min_time = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && has_value)
+        {
+            config->seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s --shape input,layer_1,...,output [--packed] [--latency_repeats n] [--batch_samples n] [--min_time s] [--seed n]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (config->n_layers == 0 || config->latency_repeats <= 0 || config->batch_samples <= 0 || config->seed == 0)
+    {
+        fprintf(stderr, "Error benchmark: a shape is required, counts and the seed have to be positive\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Random INPUT_MAJOR model with relu hidden layers and a linear output layer, as model_generator.py creates them */
+static Model *create_random_model(BenchmarkConfig *config, float **weights, float **biases, enum ActivationType *activations)
+{
+    for (int i = 0; i < config->n_layers; i++)
+    {
+        int in = config->sizes[i];
+        int out = config->sizes[i + 1];
+        float limit = sqrtf(6.0f / (in + out));
+        weights[i] = (float *)malloc((size_t)in * out * sizeof(float));
+        biases[i] = (float *)malloc(out * sizeof(float));
+        for (int j = 0; j < in * out; j++)
+        {
+            weights[i][j] = random_uniform(-limit, limit);
+        }
+        for (int j = 0; j < out; j++)
+        {
+            biases[i][j] = random_uniform(-0.1f, 0.1f);
+        }
+        activations[i] = (i == config->n_layers - 1) ? LINEAR : RELU;
+    }
+    Model *model = createAndSetModel(config->n_layers, config->sizes[0], config->sizes[config->n_layers], config->sizes + 1,
+                                     weights, biases, activations);
+    if (config->packed)
+    {
+        packModelWeights(model);
+    }
+    return model;
+}
+
+static size_t layer_weights_count(Model *model, int layer)
+{
+    int prev_size = (layer == 0) ? model->input_size : model->layers_size[layer - 1];
+    int row = (model->weights_layout == OUTPUT_MAJOR_PACKED) ? FC_PACKED_STRIDE(prev_size) : prev_size;
+    return (size_t)row * model->layers_size[layer];
+}
+
+/* Copies the parameters of the model into the saved arrays, or back into the model when restore is set */
+static void copy_parameters(Model *model, BenchmarkData *data, int restore)
+{
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        size_t n_weights = layer_weights_count(model, i) * sizeof(float);
+        size_t n_biases = model->layers_size[i] * sizeof(float);
+        if (restore)
+        {
+            memcpy(model->layers_weights[i], data->saved_weights[i], n_weights);
+            memcpy(model->layers_biases[i], data->saved_biases[i], n_biases);
+        }
+        else
+        {
+            memcpy(data->saved_weights[i], model->layers_weights[i], n_weights);
+            memcpy(data->saved_biases[i], model->layers_biases[i], n_biases);
+        }
+    }
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Single sample latency of the heap-free predict path. Calls are timed in blocks long enough for the clock to resolve,
+    the percentiles are over the per-call time of the blocks. */
+static void benchmark_latency(Model *model, BenchmarkConfig *config, float *inputs, int n_inputs)
+{
+    InferenceWorkspace *workspace = allocate_inference_workspace(model);
+    float *output = (float *)malloc(model->output_size * sizeof(float));
+
+    int calls = 1;
+    while (1)
+    {
+        double start = now_seconds();
+        for (int c = 0; c < calls; c++)
+        {
+            fc_model_predict_into(model, workspace, inputs + (c % n_inputs) * model->input_size, output);
+        }
+        if (now_seconds() - start > 2e-6 || calls >= (1 << 20))
+        {
+            break;
+        }
+        calls *= 2;
+    }
+
+    double *times = (double *)malloc(config->latency_repeats * sizeof(double));
+    double sum = 0;
+    for (int r = 0; r < config->latency_repeats; r++)
+    {
+        double start = now_seconds();
+        for (int c = 0; c < calls; c++)
+        {
+            fc_model_predict_into(model, workspace, inputs + ((r + c) % n_inputs) * model->input_size, output);
+        }
+        times[r] = (now_seconds() - start) / calls;
+        sum += times[r];
+    }
+    qsort(times, config->latency_repeats, sizeof(double), compare_doubles);
+    printf("    \"predict_latency_us\": {\"p50\": %.4f, \"p99\": %.4f, \"mean\": %.4f, \"calls_per_sample\": %d},\n",
+           times[config->latency_repeats / 2] * 1e6, times[(int)(config->latency_repeats * 0.99)] * 1e6,
+           sum / config->latency_repeats * 1e6, calls);
+
+    free(times);
+    free(output);
+    free_inference_workspace(workspace);
+}
+
+static void benchmark_batch_predict(Model *model, BenchmarkConfig *config, float *inputs)
+{
+    float *outputs = (float *)malloc((size_t)config->batch_samples * model->output_size * sizeof(float));
+    fc_model_predict_batch(model, inputs, config->batch_samples, outputs); // warm up
+    long samples = 0;
+    double start = now_seconds();
+    double elapsed = 0;
+    do
+    {
+        fc_model_predict_batch(model, inputs, config->batch_samples, outputs);
+        samples += config->batch_samples;
+        elapsed = now_seconds() - start;
+    } while (elapsed < config->min_time);
+    printf("    \"predict_batch_samples_per_s\": %.1f,\n", samples / elapsed);
+    free(outputs);
+}
+
+/* Training throughput of a trainer that is created once, as on the device. The parameters are restored every
+    RESTORE_INTERVAL batches outside of the timed part.
+    @param target_layer: -1 for the whole network, else the trained layer
+    @param n_weights: weights trained per neuron of the target layer
+*/
+static void benchmark_training(Model *model, BenchmarkConfig *config, BenchmarkData *data, const char *name, int target_layer,
+                               int n_weights, int last)
+{
+#ifdef ENABLE_TRACK_MEMORY
+    reset_peak_memory();
+    size_t in_use = get_peak_memory();
+#endif
+    Trainer *trainer;
+    Optimizer *optimizer;
+    if (target_layer < 0)
+    {
+        trainer = create_trainer(model);
+        optimizer = create_optimizer(model, OPTIMIZER);
+    }
+    else
+    {
+        trainer = create_partial_trainer(model, target_layer, n_weights, 0);
+        optimizer = create_partial_optimizer(model, OPTIMIZER, target_layer, n_weights);
+    }
+
+    long samples = 0;
+    double elapsed = 0;
+    do
+    {
+        double start = now_seconds();
+        for (int batch = 0; batch < RESTORE_INTERVAL; batch++)
+        {
+            int b = batch % data->n_batches;
+            float *batch_x = data->samples_x + (size_t)b * BATCH_SIZE * model->input_size;
+            float *batch_y = data->samples_y + (size_t)b * BATCH_SIZE * model->output_size;
+            fc_trainer_train(trainer, optimizer, (float(*)[model->input_size])batch_x, (float(*)[model->output_size])batch_y);
+        }
+        elapsed += now_seconds() - start;
+        samples += RESTORE_INTERVAL * BATCH_SIZE;
+        copy_parameters(model, data, 1);
+    } while (elapsed < config->min_time);
+
+    free_optimizer(optimizer);
+    free_trainer(trainer);
+#ifdef ENABLE_TRACK_MEMORY
+    printf("    \"train_%s\": {\"samples_per_s\": %.1f, \"peak_heap_bytes\": %zu}%s\n", name, samples / elapsed,
+           get_peak_memory() - in_use, last ? "" : ",");
+#else
+    printf("    \"train_%s\": {\"samples_per_s\": %.1f, \"peak_heap_bytes\": null}%s\n", name, samples / elapsed, last ? "" : ",");
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkConfig config;
+    if (parse_args(argc, argv, &config) != 0)
+    {
+        return 1;
+    }
+    random_state = config.seed;
+
+    float *weights[MAX_LAYERS];
+    float *biases[MAX_LAYERS];
+    enum ActivationType activations[MAX_LAYERS];
+    Model *model = create_random_model(&config, weights, biases, activations);
+    int input_size = model->input_size;
+    int output_size = model->output_size;
+
+    BenchmarkData data;
+    data.n_batches = 4;
+    int n_samples = data.n_batches * BATCH_SIZE > config.batch_samples ? data.n_batches * BATCH_SIZE : config.batch_samples;
+    data.samples_x = (float *)malloc((size_t)n_samples * input_size * sizeof(float));
+    data.samples_y = (float *)malloc((size_t)n_samples * output_size * sizeof(float));
+    for (int i = 0; i < n_samples * input_size; i++)
+    {
+        data.samples_x[i] = random_uniform(0.0f, 1.0f);
+    }
+    for (int i = 0; i < n_samples * output_size; i++)
+    {
+        data.samples_y[i] = random_uniform(-1.0f, 1.0f);
+    }
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        data.saved_weights[i] = (float *)malloc(layer_weights_count(model, i) * sizeof(float));
+        data.saved_biases[i] = (float *)malloc(model->layers_size[i] * sizeof(float));
+    }
+    copy_parameters(model, &data, 0);
+
+    printf("{\n");
+    printf("    \"shape\": [");
+    for (int i = 0; i <= config.n_layers; i++)
+    {
+        printf("%d%s", config.sizes[i], i < config.n_layers ? ", " : "],\n");
+    }
+    printf("    \"weights_layout\": \"%s\",\n", config.packed ? "OUTPUT_MAJOR_PACKED" : "INPUT_MAJOR");
+    printf("    \"simd_level\": \"%s\",\n", get_simd_level_name(get_simd_level()));
+    printf("    \"batch_size\": %d,\n", BATCH_SIZE);
+
+    benchmark_latency(model, &config, data.samples_x, n_samples);
+    benchmark_batch_predict(model, &config, data.samples_x);
+
+    int target_layer = model->n_layers - 1;
+    int prev_size = (target_layer == 0) ? input_size : model->layers_size[target_layer - 1];
+    int partial_weights = prev_size > 1 ? prev_size / 2 : 1;
+    benchmark_training(model, &config, &data, "full", -1, 0, 0);
+    benchmark_training(model, &config, &data, "layer", target_layer, prev_size, 0);
+    benchmark_training(model, &config, &data, "partial", target_layer, partial_weights, 1);
+    printf("}\n");
+
+    free(data.samples_x);
+    free(data.samples_y);
+    for (int i = 0; i < config.n_layers; i++)
+    {
+        free(data.saved_weights[i]);
+        free(data.saved_biases[i]);
+        free(weights[i]);
+        free(biases[i]);
+    }
+    freeModel(model);
+    return 0;
+}
@@ -0,0 +1,607 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../include/nn_from_scratch.h"
+
+/* Microbenchmark of the layer kernels over a sweep of input and output sizes, results are printed as JSON.
+    Every kernel is timed with warm caches (the same operands on every call) and cold caches (the calls cycle
+    through copies of the operands that together are larger than the last level cache). FLOPs and bytes are
+    counted analytically as the minimum the kernel has to compute and move, so GB/s is a lower bound on the traffic.
+    The roofline of a measurement is min(peak GFLOP/s, intensity * bandwidth). The bandwidth is the better of a read and
+    a read+write stream over as much memory as the measured calls touch: one call for warm caches, the whole cycle through
+    the copies for cold caches, at least main memory. A kernel that moves its bytes faster than the streams raises its roof.
+    Kernels whose lookup dispatches on the SIMD level are run for every level the CPU supports.
+    Built and run by run_benchmarks.py --kernels.
+*/
+
+#define MAX_SIZES 16
+#define BATCH_SAMPLES 64
+
+enum KernelKind
+{
+    KERNEL_FORWARD_PROP_INTO,
+    KERNEL_FORWARD_PROP_T,
+    KERNEL_FORWARD_PROP_BATCH,
+    KERNEL_BACK_PROP,
+    KERNEL_LIGHT_BACK_PROP,
+    KERNEL_SPECIFIC_BACK_PROP
+};
+
+typedef struct
+{
+    const char *name;
+    enum KernelKind kind;
+    enum WeightLayout layout;
+    int per_activation; // one variant per activation in ACTIVATION_MACRO_LIST
+    int simd;           // the lookup dispatches on the SIMD level
+} KernelInfo;
+
+static const KernelInfo kernels[] = {
+    {"fc_forward_prop_into", KERNEL_FORWARD_PROP_INTO, INPUT_MAJOR, 1, 1},
+    {"fc_forward_prop_into_packed", KERNEL_FORWARD_PROP_INTO, OUTPUT_MAJOR_PACKED, 1, 1},
+    {"fc_forward_prop_t", KERNEL_FORWARD_PROP_T, INPUT_MAJOR, 1, 1},
+    {"fc_forward_prop_t_packed", KERNEL_FORWARD_PROP_T, OUTPUT_MAJOR_PACKED, 1, 1},
+    {"fc_forward_prop_batch", KERNEL_FORWARD_PROP_BATCH, INPUT_MAJOR, 1, 1},
+    {"fc_forward_prop_batch_packed", KERNEL_FORWARD_PROP_BATCH, OUTPUT_MAJOR_PACKED, 1, 1},
+    {"fc_back_prop", KERNEL_BACK_PROP, INPUT_MAJOR, 1, 1},
+    {"fc_back_prop_packed", KERNEL_BACK_PROP, OUTPUT_MAJOR_PACKED, 1, 1},
+    {"fc_light_back_prop", KERNEL_LIGHT_BACK_PROP, INPUT_MAJOR, 0, 0},
+    {"fc_light_back_prop_packed", KERNEL_LIGHT_BACK_PROP, OUTPUT_MAJOR_PACKED, 0, 1},
+    {"fc_specific_back_prop_cached", KERNEL_SPECIFIC_BACK_PROP, INPUT_MAJOR, 0, 1},
+    {"fc_specific_back_prop_cached_packed", KERNEL_SPECIFIC_BACK_PROP, OUTPUT_MAJOR_PACKED, 0, 1},
+};
+
+static const char *activation_names[] = {
+#define X(act, func, func_deriv) #act,
+    ACTIVATION_MACRO_LIST
+#undef X
+};
+
+#define N_ACTIVATIONS ((int)(sizeof(activation_names) / sizeof(activation_names[0])))
+
+typedef union
+{
+    ForwardPropInto forward_prop_into;
+    ForwardPropT forward_prop_t;
+    ForwardPropBatch forward_prop_batch;
+    BackProp back_prop;
+    LightBackProp light_back_prop;
+    SpecificBackProp specific_back_prop;
+} KernelFunc;
+
+/* Operands of one call, sized for both layouts */
+typedef struct
+{
+    float *input;   // BATCH_SAMPLES * input_size
+    float *weights; // output_size * FC_PACKED_STRIDE(input_size)
+    float *biases;
+    float *output;      // BATCH_SAMPLES * output_size
+    float *activations; // output_size, or input_size for the back propagation
+    float *net_inputs;  // input_size
+    float *gradient;    // output_size
+    float *gradient_weights;
+    float *gradient_biases;
+    uint32_t *deriv_mask;
+} Operands;
+
+typedef struct
+{
+    int sizes[MAX_SIZES];
+    int n_sizes;
+    double min_time;    // seconds each measurement runs for at least
+    size_t cold_bytes;  // operands cycled through for the cold cache measurements
+    double peak_gflops; // 0 to measure
+    double peak_gbs;    // main memory bandwidth, 0 to measure
+} KernelBenchmarkConfig;
+
+static double now_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random_state = 1;
+
+static float random_uniform(float low, float high)
+{
+    uint32_t x = random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state = x;
+    return low + (high - low) * (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static size_t operands_floats(int input_size, int output_size)
+{
+    size_t n_weights = (size_t)output_size * FC_PACKED_STRIDE(input_size);
+    return 2 * n_weights + (size_t)BATCH_SAMPLES * (input_size + output_size) + 4 * output_size + 2 * input_size;
+}
+
+/* Bytes of one copy of the operands, rounded up to a cache line so the copies do not share lines */
+static size_t operands_bytes(int input_size, int output_size)
+{
+    size_t bytes = operands_floats(input_size, output_size) * sizeof(float) + DERIV_MASK_WORDS(input_size) * sizeof(uint32_t);
+    return (bytes + 63) / 64 * 64;
+}
+
+/* Fills one copy of the operands in memory of operands_bytes bytes */
+static void create_operands(Operands *operands, void *memory, int input_size, int output_size)
+{
+    size_t n_weights = (size_t)output_size * FC_PACKED_STRIDE(input_size);
+    size_t n_floats = operands_floats(input_size, output_size);
+    size_t n_words = DERIV_MASK_WORDS(input_size);
+    float *data = (float *)memory;
+    for (size_t i = 0; i < n_floats; i++)
+    {
+        data[i] = random_uniform(-0.5f, 0.5f);
+    }
+    operands->weights = data;
+    data += n_weights;
+    operands->gradient_weights = data;
+    data += n_weights;
+    operands->input = data;
+    data += (size_t)BATCH_SAMPLES * input_size;
+    operands->output = data;
+    data += (size_t)BATCH_SAMPLES * output_size;
+    operands->biases = data;
+    operands->gradient = data + output_size;
+    operands->gradient_biases = data + 2 * output_size;
+    operands->activations = data + 3 * output_size; // output_size + input_size floats
+    operands->net_inputs = data + 4 * output_size + input_size;
+    operands->deriv_mask = (uint32_t *)(data + 4 * output_size + 2 * input_size);
+    for (size_t i = 0; i < n_words; i++)
+    {
+        operands->deriv_mask[i] = (uint32_t)(random_uniform(0.0f, 1.0f) * 4294967295.0f);
+    }
+}
+
+static KernelFunc lookup_kernel(const KernelInfo *kernel, enum ActivationType activation)
+{
+    KernelFunc func;
+    int packed = kernel->layout == OUTPUT_MAJOR_PACKED;
+    switch (kernel->kind)
+    {
+    case KERNEL_FORWARD_PROP_INTO:
+        func.forward_prop_into = packed ? get_fc_forward_prop_into_packed_variant(activation) : get_fc_forward_prop_into_variant(activation);
+        break;
+    case KERNEL_FORWARD_PROP_T:
+        func.forward_prop_t = packed ? get_fc_forward_prop_t_packed_variant(activation) : get_fc_forward_prop_t_variant(activation);
+        break;
+    case KERNEL_FORWARD_PROP_BATCH:
+        func.forward_prop_batch = packed ? get_fc_forward_prop_batch_packed_variant(activation) : get_fc_forward_prop_batch_variant(activation);
+        break;
+    case KERNEL_BACK_PROP:
+        func.back_prop = packed ? get_fc_back_prop_packed_variant(activation) : get_fc_back_prop_variant(activation);
+        break;
+    case KERNEL_LIGHT_BACK_PROP:
+        func.light_back_prop = get_fc_light_back_prop_variant(kernel->layout);
+        break;
+    default:
+        func.specific_back_prop = get_fc_specific_back_prop_cached_variant(kernel->layout);
+        break;
+    }
+    return func;
+}
+
+/* One call of the kernel for a layer with input_size inputs and output_size outputs.
+    The back propagation kernels get the gradient of the outputs and propagate it to the inputs. */
+static void call_kernel(const KernelInfo *kernel, KernelFunc func, Operands *o, int input_size, int output_size)
+{
+    // distance between the gradients of two inputs for INPUT_MAJOR, between two neurons for OUTPUT_MAJOR_PACKED
+    int stride = (kernel->layout == OUTPUT_MAJOR_PACKED) ? FC_PACKED_STRIDE(input_size) : output_size;
+    switch (kernel->kind)
+    {
+    case KERNEL_FORWARD_PROP_INTO:
+        func.forward_prop_into(o->input, o->weights, o->biases, input_size, output_size, o->output);
+        break;
+    case KERNEL_FORWARD_PROP_T:
+        func.forward_prop_t(o->input, input_size, o->output, output_size, o->weights, o->biases, o->activations);
+        break;
+    case KERNEL_FORWARD_PROP_BATCH:
+        func.forward_prop_batch(o->input, o->weights, o->biases, input_size, output_size, BATCH_SAMPLES, o->output);
+        break;
+    case KERNEL_BACK_PROP:
+        func.back_prop(o->gradient, o->activations, o->net_inputs, o->weights, output_size, input_size, o->gradient_weights, o->gradient_biases);
+        break;
+    case KERNEL_LIGHT_BACK_PROP:
+        func.light_back_prop(o->gradient, o->weights, output_size, input_size, o->deriv_mask, o->net_inputs);
+        break;
+    default:
+        func.specific_back_prop(o->gradient, o->activations, output_size, o->gradient_weights, o->gradient_biases, input_size, stride);
+        break;
+    }
+}
+
+/* FLOPs and bytes a kernel has to compute and move at least, a multiply-add counts as two FLOPs.
+    Weights are read once per call, gradients are read and written. The footprint is the memory a call touches,
+    the bytes without the writes back.
+*/
+static void count_work(const KernelInfo *kernel, int input_size, int output_size, double *flops, double *bytes, double *footprint)
+{
+    int stride = (kernel->layout == OUTPUT_MAJOR_PACKED) ? FC_PACKED_STRIDE(input_size) : input_size;
+    double macs = (double)input_size * output_size;
+    double weights = (double)output_size * stride;
+    double in = input_size;
+    double out = output_size;
+    switch (kernel->kind)
+    {
+    case KERNEL_FORWARD_PROP_INTO:
+        *flops = 2 * macs + out;
+        *bytes = 4 * (weights + in + 2 * out);
+        *footprint = *bytes;
+        break;
+    case KERNEL_FORWARD_PROP_T:
+        *flops = 2 * macs + out;
+        *bytes = 4 * (weights + in + 3 * out);
+        *footprint = *bytes;
+        break;
+    case KERNEL_FORWARD_PROP_BATCH:
+        *flops = BATCH_SAMPLES * (2 * macs + out);
+        *bytes = 4 * (weights + out + BATCH_SAMPLES * (in + out));
+        *footprint = *bytes;
+        break;
+    case KERNEL_BACK_PROP:
+        *flops = 4 * macs + out;
+        *bytes = 4 * (3 * weights + 3 * out + 3 * in);
+        *footprint = 4 * (2 * weights + 2 * out + 2 * in);
+        break;
+    case KERNEL_LIGHT_BACK_PROP:
+        *flops = 2 * macs;
+        *bytes = 4 * (weights + out + in) + DERIV_MASK_WORDS(input_size) * 4;
+        *footprint = *bytes;
+        break;
+    default:
+        *flops = 2 * macs + out;
+        *bytes = 4 * (2 * weights + 3 * out + in);
+        *footprint = 4 * (weights + 2 * out + in);
+        break;
+    }
+}
+
+/* Average seconds per call, cycling through n_copies operands */
+static double time_kernel(const KernelInfo *kernel, KernelFunc func, Operands *copies, int n_copies, int input_size,
+                          int output_size, double min_time)
+{
+    call_kernel(kernel, func, &copies[0], input_size, output_size); // warm up
+    long calls = 0;
+    int c = 0;
+    double start = now_seconds();
+    double elapsed = 0;
+    do
+    {
+        for (int k = 0; k < 16; k++)
+        {
+            call_kernel(kernel, func, &copies[c], input_size, output_size);
+            c = (c + 1 == n_copies) ? 0 : c + 1;
+        }
+        calls += 16;
+        elapsed = now_seconds() - start;
+    } while (elapsed < min_time);
+    return elapsed / calls;
+}
+
+// bytes streamed at least per timing of the bandwidth measurements
+#define STREAM_TIMED_BYTES (1 << 20)
+
+#ifdef __GNUC__
+typedef float PeakVector __attribute__((vector_size(64)));
+#define PEAK_LANES 16
+#else
+typedef float PeakVector;
+#define PEAK_LANES 1
+#endif
+
+/* Best read bandwidth in GB/s of summing a buffer of the given size, from memory when it is larger than the caches.
+    Small buffers are summed several times per timing, so the timer does not dominate. */
+static double measure_read_gbs(size_t bytes, double min_time)
+{
+    size_t n = (bytes / sizeof(PeakVector) + 3) / 4 * 4;
+    int n_passes = 1 + (int)(STREAM_TIMED_BYTES / (n * sizeof(PeakVector)));
+    float *data = (float *)malloc(n * sizeof(PeakVector));
+    for (size_t i = 0; i < n * PEAK_LANES; i++)
+    {
+        data[i] = 1.0f;
+    }
+    double best = 0;
+    double total_time = 0;
+    float check = 0;
+    while (total_time < min_time)
+    {
+        PeakVector sum0, sum1, sum2, sum3, v0, v1, v2, v3;
+        memset(&sum0, 0, sizeof(sum0));
+        sum1 = sum2 = sum3 = sum0;
+        double start = now_seconds();
+        for (int pass = 0; pass < n_passes; pass++)
+        {
+            for (size_t i = 0; i < n * PEAK_LANES; i += 4 * PEAK_LANES)
+            {
+                // memcpy since malloc does not align to the vector size
+                memcpy(&v0, data + i, sizeof(v0));
+                memcpy(&v1, data + i + PEAK_LANES, sizeof(v1));
+                memcpy(&v2, data + i + 2 * PEAK_LANES, sizeof(v2));
+                memcpy(&v3, data + i + 3 * PEAK_LANES, sizeof(v3));
+                sum0 += v0;
+                sum1 += v1;
+                sum2 += v2;
+                sum3 += v3;
+            }
+        }
+        double elapsed = now_seconds() - start;
+        total_time += elapsed;
+        PeakVector sum = sum0 + sum1 + sum2 + sum3;
+        check += ((float *)&sum)[0];
+        double read = (double)n_passes * n * sizeof(PeakVector);
+        best = (read / elapsed > best) ? read / elapsed : best;
+    }
+    free(data);
+    return check == 0 ? 0 : best * 1e-9; // check keeps the sums from being optimized away
+}
+
+/* Best bandwidth in GB/s of a buffer of the given size, the better of the read stream and a read+write stream.
+    The read+write stream is the packed gradient accumulation at the best SIMD level, gradient rows updated in place
+    with activations from the L1 cache, so kernels that write as much as they read, or load wider vectors than the
+    generic read loop, stay below the roof.
+*/
+static double measure_bandwidth_gbs(size_t bytes, double min_time)
+{
+    double read_gbs = measure_read_gbs(bytes, min_time);
+    float activations[256];
+    int width = (int)(sizeof(activations) / sizeof(activations[0]));
+    int n_rows = (int)(bytes / (width * sizeof(float)));
+    n_rows = n_rows < 1 ? 1 : n_rows;
+    float *gradient_weights = (float *)calloc((size_t)n_rows * width, sizeof(float));
+    float *gradients = (float *)malloc(n_rows * sizeof(float));
+    float *gradient_biases = (float *)calloc(n_rows, sizeof(float));
+    int n_passes = 4 + (int)(STREAM_TIMED_BYTES / ((size_t)n_rows * width * sizeof(float)));
+    for (int j = 0; j < width; j++)
+    {
+        activations[j] = 1.0f;
+    }
+    for (int i = 0; i < n_rows; i++)
+    {
+        gradients[i] = 1e-6f;
+    }
+    enum SimdLevel level = get_simd_level();
+    set_simd_level(get_best_simd_level());
+    SpecificBackProp stream = get_fc_specific_back_prop_cached_variant(OUTPUT_MAJOR_PACKED);
+    set_simd_level(level);
+    stream(gradients, activations, n_rows, gradient_weights, gradient_biases, width, width); // warm up
+    double best = 0;
+    double total_time = 0;
+    while (total_time < min_time)
+    {
+        double start = now_seconds();
+        for (int pass = 0; pass < n_passes; pass++)
+        {
+            stream(gradients, activations, n_rows, gradient_weights, gradient_biases, width, width);
+        }
+        double elapsed = now_seconds() - start;
+        total_time += elapsed;
+        // the gradient rows are read and written
+        double gbs = n_passes * 2.0 * n_rows * width * sizeof(float) / elapsed * 1e-9;
+        best = gbs > best ? gbs : best;
+    }
+    free(gradient_weights);
+    free(gradients);
+    free(gradient_biases);
+    return best > read_gbs ? best : read_gbs;
+}
+
+/* FLOP/s of independent multiply-adds in registers, the compute roof for kernels the compiler vectorizes as well.
+    Multiply-adds are fused where the target has FMA, like in the SIMD kernels. */
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("fp-contract=fast")))
+#endif
+static double measure_peak_gflops()
+{
+#if defined(__clang__)
+#pragma clang fp contract(fast)
+#endif
+    PeakVector acc0, acc1, acc2, acc3, acc4, acc5, acc6, acc7, a, b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    a += 0.999999f;
+    b += 1e-7f;
+    acc0 = a;
+    acc1 = a + b;
+    acc2 = acc1 + b;
+    acc3 = acc2 + b;
+    acc4 = acc3 + b;
+    acc5 = acc4 + b;
+    acc6 = acc5 + b;
+    acc7 = acc6 + b;
+    long iterations = 1 << 24;
+    double best = 0;
+    for (int r = 0; r < 5; r++)
+    {
+        double start = now_seconds();
+        for (long i = 0; i < iterations; i++)
+        {
+            acc0 = acc0 * a + b;
+            acc1 = acc1 * a + b;
+            acc2 = acc2 * a + b;
+            acc3 = acc3 * a + b;
+            acc4 = acc4 * a + b;
+            acc5 = acc5 * a + b;
+            acc6 = acc6 * a + b;
+            acc7 = acc7 * a + b;
+        }
+        double elapsed = now_seconds() - start;
+        double flops = 2.0 * 8 * PEAK_LANES * iterations / elapsed;
+        best = flops > best ? flops : best;
+    }
+    PeakVector sum = acc0 + acc1 + acc2 + acc3 + acc4 + acc5 + acc6 + acc7;
+    float *lanes = (float *)&sum;
+    float total = 0;
+    for (int k = 0; k < PEAK_LANES; k++)
+    {
+        total += lanes[k];
+    }
+    return total == 0 ? 0 : best * 1e-9; // total keeps the loop from being optimized away
+}
+
+/* Size of the last level cache where the C library reports it, at least 32 MB */
+static size_t last_level_cache_bytes()
+{
+    long size = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    return size > (32L << 20) ? (size_t)size : (size_t)32 << 20;
+}
+
+static int parse_sizes(const char *text, KernelBenchmarkConfig *config)
+{
+    config->n_sizes = 0;
+    const char *p = text;
+    while (*p != '\0' && config->n_sizes < MAX_SIZES)
+    {
+        char *end;
+        long size = strtol(p, &end, 10);
+        if (end == p || size <= 0)
+        {
+            return -1;
+        }
+        config->sizes[config->n_sizes++] = (int)size;
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return (config->n_sizes > 0 && *p == '\0') ? 0 : -1;
+}
+
+static int parse_args(int argc, char **argv, KernelBenchmarkConfig *config)
+{
+    parse_sizes("16,64,256,1024", config);
+    config->min_time = 0.02;
+    config->cold_bytes = 2 * last_level_cache_bytes();
+    config->peak_gflops = 0;
+    config->peak_gbs = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--sizes") == 0 && has_value)
+        {
+            if (parse_sizes(argv[++i], config) != 0)
+            {
+                fprintf(stderr, "Error kernel benchmark: invalid sizes %s, expected sizes like 16,64,256\n", argv[i]);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--min_time") == 0 && has_value)
+        {
+            config->min_time = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--cold_mb") == 0 && has_value)
+        {
+            config->cold_bytes = (size_t)atol(argv[++i]) << 20;
+        }
+        else if (strcmp(argv[i], "--peak_gflops") == 0 && has_value)
+        {
+            config->peak_gflops = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--peak_gbs") == 0 && has_value)
+        {
+            config->peak_gbs = atof(argv[++i]);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--sizes 16,64,...] [--min_time s] [--cold_mb n] [--peak_gflops x] [--peak_gbs x]\n", argv[0]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    KernelBenchmarkConfig config;
+    if (parse_args(argc, argv, &config) != 0)
+    {
+        return 1;
+    }
+    enum SimdLevel best_level = get_best_simd_level();
+    double peak_gflops = config.peak_gflops > 0 ? config.peak_gflops : measure_peak_gflops();
+    double peak_gbs = config.peak_gbs > 0 ? config.peak_gbs : measure_bandwidth_gbs(config.cold_bytes, 1.0);
+
+    printf("{\n");
+    printf("    \"machine\": {\"best_simd_level\": \"%s\", \"peak_gflops\": %.2f, \"peak_gbs\": %.2f, \"peak_measured\": %s},\n",
+           get_simd_level_name(best_level), peak_gflops, peak_gbs, (config.peak_gflops > 0 && config.peak_gbs > 0) ? "false" : "true");
+    printf("    \"kernels\": [\n");
+    int first = 1;
+    for (int si = 0; si < config.n_sizes; si++)
+    {
+        for (int so = 0; so < config.n_sizes; so++)
+        {
+            int input_size = config.sizes[si];
+            int output_size = config.sizes[so];
+            size_t copy_bytes = operands_bytes(input_size, output_size);
+            int n_copies = (int)(config.cold_bytes / copy_bytes) + 1;
+            n_copies = n_copies < 2 ? 2 : n_copies;
+            // one block for all copies, there can be more of them than the memory tracker keeps blocks
+            char *memory = (char *)malloc(n_copies * copy_bytes);
+            Operands *copies = (Operands *)malloc(n_copies * sizeof(Operands));
+            for (int c = 0; c < n_copies; c++)
+            {
+                create_operands(&copies[c], memory + c * copy_bytes, input_size, output_size);
+            }
+
+            for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+            {
+                const KernelInfo *kernel = &kernels[k];
+                double flops, bytes, footprint;
+                count_work(kernel, input_size, output_size, &flops, &bytes, &footprint);
+                double intensity = flops / bytes;
+                // the roofs are measured over the memory the calls touch, a cycle through the copies of the
+                // operands that a kernel only touches partly can still fit the last level cache
+                double cache_gbs = measure_bandwidth_gbs((size_t)footprint, 0.01);
+                double cold_gbs = measure_bandwidth_gbs((size_t)(footprint * n_copies), 0.05);
+                cold_gbs = cold_gbs > peak_gbs ? cold_gbs : peak_gbs;
+                int n_levels = kernel->simd ? (int)best_level + 1 : 1;
+                for (int level = 0; level < n_levels; level++)
+                {
+                    // ARM builds only have the scalar level and the one fixed at compile time
+                    if (level != SIMD_SCALAR && level != (int)best_level && best_level > SIMD_AVX512)
+                    {
+                        continue;
+                    }
+                    set_simd_level(kernel->simd ? (enum SimdLevel)level : best_level);
+                    for (int a = 0; a < (kernel->per_activation ? N_ACTIVATIONS : 1); a++)
+                    {
+                        KernelFunc func = lookup_kernel(kernel, (enum ActivationType)a);
+                        double warm = time_kernel(kernel, func, copies, 1, input_size, output_size, config.min_time);
+                        double cold = time_kernel(kernel, func, copies, n_copies, input_size, output_size, config.min_time);
+                        double times[2] = {warm, cold};
+                        double bandwidths[2] = {cache_gbs > cold_gbs ? cache_gbs : cold_gbs, cold_gbs};
+                        for (int t = 0; t < 2; t++)
+                        {
+                            double gflops = flops / times[t] * 1e-9;
+                            // the streams only bound the bandwidth from below, a kernel moving its bytes faster sets the roof
+                            double gbs = bytes / times[t] * 1e-9;
+                            bandwidths[t] = gbs > bandwidths[t] ? gbs : bandwidths[t];
+                            double roof = intensity * bandwidths[t] < peak_gflops ? intensity * bandwidths[t] : peak_gflops;
+                            printf("%s        {\"kernel\": \"%s\", \"activation\": \"%s\", \"simd_level\": \"%s\", \"input_size\": %d, "
+                                   "\"output_size\": %d, \"cache\": \"%s\", \"ns_per_call\": %.2f, \"gflops\": %.3f, \"gbs\": %.3f, "
+                                   "\"flops\": %.0f, \"bytes\": %.0f, \"intensity\": %.4f, \"bandwidth_roof_gbs\": %.2f, \"roofline_gflops\": %.3f, "
+                                   "\"roofline_fraction\": %.4f}",
+                                   first ? "" : ",\n", kernel->name, kernel->per_activation ? activation_names[a] : "any",
+                                   kernel->simd ? get_simd_level_name((enum SimdLevel)level) : "n/a", input_size, output_size,
+                                   t == 0 ? "warm" : "cold", times[t] * 1e9, gflops, gbs, flops, bytes, intensity,
+                                   bandwidths[t], roof, gflops / roof);
+                            first = 0;
+                        }
+                    }
+                }
+            }
+
+            free(memory);
+            free(copies);
+        }
+    }
+    printf("\n    ]\n}\n");
+    set_simd_level(best_level);
+    return 0;
+}
@@ -0,0 +1,225 @@
+import argparse
+import datetime
+import glob
+import importlib.util
+import json
+import os
+import platform
+import subprocess
+import sys
+
+HARDWARE_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), ".."))
+PROJECT_ROOT = os.path.abspath(os.path.join(HARDWARE_DIR, "..", ".."))
+CONFIGS_DIR = os.path.join(PROJECT_ROOT, "nn_from_scratch", "model", "generate", "configs")
+
+# larger models than the generated ones, to see how the kernels scale
+SYNTHETIC_SHAPES = ["16,64,64,4", "128,256,256,10", "784,512,256,10"]
+
+# metrics where a lower value is better, all others are throughputs
+LOWER_IS_BETTER = ("predict_latency_us.p50", "predict_latency_us.p99")
+
+
+def build_benchmark(build_dir, cc="gcc", cflags="-O2", name="benchmark"):
+    """
+    Compile a benchmark with the library sources of the hardware directory.
+
+    Args:
+        build_dir (str): Directory of the executable.
+        cc (str): C compiler.
+        cflags (str): Extra compiler flags, e.g. -march=native or -DPACK_WEIGHTS.
+        name (str): Benchmark to build, benchmark or kernel_benchmark.
+
+    Returns:
+        str: Path of the executable.
+    """
+    sources = [os.path.join(HARDWARE_DIR, "benchmark", name + ".c")]
+    sources += sorted(glob.glob(os.path.join(HARDWARE_DIR, "util", "*.c")))
+    sources += sorted(glob.glob(os.path.join(HARDWARE_DIR, "src", "*.c")))
+    os.makedirs(build_dir, exist_ok=True)
+    executable = os.path.join(build_dir, name)
+    command = [cc, "-Wall", "-Wextra", "-std=c99"] + cflags.split() + sources + ["-o", executable, "-lm", "-pthread"]
+    subprocess.run(command, check=True)
+    return executable
+
+
+def get_setting_shape(setting):
+    """
+    Get the shape of the model that model_generator.py creates for a setting, the input and output sizes come from its dataset.
+
+    Args:
+        setting (str): Name of the setting, e.g. setting_1.
+
+    Returns:
+        list: Input size, hidden layer sizes and output size.
+    """
+    from omegaconf import OmegaConf
+
+    cfg = OmegaConf.to_container(OmegaConf.load(os.path.join(CONFIGS_DIR, setting + ".yaml")), resolve=True)
+    spec = importlib.util.spec_from_file_location("imported_module", os.path.join(PROJECT_ROOT, cfg["dataset"]["path"]))
+    imported_module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(imported_module)
+    dataset = imported_module.DatasetSupervisor(**cfg["dataset"]["args"])
+    return [dataset.feature_size] + list(cfg["denses_params"]) + [dataset.num_labels]
+
+
+def run_benchmark(executable, name, shape, packed=False, min_time=0.2):
+    """
+    Run the benchmark for one model shape.
+
+    Returns:
+        dict: The results printed by benchmark.c, with the name of the run.
+    """
+    command = [executable, "--shape", ",".join(map(str, shape)), "--min_time", str(min_time)]
+    if packed:
+        command.append("--packed")
+    output = subprocess.run(command, check=True, capture_output=True, text=True).stdout
+    result = json.loads(output)
+    result["name"] = name + ("_packed" if packed else "")
+    return result
+
+
+def get_metric(result, path):
+    value = result
+    for key in path.split("."):
+        value = value[key]
+    return value
+
+
+def compare_results(results, baseline, threshold):
+    """
+    Compare results with a previous run, a metric regresses when it is worse by more than threshold (relative).
+
+    Returns:
+        list: A message for every regression.
+    """
+    metrics = list(LOWER_IS_BETTER) + ["predict_batch_samples_per_s", "train_full.samples_per_s",
+                                       "train_layer.samples_per_s", "train_partial.samples_per_s"]
+    baseline_runs = {run["name"]: run for run in baseline["results"]}
+    regressions = []
+    for run in results:
+        if run["name"] not in baseline_runs:
+            continue
+        for metric in metrics:
+            new = get_metric(run, metric)
+            old = get_metric(baseline_runs[run["name"]], metric)
+            change = (new - old) / old if old else 0.0
+            if metric in LOWER_IS_BETTER:
+                change = -change
+            print("{:<28} {:<30} {:>14.3f} -> {:>14.3f} ({:+.1%})".format(run["name"], metric, old, new, change))
+            if change < -threshold:
+                regressions.append("{} {} regressed by {:.1%}".format(run["name"], metric, -change))
+    return regressions
+
+
+def run_kernel_benchmark(executable, sizes, min_time, peak_gflops=None, peak_gbs=None):
+    """
+    Run the kernel microbenchmark over all pairs of the input and output sizes.
+
+    Returns:
+        dict: The machine roofs and a result per kernel, activation, SIMD level, size and cache state.
+    """
+    command = [executable, "--sizes", ",".join(map(str, sizes)), "--min_time", str(min_time)]
+    if peak_gflops is not None:
+        command += ["--peak_gflops", str(peak_gflops)]
+    if peak_gbs is not None:
+        command += ["--peak_gbs", str(peak_gbs)]
+    output = subprocess.run(command, check=True, capture_output=True, text=True).stdout
+    return json.loads(output)
+
+
+def print_kernel_table(kernel_results, activation="RELU"):
+    """
+    Print a table of the kernel results of one activation, the other activations only differ in the activation function.
+    """
+    machine = kernel_results["machine"]
+    print("Roofs: {:.1f} GFLOP/s, {:.1f} GB/s main memory".format(machine["peak_gflops"], machine["peak_gbs"]))
+    print("{:<36} {:<8} {:>11} {:<5} {:>14} {:>9} {:>9} {:>7} {:>7}".format(
+        "kernel", "simd", "in x out", "cache", "ns/call", "GFLOP/s", "GB/s", "FLOP/B", "roof"))
+    for result in kernel_results["kernels"]:
+        if result["activation"] not in (activation, "any"):
+            continue
+        print("{:<36} {:<8} {:>11} {:<5} {:>14.1f} {:>9.2f} {:>9.2f} {:>7.2f} {:>6.0%}".format(
+            result["kernel"], result["simd_level"], "{}x{}".format(result["input_size"], result["output_size"]), result["cache"],
+            result["ns_per_call"], result["gflops"], result["gbs"], result["intensity"], result["roofline_fraction"]))
+
+
+def get_git_commit():
+    try:
+        return subprocess.run(["git", "rev-parse", "HEAD"], cwd=PROJECT_ROOT, check=True, capture_output=True, text=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Benchmark the C inference and training paths (Linux)")
+    parser.add_argument("--settings", nargs="*", default=["setting_1", "setting_2"], help="Model settings of model_generator.py to benchmark")
+    parser.add_argument("--shapes", nargs="*", default=SYNTHETIC_SHAPES, help="Additional model shapes like 16,64,4 (input, layers, output)")
+    parser.add_argument("--packed", action="store_true", help="Also benchmark every model with the packed weights layout")
+    parser.add_argument("--cc", type=str, default="gcc", help="C compiler")
+    parser.add_argument("--cflags", type=str, default="-O2 -march=native", help="Compiler flags")
+    parser.add_argument("--min_time", type=float, default=None, help="Seconds each measurement runs for at least, 0.2 or 0.02 with --kernels")
+    parser.add_argument("--build_dir", type=str, default=os.path.join(PROJECT_ROOT, "build", "benchmark"), help="Directory of the executable")
+    parser.add_argument("--output", type=str, default=None, help="Path of the JSON results, benchmark_results.json or kernel_results.json with --kernels")
+    parser.add_argument("--compare", type=str, default=None, help="JSON results of a previous run to check for regressions")
+    parser.add_argument("--threshold", type=float, default=0.1, help="Relative slowdown that counts as a regression")
+    parser.add_argument("--kernels", action="store_true", help="Run the kernel microbenchmark instead of the model benchmark")
+    parser.add_argument("--sizes", nargs="*", type=int, default=[16, 64, 256, 1024], help="Layer input and output sizes of the kernel microbenchmark")
+    parser.add_argument("--peak_gflops", type=float, default=None, help="Compute roof of the kernel microbenchmark, measured if not given")
+    parser.add_argument("--peak_gbs", type=float, default=None, help="Main memory bandwidth roof of the kernel microbenchmark, measured if not given")
+    args = parser.parse_args()
+
+    meta = {
+        "time": datetime.datetime.now().isoformat(timespec="seconds"),
+        "git_commit": get_git_commit(),
+        "machine": platform.machine(),
+        "processor": platform.processor(),
+        "cc": args.cc,
+        "cflags": args.cflags,
+    }
+
+    if args.kernels:
+        executable = build_benchmark(args.build_dir, args.cc, args.cflags, "kernel_benchmark")
+        print("Benchmarking the kernels for sizes {} ...".format(args.sizes), flush=True)
+        min_time = args.min_time if args.min_time is not None else 0.02
+        kernel_results = run_kernel_benchmark(executable, args.sizes, min_time, args.peak_gflops, args.peak_gbs)
+        print_kernel_table(kernel_results)
+        output = args.output if args.output is not None else "kernel_results.json"
+        with open(output, "w") as f:
+            json.dump(dict(meta=meta, **kernel_results), f, indent=4)
+        print("Results written to {}".format(output))
+        sys.exit(0)
+
+    min_time = args.min_time if args.min_time is not None else 0.2
+    output = args.output if args.output is not None else "benchmark_results.json"
+    executable = build_benchmark(args.build_dir, args.cc, args.cflags)
+
+    runs = []
+    for setting in args.settings:
+        try:
+            runs.append((setting, get_setting_shape(setting)))
+        except Exception as e:
+            print("Skipping {}, could not get its shape: {}".format(setting, e))
+    runs += [("synthetic_" + shape.replace(",", "x"), [int(s) for s in shape.split(",")]) for shape in args.shapes]
+
+    results = []
+    for name, shape in runs:
+        for packed in ([False, True] if args.packed else [False]):
+            print("Benchmarking {} {}{} ...".format(name, shape, " packed" if packed else ""), end=" ", flush=True)
+            results.append(run_benchmark(executable, name, shape, packed, min_time))
+            print("Done")
+
+    report = {
+        "meta": meta,
+        "results": results,
+    }
+    with open(output, "w") as f:
+        json.dump(report, f, indent=4)
+    print("Results written to {}".format(output))
+
+    if args.compare is not None:
+        with open(args.compare, "r") as f:
+            baseline = json.load(f)
+        regressions = compare_results(results, baseline, args.threshold)
+        for regression in regressions:
+            print("REGRESSION: " + regression)
+        sys.exit(1 if regressions else 0)
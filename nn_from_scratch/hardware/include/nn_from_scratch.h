@@ -1,3 +1,17 @@
 #include "../util/config.h"
 #include "../src/partial_model_fc.h"
+#include "../src/masked_model_fc.h"
+#include "../src/feature_cache.h"
 #include "../src/model_fc.h"
+#include "../src/parallel_model_fc.h"
+#include "../src/trainer_fc.h"
+#include "../src/quant_model_fc.h"
+#include "../src/fixed_model_fc.h"
+#include "../src/partial_fixed_model_fc.h"
+#include "../src/half_model_fc.h"
+#include "../util/simd_dispatch.h"
+#include "../util/model_file.h"
+#include "../util/data_loader.h"
+#include "../util/profiler.h"
+#include "../util/heap_emulator.h"
+#include "../util/sparse_prop.h"
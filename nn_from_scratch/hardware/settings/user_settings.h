@@ -1,3 +1,17 @@
 #define ENABLE_TRACK_MEMORY
+// #define ENABLE_HEAP_EMULATION
+// #define PACK_WEIGHTS
+// #define ENABLE_PARALLEL_TRAINING
+// #define ENABLE_QUANT_MODEL
+// #define ENABLE_FIXED_POINT_TRAINING
+// #define ENABLE_HALF_MODEL
+// #define HALF_MODEL_FORMAT HALF_BF16
+// #define ENABLE_SPECIALIZED_MODEL
+// #define ENABLE_MODEL_FILE
+// #define ENABLE_DATA_LOADER
+// #define ENABLE_DATA_PREFETCH
+// #define ENABLE_PROFILING
+// #define OPTIMIZER ADAM
+// #define GRADIENT_CHECKPOINT_BUDGET 16384
 #define BATCH_SIZE 64
 #define LEARNING_RATE 0.001
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "feature_cache.h"
+#include "model_fc.h"
+#include "partial_model_fc.h"
+#include "../util/half_float.h"
+#include "../util/config.h"
+
+static size_t feature_value_size(enum FeatureStorage storage)
+{
+    switch (storage)
+    {
+    case FEATURE_FP16:
+        return sizeof(half_t);
+    case FEATURE_INT8:
+        return sizeof(int8_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+/* Number of bytes needed for the cached features of n_samples samples, see set_feature_cache */
+size_t feature_cache_memory_size(Model *model, int prefix_layers, int n_samples, enum FeatureStorage storage)
+{
+    size_t feature_size = model->layers_size[prefix_layers - 1];
+    size_t size = n_samples * feature_size * feature_value_size(storage);
+    size = (size + sizeof(float) - 1) / sizeof(float) * sizeof(float); // the floats after it stay aligned
+    if (storage == FEATURE_INT8)
+    {
+        size += n_samples * sizeof(float);
+    }
+    if (storage != FEATURE_FP32)
+    {
+        size += BATCH_SIZE * feature_size * sizeof(float);
+    }
+    return size;
+}
+
+/* stores the features of n samples, the decoded batch buffer holds them as floats */
+static void encode_features(FeatureCache *cache, int first_sample, int n, float *values)
+{
+    int size = cache->feature_size;
+    for (int s = 0; s < n; s++)
+    {
+        float *sample = values + s * size;
+        size_t offset = (size_t)(first_sample + s) * size;
+        if (cache->storage == FEATURE_FP16)
+        {
+            half_t *features = (half_t *)cache->features + offset;
+            for (int j = 0; j < size; j++)
+            {
+                features[j] = float_to_half(sample[j]);
+            }
+        }
+        else
+        {
+            float max_abs = 0;
+            for (int j = 0; j < size; j++)
+            {
+                max_abs = fmaxf(max_abs, fabsf(sample[j]));
+            }
+            float scale = (max_abs > 0) ? max_abs / 127 : 1;
+            int8_t *features = (int8_t *)cache->features + offset;
+            for (int j = 0; j < size; j++)
+            {
+                features[j] = (int8_t)lrintf(sample[j] / scale);
+            }
+            cache->scales[first_sample + s] = scale;
+        }
+    }
+}
+
+/* Runs the frozen prefix over the samples and binds a caller-provided block of at least feature_cache_memory_size bytes
+    to the cache. The block must be aligned for floats.
+    @param prefix_layers: number of frozen layers at the front, at least 1 and below n_layers
+    @param samples_x: n_samples inputs of the model, one after the other
+    @return 1 on success, 0 when the prefix is invalid
+*/
+int set_feature_cache(FeatureCache *cache, Model *model, int prefix_layers, float *samples_x, int n_samples, enum FeatureStorage storage,
+                      void *buffer)
+{
+    if (prefix_layers < 1 || prefix_layers >= model->n_layers || n_samples < 1)
+    {
+        printf("Invalid arguments for the feature cache! \n");
+        return 0;
+    }
+    cache->model = model;
+    cache->prefix_layers = prefix_layers;
+    cache->n_samples = n_samples;
+    cache->feature_size = model->layers_size[prefix_layers - 1];
+    cache->storage = storage;
+    cache->features = buffer;
+
+    size_t features_size = (size_t)n_samples * cache->feature_size * feature_value_size(storage);
+    float *data = (float *)buffer + (features_size + sizeof(float) - 1) / sizeof(float);
+    cache->scales = NULL;
+    cache->batch = NULL;
+    if (storage == FEATURE_INT8)
+    {
+        cache->scales = data;
+        data += n_samples;
+    }
+    if (storage != FEATURE_FP32)
+    {
+        cache->batch = data;
+    }
+
+    Model prefix = *model;
+    prefix.n_layers = prefix_layers;
+    prefix.output_size = cache->feature_size;
+    if (storage == FEATURE_FP32)
+    {
+        fc_model_predict_batch(&prefix, samples_x, n_samples, (float *)cache->features);
+    }
+    else
+    {
+        // encoded a batch at a time, so the floats never take more than the decoding buffer
+        for (int s = 0; s < n_samples; s += BATCH_SIZE)
+        {
+            int n = (n_samples - s < BATCH_SIZE) ? n_samples - s : BATCH_SIZE;
+            fc_model_predict_batch(&prefix, samples_x + (size_t)s * model->input_size, n, cache->batch);
+            encode_features(cache, s, n, cache->batch);
+        }
+    }
+
+    setModel(&cache->head, model->n_layers - prefix_layers, cache->feature_size, model->output_size, model->layers_size + prefix_layers,
+             model->layers_weights + prefix_layers, model->layers_biases + prefix_layers, model->layers_activation + prefix_layers);
+    cache->head.weights_layout = model->weights_layout;
+    cache->head.layers_sparse = (model->layers_sparse != NULL) ? model->layers_sparse + prefix_layers : NULL;
+    cache->memory = NULL;
+    return 1;
+}
+
+/* Computes the features of the frozen first prefix_layers layers of the model for n_samples samples
+    @return the cache, NULL when the prefix is invalid
+*/
+FeatureCache *create_feature_cache(Model *model, int prefix_layers, float *samples_x, int n_samples, enum FeatureStorage storage)
+{
+    if (prefix_layers < 1 || prefix_layers >= model->n_layers)
+    {
+        printf("Invalid arguments for the feature cache! \n");
+        return NULL;
+    }
+    FeatureCache *cache = (FeatureCache *)malloc(sizeof(FeatureCache));
+    void *buffer = malloc(feature_cache_memory_size(model, prefix_layers, n_samples, storage));
+    if (!set_feature_cache(cache, model, prefix_layers, samples_x, n_samples, storage, buffer))
+    {
+        free(buffer);
+        free(cache);
+        return NULL;
+    }
+    cache->memory = buffer;
+    return cache;
+}
+
+void free_feature_cache(FeatureCache *cache)
+{
+    if (cache->memory != NULL)
+    {
+        free(cache->memory);
+    }
+    free(cache);
+}
+
+/* Features of BATCH_SIZE samples starting at first_sample, the input of a batch of the head.
+    @return the features in place for FEATURE_FP32, else decoded into the batch buffer of the cache
+*/
+float *feature_cache_batch(FeatureCache *cache, int first_sample)
+{
+    int size = cache->feature_size;
+    size_t offset = (size_t)first_sample * size;
+    if (cache->storage == FEATURE_FP32)
+    {
+        return (float *)cache->features + offset;
+    }
+    for (int s = 0; s < BATCH_SIZE; s++)
+    {
+        float *sample = cache->batch + s * size;
+        if (cache->storage == FEATURE_FP16)
+        {
+            half_t *features = (half_t *)cache->features + offset + s * size;
+            for (int j = 0; j < size; j++)
+            {
+                sample[j] = half_to_float(features[j]);
+            }
+        }
+        else
+        {
+            int8_t *features = (int8_t *)cache->features + offset + s * size;
+            float scale = cache->scales[first_sample + s];
+            for (int j = 0; j < size; j++)
+            {
+                sample[j] = features[j] * scale;
+            }
+        }
+    }
+    return cache->batch;
+}
+
+/* checks that a batch of the cache exists and that the target layer is above the frozen prefix */
+static int check_cached_arguments(FeatureCache *cache, int first_sample, int target_layer)
+{
+    if (first_sample < 0 || first_sample + BATCH_SIZE > cache->n_samples || target_layer < cache->prefix_layers ||
+        target_layer >= cache->model->n_layers)
+    {
+        printf("Invalid arguments for cached layer training! \n");
+        return 0;
+    }
+    return 1;
+}
+
+/* fc_model_train_partial_layer on one batch of the cache, the frozen prefix is not run again.
+    @param first_sample: index of the first cached sample of the batch
+    @param samples_y: expected outputs of the BATCH_SIZE samples starting at first_sample
+    @param target_layer: layer of the model to train, at or above prefix_layers
+*/
+void fc_model_train_partial_layer_cached(FeatureCache *cache, Optimizer *optimizer, int first_sample, float (*samples_y)[cache->model->output_size],
+                                         int target_layer, int n_weights, int offset)
+{
+    if (!check_cached_arguments(cache, first_sample, target_layer))
+    {
+        return;
+    }
+    float *features = feature_cache_batch(cache, first_sample);
+    fc_model_train_partial_layer(&cache->head, optimizer, (float(*)[cache->feature_size])features, samples_y,
+                                 target_layer - cache->prefix_layers, n_weights, offset);
+}
+
+/* fc_model_train_layer on one batch of the cache
+    @param optimizer: optimizer created with create_partial_optimizer for the whole layer, NULL for plain SGD with LEARNING_RATE
+*/
+void fc_model_train_layer_cached(FeatureCache *cache, Optimizer *optimizer, int first_sample, float (*samples_y)[cache->model->output_size],
+                                 int target_layer)
+{
+    if (!check_cached_arguments(cache, first_sample, target_layer))
+    {
+        return;
+    }
+    fc_model_train_partial_layer_cached(cache, optimizer, first_sample, samples_y, target_layer,
+                                        cache->model->layers_size[target_layer - 1], 0);
+}
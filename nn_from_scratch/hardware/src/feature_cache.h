@@ -0,0 +1,48 @@
+#ifndef FEATURE_CACHE_H
+#define FEATURE_CACHE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "../util/model_binding.h"
+#include "../util/optimizer.h"
+
+enum FeatureStorage
+{
+    FEATURE_FP32,
+    FEATURE_FP16, // half the memory, about 3 significant digits
+    FEATURE_INT8  // a quarter of the memory, symmetric with one scale per sample
+};
+
+/* Outputs of the frozen first prefix_layers layers for a set of samples, computed once so that fine-tuning the layers
+   above them skips the prefix in every epoch. head is a view of the layers above the prefix that shares their weights
+   with the model, training it trains the model, see fc_model_train_layer_cached.
+   The trainers of trainer_fc.h can be created for the head as well, with batches from feature_cache_batch.
+   The cache is stale once a prefix layer changes, and the view once the model is repacked.
+*/
+typedef struct
+{
+    Model *model;
+    Model head; // layers prefix_layers and above, its input is the cached features
+    int prefix_layers;
+    int n_samples;
+    int feature_size; // size of the last prefix layer
+    enum FeatureStorage storage;
+    void *features;  // n_samples * feature_size values of the storage type
+    float *scales;   // dequantization scale of each sample, FEATURE_INT8 only
+    float *batch;    // BATCH_SIZE decoded samples, NULL for FEATURE_FP32 which is used in place
+    void *memory;    // owned memory, NULL when the block is provided by the caller
+} FeatureCache;
+
+size_t feature_cache_memory_size(Model *model, int prefix_layers, int n_samples, enum FeatureStorage storage);
+int set_feature_cache(FeatureCache *cache, Model *model, int prefix_layers, float *samples_x, int n_samples, enum FeatureStorage storage,
+                      void *buffer);
+FeatureCache *create_feature_cache(Model *model, int prefix_layers, float *samples_x, int n_samples, enum FeatureStorage storage);
+void free_feature_cache(FeatureCache *cache);
+
+float *feature_cache_batch(FeatureCache *cache, int first_sample);
+
+void fc_model_train_partial_layer_cached(FeatureCache *cache, Optimizer *optimizer, int first_sample, float (*samples_y)[cache->model->output_size],
+                                         int target_layer, int n_weights, int offset);
+void fc_model_train_layer_cached(FeatureCache *cache, Optimizer *optimizer, int first_sample, float (*samples_y)[cache->model->output_size],
+                                 int target_layer);
+
+#endif
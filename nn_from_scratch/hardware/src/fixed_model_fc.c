@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include "fixed_model_fc.h"
+#include "../util/fixed_prop.h"
+#include "../util/loss_functions.h"
+#include "../util/config.h"
+#include <stdio.h>
+
+/* Fixed-point fc_calc_gradients, forward propagation and backpropagation in integer arithmetic,
+    accumulating the gradients of one sample into the gradient structure.
+    Unlike the float path the input sample is left untouched.
+*/
+void fc_fixed_calc_gradients(FixedModel *model, fixed_t *input, fixed_t *actual, FixedGradients *gradients)
+{
+    fixed_t *curr_in = input;
+    int size = model->input_size;
+    ForwardPropTFixed forward_prop = fc_forward_prop_t_fixed_LINEAR;
+
+    // forward propagate through each layer
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        curr_in = forward_prop(curr_in, size, gradients->net_inputs[i],
+                               model->layers_size[i], model->layers_weights[i], model->layers_biases[i]);
+        size = model->layers_size[i];
+        forward_prop = get_fc_forward_prop_t_fixed_variant(model->layers_activation[i]);
+    }
+
+    // calculate loss derivative, on the activated outputs like the float path
+    enum ActivationType last_activation = model->layers_activation[model->n_layers - 1];
+    fixed_t loss_deriv = fixed_MSE_derivative(curr_in, actual, model->output_size, last_activation);
+
+    // calculate initial gradient
+    for (int i = 0; i < model->output_size; i++)
+    {
+        fixed_t *net_input = &gradients->net_inputs[model->n_layers - 1][i];
+        *net_input = loss_deriv * fixed_activation_deriv(last_activation, *net_input);
+    }
+
+    // perform backprop
+    for (int i = model->n_layers - 1; i > 0; i--)
+    {
+        BackPropFixed back_prop = get_fc_back_prop_fixed_variant(model->layers_activation[i - 1]);
+        back_prop(gradients->net_inputs[i], gradients->net_inputs[i - 1], model->layers_weights[i],
+                  model->layers_size[i], model->layers_size[i - 1], gradients->weights[i], gradients->biases[i]);
+    }
+
+    // the first layer only needs its own gradients, nothing is propagated into the input
+    fc_specific_back_prop_fixed_LINEAR(gradients->net_inputs[0], input, model->layers_size[0],
+                                       gradients->weights[0], gradients->biases[0], model->input_size);
+}
+
+/* Scales a summed gradient to a weight step, gradient * 2^-(FIXED_FRAC_BITS + FIXED_GRADIENT_SHIFT).
+    The shift replaces LEARNING_RATE / BATCH_SIZE, rounding is stochastic with FIXED_STOCHASTIC_ROUNDING.
+*/
+fixed_acc_t fc_fixed_gradient_step(FixedModel *model, fixed_acc_t gradient)
+{
+    int shift = FIXED_FRAC_BITS + FIXED_GRADIENT_SHIFT;
+#if FIXED_STOCHASTIC_ROUNDING
+    // xorshift32
+    uint32_t x = model->rounding_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    model->rounding_state = x;
+    int64_t rounding = x & (((uint32_t)1 << shift) - 1);
+#else
+    (void)model;
+    int64_t rounding = (int64_t)1 << (shift - 1);
+#endif
+    return (fixed_acc_t)(((int64_t)gradient + rounding) >> shift);
+}
+
+/* Applies gradients for a fully connected layer, saturating the weights and biases */
+void fc_fixed_apply_gradient(FixedModel *model, int layer, int layer_size, int prev_layer_size, FixedGradients *gradients)
+{
+    for (int i = 0; i < layer_size; i++)
+    {
+        fixed_t *bias = &model->layers_biases[layer][i];
+        *bias = fixed_saturate(*bias - fc_fixed_gradient_step(model, gradients->biases[layer][i]));
+        for (int j = 0; j < prev_layer_size; j++)
+        {
+            fixed_t *weight = &model->layers_weights[layer][i + j * layer_size];
+            *weight = fixed_saturate(*weight - fc_fixed_gradient_step(model, gradients->weights[layer][i + j * layer_size]));
+        }
+    }
+}
+
+/* train fixed-point model for batch_size amount of samples
+    @param model: pointer to fixed-point model
+    @param samples_x: input samples, see float_to_fixed_array
+    @param samples_y: expected output samples
+*/
+void fc_fixed_model_train(FixedModel *model, fixed_t (*samples_x)[model->input_size], fixed_t (*samples_y)[model->output_size])
+{
+    FixedGradients *gradients = allocate_fixed_gradients(model);
+
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        fc_fixed_calc_gradients(model, samples_x[i], samples_y[i], gradients);
+    }
+    // loop over the gradients and apply step
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        fc_fixed_apply_gradient(model, i, model->layers_size[i], size, gradients);
+        size = model->layers_size[i];
+    }
+
+    free_fixed_gradients(gradients, model);
+}
+
+/* Function to calculate fixed-point model output without touching the heap.
+    @param model: pointer to fixed-point model
+    @param workspace: buffer of at least fixed_workspace_size(model) values
+    @param input: input sample
+    @param output: pointer to where the output_size outputs will be stored
+*/
+void fc_fixed_model_predict_into(FixedModel *model, fixed_t *workspace, fixed_t *input, fixed_t *output)
+{
+    int half = fixed_workspace_size(model) / 2;
+    fixed_t *curr_in = input;
+    int size = model->input_size;
+    ForwardPropTFixed forward_prop = fc_forward_prop_t_fixed_LINEAR;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        fixed_t *curr_out = (i == model->n_layers - 1) ? output : workspace + (i % 2) * half;
+        curr_in = forward_prop(curr_in, size, curr_out, model->layers_size[i], model->layers_weights[i], model->layers_biases[i]);
+        size = model->layers_size[i];
+        forward_prop = get_fc_forward_prop_t_fixed_variant(model->layers_activation[i]);
+    }
+    for (int i = 0; i < model->output_size; i++)
+    {
+        output[i] = fixed_activation(model->layers_activation[model->n_layers - 1], output[i]);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef FIXED_MODEL_FC_H
+#define FIXED_MODEL_FC_H
+#include "../util/fixed_model_binding.h"
+#include "../util/fixed_model_gradients.h"
+
+void fc_fixed_calc_gradients(FixedModel *model, fixed_t *input, fixed_t *actual, FixedGradients *gradients);
+
+fixed_acc_t fc_fixed_gradient_step(FixedModel *model, fixed_acc_t gradient);
+
+void fc_fixed_apply_gradient(FixedModel *model, int layer, int layer_size, int prev_layer_size, FixedGradients *gradients);
+
+void fc_fixed_model_train(FixedModel *model, fixed_t (*samples_x)[model->input_size], fixed_t (*samples_y)[model->output_size]);
+
+void fc_fixed_model_predict_into(FixedModel *model, fixed_t *workspace, fixed_t *input, fixed_t *output);
+
+#endif
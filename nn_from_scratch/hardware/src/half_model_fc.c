@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util/half_prop.h"
+#include "../util/back_prop.h"
+#include "../util/loss_functions.h"
+#include "half_model_fc.h"
+#include "partial_model_fc.h"
+#include "../util/config.h"
+#include <stdio.h>
+
+/* Function to calculate the output of a half precision model without touching the heap.
+    Hidden layers ping-pong between the two halves of the workspace, the last layer writes into output.
+
+    @param model: pointer to half precision model
+    @param workspace: buffer of at least half_workspace_size(model) floats
+    @param input: input sample
+    @param output: pointer to where the output_size outputs will be stored
+*/
+void fc_half_model_predict_into(HalfModel *model, float *workspace, float *input, float *output)
+{
+    int half = half_workspace_size(model) / 2;
+    float *curr_in = input;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        float *curr_out = (i == model->n_layers - 1) ? output : workspace + (i % 2) * half;
+        ForwardPropHalf forward_prop = get_fc_forward_prop_half_variant(model->layers_activation[i]);
+        forward_prop(curr_in, model->layers_weights[i], model->layers_biases[i], size, model->layers_size[i], model->format, curr_out);
+        curr_in = curr_out;
+        size = model->layers_size[i];
+    }
+}
+
+/* Model with the sizes of a half precision model and no weights, for the gradient buffers shared with the float model */
+static void half_model_shape(HalfModel *model, Model *shape)
+{
+    setModel(shape, model->n_layers, model->input_size, model->output_size, model->layers_size, NULL, NULL, model->layers_activation);
+}
+
+/* partial_calc_gradients for a half precision model, the forward pass runs on the 16 bit weights and everything else in float */
+void half_partial_calc_gradients(float *input, HalfModel *model, int target_layer, int n_weights, int offset, float *actual,
+                                 PartialGradients *gradients)
+{
+    float *curr_in = input;
+    float *net_inputs = gradients->buffers[2];
+    int size = model->input_size;
+
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        float *output = gradients->buffers[i % 2]; // activations, input of the next layer
+        if (i == target_layer) // store the activations feeding the target weights
+        {
+            memcpy(gradients->net_input, curr_in + offset, n_weights * sizeof(float));
+        }
+        ForwardPropTHalf forward_prop = get_fc_forward_prop_t_half_variant(model->layers_activation[i]);
+        forward_prop(curr_in, model->layers_weights[i], model->layers_biases[i], size, model->layers_size[i], model->format, net_inputs, output);
+
+        if (i >= target_layer)
+        { // else only store derivative of the input
+            ActivationFunc func_deriv = get_activation_func_deriv(model->layers_activation[i]);
+            for (int j = 0; j < model->layers_size[i]; j++)
+            {
+                deriv_mask_set(gradients->deriv_activations[i - target_layer], j, func_deriv(net_inputs[j]) != 0);
+            }
+        }
+        curr_in = output;
+        size = model->layers_size[i];
+    }
+
+    float loss_deriv = MSE_derivative(curr_in, actual, model->output_size);
+    for (int i = 0; i < model->output_size; i++)
+    {
+        curr_in[i] = loss_deriv;
+    }
+    deriv_mask_apply(curr_in, gradients->deriv_activations[model->n_layers - 1 - target_layer], model->output_size);
+
+    for (int i = model->n_layers - 1; i > target_layer; i--)
+    {
+        float *output = (curr_in == gradients->buffers[0]) ? gradients->buffers[1] : gradients->buffers[0];
+        fc_light_back_prop_half_into(curr_in, model->layers_weights[i], model->layers_size[i], model->layers_size[i - 1], model->format,
+                                     gradients->deriv_activations[i - target_layer - 1], output);
+        curr_in = output;
+    }
+    SpecificBackProp specific_back_prop = get_fc_specific_back_prop_cached_variant(INPUT_MAJOR);
+    specific_back_prop(curr_in, gradients->net_input, model->layers_size[target_layer], gradients->weights, gradients->biases,
+                       n_weights, model->layers_size[target_layer]);
+}
+
+/* Applies the gradients of the trained slice to its fp32 master copy, see setHalfTrainableSlice, and rounds the master copy
+    into the 16 bit weights the forward pass reads */
+void fc_half_apply_specific_gradients(HalfModel *model, Optimizer *optimizer, PartialGradients *gradients)
+{
+    int layer = model->master_layer;
+    int layer_size = model->layers_size[layer];
+    int n_values = model->master_n_weights * layer_size;
+    optimizer_update(optimizer, 1, 0, model->layers_biases[layer], gradients->biases, layer_size);
+    optimizer_update(optimizer, 0, 0, model->master_weights, gradients->weights, n_values);
+
+    half_t *weights = model->layers_weights[layer] + model->master_offset * layer_size;
+    for (int j = 0; j < n_values; j++)
+    {
+        weights[j] = float_to_half_format(model->master_weights[j], model->format);
+    }
+}
+
+/* fc_model_train_partial_layer for a half precision model. The slice gets an fp32 master copy on its first batch,
+    training another slice rounds it into the weights and replaces it, see setHalfTrainableSlice.
+    @param optimizer: optimizer created with create_partial_optimizer for the slice on the float model, NULL for plain SGD with LEARNING_RATE
+ */
+void fc_half_model_train_partial_layer(HalfModel *model, Optimizer *optimizer, float (*samples_x)[model->input_size],
+                                       float (*samples_y)[model->output_size], int target_layer, int n_weights, int offset)
+{
+    Model shape;
+    half_model_shape(model, &shape);
+    if (!check_partial_arguments(&shape, target_layer, n_weights, offset))
+    {
+        return;
+    }
+    Optimizer default_optimizer;
+    if (optimizer == NULL)
+    {
+        default_optimizer = get_default_optimizer();
+        optimizer = &default_optimizer;
+    }
+    else if (!check_partial_optimizer(optimizer, model->layers_size[target_layer], n_weights))
+    {
+        return;
+    }
+    if (!setHalfTrainableSlice(model, target_layer, n_weights, offset))
+    {
+        return;
+    }
+
+    PartialGradients *gradients = allocate_partial_gradients(&shape, target_layer, n_weights);
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        half_partial_calc_gradients(samples_x[i], model, target_layer, n_weights, offset, samples_y[i], gradients);
+    }
+    optimizer_next_step(optimizer);
+    fc_half_apply_specific_gradients(model, optimizer, gradients);
+    free_partial_gradients(gradients);
+}
+
+/* train a specific layer of a half precision model
+    @param optimizer: optimizer created with create_partial_optimizer for the whole layer, NULL for plain SGD with LEARNING_RATE
+*/
+void fc_half_model_train_layer(HalfModel *model, Optimizer *optimizer, float (*samples_x)[model->input_size],
+                               float (*samples_y)[model->output_size], int target_layer)
+{
+    if (target_layer < 0 || target_layer >= model->n_layers)
+    {
+        printf("Invalid arguments for layer training! \n");
+        return;
+    }
+    int n_weights = (target_layer == 0) ? model->input_size : model->layers_size[target_layer - 1];
+    fc_half_model_train_partial_layer(model, optimizer, samples_x, samples_y, target_layer, n_weights, 0);
+}
@@ -0,0 +1,19 @@
+#ifndef HALF_MODEL_FC_H
+#define HALF_MODEL_FC_H
+#include "../util/half_model_binding.h"
+#include "../util/model_gradients.h"
+#include "../util/optimizer.h"
+
+void fc_half_model_predict_into(HalfModel *model, float *workspace, float *input, float *output);
+
+void half_partial_calc_gradients(float *input, HalfModel *model, int target_layer, int n_weights, int offset, float *actual,
+                                 PartialGradients *gradients);
+void fc_half_apply_specific_gradients(HalfModel *model, Optimizer *optimizer, PartialGradients *gradients);
+
+void fc_half_model_train_partial_layer(HalfModel *model, Optimizer *optimizer, float (*samples_x)[model->input_size],
+                                       float (*samples_y)[model->output_size], int target_layer, int n_weights, int offset);
+
+void fc_half_model_train_layer(HalfModel *model, Optimizer *optimizer, float (*samples_x)[model->input_size],
+                               float (*samples_y)[model->output_size], int target_layer);
+
+#endif
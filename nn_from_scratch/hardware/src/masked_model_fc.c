@@ -0,0 +1,161 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util/forward_prop.h"
+#include "../util/activation_functions.h"
+#include "../util/back_prop.h"
+#include "../util/sparse_prop.h"
+#include "../util/loss_functions.h"
+#include "masked_model_fc.h"
+#include "../util/config.h"
+#include <stdio.h>
+
+/* function to calculate the gradients of the trainable layers of a freeze mask.
+    The forward pass writes the activations feeding a trainable layer straight into its cache, the others ping-pong in
+    the scratch buffers. Back propagation runs through the frozen layers with the derivative masks and stops at the
+    first trainable layer.
+*/
+void masked_calc_gradients(Model *model, float *input, float *actual, MaskedGradients *gradients)
+{
+    float *curr_in = input;
+    float *net_inputs = gradients->buffers[2];
+    int first = gradients->first_trainable;
+    uint32_t trainable_layers = gradients->trainable_layers;
+    int size = model->input_size;
+    int packed = model->weights_layout == OUTPUT_MAJOR_PACKED;
+
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        PROFILE_BEGIN(start);
+        // activations, input of the next layer
+        float *output = (i + 1 < model->n_layers && gradients->inputs[i + 1] != NULL) ? gradients->inputs[i + 1] : gradients->buffers[i % 2];
+        SparseLayer *sparse = getSparseLayer(model, i);
+        if (sparse != NULL)
+        {
+            SparseForwardPropT forward_prop = get_fc_sparse_forward_prop_t_variant(model->layers_activation[i]);
+            forward_prop(curr_in, model->layers_weights[i], sparse, model->layers_biases[i], model->layers_size[i], net_inputs, output);
+        }
+        else
+        {
+            ForwardPropT forward_prop = packed ? get_fc_forward_prop_t_packed_variant(model->layers_activation[i])
+                                               : get_fc_forward_prop_t_variant(model->layers_activation[i]);
+            forward_prop(curr_in, size, net_inputs, model->layers_size[i], model->layers_weights[i], model->layers_biases[i], output);
+        }
+
+        if (i >= first)
+        { // below the first trainable layer nothing is back propagated
+            ActivationFunc func_deriv = get_activation_func_deriv(model->layers_activation[i]);
+            for (int j = 0; j < model->layers_size[i]; j++)
+            {
+                deriv_mask_set(gradients->deriv_activations[i - first], j, func_deriv(net_inputs[j]) != 0);
+            }
+        }
+        PROFILE_END(start, i, PROFILE_FORWARD, PROFILE_FC_MACS(model, i, size),
+                    sizeof(float) * (PROFILE_FC_WEIGHTS(model, i) + size + 3 * model->layers_size[i]));
+        curr_in = output;
+        size = model->layers_size[i];
+    }
+
+    // calculate loss derivative, the output activations are in a scratch buffer
+    PROFILE_BEGIN(loss_start);
+    float loss_deriv = MSE_derivative(curr_in, actual, model->output_size);
+    for (int i = 0; i < model->output_size; i++)
+    {
+        curr_in[i] = loss_deriv;
+    }
+    deriv_mask_apply(curr_in, gradients->deriv_activations[model->n_layers - 1 - first], model->output_size);
+    PROFILE_END(loss_start, model->n_layers - 1, PROFILE_LOSS, model->output_size, sizeof(float) * 3 * model->output_size);
+
+    LightBackProp light_back_prop = get_fc_light_back_prop_variant(model->weights_layout);
+    SpecificBackProp specific_back_prop = get_fc_specific_back_prop_cached_variant(model->weights_layout);
+    for (int i = model->n_layers - 1; i >= first; i--)
+    {
+        PROFILE_BEGIN(start);
+        int prev_size = (i == 0) ? model->input_size : model->layers_size[i - 1];
+        SparseLayer *sparse = getSparseLayer(model, i);
+        if (trainable_layers & LAYER_MASK(i))
+        {
+            float *activations = (i == 0) ? input : gradients->inputs[i];
+            if (sparse != NULL)
+            {
+                fc_sparse_gradients(curr_in, activations, sparse, model->layers_size[i], gradients->weights[i], gradients->biases[i]);
+            }
+            else
+            {
+                int gradient_stride = packed ? FC_PACKED_STRIDE(prev_size) : model->layers_size[i];
+                specific_back_prop(curr_in, activations, model->layers_size[i], gradients->weights[i], gradients->biases[i],
+                                   prev_size, gradient_stride);
+            }
+        }
+        if (i > first)
+        {
+            float *output = (curr_in == gradients->buffers[0]) ? gradients->buffers[1] : gradients->buffers[0];
+            if (sparse != NULL)
+            {
+                fc_sparse_light_back_prop_into(curr_in, model->layers_weights[i], sparse, model->layers_size[i],
+                                               prev_size, gradients->deriv_activations[i - first - 1], output);
+            }
+            else
+            {
+                light_back_prop(curr_in, model->layers_weights[i], model->layers_size[i],
+                                prev_size, gradients->deriv_activations[i - first - 1], output);
+            }
+            curr_in = output;
+        }
+        PROFILE_END(start, i, PROFILE_BACKWARD, PROFILE_FC_MACS(model, i, prev_size),
+                    sizeof(float) * (PROFILE_FC_WEIGHTS(model, i) + model->layers_size[i] + prev_size));
+    }
+}
+
+/* Apply the gradients of the trainable layers with the optimizer, frozen layers are not touched.
+    The optimizer keeps the groups of the whole model, see create_masked_optimizer.
+*/
+void fc_apply_masked_gradients(Model *model, Optimizer *optimizer, MaskedGradients *gradients)
+{
+    for (int i = gradients->first_trainable; i < model->n_layers; i++)
+    {
+        if (!(gradients->trainable_layers & LAYER_MASK(i)))
+        {
+            continue;
+        }
+        PROFILE_BEGIN(start);
+        int n_weights = getLayerWeightsCount(model, i);
+        optimizer_update(optimizer, 2 * i + 1, 0, model->layers_biases[i], gradients->biases[i], model->layers_size[i]);
+        optimizer_update(optimizer, 2 * i, 0, model->layers_weights[i], gradients->weights[i], n_weights);
+        PROFILE_END(start, i, PROFILE_APPLY, n_weights + model->layers_size[i], sizeof(float) * 3 * (n_weights + model->layers_size[i]));
+    }
+}
+
+/* checks that an optimizer has the groups of the whole model and state for every trainable layer */
+int check_masked_optimizer(Model *model, Optimizer *optimizer, uint32_t trainable_layers)
+{
+    int valid = optimizer->n_groups == 2 * model->n_layers;
+    for (int i = 0; i < model->n_layers && valid; i++)
+    {
+        if (trainable_layers & LAYER_MASK(i))
+        {
+            valid = optimizer->groups_size[2 * i] == getLayerWeightsCount(model, i) && optimizer->groups_size[2 * i + 1] == model->layers_size[i];
+        }
+    }
+    if (!valid)
+    {
+        printf("Optimizer does not match the trainable layers! \n");
+    }
+    return valid;
+}
+
+/* train the layers set in a freeze mask, the other layers stay frozen.
+    Allocates a trainer for the one batch, use create_masked_trainer and fc_trainer_train to reuse it across batches.
+    @param trainable_layers: bit mask of the layers to train, LAYER_MASK(N_LAYERS - 1) | LAYER_MASK(N_LAYERS - 2) for the last two
+    @param optimizer: optimizer created with create_masked_optimizer or create_optimizer, NULL for plain SGD with LEARNING_RATE
+*/
+void fc_model_train_masked(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size],
+                           uint32_t trainable_layers)
+{
+    Trainer *trainer = create_masked_trainer(model, trainable_layers);
+    if (trainer == NULL)
+    {
+        return;
+    }
+    fc_trainer_train(trainer, optimizer, samples_x, samples_y);
+    free_trainer(trainer);
+}
@@ -0,0 +1,15 @@
+#ifndef MASKED_MODEL_FC_H
+#define MASKED_MODEL_FC_H
+#include "../util/model_binding.h"
+#include "../util/model_gradients.h"
+#include "../util/optimizer.h"
+#include "trainer_fc.h"
+
+void masked_calc_gradients(Model *model, float *input, float *actual, MaskedGradients *gradients);
+void fc_apply_masked_gradients(Model *model, Optimizer *optimizer, MaskedGradients *gradients);
+int check_masked_optimizer(Model *model, Optimizer *optimizer, uint32_t trainable_layers);
+
+void fc_model_train_masked(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size],
+                           uint32_t trainable_layers);
+
+#endif
@@ -4,120 +4,285 @@
 #include "../util/forward_prop.h"
 #include "../util/activation_functions.h"
 #include "../util/back_prop.h"
+#include "../util/sparse_prop.h"
 #include "../util/loss_functions.h"
 #include "../util/config.h"
 #include <stdio.h>
 #include <math.h>
-/* Fully connected model functionality, does forward propagation,
-    backpropagation with training to calculate gradients into gradient structure.
-    @return nothing.
+/* forward propagates layers from up to to, caching their net inputs and activations in the gradients
+    @return the activations of the last layer
 */
-void fc_calc_gradients(Model *model, float *input, float *actual, Gradients *gradients)
+static float *fc_forward_layers(Model *model, float *input, int from, int to, Gradients *gradients)
 {
     float *curr_in = input;
-    int size = model->input_size;
-    ForwardPropT forward_prop = fc_forward_prop_t_LINEAR;
-
-    // forward propagate through each layer
-    for (int i = 0; i < model->n_layers; i++)
+    int size = (from == 0) ? model->input_size : model->layers_size[from - 1];
+    int packed = model->weights_layout == OUTPUT_MAJOR_PACKED;
+    for (int i = from; i < to; i++)
     {
-
-        curr_in = forward_prop(curr_in, size, gradients->net_inputs[i],
-                               model->layers_size[i], model->layers_weights[i], model->layers_biases[i]);
+        PROFILE_BEGIN(start);
+        SparseLayer *sparse = getSparseLayer(model, i);
+        if (sparse != NULL)
+        {
+            SparseForwardPropT forward_prop = get_fc_sparse_forward_prop_t_variant(model->layers_activation[i]);
+            curr_in = forward_prop(curr_in, model->layers_weights[i], sparse, model->layers_biases[i], model->layers_size[i],
+                                   gradients->net_inputs[i], gradients->activations[i]);
+        }
+        else
+        {
+            ForwardPropT forward_prop = packed ? get_fc_forward_prop_t_packed_variant(model->layers_activation[i])
+                                               : get_fc_forward_prop_t_variant(model->layers_activation[i]);
+            curr_in = forward_prop(curr_in, size, gradients->net_inputs[i], model->layers_size[i],
+                                   model->layers_weights[i], model->layers_biases[i], gradients->activations[i]);
+        }
+        PROFILE_END(start, i, PROFILE_FORWARD, PROFILE_FC_MACS(model, i, size),
+                    sizeof(float) * (PROFILE_FC_WEIGHTS(model, i) + size + 3 * model->layers_size[i]));
         size = model->layers_size[i];
-        forward_prop = get_fc_forward_prop_t_variant(model->layers_activation[i]);
     }
+    return curr_in;
+}
 
-    ActivationFunc func = get_activation_func(model->layers_activation[model->n_layers - 1]);
-
-    float *output = (float *)malloc(sizeof(float) * model->output_size);
-    for (int i = 0; i < model->output_size; i++)
-    {
-        output[i] = func(curr_in[i]);
-    }
+/* Fully connected model functionality, does forward propagation,
+    backpropagation with training to calculate gradients into gradient structure.
+    The forward pass caches every layer's net inputs and activations, so the input sample is left untouched.
+    With a checkpoint interval above 1 the layers between checkpoints are recomputed segment by segment, see model_gradients.h.
+    @return nothing.
+*/
+void fc_calc_gradients(Model *model, float *input, float *actual, Gradients *gradients)
+{
+    int packed = model->weights_layout == OUTPUT_MAJOR_PACKED;
+    // forward propagate through each layer, layers between checkpoints overwrite each other's segment
+    float *curr_in = fc_forward_layers(model, input, 0, model->n_layers, gradients);
 
     // calculate loss derivative
+    PROFILE_BEGIN(loss_start);
     float loss_deriv = MSE_derivative(curr_in, actual, model->output_size);
-    free(output);
 
-    func = get_activation_func_deriv(model->layers_activation[model->n_layers - 1]);
+    ActivationFunc func = get_activation_func_deriv(model->layers_activation[model->n_layers - 1]);
 
     // calculate initial gradient
     for (int i = 0; i < model->output_size; i++)
     {
         gradients->net_inputs[model->n_layers - 1][i] = loss_deriv * func(gradients->net_inputs[model->n_layers - 1][i]);
     }
+    PROFILE_END(loss_start, model->n_layers - 1, PROFILE_LOSS, model->output_size, sizeof(float) * 3 * model->output_size);
     // perform backprop
     BackProp back_prop;
 
     for (int i = model->n_layers - 1; i > 0; i--)
     {
-        back_prop = get_fc_back_prop_variant(model->layers_activation[i - 1]);
-        back_prop(gradients->net_inputs[i], gradients->net_inputs[i - 1], model->layers_weights[i],
-                  model->layers_size[i], model->layers_size[i - 1], gradients->weights[i], gradients->biases[i]);
+        // the segment below a checkpoint is recomputed from the checkpoint before it, the last one is still in place
+        int segment_start = checkpoint_recompute_from(gradients, model, i);
+        if (segment_start < i)
+        {
+            fc_forward_layers(model, segment_start == 0 ? input : gradients->activations[segment_start - 1], segment_start, i, gradients);
+        }
+        PROFILE_BEGIN(start);
+        SparseLayer *sparse = getSparseLayer(model, i);
+        if (sparse != NULL)
+        {
+            SparseBackProp sparse_back_prop = get_fc_sparse_back_prop_variant(model->layers_activation[i - 1]);
+            sparse_back_prop(gradients->net_inputs[i], gradients->activations[i - 1], gradients->net_inputs[i - 1],
+                             model->layers_weights[i], sparse, model->layers_size[i], model->layers_size[i - 1],
+                             gradients->weights[i], gradients->biases[i]);
+        }
+        else
+        {
+            back_prop = packed ? get_fc_back_prop_packed_variant(model->layers_activation[i - 1])
+                               : get_fc_back_prop_variant(model->layers_activation[i - 1]);
+            back_prop(gradients->net_inputs[i], gradients->activations[i - 1], gradients->net_inputs[i - 1], model->layers_weights[i],
+                      model->layers_size[i], model->layers_size[i - 1], gradients->weights[i], gradients->biases[i]);
+        }
+        // weights are read and their gradients read and written
+        PROFILE_END(start, i, PROFILE_BACKWARD, 2 * PROFILE_FC_MACS(model, i, model->layers_size[i - 1]),
+                    sizeof(float) * 3 * (PROFILE_FC_WEIGHTS(model, i) + model->layers_size[i] + model->layers_size[i - 1]));
     }
 
-    // edge case for input to first layer
-    curr_in = input;
-    fc_back_prop_LINEAR(gradients->net_inputs[0], curr_in, model->layers_weights[0],
-                        model->layers_size[0], model->input_size, gradients->weights[0], gradients->biases[0]);
+    // edge case for input to first layer, only its own gradients are needed
+    PROFILE_BEGIN(first_start);
+    SparseLayer *first_sparse = getSparseLayer(model, 0);
+    if (first_sparse != NULL)
+    {
+        fc_sparse_gradients(gradients->net_inputs[0], input, first_sparse, model->layers_size[0], gradients->weights[0], gradients->biases[0]);
+    }
+    else
+    {
+        int gradient_stride = packed ? FC_PACKED_STRIDE(model->input_size) : model->layers_size[0];
+        SpecificBackProp specific_back_prop = get_fc_specific_back_prop_cached_variant(model->weights_layout);
+        specific_back_prop(gradients->net_inputs[0], input, model->layers_size[0],
+                           gradients->weights[0], gradients->biases[0], model->input_size, gradient_stride);
+    }
+    PROFILE_END(first_start, 0, PROFILE_BACKWARD, PROFILE_FC_MACS(model, 0, model->input_size),
+                sizeof(float) * (2 * PROFILE_FC_WEIGHTS(model, 0) + 3 * model->layers_size[0] + model->input_size));
     return;
 }
 
-/* Applies gradients for a fully connected layer*/
-void fc_apply_gradient(Model *model, int layer, int layer_size, int prev_layer_size, Gradients *gradients)
+/* Applies gradients for a fully connected layer with the optimizer, one fused pass over the weights and one over the biases.
+    Packed gradients use the padded rows of the weights, so a layer is contiguous in both layouts. Sparse layers only
+    update their stored weights.
+*/
+void fc_apply_gradient(Model *model, Optimizer *optimizer, int layer, int layer_size, int prev_layer_size, Gradients *gradients)
+{
+    PROFILE_BEGIN(start);
+    SparseLayer *sparse = getSparseLayer(model, layer);
+    int row_size = (model->weights_layout == OUTPUT_MAJOR_PACKED) ? FC_PACKED_STRIDE(prev_layer_size) : prev_layer_size;
+    int n_weights = (sparse != NULL) ? sparse->nnz : layer_size * row_size;
+    optimizer_update(optimizer, 2 * layer + 1, 0, model->layers_biases[layer], gradients->biases[layer], layer_size);
+    optimizer_update(optimizer, 2 * layer, 0, model->layers_weights[layer], gradients->weights[layer], n_weights);
+    // a parameter is read and written and its gradient read, the optimizer state comes on top
+    PROFILE_END(start, layer, PROFILE_APPLY, n_weights + layer_size, sizeof(float) * 3 * (n_weights + layer_size));
+}
+
+/* checks that the optimizer has the groups of the whole network in the current layout of the weights,
+    like the one of create_optimizer */
+int check_optimizer(Model *model, Optimizer *optimizer)
 {
-    for (int i = 0; i < layer_size; i++)
+    int valid = optimizer->n_groups == 2 * model->n_layers;
+    for (int i = 0; i < model->n_layers && valid; i++)
     {
-        model->layers_biases[layer][i] -= LEARNING_RATE * (gradients->biases[layer][i] / BATCH_SIZE);
-        for (int j = 0; j < prev_layer_size; j++)
-        {
-            model->layers_weights[layer][i + j * layer_size] -= LEARNING_RATE * (gradients->weights[layer][i + j * layer_size] / BATCH_SIZE);
-        }
+        valid = optimizer->groups_size[2 * i] == getLayerWeightsCount(model, i) && optimizer->groups_size[2 * i + 1] == model->layers_size[i];
+    }
+    if (!valid)
+    {
+        printf("Optimizer does not match the model! \n");
     }
+    return valid;
 }
 
-/* train fully connected layer for batch_size amount of samples*/
-void fc_model_train(Model *model, float (*samples_x)[model->output_size], float (*samples_y)[model->output_size])
+/* train fully connected layer for batch_size amount of samples.
+    Allocates a trainer for the one batch, use create_trainer and fc_trainer_train to reuse it across batches.
+    @param optimizer: optimizer created with create_optimizer, NULL for plain SGD with LEARNING_RATE
+*/
+void fc_model_train(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size])
 {
-    /* create gradient struct*/
-    Gradients *gradients = (Gradients *)allocate_gradients(model);
+    Trainer *trainer = create_trainer(model);
+    fc_trainer_train(trainer, optimizer, samples_x, samples_y);
+    free_trainer(trainer);
+}
 
-    for (int i = 0; i < BATCH_SIZE; i++)
+/* forward propagates one layer for inference, sparse layers only visit their stored weights */
+static void fc_layer_forward_into(Model *model, int layer, float *input, int input_size, float *output)
+{
+    PROFILE_BEGIN(start);
+    SparseLayer *sparse = getSparseLayer(model, layer);
+    if (sparse != NULL)
     {
-        fc_calc_gradients(model, samples_x[i], samples_y[i], gradients);
+        SparseForwardPropInto forward_prop = get_fc_sparse_forward_prop_into_variant(model->layers_activation[layer]);
+        forward_prop(input, model->layers_weights[layer], sparse, model->layers_biases[layer], model->layers_size[layer], output);
     }
-    // loop over the gradients and apply step
-    int size = model->input_size;
-    for (int i = 0; i < model->n_layers; i++)
+    else
     {
-        fc_apply_gradient(model, i, model->layers_size[i], size, gradients);
-        size = model->layers_size[i];
+        ForwardPropInto forward_prop = (model->weights_layout == OUTPUT_MAJOR_PACKED)
+                                           ? get_fc_forward_prop_into_packed_variant(model->layers_activation[layer])
+                                           : get_fc_forward_prop_into_variant(model->layers_activation[layer]);
+        forward_prop(input, model->layers_weights[layer], model->layers_biases[layer], input_size, model->layers_size[layer], output);
     }
-
-    free_gradients(gradients, model);
+    PROFILE_END(start, layer, PROFILE_PREDICT, PROFILE_FC_MACS(model, layer, input_size),
+                sizeof(float) * (PROFILE_FC_WEIGHTS(model, layer) + input_size + 2 * model->layers_size[layer]));
 }
 
 /* Function to calculated fully-connected model output */
 float *fc_model_predict(Model *model, float *input)
 {
-
     int size = model->input_size;
-    ForwardProp forward_prop = get_fc_forward_prop_variant(model->layers_activation[0]);
+    float *curr_in = input;
     // forward propagate through each layer
-    float *output = forward_prop(input, model->layers_weights[0], model->layers_biases[0],
-                                 size, model->layers_size[0]);
-    input = output;
-    size = model->layers_size[0];
-    for (int i = 1; i < model->n_layers; i++)
+    for (int i = 0; i < model->n_layers; i++)
     {
+        float *output = (float *)malloc(model->layers_size[i] * sizeof(float));
+        fc_layer_forward_into(model, i, curr_in, size, output);
+        if (i > 0)
+        {
+            free(curr_in);
+        }
+        curr_in = output;
+        size = model->layers_size[i];
+    }
+    return curr_in;
+}
+
+/* Function to calculate fully-connected model output without touching the heap.
+    Hidden layers ping-pong between the two workspace buffers, the last layer writes into output.
 
-        forward_prop = get_fc_forward_prop_variant(model->layers_activation[i]);
-        output = forward_prop(input, model->layers_weights[i], model->layers_biases[i],
-                              size, model->layers_size[i]);
-        free(input);
-        input = output;
+    @param model: pointer to model
+    @param workspace: workspace allocated or set for the model
+    @param input: input sample
+    @param output: pointer to where the output_size outputs will be stored
+*/
+void fc_model_predict_into(Model *model, InferenceWorkspace *workspace, float *input, float *output)
+{
+    float *curr_in = input;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        float *curr_out = (i == model->n_layers - 1) ? output : workspace->buffers[i % 2];
+        fc_layer_forward_into(model, i, curr_in, size, curr_out);
+        curr_in = curr_out;
         size = model->layers_size[i];
     }
-    return input;
+}
+
+/* Function to calculate fully-connected model outputs for a batch of samples.
+    Samples are pushed through the network FC_BATCH_MAX_SAMPLES at a time, so each weight is
+    loaded once per block instead of once per sample.
+
+    @param model: pointer to model
+    @param inputs: input samples stored row-wise (n_samples x input_size)
+    @param n_samples: number of samples
+    @param outputs: pointer to where the outputs will be stored row-wise (n_samples x output_size)
+*/
+void fc_model_predict_batch(Model *model, float *inputs, int n_samples, float *outputs)
+{
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers - 1; i++)
+    {
+        if (model->layers_size[i] > max_size)
+        {
+            max_size = model->layers_size[i];
+        }
+    }
+    int block = n_samples < FC_BATCH_MAX_SAMPLES ? n_samples : FC_BATCH_MAX_SAMPLES;
+    float *buffers[2] = {NULL, NULL};
+    if (model->n_layers > 1)
+    {
+        buffers[0] = (float *)malloc(block * max_size * sizeof(float));
+        buffers[1] = (float *)malloc(block * max_size * sizeof(float));
+    }
+
+    for (int s = 0; s < n_samples; s += block)
+    {
+        int n = (n_samples - s < block) ? n_samples - s : block;
+        float *curr_in = inputs + s * model->input_size;
+        int size = model->input_size;
+        for (int i = 0; i < model->n_layers; i++)
+        {
+            // last layer writes straight into the caller's outputs
+            float *curr_out = (i == model->n_layers - 1) ? outputs + s * model->output_size : buffers[i % 2];
+            SparseLayer *sparse = getSparseLayer(model, i);
+            if (sparse != NULL)
+            {
+                // compressed rows gain nothing from tiling, the samples go through one by one
+                SparseForwardPropInto forward_prop = get_fc_sparse_forward_prop_into_variant(model->layers_activation[i]);
+                for (int j = 0; j < n; j++)
+                {
+                    forward_prop(curr_in + j * size, model->layers_weights[i], sparse, model->layers_biases[i], model->layers_size[i],
+                                 curr_out + j * model->layers_size[i]);
+                }
+                curr_in = curr_out;
+                size = model->layers_size[i];
+                continue;
+            }
+            ForwardPropBatch forward_prop = (model->weights_layout == OUTPUT_MAJOR_PACKED)
+                                                ? get_fc_forward_prop_batch_packed_variant(model->layers_activation[i])
+                                                : get_fc_forward_prop_batch_variant(model->layers_activation[i]);
+            forward_prop(curr_in, model->layers_weights[i], model->layers_biases[i], size, model->layers_size[i], n, curr_out);
+            curr_in = curr_out;
+            size = model->layers_size[i];
+        }
+    }
+
+    if (model->n_layers > 1)
+    {
+        free(buffers[0]);
+        free(buffers[1]);
+    }
 }
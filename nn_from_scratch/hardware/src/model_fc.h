@@ -3,8 +3,16 @@
 
 #include "../util/model_binding.h"
 #include "../util/model_gradients.h"
+#include "../util/inference_workspace.h"
+#include "../util/optimizer.h"
+#include "trainer_fc.h"
 
-void fc_model_train(Model *model, float (*samples_x)[model->output_size], float (*samples_y)[model->output_size]);
+void fc_calc_gradients(Model *model, float *input, float *actual, Gradients *gradients);
+void fc_apply_gradient(Model *model, Optimizer *optimizer, int layer, int layer_size, int prev_layer_size, Gradients *gradients);
+int check_optimizer(Model *model, Optimizer *optimizer);
+void fc_model_train(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size]);
 float *fc_model_predict(Model *model, float *input);
+void fc_model_predict_into(Model *model, InferenceWorkspace *workspace, float *input, float *output);
+void fc_model_predict_batch(Model *model, float *inputs, int n_samples, float *outputs);
 
 #endif
@@ -0,0 +1,225 @@
+#define _POSIX_C_SOURCE 200809L
+#include "parallel_model_fc.h"
+#ifdef ENABLE_PARALLEL_TRAINING
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "model_fc.h"
+#include "../util/simd_dispatch.h"
+
+#ifdef ENABLE_PROFILING
+#error "The profiling counters are not thread-safe, disable ENABLE_PROFILING for parallel training"
+#endif
+
+enum TrainJob
+{
+    TRAIN_JOB_NONE,
+    TRAIN_JOB_GRADIENTS,
+    TRAIN_JOB_REDUCE,
+    TRAIN_JOB_EXIT
+};
+
+/* Adds the gradients of all workers into worker 0 for the range [start, end) of one array.
+    Pairwise tree with a fixed order, so the result only depends on the number of threads.
+*/
+static void reduce_range(float **arrays, int n_workers, int start, int end)
+{
+    for (int stride = 1; stride < n_workers; stride *= 2)
+    {
+        for (int w = 0; w + stride < n_workers; w += 2 * stride)
+        {
+            float *dst = arrays[w];
+            float *src = arrays[w + stride];
+            for (int e = start; e < end; e++)
+            {
+                dst[e] += src[e];
+            }
+        }
+    }
+}
+
+/* Worker's share of the reduction: a slice of the weight and bias gradients, which are contiguous in every worker */
+static void reduce_slice(TrainWorker *worker)
+{
+    TrainPool *pool = worker->pool;
+    int n = pool->n_threads;
+    int n_params = worker->gradients->n_params;
+    reduce_range(pool->reduce_arrays, n, n_params * worker->index / n, n_params * (worker->index + 1) / n);
+}
+
+/* Worker's share of the minibatch */
+static void calc_gradients_slice(TrainWorker *worker)
+{
+    TrainPool *pool = worker->pool;
+    Model *model = pool->model;
+    int start = BATCH_SIZE * worker->index / pool->n_threads;
+    int end = BATCH_SIZE * (worker->index + 1) / pool->n_threads;
+
+    clear_gradients(worker->gradients);
+    for (int i = start; i < end; i++)
+    {
+        fc_calc_gradients(model, pool->samples_x + i * model->input_size, pool->samples_y + i * model->output_size, worker->gradients);
+    }
+}
+
+static void *train_worker_loop(void *arg)
+{
+    TrainWorker *worker = (TrainWorker *)arg;
+    TrainPool *pool = worker->pool;
+    int seen_generation = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->generation == seen_generation)
+        {
+            pthread_cond_wait(&pool->job_cond, &pool->mutex);
+        }
+        seen_generation = pool->generation;
+        int job = pool->job;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (job == TRAIN_JOB_EXIT)
+        {
+            return NULL;
+        }
+        else if (job == TRAIN_JOB_GRADIENTS)
+        {
+            calc_gradients_slice(worker);
+        }
+        else if (job == TRAIN_JOB_REDUCE)
+        {
+            reduce_slice(worker);
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->n_done++;
+        if (pool->n_done == pool->n_threads)
+        {
+            pthread_cond_signal(&pool->done_cond);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+/* Hands a job to every worker and waits until all of them finished it */
+static void run_job(TrainPool *pool, int job)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->job = job;
+    pool->n_done = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->job_cond);
+    if (job != TRAIN_JOB_EXIT)
+    {
+        while (pool->n_done < pool->n_threads)
+        {
+            pthread_cond_wait(&pool->done_cond, &pool->mutex);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Stops the first n_started workers and frees the pool with the gradients of all its workers */
+static void destroy_train_pool(TrainPool *pool, int n_started)
+{
+    run_job(pool, TRAIN_JOB_EXIT);
+    for (int i = 0; i < n_started; i++)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    for (int i = 0; i < pool->n_threads; i++)
+    {
+        free_gradients(pool->workers[i].gradients);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->job_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->reduce_arrays);
+    free(pool->workers);
+    free(pool);
+}
+
+/* Creates a pool of n_threads workers for training a model, each with its own gradients
+    @return the pool, NULL if a worker thread could not be started
+*/
+TrainPool *create_train_pool(Model *model, int n_threads)
+{
+    if (n_threads < 1)
+    {
+        n_threads = 1;
+    }
+    init_simd_level(); // before the workers look up kernels
+    TrainPool *pool = (TrainPool *)malloc(sizeof(TrainPool));
+    pool->model = model;
+    pool->n_threads = n_threads;
+    pool->job = TRAIN_JOB_NONE;
+    pool->generation = 0;
+    pool->n_done = 0;
+    pool->samples_x = NULL;
+    pool->samples_y = NULL;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->job_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    pool->workers = (TrainWorker *)malloc(n_threads * sizeof(TrainWorker));
+    pool->reduce_arrays = (float **)malloc(n_threads * sizeof(float *));
+    for (int i = 0; i < n_threads; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pool->workers[i].gradients = allocate_gradients(model);
+        pool->reduce_arrays[i] = pool->workers[i].gradients->params;
+    }
+    for (int i = 0; i < n_threads; i++)
+    {
+        if (pthread_create(&pool->workers[i].thread, NULL, train_worker_loop, &pool->workers[i]) != 0)
+        {
+            printf("Error starting training worker %d of %d\n", i + 1, n_threads);
+            destroy_train_pool(pool, i);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+/* Stops the workers and frees the pool */
+void free_train_pool(TrainPool *pool)
+{
+    destroy_train_pool(pool, pool->n_threads);
+}
+
+/* train fully connected model for batch_size amount of samples, split across the workers of the pool
+    @param optimizer: optimizer created with create_optimizer, NULL for plain SGD with LEARNING_RATE
+*/
+void fc_model_train_parallel(TrainPool *pool, Optimizer *optimizer, float (*samples_x)[pool->model->input_size], float (*samples_y)[pool->model->output_size])
+{
+    Model *model = pool->model;
+    Optimizer default_optimizer;
+    if (optimizer == NULL)
+    {
+        default_optimizer = get_default_optimizer();
+        optimizer = &default_optimizer;
+    }
+    else if (!check_optimizer(model, optimizer))
+    {
+        return;
+    }
+    pool->samples_x = samples_x[0];
+    pool->samples_y = samples_y[0];
+
+    run_job(pool, TRAIN_JOB_GRADIENTS);
+    run_job(pool, TRAIN_JOB_REDUCE);
+
+    // worker 0 holds the summed gradients of the whole minibatch
+    Gradients *gradients = pool->workers[0].gradients;
+    optimizer_next_step(optimizer);
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        fc_apply_gradient(model, optimizer, i, model->layers_size[i], size, gradients);
+        size = model->layers_size[i];
+    }
+}
+
+#endif
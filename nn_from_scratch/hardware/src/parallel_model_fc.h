@@ -0,0 +1,45 @@
+#ifndef PARALLEL_MODEL_FC_H
+#define PARALLEL_MODEL_FC_H
+#include "../util/config.h"
+#ifdef ENABLE_PARALLEL_TRAINING
+#include <pthread.h>
+#include "../util/model_binding.h"
+#include "../util/model_gradients.h"
+#include "../util/optimizer.h"
+
+struct TrainPool;
+
+/* A worker owns its gradients, which include the activation scratch (net_inputs, activations).
+   Samples are only read, so workers share them */
+typedef struct
+{
+    struct TrainPool *pool;
+    pthread_t thread;
+    int index;
+    Gradients *gradients;
+} TrainWorker;
+
+/* Pool of threads that splits a minibatch across workers, created once per model */
+typedef struct TrainPool
+{
+    Model *model;
+    int n_threads;
+    TrainWorker *workers;
+    pthread_mutex_t mutex;
+    pthread_cond_t job_cond;
+    pthread_cond_t done_cond;
+    int job;
+    int generation;
+    int n_done;
+    float *samples_x;
+    float *samples_y;
+    float **reduce_arrays; // params of every worker's gradients, summed into worker 0
+} TrainPool;
+
+TrainPool *create_train_pool(Model *model, int n_threads);
+void free_train_pool(TrainPool *pool);
+
+void fc_model_train_parallel(TrainPool *pool, Optimizer *optimizer, float (*samples_x)[pool->model->input_size], float (*samples_y)[pool->model->output_size]);
+
+#endif
+#endif
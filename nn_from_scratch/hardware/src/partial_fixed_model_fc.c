@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util/fixed_prop.h"
+#include "../util/loss_functions.h"
+#include "partial_fixed_model_fc.h"
+#include "fixed_model_fc.h"
+#include "../util/config.h"
+#include <stdio.h>
+
+/* fixed-point partial_calc_gradients, the input sample is left untouched.
+    Net inputs and propagated gradients ping-pong between the scratch buffers of the gradients, so the heap is not touched.
+*/
+void partial_fixed_calc_gradients(fixed_t *input, FixedModel *model, int target_layer, int n_weights, int offset, fixed_t *actual,
+                                  FixedPartialGradients *gradients)
+{
+    fixed_t *curr_in = input;
+    int size = model->input_size;
+    ForwardPropTFixed forward_prop = fc_forward_prop_t_fixed_LINEAR;
+
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        fixed_t *output = gradients->buffers[i % 2]; // net inputs, activated by the next layer on the fly
+        forward_prop(curr_in, size, output, model->layers_size[i], model->layers_weights[i], model->layers_biases[i]);
+        if (i == target_layer) // store neurons feeding the target weights
+        {
+            memcpy(gradients->net_input, curr_in + offset, n_weights * sizeof(fixed_t));
+        }
+
+        if (i >= target_layer) // only the derivatives are needed above the target layer
+        {
+            for (int j = 0; j < model->layers_size[i]; j++)
+            {
+                deriv_mask_set(gradients->deriv_activations[i - target_layer], j, fixed_activation_deriv(model->layers_activation[i], output[j]));
+            }
+        }
+        curr_in = output;
+        size = model->layers_size[i];
+        forward_prop = get_fc_forward_prop_t_fixed_variant(model->layers_activation[i]);
+    }
+
+    // calculate loss derivative on the activated outputs and initial gradient
+    fixed_t loss_deriv = fixed_MSE_derivative(curr_in, actual, model->output_size, model->layers_activation[model->n_layers - 1]);
+    for (int i = 0; i < model->output_size; i++)
+    {
+        curr_in[i] = (fixed_t)(loss_deriv & (fixed_t)deriv_mask_select(gradients->deriv_activations[model->n_layers - 1 - target_layer], i));
+    }
+
+    // backpropagate with the stored derivatives until the target layer
+    for (int i = model->n_layers - 1; i > target_layer; i--)
+    {
+        fixed_t *output = (curr_in == gradients->buffers[0]) ? gradients->buffers[1] : gradients->buffers[0];
+        fc_light_back_prop_fixed_into(curr_in, model->layers_weights[i], model->layers_size[i],
+                                      model->layers_size[i - 1], gradients->deriv_activations[i - target_layer - 1], output);
+        curr_in = output;
+    }
+
+    SpecificBackPropFixed specific_back_prop = (target_layer != 0)
+                                                   ? get_fc_specific_back_prop_fixed_variant(model->layers_activation[target_layer - 1])
+                                                   : fc_specific_back_prop_fixed_LINEAR;
+    specific_back_prop(curr_in, gradients->net_input, model->layers_size[target_layer], gradients->weights, gradients->biases, n_weights);
+}
+
+/* Apply gradients to a layer, given specific neurons*/
+void fc_fixed_apply_specific_gradients(FixedModel *model, int layer, int layer_size, int n_weights, int offset, FixedPartialGradients *gradients)
+{
+    for (int i = 0; i < layer_size; i++)
+    {
+        fixed_t *bias = &model->layers_biases[layer][i];
+        *bias = fixed_saturate(*bias - fc_fixed_gradient_step(model, gradients->biases[i]));
+        for (int j = 0; j < n_weights; j++)
+        {
+            fixed_t *weight = &model->layers_weights[layer][i + (j + offset) * layer_size];
+            *weight = fixed_saturate(*weight - fc_fixed_gradient_step(model, gradients->weights[i + j * layer_size]));
+        }
+    }
+}
+
+/* fixed-point fc_model_train_partial_layer, trains n_weights weights per neuron of the target layer starting at offset,
+    biases of the target layer are always trained
+    @param model: pointer to fixed-point model
+    @param samples_x: input samples
+    @param samples_y: expected output samples
+    @param target_layer: target layer of weights to be trained
+    @param n_weights: number of weights to be trained pr neuron in the layer.
+    @param offset: offset for the number of weights to be trained
+ */
+void fc_fixed_model_train_partial_layer(FixedModel *model, fixed_t (*samples_x)[model->input_size], fixed_t (*samples_y)[model->output_size],
+                                        int target_layer, int n_weights, int offset)
+{
+    if (target_layer < 0 || target_layer >= model->n_layers || offset < 0 || n_weights < 1)
+    {
+        printf("Invalid arguments for partial layer training! \n");
+        return;
+    }
+    int prev_size = (target_layer == 0) ? model->input_size : model->layers_size[target_layer - 1];
+    if (n_weights + offset > prev_size)
+    {
+        printf("Invalid arguments for partial layer training! \n");
+        return;
+    }
+
+    FixedPartialGradients *gradients = allocate_fixed_partial_gradients(model, target_layer, n_weights);
+
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        partial_fixed_calc_gradients(samples_x[i], model, target_layer, n_weights, offset, samples_y[i], gradients);
+    }
+
+    fc_fixed_apply_specific_gradients(model, target_layer, model->layers_size[target_layer], n_weights, offset, gradients);
+    free_fixed_partial_gradients(gradients, model, target_layer);
+}
+
+/* train a specific layer of a fixed-point model*/
+void fc_fixed_model_train_layer(FixedModel *model, fixed_t (*samples_x)[model->input_size], fixed_t (*samples_y)[model->output_size],
+                                int target_layer)
+{
+    if (target_layer < 0 || target_layer >= model->n_layers)
+    {
+        printf("Invalid arguments for layer training! \n");
+        return;
+    }
+    int n_weights = (target_layer == 0) ? model->input_size : model->layers_size[target_layer - 1];
+    fc_fixed_model_train_partial_layer(model, samples_x, samples_y, target_layer, n_weights, 0);
+}
@@ -0,0 +1,15 @@
+#ifndef PARTIAL_FIXED_MODEL_FC_H
+#define PARTIAL_FIXED_MODEL_FC_H
+#include "../util/fixed_model_binding.h"
+#include "../util/fixed_model_gradients.h"
+
+void partial_fixed_calc_gradients(fixed_t *input, FixedModel *model, int target_layer, int n_weights, int offset, fixed_t *actual,
+                                  FixedPartialGradients *gradients);
+
+void fc_fixed_model_train_partial_layer(FixedModel *model, fixed_t (*samples_x)[model->input_size], fixed_t (*samples_y)[model->output_size],
+                                        int target_layer, int n_weights, int offset);
+
+void fc_fixed_model_train_layer(FixedModel *model, fixed_t (*samples_x)[model->input_size], fixed_t (*samples_y)[model->output_size],
+                                int target_layer);
+
+#endif
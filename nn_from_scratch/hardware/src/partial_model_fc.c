@@ -1,39 +1,45 @@
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "../util/forward_prop.h"
 #include "../util/activation_functions.h"
 #include "../util/back_prop.h"
+#include "../util/sparse_prop.h"
 #include "../util/loss_functions.h"
 #include "partial_model_fc.h"
 #include "../util/config.h"
 #include <stdio.h>
 
-/* function to calculate gradients under partial training conditions */
+/* function to calculate gradients under partial training conditions.
+    Activations and propagated gradients ping-pong between the scratch buffers of the gradients, so the heap is not touched.
+*/
 void partial_calc_gradients(float *input, Model *model, int target_layer, int n_weights, int offset, float *actual, PartialGradients *gradients)
 {
 
     float *curr_in = input;
-    float *output;
+    float *net_inputs = gradients->buffers[2];
     int size = model->input_size;
-    ForwardPropT forward_prop = fc_forward_prop_t_LINEAR;
+    int packed = model->weights_layout == OUTPUT_MAJOR_PACKED;
 
     for (int i = 0; i < model->n_layers; i++)
     {
-        output = (float *)malloc(model->layers_size[i] * sizeof(float)); // allocate output
-        /* forward propagate, store needed data otherwise free */
-        output = forward_prop(curr_in, size, output, model->layers_size[i], model->layers_weights[i], model->layers_biases[i]);
-        if (i == target_layer) // store neuron if at target layer
+        PROFILE_BEGIN(start);
+        float *output = gradients->buffers[i % 2]; // activations, input of the next layer
+        if (i == target_layer) // store the activations feeding the target weights
         {
-
             memcpy(gradients->net_input, curr_in + offset, n_weights * sizeof(float));
-            if (target_layer != 0)
-            {
-                free(curr_in);
-            }
         }
-        else if (i != 0 && (i < target_layer || i > target_layer)) // free if below target layer or larget than target, since not needed
+        SparseLayer *sparse = getSparseLayer(model, i);
+        if (sparse != NULL)
+        {
+            SparseForwardPropT forward_prop = get_fc_sparse_forward_prop_t_variant(model->layers_activation[i]);
+            forward_prop(curr_in, model->layers_weights[i], sparse, model->layers_biases[i], model->layers_size[i], net_inputs, output);
+        }
+        else
         {
-            free(curr_in);
+            ForwardPropT forward_prop = packed ? get_fc_forward_prop_t_packed_variant(model->layers_activation[i])
+                                               : get_fc_forward_prop_t_variant(model->layers_activation[i]);
+            forward_prop(curr_in, size, net_inputs, model->layers_size[i], model->layers_weights[i], model->layers_biases[i], output);
         }
 
         if (i >= target_layer)
@@ -41,106 +47,227 @@ void partial_calc_gradients(float *input, Model *model, int target_layer, int n_
             ActivationFunc func_deriv = get_activation_func_deriv(model->layers_activation[i]);
             for (int j = 0; j < model->layers_size[i]; j++)
             {
-                gradients->deriv_activations[i - target_layer][j] = (uint8_t)func_deriv(output[j]);
+                deriv_mask_set(gradients->deriv_activations[i - target_layer], j, func_deriv(net_inputs[j]) != 0);
             }
         }
+        PROFILE_END(start, i, PROFILE_FORWARD, PROFILE_FC_MACS(model, i, size),
+                    sizeof(float) * (PROFILE_FC_WEIGHTS(model, i) + size + 3 * model->layers_size[i]));
         curr_in = output;
         size = model->layers_size[i];
-        forward_prop = get_fc_forward_prop_t_variant(model->layers_activation[i]);
-    }
-    ActivationFunc func = get_activation_func(model->layers_activation[model->n_layers - 1]);
-    output = (float *)malloc(sizeof(float) * model->output_size);
-    for (int i = 0; i < model->output_size; i++)
-    {
-        output[i] = func(curr_in[i]);
     }
 
     // calculate loss derivative
+    PROFILE_BEGIN(loss_start);
     float loss_deriv = MSE_derivative(curr_in, actual, model->output_size);
-    free(output);
-    ActivationFunc func_deriv = get_activation_func_deriv(model->layers_activation[model->n_layers - 1]);
 
     // get initial gradient
     for (int i = 0; i < model->output_size; i++)
     {
-        curr_in[i] = loss_deriv * func_deriv(curr_in[i]);
+        curr_in[i] = loss_deriv;
     }
+    deriv_mask_apply(curr_in, gradients->deriv_activations[model->n_layers - 1 - target_layer], model->output_size);
+    PROFILE_END(loss_start, model->n_layers - 1, PROFILE_LOSS, model->output_size, sizeof(float) * 3 * model->output_size);
     // perform packprop using the backprop that uses the stored derivative activation values until target layer
+    LightBackProp light_back_prop = get_fc_light_back_prop_variant(model->weights_layout);
     for (int i = model->n_layers - 1; i > target_layer; i--)
     {
-
-        float *output = fc_light_back_prop(curr_in, model->layers_weights[i], model->layers_size[i],
-                                           model->layers_size[i - 1], gradients->deriv_activations[i - target_layer - 1]);
-        free(curr_in);
+        PROFILE_BEGIN(start);
+        float *output = (curr_in == gradients->buffers[0]) ? gradients->buffers[1] : gradients->buffers[0];
+        SparseLayer *sparse = getSparseLayer(model, i);
+        if (sparse != NULL)
+        {
+            fc_sparse_light_back_prop_into(curr_in, model->layers_weights[i], sparse, model->layers_size[i],
+                                           model->layers_size[i - 1], gradients->deriv_activations[i - target_layer - 1], output);
+        }
+        else
+        {
+            light_back_prop(curr_in, model->layers_weights[i], model->layers_size[i],
+                            model->layers_size[i - 1], gradients->deriv_activations[i - target_layer - 1], output);
+        }
+        PROFILE_END(start, i, PROFILE_BACKWARD, PROFILE_FC_MACS(model, i, model->layers_size[i - 1]),
+                    sizeof(float) * (PROFILE_FC_WEIGHTS(model, i) + model->layers_size[i] + model->layers_size[i - 1]));
         curr_in = output;
     }
-    // Apply last backprop, using 'normal backprop' to calculate the gradient to target weights.
-    SpecificBackProp specific_back_prop;
-    if (target_layer != 0)
+    // Apply last backprop, using the cached activations to calculate the gradient to target weights.
+    PROFILE_BEGIN(target_start);
+    int gradient_stride = packed ? n_weights : model->layers_size[target_layer];
+    SpecificBackProp specific_back_prop = get_fc_specific_back_prop_cached_variant(model->weights_layout);
+    specific_back_prop(curr_in, gradients->net_input, model->layers_size[target_layer], gradients->weights, gradients->biases,
+                       n_weights, gradient_stride);
+    // only the gradients of the trained slice are read and written
+    PROFILE_END(target_start, target_layer, PROFILE_BACKWARD, model->layers_size[target_layer] * n_weights,
+                sizeof(float) * (2 * model->layers_size[target_layer] * n_weights + 3 * model->layers_size[target_layer] + n_weights));
+}
+
+/* Apply gradients to a layer, given specific neurons.
+    The optimizer state covers only the trained slice, see create_partial_optimizer.
+*/
+void fc_apply_specific_gradients(Model *model, Optimizer *optimizer, int layer, int layer_size, int n_weights, int offset, PartialGradients *gradients)
+{
+    PROFILE_BEGIN(start);
+    optimizer_update(optimizer, 1, 0, model->layers_biases[layer], gradients->biases, layer_size);
+    if (model->weights_layout == OUTPUT_MAJOR_PACKED)
     {
-        specific_back_prop = get_fc_specific_back_prop_variant(model->layers_activation[target_layer - 1]);
+        // the slice is a run of n_weights in every padded row
+        int stride = FC_PACKED_STRIDE(layer == 0 ? model->input_size : model->layers_size[layer - 1]);
+        for (int i = 0; i < layer_size; i++)
+        {
+            optimizer_update(optimizer, 0, i * n_weights, model->layers_weights[layer] + i * stride + offset,
+                             gradients->weights + i * n_weights, n_weights);
+        }
     }
     else
     {
-        // special case if the target layer in the first layer
-        specific_back_prop = fc_specific_back_prop_LINEAR;
+        // INPUT_MAJOR: weights [offset, offset + n_weights) of every neuron are one contiguous block
+        optimizer_update(optimizer, 0, 0, model->layers_weights[layer] + offset * layer_size, gradients->weights, n_weights * layer_size);
     }
-    specific_back_prop(curr_in, gradients->net_input, model->layers_size[target_layer], gradients->weights, gradients->biases, n_weights);
-
-    free(curr_in);
+    PROFILE_END(start, layer, PROFILE_APPLY, layer_size * (n_weights + 1), sizeof(float) * 3 * layer_size * (n_weights + 1));
+}
 
-    return;
+/* restores the min-heap of selected parameter indices below position i, ordered by the magnitude of their accumulated gradients */
+static void top_k_sift_down(int *heap, int n, int i, float *accumulated)
+{
+    while (1)
+    {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < n && fabsf(accumulated[heap[left]]) < fabsf(accumulated[heap[smallest]]))
+        {
+            smallest = left;
+        }
+        if (right < n && fabsf(accumulated[heap[right]]) < fabsf(accumulated[heap[smallest]]))
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
 }
 
-/* Apply gradients to a layer, given specific neurons*/
-void fc_apply_specific_gradients(Model *model, int layer, int layer_size, int n_weights, int offset, PartialGradients *gradients)
+/* Apply only the top_k largest gradients of the trained slice, weights and biases together, with error feedback:
+    the gradients of the parameters that are not written stay in the residuals and are added to the next batch,
+    so every update is eventually applied. The optimizer state of a parameter only advances when it is written.
+    @return number of parameters written
+*/
+int fc_apply_top_k_gradients(Model *model, Optimizer *optimizer, int layer, int layer_size, int n_weights, int offset, PartialGradients *gradients)
 {
-    for (int i = 0; i < layer_size; i++)
+    PROFILE_BEGIN(start);
+    int n_params = gradients->n_params;
+    int n_slice_weights = layer_size * n_weights;
+    float *accumulated = gradients->residuals;
+    for (int i = 0; i < n_params; i++)
+    {
+        accumulated[i] += gradients->weights[i];
+    }
+
+    // min-heap of the k largest magnitudes, its root is the smallest selected one
+    int k = (gradients->top_k < n_params) ? gradients->top_k : n_params;
+    int *heap = gradients->selected;
+    for (int i = 0; i < k; i++)
+    {
+        heap[i] = i;
+    }
+    for (int i = k / 2 - 1; i >= 0; i--)
+    {
+        top_k_sift_down(heap, k, i, accumulated);
+    }
+    for (int i = k; i < n_params; i++)
     {
-        model->layers_biases[layer][i] -= LEARNING_RATE * (gradients->biases[i] / BATCH_SIZE);
-        for (int j = 0; j < n_weights; j++)
+        if (fabsf(accumulated[i]) > fabsf(accumulated[heap[0]]))
         {
-            model->layers_weights[layer][i + (j + offset) * layer_size] -= LEARNING_RATE * (gradients->weights[i + j * layer_size] / BATCH_SIZE);
+            heap[0] = i;
+            top_k_sift_down(heap, k, 0, accumulated);
         }
     }
+
+    int stride = FC_PACKED_STRIDE(layer == 0 ? model->input_size : model->layers_size[layer - 1]);
+    for (int i = 0; i < k; i++)
+    {
+        int index = heap[i];
+        if (index >= n_slice_weights)
+        {
+            optimizer_update(optimizer, 1, index - n_slice_weights, model->layers_biases[layer] + index - n_slice_weights, accumulated + index, 1);
+        }
+        else
+        {
+            // the same index as in fc_apply_specific_gradients, gradients and optimizer state share the layout of the slice
+            float *weight = (model->weights_layout == OUTPUT_MAJOR_PACKED)
+                                ? model->layers_weights[layer] + (index / n_weights) * stride + offset + index % n_weights
+                                : model->layers_weights[layer] + offset * layer_size + index;
+            optimizer_update(optimizer, 0, index, weight, accumulated + index, 1);
+        }
+        accumulated[index] = 0;
+    }
+    // the residuals and gradients are read in full, only the selected parameters are written
+    PROFILE_END(start, layer, PROFILE_APPLY, n_params + k, sizeof(float) * (3 * n_params + 3 * k));
+    return k;
+}
+
+/* checks that a partial optimizer covers the trained slice */
+int check_partial_optimizer(Optimizer *optimizer, int layer_size, int n_weights)
+{
+    if (optimizer->n_groups != 2 || optimizer->groups_size[0] != layer_size * n_weights || optimizer->groups_size[1] != layer_size)
+    {
+        printf("Optimizer does not match the trained slice! \n");
+        return 0;
+    }
+    return 1;
+}
+
+/* checks the slice trained by partial layer training */
+int check_partial_arguments(Model *model, int target_layer, int n_weights, int offset)
+{
+    if ((target_layer == 0 && n_weights != 1 && offset != 0) || target_layer < 0 || target_layer >= model->n_layers || offset < 0 || n_weights < 1)
+    {
+        printf("Invalid arguments for partial layer training! \n");
+        return 0;
+    }
+    else if (n_weights + offset > (target_layer == 0 ? model->input_size : model->layers_size[target_layer - 1]))
+    {
+        printf("Invalid arguments for partial layer training! \n");
+        return 0;
+    }
+    else if (getSparseLayer(model, target_layer) != NULL)
+    {
+        printf("Partial layer training of the sparse layer %d is not supported! \n", target_layer);
+        return 0;
+    }
+    return 1;
 }
 
-/* train a part of a layer - stated by target layer, the number of weights and the offset. Biases will always also be trained for the target layer
+/* train a part of a layer - stated by target layer, the number of weights and the offset. Biases will always also be trained for the target layer.
+    Allocates a trainer for the one batch, use create_partial_trainer and fc_trainer_train to reuse it across batches.
     @param model: pointer to model
     @param samples_x: input samples
     @param samples_y: expected output samples
     @param target_layer: target layer of weights to be trained
     @param n_weights: number of weights to be trained pr neuron in the layer.
     @param offset: offset for the number of weights to be trained
+    @param optimizer: optimizer created with create_partial_optimizer for the slice, NULL for plain SGD with LEARNING_RATE
  */
-void fc_model_train_partial_layer(Model *model, float (*samples_x)[model->output_size], float (*samples_y)[model->output_size],
+void fc_model_train_partial_layer(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size],
                                   int target_layer, int n_weights, int offset)
 {
-    if ((target_layer == 0 && n_weights != 1 && offset != 0) || target_layer < 0 || offset < 0 || n_weights < 1)
-    {
-        printf("Invalid arguments for partial layer training! \n");
-        return;
-    }
-    else if (n_weights + offset > model->layers_size[target_layer - 1])
+    Trainer *trainer = create_partial_trainer(model, target_layer, n_weights, offset);
+    if (trainer == NULL)
     {
-        printf("Invalid arguments for partial layer training! \n");
         return;
     }
-
-    PartialGradients *gradients = (PartialGradients *)allocate_partial_gradients(model, target_layer, n_weights);
-
-    for (int i = 0; i < BATCH_SIZE; i++)
-    {
-        partial_calc_gradients(samples_x[i], model, target_layer, n_weights, offset, samples_y[i], gradients);
-    }
-
-    // apply the calculated gradient to the specific layer
-    fc_apply_specific_gradients(model, target_layer, model->layers_size[target_layer], n_weights, offset, gradients);
-    free_partial_gradients(gradients, model, target_layer);
+    fc_trainer_train(trainer, optimizer, samples_x, samples_y);
+    free_trainer(trainer);
 }
 
-/* train a specific layer*/
-void fc_model_train_layer(Model *model, float (*samples_x)[model->output_size], float (*samples_y)[model->output_size],
+/* train a specific layer
+    @param optimizer: optimizer created with create_partial_optimizer for the whole layer, NULL for plain SGD with LEARNING_RATE
+*/
+void fc_model_train_layer(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size],
                           int target_layer)
 {
     if (target_layer >= model->n_layers)
@@ -148,7 +275,6 @@ void fc_model_train_layer(Model *model, float (*samples_x)[model->output_size],
         printf("Invalid arguments for layer training! \n");
         return;
     }
-    int offset = 0;
     int n_neurons;
     if (target_layer == 0)
     {
@@ -158,12 +284,5 @@ void fc_model_train_layer(Model *model, float (*samples_x)[model->output_size],
     {
         n_neurons = model->layers_size[target_layer - 1];
     }
-
-    PartialGradients *gradients = (PartialGradients *)allocate_partial_gradients(model, target_layer, n_neurons);
-    for (int i = 0; i < BATCH_SIZE; i++)
-    {
-        partial_calc_gradients(samples_x[i], model, target_layer, n_neurons, offset, samples_y[i], gradients);
-    }
-    fc_apply_specific_gradients(model, target_layer, model->layers_size[target_layer], n_neurons, offset, gradients);
-    free_partial_gradients(gradients, model, target_layer);
+    fc_model_train_partial_layer(model, optimizer, samples_x, samples_y, target_layer, n_neurons, 0);
 }
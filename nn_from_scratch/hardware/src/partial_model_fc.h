@@ -2,11 +2,19 @@
 #define PARTIAL_MODEL_FC_H
 #include "../util/model_binding.h"
 #include "../util/model_gradients.h"
+#include "../util/optimizer.h"
+#include "trainer_fc.h"
 
-void fc_model_train_partial_layer(Model *model, float (*samples_x)[model->output_size], float (*samples_y)[model->output_size],
+void partial_calc_gradients(float *input, Model *model, int target_layer, int n_weights, int offset, float *actual, PartialGradients *gradients);
+void fc_apply_specific_gradients(Model *model, Optimizer *optimizer, int layer, int layer_size, int n_weights, int offset, PartialGradients *gradients);
+int fc_apply_top_k_gradients(Model *model, Optimizer *optimizer, int layer, int layer_size, int n_weights, int offset, PartialGradients *gradients);
+int check_partial_arguments(Model *model, int target_layer, int n_weights, int offset);
+int check_partial_optimizer(Optimizer *optimizer, int layer_size, int n_weights);
+
+void fc_model_train_partial_layer(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size],
                                   int target_layer, int n_neurons, int offset);
 
-void fc_model_train_layer(Model *model, float (*samples_x)[model->output_size], float (*samples_y)[model->output_size],
+void fc_model_train_layer(Model *model, Optimizer *optimizer, float (*samples_x)[model->input_size], float (*samples_y)[model->output_size],
                           int target_layer);
 
 #endif
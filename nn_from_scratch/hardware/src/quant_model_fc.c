@@ -0,0 +1,50 @@
+#include <math.h>
+#include "quant_model_fc.h"
+#include "../util/quant_forward_prop.h"
+
+/* Function to calculate quantized model output, integer only and without touching the heap.
+    Hidden layers ping-pong between the two halves of the workspace, the last layer writes into output.
+
+    @param model: pointer to quantized model
+    @param workspace: buffer of at least quant_workspace_size(model) bytes
+    @param input: int8 input sample, see fc_quantize_input
+    @param output: pointer to where the output_size int8 outputs will be stored, see fc_dequantize_output
+*/
+void fc_quant_model_predict_into(QuantModel *model, int8_t *workspace, int8_t *input, int8_t *output)
+{
+    int half = quant_workspace_size(model) / 2;
+    int8_t *curr_in = input;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int8_t *curr_out = (i == model->n_layers - 1) ? output : workspace + (i % 2) * half;
+        ForwardPropQ forward_prop = get_fc_forward_prop_q_variant(model->layers_activation[i]);
+        forward_prop(curr_in, model->layers_weights[i], model->layers_biases[i], size, model->layers_size[i],
+                     model->zero_points[i], model->zero_points[i + 1], model->layers_multipliers[i], model->layers_shifts[i],
+                     model->layers_per_channel[i], curr_out);
+        curr_in = curr_out;
+        size = model->layers_size[i];
+    }
+}
+
+/* Quantizes a float input sample with the input scale and zero point of the model */
+void fc_quantize_input(QuantModel *model, float *input, int8_t *output)
+{
+    for (int i = 0; i < model->input_size; i++)
+    {
+        long q = lroundf(input[i] / model->input_scale) + model->zero_points[0];
+        q = q > INT8_MAX ? INT8_MAX : q;
+        q = q < INT8_MIN ? INT8_MIN : q;
+        output[i] = (int8_t)q;
+    }
+}
+
+/* Dequantizes the int8 output of the model to float */
+void fc_dequantize_output(QuantModel *model, int8_t *input, float *output)
+{
+    int32_t zero_point = model->zero_points[model->n_layers];
+    for (int i = 0; i < model->output_size; i++)
+    {
+        output[i] = model->output_scale * (float)(input[i] - zero_point);
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef QUANT_MODEL_FC_H
+#define QUANT_MODEL_FC_H
+
+#include <stdint.h>
+#include "../util/quant_model_binding.h"
+
+void fc_quant_model_predict_into(QuantModel *model, int8_t *workspace, int8_t *input, int8_t *output);
+
+void fc_quantize_input(QuantModel *model, float *input, int8_t *output);
+void fc_dequantize_output(QuantModel *model, int8_t *input, float *output);
+
+#endif
@@ -0,0 +1,246 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "trainer_fc.h"
+#include "model_fc.h"
+#include "partial_model_fc.h"
+#include "masked_model_fc.h"
+#include "../util/config.h"
+
+/* checkpoint interval of whole network training, the smallest one fitting GRADIENT_CHECKPOINT_BUDGET when it is set */
+static int trainer_checkpoint_interval(Model *model)
+{
+    return GRADIENT_CHECKPOINT_BUDGET > 0 ? checkpoint_interval_for_budget(model, GRADIENT_CHECKPOINT_BUDGET) : 1;
+}
+
+/* Bytes of memory a trainer needs besides the Trainer struct, the worst case footprint of training.
+    @param target_layer: layer to train, -1 for the whole network
+    @param n_weights: weights trained per neuron of the target layer, ignored for the whole network
+*/
+size_t trainer_memory_size(Model *model, int target_layer, int n_weights)
+{
+    return top_k_trainer_memory_size(model, target_layer, n_weights, 0);
+}
+
+/* trainer_memory_size of a trainer writing only top_k parameters of the target layer per batch, see create_top_k_trainer */
+size_t top_k_trainer_memory_size(Model *model, int target_layer, int n_weights, int top_k)
+{
+    if (target_layer < 0)
+    {
+        return checkpointed_gradients_memory_size(model, trainer_checkpoint_interval(model));
+    }
+    return top_k_partial_gradients_memory_size(model, target_layer, n_weights, top_k);
+}
+
+/* Binds a caller-provided block of at least trainer_memory_size bytes to the trainer.
+    Useful on device, where the block can be statically allocated. It must be aligned for pointers.
+    @return 1 on success, 0 when the trained slice is invalid
+*/
+int set_trainer(Trainer *trainer, Model *model, int target_layer, int n_weights, int offset, void *buffer)
+{
+    return set_top_k_trainer(trainer, model, target_layer, n_weights, offset, 0, buffer);
+}
+
+/* set_trainer for a trainer writing only top_k parameters of the target layer per batch, with a block of at least
+    top_k_trainer_memory_size bytes
+*/
+int set_top_k_trainer(Trainer *trainer, Model *model, int target_layer, int n_weights, int offset, int top_k, void *buffer)
+{
+    if (target_layer >= 0 && !check_partial_arguments(model, target_layer, n_weights, offset))
+    {
+        return 0;
+    }
+    if (top_k < 0 || (top_k > 0 && target_layer < 0))
+    {
+        printf("Invalid arguments for top-k training, it needs a target layer! \n");
+        return 0;
+    }
+    trainer->model = model;
+    trainer->target_layer = target_layer < 0 ? -1 : target_layer;
+    trainer->n_weights = n_weights;
+    trainer->offset = offset;
+    trainer->trainable_layers = 0;
+    trainer->n_written = 0;
+    if (trainer->target_layer < 0)
+    {
+        set_checkpointed_gradients(&trainer->gradients, model, trainer_checkpoint_interval(model), buffer);
+    }
+    else
+    {
+        set_top_k_partial_gradients(&trainer->partial_gradients, model, target_layer, n_weights, top_k, buffer);
+    }
+    trainer->memory = NULL;
+    return 1;
+}
+
+static Trainer *allocate_trainer(Model *model, int target_layer, int n_weights, int offset, int top_k)
+{
+    Trainer *trainer = (Trainer *)malloc(sizeof(Trainer));
+    void *buffer = malloc(top_k_trainer_memory_size(model, target_layer, n_weights, top_k));
+    if (!set_top_k_trainer(trainer, model, target_layer, n_weights, offset, top_k, buffer))
+    {
+        free(buffer);
+        free(trainer);
+        return NULL;
+    }
+    trainer->memory = buffer;
+    return trainer;
+}
+
+/* Allocates a trainer for the whole network */
+Trainer *create_trainer(Model *model)
+{
+    return allocate_trainer(model, -1, 0, 0, 0);
+}
+
+/* Allocates a trainer for n_weights weights, starting at offset, of every neuron in target_layer
+    @return the trainer, NULL when the slice is invalid
+*/
+Trainer *create_partial_trainer(Model *model, int target_layer, int n_weights, int offset)
+{
+    return create_top_k_trainer(model, target_layer, n_weights, offset, 0);
+}
+
+/* Allocates a partial trainer that writes only the top_k parameters of the slice with the largest accumulated gradients
+    per batch, see fc_apply_top_k_gradients. The held back gradients live in the trainer, so it has to be reused across batches.
+    @param top_k: parameters written per batch, weights and biases together, 0 writes the whole slice
+    @return the trainer, NULL when the slice is invalid
+*/
+Trainer *create_top_k_trainer(Model *model, int target_layer, int n_weights, int offset, int top_k)
+{
+    if (target_layer < 0)
+    {
+        printf("Invalid arguments for partial layer training! \n");
+        return NULL;
+    }
+    return allocate_trainer(model, target_layer, n_weights, offset, top_k);
+}
+
+/* Bytes of memory a trainer of the layers set in a freeze mask needs besides the Trainer struct */
+size_t masked_trainer_memory_size(Model *model, uint32_t trainable_layers)
+{
+    return masked_gradients_memory_size(model, trainable_layers);
+}
+
+/* set_trainer for a trainer of the layers set in a freeze mask, with a block of at least masked_trainer_memory_size bytes
+    @return 1 on success, 0 when the mask is invalid
+*/
+int set_masked_trainer(Trainer *trainer, Model *model, uint32_t trainable_layers, void *buffer)
+{
+    if (!check_trainable_layers(model, trainable_layers))
+    {
+        return 0;
+    }
+    trainer->model = model;
+    trainer->target_layer = -1;
+    trainer->n_weights = 0;
+    trainer->offset = 0;
+    trainer->trainable_layers = trainable_layers;
+    trainer->n_written = 0;
+    set_masked_gradients(&trainer->masked_gradients, model, trainable_layers, buffer);
+    trainer->memory = NULL;
+    return 1;
+}
+
+/* Allocates a trainer of the layers set in a freeze mask, see fc_model_train_masked
+    @return the trainer, NULL when the mask is invalid
+*/
+Trainer *create_masked_trainer(Model *model, uint32_t trainable_layers)
+{
+    if (!check_trainable_layers(model, trainable_layers))
+    {
+        return NULL;
+    }
+    Trainer *trainer = (Trainer *)malloc(sizeof(Trainer));
+    void *buffer = malloc(masked_trainer_memory_size(model, trainable_layers));
+    set_masked_trainer(trainer, model, trainable_layers, buffer);
+    trainer->memory = buffer;
+    return trainer;
+}
+
+/* Frees a trainer created by one of the create_*trainer functions */
+void free_trainer(Trainer *trainer)
+{
+    if (trainer->memory != NULL)
+    {
+        free(trainer->memory);
+    }
+    free(trainer);
+}
+
+/* train for batch_size amount of samples, with the configuration of the trainer
+    @param optimizer: optimizer created with create_optimizer (whole network), create_partial_optimizer (target layer)
+        or create_masked_optimizer (freeze mask),
+        NULL for plain SGD with LEARNING_RATE
+*/
+void fc_trainer_train(Trainer *trainer, Optimizer *optimizer, float (*samples_x)[trainer->model->input_size], float (*samples_y)[trainer->model->output_size])
+{
+    Model *model = trainer->model;
+    int target_layer = trainer->target_layer;
+    Optimizer default_optimizer;
+    if (optimizer == NULL)
+    {
+        default_optimizer = get_default_optimizer();
+        optimizer = &default_optimizer;
+    }
+    else if (target_layer >= 0 && !check_partial_optimizer(optimizer, model->layers_size[target_layer], trainer->n_weights))
+    {
+        return;
+    }
+    else if (trainer->trainable_layers != 0 && !check_masked_optimizer(model, optimizer, trainer->trainable_layers))
+    {
+        return;
+    }
+    else if (target_layer < 0 && trainer->trainable_layers == 0 && !check_optimizer(model, optimizer))
+    {
+        return;
+    }
+
+    if (trainer->trainable_layers != 0)
+    {
+        clear_masked_gradients(&trainer->masked_gradients);
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            masked_calc_gradients(model, samples_x[i], samples_y[i], &trainer->masked_gradients);
+        }
+        optimizer_next_step(optimizer);
+        fc_apply_masked_gradients(model, optimizer, &trainer->masked_gradients);
+        trainer->n_written += trainer->masked_gradients.n_params;
+        return;
+    }
+
+    if (target_layer < 0)
+    {
+        clear_gradients(&trainer->gradients);
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            fc_calc_gradients(model, samples_x[i], samples_y[i], &trainer->gradients);
+        }
+        // loop over the gradients and apply step
+        optimizer_next_step(optimizer);
+        int size = model->input_size;
+        for (int i = 0; i < model->n_layers; i++)
+        {
+            fc_apply_gradient(model, optimizer, i, model->layers_size[i], size, &trainer->gradients);
+            trainer->n_written += (uint64_t)getLayerWeightsCount(model, i) + model->layers_size[i];
+            size = model->layers_size[i];
+        }
+        return;
+    }
+
+    clear_partial_gradients(&trainer->partial_gradients);
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        partial_calc_gradients(samples_x[i], model, target_layer, trainer->n_weights, trainer->offset, samples_y[i], &trainer->partial_gradients);
+    }
+    // apply the calculated gradient to the specific layer
+    optimizer_next_step(optimizer);
+    if (trainer->partial_gradients.top_k > 0)
+    {
+        trainer->n_written += fc_apply_top_k_gradients(model, optimizer, target_layer, model->layers_size[target_layer], trainer->n_weights,
+                                                       trainer->offset, &trainer->partial_gradients);
+        return;
+    }
+    fc_apply_specific_gradients(model, optimizer, target_layer, model->layers_size[target_layer], trainer->n_weights, trainer->offset,
+                                &trainer->partial_gradients);
+    trainer->n_written += (uint64_t)model->layers_size[target_layer] * (trainer->n_weights + 1);
+}
@@ -0,0 +1,42 @@
+#ifndef TRAINER_FC_H
+#define TRAINER_FC_H
+#include <stddef.h>
+#include <stdint.h>
+#include "../util/model_binding.h"
+#include "../util/model_gradients.h"
+#include "../util/optimizer.h"
+
+/* Training state created once per model and training configuration. It owns the gradients, cached activations and
+   scratch memory, so fc_trainer_train runs any number of batches without touching the heap.
+   The optimizer state is kept separately, see optimizer.h.
+*/
+typedef struct
+{
+    Model *model;
+    int target_layer; // -1 when the whole network or the layers of a freeze mask are trained
+    int n_weights;    // weights trained per neuron of the target layer
+    int offset;
+    Gradients gradients;                // whole network
+    PartialGradients partial_gradients; // target layer
+    uint32_t trainable_layers;          // freeze mask of masked training, 0 otherwise
+    MaskedGradients masked_gradients;   // layers of the freeze mask
+    uint64_t n_written;                 // parameters written by the optimizer since the trainer was set, a measure of write traffic and flash wear
+    void *memory;                       // owned memory, NULL when the block is provided by the caller
+} Trainer;
+
+size_t trainer_memory_size(Model *model, int target_layer, int n_weights);
+size_t top_k_trainer_memory_size(Model *model, int target_layer, int n_weights, int top_k);
+int set_trainer(Trainer *trainer, Model *model, int target_layer, int n_weights, int offset, void *buffer);
+int set_top_k_trainer(Trainer *trainer, Model *model, int target_layer, int n_weights, int offset, int top_k, void *buffer);
+
+Trainer *create_trainer(Model *model);
+Trainer *create_partial_trainer(Model *model, int target_layer, int n_weights, int offset);
+Trainer *create_top_k_trainer(Model *model, int target_layer, int n_weights, int offset, int top_k);
+size_t masked_trainer_memory_size(Model *model, uint32_t trainable_layers);
+int set_masked_trainer(Trainer *trainer, Model *model, uint32_t trainable_layers, void *buffer);
+Trainer *create_masked_trainer(Model *model, uint32_t trainable_layers);
+void free_trainer(Trainer *trainer);
+
+void fc_trainer_train(Trainer *trainer, Optimizer *optimizer, float (*samples_x)[trainer->model->input_size], float (*samples_y)[trainer->model->output_size]);
+
+#endif
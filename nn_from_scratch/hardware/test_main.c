@@ -3,30 +3,36 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "include/nn_from_scratch.h"
 #include "model/model.h"
 #include "data/eqcheck_data.h"
 #include "data/ft_data.h"
 #include "data/true_data.h"
+#ifdef ENABLE_QUANT_MODEL
+#include "model/quant_model.h"
+#endif
+#ifdef ENABLE_SPECIALIZED_MODEL
+#include "model/model_specialized.h"
+#endif
 
 /* calculates the loss for the 168 test samples*/
 void compare_true(Model *model)
 {
 
     float sum = 0;
-    for (int i = FT_N_SAMPLES - 168; i < FT_N_SAMPLES; i++)
+    float *outputs = (float *)malloc(168 * OUTPUT_SIZE * sizeof(float));
+    fc_model_predict_batch(model, ft_samples_x[FT_N_SAMPLES - 168], 168, outputs);
+    for (int i = 0; i < 168; i++)
     {
-        float *input = ft_samples_x[i];
-        float *output = fc_model_predict(model, input);
-
         for (int j = 0; j < OUTPUT_SIZE; j++)
         {
-            float t = (output[j] - ft_samples_y[i][j]);
+            float t = (outputs[i * OUTPUT_SIZE + j] - ft_samples_y[FT_N_SAMPLES - 168 + i][j]);
             t *= t;
             sum += t;
         }
-        free(output);
     }
+    free(outputs);
     printf("MSE error: %f \n", sum / 168);
 }
 /* Checks that the model is outputting correct values (before any training) - used to test correctness of forward propagation */
@@ -49,72 +55,1436 @@ void eqcheck(Model *model)
         }
         free(output);
     }
+
+    // heap-free inference has to agree with the allocating path
+    InferenceWorkspace *workspace = allocate_inference_workspace(model);
+    float output[OUTPUT_SIZE];
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        fc_model_predict_into(model, workspace, eqcheck_samples_x[i], output);
+        float tolerance = 0.0001;
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            if (fabs(output[j] - eqcheck_samples_y[i][j]) > tolerance)
+            {
+                printf("FAILED: workspace eqcheck for sample, expected: %f but predicted: %f\n", eqcheck_samples_y[i][j], output[j]);
+                break;
+            }
+        }
+    }
+    free_inference_workspace(workspace);
+
+    // batched inference has to agree with the single sample path
+    float *outputs = (float *)malloc(EQCHECK_N_SAMPLES * OUTPUT_SIZE * sizeof(float));
+    fc_model_predict_batch(model, eqcheck_samples_x[0], EQCHECK_N_SAMPLES, outputs);
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        float tolerance = 0.0001;
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            if (fabs(outputs[i * OUTPUT_SIZE + j] - eqcheck_samples_y[i][j]) > tolerance)
+            {
+                printf("FAILED: batched eqcheck for sample, expected: %f but predicted: %f\n", eqcheck_samples_y[i][j], outputs[i * OUTPUT_SIZE + j]);
+                break;
+            }
+        }
+    }
+    free(outputs);
     printf("eqcheck completed! \n");
 }
+#ifdef ENABLE_QUANT_MODEL
+/* Checks the int8 model against the float reference outputs, quantization error has to stay within QUANT_EQCHECK_TOLERANCE */
+void quant_eqcheck()
+{
+    printf("start quantized eqcheck..\n");
+    QuantModel *model = createAndSetQuantModel(Q_N_LAYERS, Q_INPUT_SIZE, Q_OUTPUT_SIZE, q_layers_size, q_layers_weights, q_layers_biases,
+                                               q_layers_multipliers, q_layers_shifts, q_layers_per_channel, q_zero_points, q_layers_activation,
+                                               Q_INPUT_SCALE, Q_OUTPUT_SCALE);
+    int8_t *workspace = (int8_t *)malloc(quant_workspace_size(model));
+    int8_t q_input[Q_INPUT_SIZE];
+    int8_t q_output[Q_OUTPUT_SIZE];
+    float output[Q_OUTPUT_SIZE];
+    float max_error = 0;
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        fc_quantize_input(model, eqcheck_samples_x[i], q_input);
+        fc_quant_model_predict_into(model, workspace, q_input, q_output);
+        fc_dequantize_output(model, q_output, output);
+        for (int j = 0; j < Q_OUTPUT_SIZE; j++)
+        {
+            float error = fabs(output[j] - eqcheck_samples_y[i][j]);
+            max_error = error > max_error ? error : max_error;
+            if (error > QUANT_EQCHECK_TOLERANCE)
+            {
+                printf("FAILED: quantized eqcheck for sample, expected: %f but predicted: %f\n", eqcheck_samples_y[i][j], output[j]);
+                break;
+            }
+        }
+    }
+    free(workspace);
+    freeQuantModel(model);
+    printf("quantized eqcheck completed, max error: %f \n", max_error);
+}
+#endif
+#ifdef ENABLE_HALF_MODEL
+/* Checks the 16 bit model of HALF_MODEL_FORMAT against the float reference outputs within HALF_EQCHECK_TOLERANCE, its vector
+    kernels against the scalar ones, and that training its last layer steps the fp32 master copy like the float model.
+    The weights of the float model are restored afterwards. */
+void half_eqcheck(Model *model)
+{
+    printf("start half precision eqcheck..\n");
+    HalfModel *half_model = createHalfModel(model, HALF_MODEL_FORMAT);
+    if (half_model == NULL)
+    {
+        return;
+    }
+    float *workspace = (float *)malloc(half_workspace_size(half_model) * sizeof(float));
+    float output[OUTPUT_SIZE];
+    float scalar_output[OUTPUT_SIZE];
+    float max_error = 0;
+    enum SimdLevel level = get_simd_level();
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        fc_half_model_predict_into(half_model, workspace, eqcheck_samples_x[i], output);
+        set_simd_level(SIMD_SCALAR);
+        fc_half_model_predict_into(half_model, workspace, eqcheck_samples_x[i], scalar_output);
+        set_simd_level(level);
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            float error = fabs(output[j] - eqcheck_samples_y[i][j]);
+            max_error = error > max_error ? error : max_error;
+            if (error > HALF_EQCHECK_TOLERANCE)
+            {
+                printf("FAILED: half precision eqcheck for sample, expected: %f but predicted: %f\n", eqcheck_samples_y[i][j], output[j]);
+                break;
+            }
+            if (fabs(output[j] - scalar_output[j]) > 0.0001 * (1 + fabs(scalar_output[j])))
+            {
+                printf("FAILED: half precision SIMD check, scalar: %f but SIMD: %f\n", scalar_output[j], output[j]);
+                break;
+            }
+        }
+    }
+    free(workspace);
+
+    // halfModelToModel writes every layer, so all of them are saved
+    int n_values = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        n_values += getLayerWeightsCount(model, i) + model->layers_size[i];
+    }
+    float *saved = (float *)malloc(n_values * sizeof(float));
+    float *values = saved;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        memcpy(values, model->layers_weights[i], getLayerWeightsCount(model, i) * sizeof(float));
+        values += getLayerWeightsCount(model, i);
+        memcpy(values, model->layers_biases[i], model->layers_size[i] * sizeof(float));
+        values += model->layers_size[i];
+    }
+    int last = model->n_layers - 1;
+    int n_weights = getLayerWeightsCount(model, last);
+    float *saved_last = values - model->layers_size[last] - n_weights;
+    fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, last);
+    fc_half_model_train_layer(half_model, NULL, ft_samples_x, ft_samples_y, last);
+    // the steps differ by the rounding of the weights in the forward pass only
+    float max_step = 0;
+    float max_step_error = 0;
+    for (int j = 0; j < n_weights; j++)
+    {
+        float step = model->layers_weights[last][j] - saved_last[j];
+        float start = half_format_to_float(float_to_half_format(saved_last[j], HALF_MODEL_FORMAT), HALF_MODEL_FORMAT);
+        max_step = fmax(max_step, fabs(step));
+        max_step_error = fmax(max_step_error, fabs(half_model->master_weights[j] - start - step));
+    }
+    if (max_step_error > HALF_EQCHECK_TOLERANCE * max_step)
+    {
+        printf("FAILED: half precision training, the steps of the master weights are off by %f of %f\n", max_step_error, max_step);
+    }
+    halfModelToModel(half_model, model);
+    for (int j = 0; j < n_weights; j++)
+    {
+        if (model->layers_weights[last][j] != half_model->master_weights[j])
+        {
+            printf("FAILED: half precision model written back, expected: %f but got: %f\n", half_model->master_weights[j], model->layers_weights[last][j]);
+            break;
+        }
+    }
+    values = saved;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        memcpy(model->layers_weights[i], values, getLayerWeightsCount(model, i) * sizeof(float));
+        values += getLayerWeightsCount(model, i);
+        memcpy(model->layers_biases[i], values, model->layers_size[i] * sizeof(float));
+        values += model->layers_size[i];
+    }
+    free(saved);
+    printf("half precision eqcheck completed, max error: %f, steps off by %f of %f \n", max_error, max_step_error, max_step);
+    freeHalfModel(half_model);
+}
+#endif
+/* Cross-checks the SIMD kernels picked by the dispatcher against the scalar reference kernels */
+void simd_check(Model *model)
+{
+    enum SimdLevel level = get_simd_level();
+    printf("start SIMD check (%s)..\n", get_simd_level_name(level));
+    float tolerance = 0.0001;
+
+    InferenceWorkspace *workspace = allocate_inference_workspace(model);
+    float simd_output[OUTPUT_SIZE];
+    float scalar_output[OUTPUT_SIZE];
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        set_simd_level(level);
+        fc_model_predict_into(model, workspace, eqcheck_samples_x[i], simd_output);
+        set_simd_level(SIMD_SCALAR);
+        fc_model_predict_into(model, workspace, eqcheck_samples_x[i], scalar_output);
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            if (fabs(simd_output[j] - scalar_output[j]) > tolerance)
+            {
+                printf("FAILED: SIMD check for prediction, scalar: %f but SIMD: %f\n", scalar_output[j], simd_output[j]);
+                break;
+            }
+        }
+    }
+    free_inference_workspace(workspace);
+
+    // an odd number of samples runs the remainders of the batched micro-kernels too
+    int n_samples = EQCHECK_N_SAMPLES - 1 + EQCHECK_N_SAMPLES % 2;
+    float *simd_outputs = (float *)malloc(n_samples * OUTPUT_SIZE * sizeof(float));
+    float *scalar_outputs = (float *)malloc(n_samples * OUTPUT_SIZE * sizeof(float));
+    set_simd_level(level);
+    fc_model_predict_batch(model, eqcheck_samples_x[0], n_samples, simd_outputs);
+    set_simd_level(SIMD_SCALAR);
+    fc_model_predict_batch(model, eqcheck_samples_x[0], n_samples, scalar_outputs);
+    for (int j = 0; j < n_samples * OUTPUT_SIZE; j++)
+    {
+        if (fabs(simd_outputs[j] - scalar_outputs[j]) > tolerance)
+        {
+            printf("FAILED: SIMD check for batched prediction, scalar: %f but SIMD: %f\n", scalar_outputs[j], simd_outputs[j]);
+            break;
+        }
+    }
+    free(simd_outputs);
+    free(scalar_outputs);
+
+    Gradients *simd_gradients = allocate_gradients(model);
+    Gradients *scalar_gradients = allocate_gradients(model);
+    for (int i = 0; i < 16; i++)
+    {
+        set_simd_level(level);
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], simd_gradients);
+        set_simd_level(SIMD_SCALAR);
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], scalar_gradients);
+    }
+    set_simd_level(level);
+
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int n_weights = getLayerWeightsCount(model, i);
+        for (int j = 0; j < n_weights; j++)
+        {
+            if (fabs(simd_gradients->weights[i][j] - scalar_gradients->weights[i][j]) > tolerance * (1 + fabs(scalar_gradients->weights[i][j])))
+            {
+                printf("FAILED: SIMD check for weight gradient in layer %d, scalar: %f but SIMD: %f\n", i, scalar_gradients->weights[i][j], simd_gradients->weights[i][j]);
+                break;
+            }
+        }
+        for (int j = 0; j < model->layers_size[i]; j++)
+        {
+            if (fabs(simd_gradients->biases[i][j] - scalar_gradients->biases[i][j]) > tolerance * (1 + fabs(scalar_gradients->biases[i][j])))
+            {
+                printf("FAILED: SIMD check for bias gradient in layer %d, scalar: %f but SIMD: %f\n", i, scalar_gradients->biases[i][j], simd_gradients->biases[i][j]);
+                break;
+            }
+        }
+    }
+    free_gradients(simd_gradients);
+    free_gradients(scalar_gradients);
+
+    // kernels of the partial training, through the last layer unless it is sparse
+    int last = model->n_layers - 1;
+    if (getSparseLayer(model, last) == NULL)
+    {
+        int prev_size = (last == 0) ? model->input_size : model->layers_size[last - 1];
+        int n_weights = getLayerWeightsCount(model, last);
+        int gradient_stride = (model->weights_layout == OUTPUT_MAJOR_PACKED) ? FC_PACKED_STRIDE(prev_size) : OUTPUT_SIZE;
+        uint32_t *deriv_mask = (uint32_t *)malloc(DERIV_MASK_WORDS(prev_size) * sizeof(uint32_t));
+        memset(deriv_mask, 0xff, DERIV_MASK_WORDS(prev_size) * sizeof(uint32_t));
+        float *simd_back = (float *)malloc(prev_size * sizeof(float));
+        float *scalar_back = (float *)malloc(prev_size * sizeof(float));
+        float *simd_weights = (float *)calloc(n_weights + OUTPUT_SIZE, sizeof(float));
+        float *scalar_weights = (float *)calloc(n_weights + OUTPUT_SIZE, sizeof(float));
+        set_simd_level(level);
+        get_fc_light_back_prop_variant(model->weights_layout)(eqcheck_samples_y[0], model->layers_weights[last], OUTPUT_SIZE, prev_size,
+                                                              deriv_mask, simd_back);
+        get_fc_specific_back_prop_cached_variant(model->weights_layout)(eqcheck_samples_y[0], simd_back, OUTPUT_SIZE, simd_weights,
+                                                                        simd_weights + n_weights, prev_size, gradient_stride);
+        set_simd_level(SIMD_SCALAR);
+        get_fc_light_back_prop_variant(model->weights_layout)(eqcheck_samples_y[0], model->layers_weights[last], OUTPUT_SIZE, prev_size,
+                                                              deriv_mask, scalar_back);
+        get_fc_specific_back_prop_cached_variant(model->weights_layout)(eqcheck_samples_y[0], scalar_back, OUTPUT_SIZE, scalar_weights,
+                                                                        scalar_weights + n_weights, prev_size, gradient_stride);
+        set_simd_level(level);
+        for (int j = 0; j < prev_size; j++)
+        {
+            if (fabs(simd_back[j] - scalar_back[j]) > tolerance * (1 + fabs(scalar_back[j])))
+            {
+                printf("FAILED: SIMD check for light back propagation, scalar: %f but SIMD: %f\n", scalar_back[j], simd_back[j]);
+                break;
+            }
+        }
+        for (int j = 0; j < n_weights + OUTPUT_SIZE; j++)
+        {
+            if (fabs(simd_weights[j] - scalar_weights[j]) > tolerance * (1 + fabs(scalar_weights[j])))
+            {
+                printf("FAILED: SIMD check for specific back propagation, scalar: %f but SIMD: %f\n", scalar_weights[j], simd_weights[j]);
+                break;
+            }
+        }
+        free(deriv_mask);
+        free(simd_back);
+        free(scalar_back);
+        free(simd_weights);
+        free(scalar_weights);
+    }
+    printf("SIMD check completed! \n");
+}
+/* Gradients with every checkpoint interval have to match the ones keeping all activations, the recomputed segments
+    run the same kernels on the same inputs */
+/* Checks that checkpointed gradients match the ones of every activation kept, for every interval */
+void checkpoint_intervals_check(Model *model)
+{
+    Gradients *reference = allocate_gradients(model);
+    for (int i = 0; i < 16; i++)
+    {
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], reference);
+    }
+    for (int interval = 2; interval <= model->n_layers + 1; interval++)
+    {
+        Gradients *checkpointed = allocate_checkpointed_gradients(model, interval);
+        for (int i = 0; i < 16; i++)
+        {
+            fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], checkpointed);
+        }
+        for (int j = 0; j < reference->n_params; j++)
+        {
+            if (checkpointed->params[j] != reference->params[j])
+            {
+                printf("FAILED: checkpoint check of %d layers with interval %d, expected: %f but got: %f\n", model->n_layers, interval,
+                       reference->params[j], checkpointed->params[j]);
+                break;
+            }
+        }
+        printf("%d layers, interval %d: %d bytes of gradients instead of %d\n", model->n_layers, interval,
+               (int)checkpointed_gradients_memory_size(model, interval), (int)gradients_memory_size(model));
+        free_gradients(checkpointed);
+    }
+    free_gradients(reference);
+}
+
+/* Checks checkpointing on the model and on a deeper one of 7 layers, whose depth is not a multiple of every interval.
+    With interval 3 only layers 0 and 1 are recomputed, layers 3 and 4 are still in place from the forward pass. */
+void checkpoint_check(Model *model)
+{
+    printf("start checkpoint check..\n");
+    checkpoint_intervals_check(model);
+    if (checkpoint_interval_for_budget(model, gradients_memory_size(model)) != 1)
+    {
+        printf("FAILED: checkpointing chosen although all activations fit the budget\n");
+    }
+
+    enum
+    {
+        DEEP_LAYERS = 7,
+        DEEP_WIDTH = 8
+    };
+    int deep_sizes[DEEP_LAYERS];
+    float *deep_weights[DEEP_LAYERS];
+    float *deep_biases[DEEP_LAYERS];
+    enum ActivationType deep_activations[DEEP_LAYERS];
+    int size = INPUT_SIZE;
+    for (int i = 0; i < DEEP_LAYERS; i++)
+    {
+        deep_sizes[i] = (i == DEEP_LAYERS - 1) ? OUTPUT_SIZE : DEEP_WIDTH;
+        deep_activations[i] = (i == DEEP_LAYERS - 1) ? LINEAR : RELU;
+        deep_weights[i] = (float *)malloc(size * deep_sizes[i] * sizeof(float));
+        deep_biases[i] = (float *)malloc(deep_sizes[i] * sizeof(float));
+        for (int j = 0; j < size * deep_sizes[i]; j++)
+        {
+            deep_weights[i][j] = 0.5f * sinf(1.7f * j + i);
+        }
+        for (int j = 0; j < deep_sizes[i]; j++)
+        {
+            deep_biases[i][j] = 0.1f * cosf(j + i);
+        }
+        size = deep_sizes[i];
+    }
+    Model *deep = createAndSetModel(DEEP_LAYERS, INPUT_SIZE, OUTPUT_SIZE, deep_sizes, deep_weights, deep_biases, deep_activations);
+    checkpoint_intervals_check(deep);
+
+    Gradients *checkpointed = allocate_checkpointed_gradients(deep, 3);
+    int n_recomputed = 0;
+    for (int i = 1; i < DEEP_LAYERS; i++)
+    {
+        n_recomputed += i - checkpoint_recompute_from(checkpointed, deep, i);
+    }
+    if (n_recomputed != 2)
+    {
+        printf("FAILED: checkpoint check recomputed %d layers of 7 with interval 3, expected 2\n", n_recomputed);
+    }
+    free_gradients(checkpointed);
+    freeModel(deep);
+    for (int i = 0; i < DEEP_LAYERS; i++)
+    {
+        free(deep_weights[i]);
+        free(deep_biases[i]);
+    }
+    printf("checkpoint check completed! \n");
+}
+/* Checks masked training against the gradients of the whole network, for every layer trained, the layers from the second
+    one up and the last layer alone, and that the last layer alone trains like fc_model_train_layer. The weights are restored afterwards. */
+void masked_check(Model *model)
+{
+    printf("start masked check..\n");
+    float tolerance = 0.0001;
+    Gradients *reference = allocate_gradients(model);
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], reference);
+    }
+    uint32_t all_layers = (model->n_layers < MAX_MASKED_LAYERS) ? LAYER_MASK(model->n_layers) - 1 : ~0u;
+    uint32_t masks[3] = {all_layers, all_layers & ~LAYER_MASK(0), LAYER_MASK(model->n_layers - 1)};
+    for (int m = 0; m < 3; m++)
+    {
+        MaskedGradients *gradients = allocate_masked_gradients(model, masks[m]);
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            masked_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], gradients);
+        }
+        for (int i = 0; i < model->n_layers; i++)
+        {
+            if (!(masks[m] & LAYER_MASK(i)))
+            {
+                if (gradients->weights[i] != NULL)
+                {
+                    printf("FAILED: masked check, the frozen layer %d got gradients\n", i);
+                }
+                continue;
+            }
+            int n_weights = getLayerWeightsCount(model, i);
+            for (int j = 0; j < n_weights + model->layers_size[i]; j++)
+            {
+                float expected = (j < n_weights) ? reference->weights[i][j] : reference->biases[i][j - n_weights];
+                float value = (j < n_weights) ? gradients->weights[i][j] : gradients->biases[i][j - n_weights];
+                if (fabs(value - expected) > tolerance * (1 + fabs(expected)))
+                {
+                    printf("FAILED: masked check with mask 0x%x in layer %d, expected: %f but got: %f\n", (unsigned)masks[m], i, expected, value);
+                    break;
+                }
+            }
+        }
+        printf("mask 0x%x: %d bytes of gradients instead of %d\n", (unsigned)masks[m], (int)masked_gradients_memory_size(model, masks[m]),
+               (int)gradients_memory_size(model));
+        free_masked_gradients(gradients);
+    }
+    free_gradients(reference);
+
+    int last = model->n_layers - 1;
+    int n_values = getLayerWeightsCount(model, last) + model->layers_size[last];
+    float *saved = (float *)malloc(n_values * sizeof(float));
+    memcpy(saved, model->layers_weights[last], getLayerWeightsCount(model, last) * sizeof(float));
+    memcpy(saved + getLayerWeightsCount(model, last), model->layers_biases[last], model->layers_size[last] * sizeof(float));
+    if (getSparseLayer(model, last) == NULL)
+    {
+        fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, last);
+        float *expected = (float *)malloc(n_values * sizeof(float));
+        memcpy(expected, model->layers_weights[last], getLayerWeightsCount(model, last) * sizeof(float));
+        memcpy(expected + getLayerWeightsCount(model, last), model->layers_biases[last], model->layers_size[last] * sizeof(float));
+        memcpy(model->layers_weights[last], saved, getLayerWeightsCount(model, last) * sizeof(float));
+        memcpy(model->layers_biases[last], saved + getLayerWeightsCount(model, last), model->layers_size[last] * sizeof(float));
+
+        fc_model_train_masked(model, NULL, ft_samples_x, ft_samples_y, LAYER_MASK(last));
+        for (int j = 0; j < n_values; j++)
+        {
+            int n_weights = getLayerWeightsCount(model, last);
+            float value = (j < n_weights) ? model->layers_weights[last][j] : model->layers_biases[last][j - n_weights];
+            if (fabs(value - expected[j]) > tolerance * (1 + fabs(expected[j])))
+            {
+                printf("FAILED: masked training of the last layer, expected: %f but got: %f\n", expected[j], value);
+                break;
+            }
+        }
+        free(expected);
+        memcpy(model->layers_weights[last], saved, getLayerWeightsCount(model, last) * sizeof(float));
+        memcpy(model->layers_biases[last], saved + getLayerWeightsCount(model, last), model->layers_size[last] * sizeof(float));
+    }
+    free(saved);
+    printf("masked check completed! \n");
+}
+/* Checks that whole network training rejects optimizers of other shapes and leaves the weights as they are */
+void optimizer_check(Model *model)
+{
+    printf("start optimizer check..\n");
+    int n_values = getLayerWeightsCount(model, 0) + model->layers_size[0];
+    float *saved = (float *)malloc(n_values * sizeof(float));
+    memcpy(saved, model->layers_weights[0], getLayerWeightsCount(model, 0) * sizeof(float));
+    memcpy(saved + getLayerWeightsCount(model, 0), model->layers_biases[0], model->layers_size[0] * sizeof(float));
+    int last = model->n_layers - 1;
+    Optimizer *optimizers[2] = {create_partial_optimizer(model, ADAM, last, model->n_layers > 1 ? model->layers_size[last - 1] : model->input_size),
+                                create_masked_optimizer(model, ADAM, LAYER_MASK(last))};
+    for (int o = 0; o < 2; o++)
+    {
+        fc_model_train(model, optimizers[o], ft_samples_x, ft_samples_y);
+        free_optimizer(optimizers[o]);
+    }
+    for (int j = 0; j < n_values; j++)
+    {
+        int n_weights = getLayerWeightsCount(model, 0);
+        float value = (j < n_weights) ? model->layers_weights[0][j] : model->layers_biases[0][j - n_weights];
+        if (value != saved[j])
+        {
+            printf("FAILED: optimizer check, training with an optimizer of another shape changed the weights\n");
+            break;
+        }
+    }
+    free(saved);
+    printf("optimizer check completed! \n");
+}
+/* Checks that training the last layer on cached features matches fc_model_train_layer, and that the fp16 and int8 features
+    stay within their rounding error of the fp32 ones. The weights are restored afterwards. */
+void feature_cache_check(Model *model)
+{
+    printf("start feature cache check..\n");
+    int last = model->n_layers - 1;
+    if (last < 1)
+    {
+        return;
+    }
+    float tolerance = 0.0001;
+    int n_samples = (FT_N_SAMPLES - 168) / BATCH_SIZE * BATCH_SIZE; // the samples in front of the test samples
+    FeatureCache *reference = create_feature_cache(model, last, ft_samples_x[0], n_samples, FEATURE_FP32);
+    if (getSparseLayer(model, last) == NULL)
+    {
+        int n_weights = getLayerWeightsCount(model, last);
+        int n_values = n_weights + model->layers_size[last];
+        float *saved = (float *)malloc(n_values * sizeof(float));
+        float *expected = (float *)malloc(n_values * sizeof(float));
+        memcpy(saved, model->layers_weights[last], n_weights * sizeof(float));
+        memcpy(saved + n_weights, model->layers_biases[last], model->layers_size[last] * sizeof(float));
+        fc_model_train_layer(model, NULL, ft_samples_x + BATCH_SIZE, ft_samples_y + BATCH_SIZE, last);
+        memcpy(expected, model->layers_weights[last], n_weights * sizeof(float));
+        memcpy(expected + n_weights, model->layers_biases[last], model->layers_size[last] * sizeof(float));
+        memcpy(model->layers_weights[last], saved, n_weights * sizeof(float));
+        memcpy(model->layers_biases[last], saved + n_weights, model->layers_size[last] * sizeof(float));
+
+        fc_model_train_layer_cached(reference, NULL, BATCH_SIZE, ft_samples_y + BATCH_SIZE, last);
+        for (int j = 0; j < n_values; j++)
+        {
+            float value = (j < n_weights) ? model->layers_weights[last][j] : model->layers_biases[last][j - n_weights];
+            if (fabs(value - expected[j]) > tolerance * (1 + fabs(expected[j])))
+            {
+                printf("FAILED: cached training of the last layer, expected: %f but got: %f\n", expected[j], value);
+                break;
+            }
+        }
+        memcpy(model->layers_weights[last], saved, n_weights * sizeof(float));
+        memcpy(model->layers_biases[last], saved + n_weights, model->layers_size[last] * sizeof(float));
+        free(saved);
+        free(expected);
+    }
+
+    enum FeatureStorage storages[2] = {FEATURE_FP16, FEATURE_INT8};
+    for (int k = 0; k < 2; k++)
+    {
+        FeatureCache *cache = create_feature_cache(model, last, ft_samples_x[0], n_samples, storages[k]);
+        for (int first = 0; first + BATCH_SIZE <= n_samples; first += BATCH_SIZE)
+        {
+            float *expected = feature_cache_batch(reference, first);
+            float *features = feature_cache_batch(cache, first);
+            for (int s = 0; s < BATCH_SIZE; s++)
+            {
+                float *sample = expected + s * cache->feature_size;
+                float max_abs = 0;
+                for (int j = 0; j < cache->feature_size; j++)
+                {
+                    max_abs = fmaxf(max_abs, fabsf(sample[j]));
+                }
+                for (int j = 0; j < cache->feature_size; j++)
+                {
+                    float bound = (storages[k] == FEATURE_FP16) ? fabsf(sample[j]) / 2048 + 1e-7f : max_abs / 254 * 1.001f;
+                    if (fabsf(features[s * cache->feature_size + j] - sample[j]) > bound)
+                    {
+                        printf("FAILED: feature cache storage %d, expected: %f but got: %f\n", storages[k], sample[j],
+                               features[s * cache->feature_size + j]);
+                        s = BATCH_SIZE;
+                        break;
+                    }
+                }
+            }
+        }
+        printf("storage %d: %d bytes of features instead of %d\n", storages[k], (int)feature_cache_memory_size(model, last, n_samples, storages[k]),
+               (int)feature_cache_memory_size(model, last, n_samples, FEATURE_FP32));
+        free_feature_cache(cache);
+    }
+    free_feature_cache(reference);
+    printf("feature cache check completed! \n");
+}
+/* Checks top-k training of the last layer. Writing every parameter matches plain partial training, with a smaller k only the
+    k largest gradients are written and the others are kept in the residuals. The weights are restored afterwards. */
+void top_k_check(Model *model)
+{
+    printf("start top-k check..\n");
+    int target_layer = model->n_layers - 1;
+    int n_weights = model->layers_size[target_layer - 1];
+    int n_params = model->layers_size[target_layer] * (n_weights + 1);
+    int n_layer_weights = getLayerWeightsCount(model, target_layer);
+    int n_values = n_layer_weights + model->layers_size[target_layer];
+    float *saved = (float *)malloc(n_values * sizeof(float));
+    float *expected = (float *)malloc(n_values * sizeof(float));
+    memcpy(saved, model->layers_weights[target_layer], n_layer_weights * sizeof(float));
+    memcpy(saved + n_layer_weights, model->layers_biases[target_layer], model->layers_size[target_layer] * sizeof(float));
+
+    Trainer *trainer = create_partial_trainer(model, target_layer, n_weights, 0);
+    if (trainer == NULL)
+    {
+        free(saved);
+        free(expected);
+        return;
+    }
+    fc_trainer_train(trainer, NULL, ft_samples_x, ft_samples_y);
+    free_trainer(trainer);
+    memcpy(expected, model->layers_weights[target_layer], n_layer_weights * sizeof(float));
+    memcpy(expected + n_layer_weights, model->layers_biases[target_layer], model->layers_size[target_layer] * sizeof(float));
+
+    for (int k = n_params; k > 0; k = (k == n_params) ? n_params / 10 + 1 : 0)
+    {
+        memcpy(model->layers_weights[target_layer], saved, n_layer_weights * sizeof(float));
+        memcpy(model->layers_biases[target_layer], saved + n_layer_weights, model->layers_size[target_layer] * sizeof(float));
+        trainer = create_top_k_trainer(model, target_layer, n_weights, 0, k);
+        fc_trainer_train(trainer, NULL, ft_samples_x, ft_samples_y);
+        if (trainer->n_written != (uint64_t)k)
+        {
+            printf("FAILED: top-k check with k = %d wrote %d parameters\n", k, (int)trainer->n_written);
+        }
+
+        int n_changed = 0;
+        for (int j = 0; j < n_values; j++)
+        {
+            float value = (j < n_layer_weights) ? model->layers_weights[target_layer][j] : model->layers_biases[target_layer][j - n_layer_weights];
+            n_changed += value != saved[j];
+            if (k == n_params && value != expected[j])
+            {
+                printf("FAILED: top-k check writing every parameter, expected: %f but got: %f\n", expected[j], value);
+                break;
+            }
+        }
+        if (n_changed > k)
+        {
+            printf("FAILED: top-k check with k = %d changed %d parameters\n", k, n_changed);
+        }
+
+        // the written gradients leave a zero residual, the held back ones are kept in full and are not larger
+        PartialGradients *gradients = &trainer->partial_gradients;
+        float min_written = INFINITY;
+        float max_kept = 0;
+        for (int j = 0; j < n_params; j++)
+        {
+            if (gradients->weights[j] == 0)
+            {
+                continue;
+            }
+            else if (gradients->residuals[j] == 0)
+            {
+                min_written = fminf(min_written, fabsf(gradients->weights[j]));
+            }
+            else if (gradients->residuals[j] == gradients->weights[j])
+            {
+                max_kept = fmaxf(max_kept, fabsf(gradients->weights[j]));
+            }
+            else
+            {
+                printf("FAILED: top-k check, residual %f of the gradient %f was neither written nor kept\n", gradients->residuals[j], gradients->weights[j]);
+                break;
+            }
+        }
+        if (max_kept > min_written)
+        {
+            printf("FAILED: top-k check kept a gradient of %f but wrote one of %f\n", max_kept, min_written);
+        }
+        printf("k = %d: %d of %d parameters written, %d changed, %d bytes of training memory instead of %d\n", k, (int)trainer->n_written, n_params, n_changed,
+               (int)top_k_trainer_memory_size(model, target_layer, n_weights, k), (int)trainer_memory_size(model, target_layer, n_weights));
+        free_trainer(trainer);
+    }
+    memcpy(model->layers_weights[target_layer], saved, n_layer_weights * sizeof(float));
+    memcpy(model->layers_biases[target_layer], saved + n_layer_weights, model->layers_size[target_layer] * sizeof(float));
+    free(saved);
+    free(expected);
+    printf("top-k check completed! \n");
+}
+#ifdef ENABLE_SPECIALIZED_MODEL
+/* Checks the kernels generated by model_codegen.py against the eqcheck data and the generic training path.
+    The specialized training step is compared with an SGD step on the generic gradients, the weights are restored afterwards. */
+void specialized_check(Model *model)
+{
+    printf("start specialized model check..\n");
+    if (model->layers_weights[0] != layers_weights[0])
+    {
+        printf("specialized model check skipped, the weights were repacked at run time \n");
+        return;
+    }
+    float tolerance = 0.0001;
+    float output[OUTPUT_SIZE];
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        specialized_model_predict(eqcheck_samples_x[i], output);
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            if (fabs(output[j] - eqcheck_samples_y[i][j]) > tolerance)
+            {
+                printf("FAILED: specialized eqcheck for sample, expected: %f but predicted: %f\n", eqcheck_samples_y[i][j], output[j]);
+                break;
+            }
+        }
+    }
+
+    Gradients *gradients = allocate_gradients(model);
+    Gradients *specialized_gradients = allocate_gradients(model);
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], gradients);
+        specialized_model_calc_gradients(ft_samples_x[i], ft_samples_y[i], specialized_gradients->weights, specialized_gradients->biases);
+    }
+    for (int j = 0; j < gradients->n_params; j++)
+    {
+        if (fabs(specialized_gradients->params[j] - gradients->params[j]) > tolerance * (1 + fabs(gradients->params[j])))
+        {
+            printf("FAILED: specialized gradient check, generic: %f but specialized: %f\n", gradients->params[j], specialized_gradients->params[j]);
+            break;
+        }
+    }
+
+    int size = model->input_size;
+    float **weights = (float **)malloc(model->n_layers * sizeof(float *));
+    float **biases = (float **)malloc(model->n_layers * sizeof(float *));
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int n_weights = model->layers_size[i] * (model->weights_layout == OUTPUT_MAJOR_PACKED ? FC_PACKED_STRIDE(size) : size);
+        weights[i] = (float *)malloc(n_weights * sizeof(float));
+        biases[i] = (float *)malloc(model->layers_size[i] * sizeof(float));
+        memcpy(weights[i], model->layers_weights[i], n_weights * sizeof(float));
+        memcpy(biases[i], model->layers_biases[i], model->layers_size[i] * sizeof(float));
+        size = model->layers_size[i];
+    }
+    specialized_model_train(NULL, ft_samples_x, ft_samples_y);
+    size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int n_weights = model->layers_size[i] * (model->weights_layout == OUTPUT_MAJOR_PACKED ? FC_PACKED_STRIDE(size) : size);
+        for (int j = 0; j < n_weights; j++)
+        {
+            float expected = weights[i][j] - LEARNING_RATE * (gradients->weights[i][j] / BATCH_SIZE);
+            if (fabs(model->layers_weights[i][j] - expected) > tolerance * (1 + fabs(expected)))
+            {
+                printf("FAILED: specialized training step in layer %d, expected: %f but got: %f\n", i, expected, model->layers_weights[i][j]);
+                break;
+            }
+        }
+        memcpy(model->layers_weights[i], weights[i], n_weights * sizeof(float));
+        memcpy(model->layers_biases[i], biases[i], model->layers_size[i] * sizeof(float));
+        free(weights[i]);
+        free(biases[i]);
+        size = model->layers_size[i];
+    }
+    free(weights);
+    free(biases);
+    free_gradients(gradients);
+    free_gradients(specialized_gradients);
+    printf("specialized model check completed! \n");
+}
+#endif
+#ifdef ENABLE_MODEL_FILE
+/* Checks the binary model file written by model_converter.py --binary against the compiled-in model.
+    The file is mapped copy-on-write, a training step on it must not reach the file. */
+void model_file_check(Model *model)
+{
+    printf("start model file check..\n");
+    ModelFile *file = openModelFile(MODEL_FILE_PATH, MODEL_FILE_PRIVATE);
+    if (file == NULL)
+    {
+        printf("FAILED: could not open the model file %s\n", MODEL_FILE_PATH);
+        return;
+    }
+    Model *file_model = &file->model;
+    if (file_model->n_layers != model->n_layers || file_model->input_size != model->input_size || file_model->output_size != model->output_size)
+    {
+        printf("FAILED: model file has a different shape than the compiled model\n");
+        closeModelFile(file);
+        return;
+    }
+
+    InferenceWorkspace *workspace = allocate_inference_workspace(file_model);
+    float output[OUTPUT_SIZE];
+    float tolerance = 0.0001;
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        fc_model_predict_into(file_model, workspace, eqcheck_samples_x[i], output);
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            if (fabs(output[j] - eqcheck_samples_y[i][j]) > tolerance)
+            {
+                printf("FAILED: model file eqcheck for sample, expected: %f but predicted: %f\n", eqcheck_samples_y[i][j], output[j]);
+                break;
+            }
+        }
+    }
+    free_inference_workspace(workspace);
+
+    float first_weight = file_model->layers_weights[0][0];
+    Optimizer *optimizer = create_optimizer(file_model, SGD);
+    fc_model_train(file_model, optimizer, ft_samples_x, ft_samples_y);
+    free_optimizer(optimizer);
+    closeModelFile(file);
+
+    file = openModelFile(MODEL_FILE_PATH, MODEL_FILE_READ_ONLY);
+    if (file == NULL || file->model.layers_weights[0][0] != first_weight)
+    {
+        printf("FAILED: training on a private mapping changed the model file\n");
+    }
+    if (file != NULL)
+    {
+        closeModelFile(file);
+    }
+    printf("model file check completed! \n");
+}
+#endif
+#ifdef ENABLE_DATA_LOADER
+/* Checks that the dataset file streams the fine-tuning samples, in file order without a seed and
+    as a permutation of whole batches with one */
+void data_loader_check()
+{
+    printf("start data loader check..\n");
+    DataLoader *loader = create_data_loader(DATASET_PATH, BATCH_SIZE, 0);
+    if (loader == NULL)
+    {
+        printf("FAILED: could not open the dataset file %s\n", DATASET_PATH);
+        return;
+    }
+    float *samples_x;
+    float *samples_y;
+    int n_batches = FT_N_SAMPLES / BATCH_SIZE < loader->n_batches ? FT_N_SAMPLES / BATCH_SIZE : loader->n_batches;
+    for (int b = 0; b < n_batches && data_loader_next_batch(loader, &samples_x, &samples_y); b++)
+    {
+        if (memcmp(samples_x, ft_samples_x[b * BATCH_SIZE], BATCH_SIZE * INPUT_SIZE * sizeof(float)) != 0 ||
+            memcmp(samples_y, ft_samples_y[b * BATCH_SIZE], BATCH_SIZE * OUTPUT_SIZE * sizeof(float)) != 0)
+        {
+            printf("FAILED: data loader batch %d differs from the fine-tuning data\n", b);
+            break;
+        }
+    }
+    free_data_loader(loader);
+
+    // two shuffled epochs have the same number of batches, in a different order
+    loader = create_data_loader(DATASET_PATH, BATCH_SIZE, DATA_SHUFFLE_SEED);
+    int epoch_batches[2] = {0, 0};
+    float first_input[2] = {0, 0};
+    for (int epoch = 0; epoch < 2; epoch++)
+    {
+        while (data_loader_next_batch(loader, &samples_x, &samples_y))
+        {
+            if (epoch_batches[epoch]++ == 0)
+            {
+                first_input[epoch] = samples_x[0];
+            }
+        }
+    }
+    if (epoch_batches[0] != loader->n_batches || epoch_batches[1] != loader->n_batches)
+    {
+        printf("FAILED: data loader epochs have %d and %d batches, expected %d\n", epoch_batches[0], epoch_batches[1], loader->n_batches);
+    }
+    if (loader->n_samples > 1 && first_input[0] == first_input[1])
+    {
+        printf("FAILED: data loader did not reshuffle between epochs\n");
+    }
+    free_data_loader(loader);
+    printf("data loader check completed! \n");
+}
+#endif
+#ifdef ENABLE_PROFILING
+/* Profiles one prediction, one batch of whole network training and one batch of last layer training, checks the call
+    counts of the counters and prints the per-layer breakdown */
+void profiling_check(Model *model)
+{
+    profile_reset();
+    free(fc_model_predict(model, eqcheck_samples_x[0]));
+    fc_model_train(model, NULL, ft_samples_x, ft_samples_y);
+    fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, N_LAYERS - 1);
+    int n_trainings = (getSparseLayer(model, N_LAYERS - 1) == NULL) ? 2 : 1; // partial training rejects a sparse target layer
+
+    for (int i = 0; i < N_LAYERS; i++)
+    {
+        int backward_calls = (i == N_LAYERS - 1) ? n_trainings * BATCH_SIZE : BATCH_SIZE; // partial training stops at the target layer
+        if (profile_get(i, PROFILE_PREDICT)->calls != 1 || profile_get(i, PROFILE_FORWARD)->calls != (uint64_t)(n_trainings * BATCH_SIZE) ||
+            profile_get(i, PROFILE_BACKWARD)->calls != (uint64_t)backward_calls ||
+            profile_get(i, PROFILE_APPLY)->calls != (i == N_LAYERS - 1 ? (uint64_t)n_trainings : 1u) ||
+            profile_get(i, PROFILE_LOSS)->calls != (i == N_LAYERS - 1 ? (uint64_t)(n_trainings * BATCH_SIZE) : 0u))
+        {
+            printf("FAILED: profiling counters of layer %d do not match the calls\n", i);
+        }
+    }
+    int length = profile_to_json(NULL, 0);
+    char *json = (char *)malloc(length + 1);
+    profile_to_json(json, length + 1);
+    printf("%s\n", json);
+    free(json);
+    printf("profiling check completed! \n");
+}
+#endif
+#ifdef ENABLE_TRACK_MEMORY
 void memory_tester(Model *model)
 {
 
     reset_memory_tracking();
     printf("Memory stats for training for the whole network \n");
-    fc_model_train(model, ft_samples_x, ft_samples_y);
+    fc_model_train(model, NULL, ft_samples_x, ft_samples_y);
     print_memory();
     reset_memory_tracking();
     printf("\n \n");
 
     printf("Memory stats for training for the first layer \n");
-    fc_model_train_layer(model, ft_samples_x, ft_samples_y, 0);
+    fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, 0);
     print_memory();
     reset_memory_tracking();
     printf("\n \n");
 
     printf("Memory stats for training for the last layer \n");
-    fc_model_train_layer(model, ft_samples_x, ft_samples_y, 2);
+    fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, 2);
     print_memory();
     reset_memory_tracking();
     printf("\n \n");
 
     printf("Memory stats for the second layer \n");
-    fc_model_train_layer(model, ft_samples_x, ft_samples_y, 1);
+    fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, 1);
     print_memory();
     reset_memory_tracking();
     printf("\n \n");
 
     printf("Memory stats for training for the second layer, two last weights \n");
-    fc_model_train_partial_layer(model, ft_samples_x, ft_samples_y, 1, 2, 2);
+    fc_model_train_partial_layer(model, NULL, ft_samples_x, ft_samples_y, 1, 2, 2);
     print_memory();
     reset_memory_tracking();
     printf("\n \n");
 
+    printf("Memory stats for the ADAM optimizer state of the whole network \n");
+    Optimizer *optimizer = create_optimizer(model, ADAM);
+    fc_model_train(model, optimizer, ft_samples_x, ft_samples_y);
+    free_optimizer(optimizer);
+    print_memory();
+    reset_memory_tracking();
+    printf("\n \n");
+
+    printf("Memory stats for the ADAM optimizer state of the second layer, two last weights \n");
+    optimizer = create_partial_optimizer(model, ADAM, 1, 2);
+    fc_model_train_partial_layer(model, optimizer, ft_samples_x, ft_samples_y, 1, 2, 2);
+    free_optimizer(optimizer);
+    print_memory();
+    reset_memory_tracking();
+    printf("\n \n");
+
+    printf("Memory stats for a trainer of the second layer reused for four batches, %d bytes \n", (int)trainer_memory_size(model, 1, 2));
+    Trainer *trainer = create_partial_trainer(model, 1, 2, 2);
+    if (trainer != NULL) // NULL for a sparse second layer
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            fc_trainer_train(trainer, NULL, ft_samples_x, ft_samples_y);
+        }
+        free_trainer(trainer);
+    }
+    print_memory_report();
+    reset_memory_tracking();
+    printf("\n \n");
+
     printf("\n Completed memory test \n");
     return;
 }
+#endif
+#ifdef ENABLE_HEAP_EMULATION
+/* trains the whole network for mode 0, layer mode - 1 up to N_LAYERS and the two last weights of the second layer after that */
+void heap_train_mode(Model *model, int mode, HeapStats *stats, size_t arena_size, enum HeapPolicy policy)
+{
+    if (!start_heap_emulation(arena_size, policy))
+    {
+        printf("FAILED: heap emulation could not start\n");
+        return;
+    }
+    if (mode == 0)
+    {
+        fc_model_train(model, NULL, ft_samples_x, ft_samples_y);
+    }
+    else if (mode <= N_LAYERS)
+    {
+        fc_model_train_layer(model, NULL, ft_samples_x, ft_samples_y, mode - 1);
+    }
+    else
+    {
+        fc_model_train_partial_layer(model, NULL, ft_samples_x, ft_samples_y, 1, 2, 2);
+    }
+    stop_heap_emulation();
+    get_heap_stats(stats);
+    if (stats->used_bytes != 0 || stats->fragmentation != 0 || stats->largest_free_block + 8 != stats->arena_size)
+    {
+        printf("FAILED: arena not coalesced after training, %zu bytes in use\n", stats->used_bytes);
+    }
+}
+
+/* Runs the training modes of memory_tester in a heap of HEAP_ARENA_SIZE bytes with every policy and prints whether they fit,
+    then checks that the whole network training fails in an arena of half its peak */
+void heap_emulation_check(Model *model)
+{
+    HeapStats stats;
+    for (int policy = 0; policy < HEAP_N_POLICIES; policy++)
+    {
+        for (int mode = 0; mode < N_LAYERS + 2; mode++)
+        {
+            heap_train_mode(model, mode, &stats, HEAP_ARENA_SIZE, (enum HeapPolicy)policy);
+            printf("%s, ", get_heap_policy_name((enum HeapPolicy)policy));
+            if (mode == 0)
+            {
+                printf("whole network");
+            }
+            else if (mode <= N_LAYERS)
+            {
+                printf("layer %d", mode - 1);
+            }
+            else
+            {
+                printf("layer 1, two last weights");
+            }
+            printf(": peak %zu bytes, fragmentation %.3f at the peak, smallest largest free block %zu bytes, %s\n",
+                   stats.peak_used_bytes, stats.peak_fragmentation, stats.min_largest_free_block,
+                   stats.failed_allocations == 0 ? "fits" : "DOES NOT FIT");
+        }
+    }
+
+    heap_train_mode(model, 0, &stats, HEAP_ARENA_SIZE, HEAP_FIRST_FIT);
+    heap_train_mode(model, 0, &stats, stats.peak_used_bytes / 2, HEAP_FIRST_FIT);
+    print_heap_report();
+    if (stats.failed_allocations == 0 || stats.first_failed_size == 0)
+    {
+        printf("FAILED: training fit in an arena of half its peak\n");
+    }
+    printf("heap emulation check completed! \n");
+}
+#endif
+#ifdef ENABLE_FIXED_POINT_TRAINING
+/* Compares the gradients of the fixed-point training paths (full and partial for the last layer) with the float path for one batch.
+    Errors are relative to the largest float gradient. */
+void fixed_gradient_check(Model *model, FixedModel *fixed_model)
+{
+    printf("start fixed-point gradient check..\n");
+    int target_layer = model->n_layers - 1;
+    int n_weights = (target_layer == 0) ? INPUT_SIZE : model->layers_size[target_layer - 1];
+    Gradients *gradients = allocate_gradients(model);
+    FixedGradients *fixed_gradients = allocate_fixed_gradients(fixed_model);
+    FixedPartialGradients *partial_gradients = allocate_fixed_partial_gradients(fixed_model, target_layer, n_weights);
+    fixed_t fixed_input[INPUT_SIZE];
+    fixed_t fixed_actual[OUTPUT_SIZE];
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], gradients);
+        float_to_fixed_array(ft_samples_x[i], fixed_input, INPUT_SIZE);
+        float_to_fixed_array(ft_samples_y[i], fixed_actual, OUTPUT_SIZE);
+        fc_fixed_calc_gradients(fixed_model, fixed_input, fixed_actual, fixed_gradients);
+        partial_fixed_calc_gradients(fixed_input, fixed_model, target_layer, n_weights, 0, fixed_actual, partial_gradients);
+    }
+
+    float scale = 1.0f / ((float)FIXED_ONE * FIXED_ONE);
+    float max_gradient = 0;
+    float max_error = 0;
+    float max_partial_error = 0;
+    int size = INPUT_SIZE;
+    for (int l = 0; l < model->n_layers; l++)
+    {
+        for (int k = 0; k < model->layers_size[l] * (size + 1); k++)
+        {
+            // weights first, then the biases
+            int is_bias = k >= model->layers_size[l] * size;
+            int index = is_bias ? k - model->layers_size[l] * size : k;
+            float gradient = is_bias ? gradients->biases[l][index] : gradients->weights[l][index];
+            fixed_acc_t fixed_gradient = is_bias ? fixed_gradients->biases[l][index] : fixed_gradients->weights[l][index];
+            max_gradient = fmax(max_gradient, fabs(gradient));
+            max_error = fmax(max_error, fabs(gradient - fixed_gradient * scale));
+            if (l == target_layer)
+            {
+                fixed_acc_t partial_gradient = is_bias ? partial_gradients->biases[index] : partial_gradients->weights[index];
+                max_partial_error = fmax(max_partial_error, fabs(gradient - partial_gradient * scale));
+            }
+        }
+        size = model->layers_size[l];
+    }
+    max_gradient = max_gradient > 0 ? max_gradient : 1;
+    printf("fixed-point gradient error: %f, partial: %f \n", max_error / max_gradient, max_partial_error / max_gradient);
+    if (max_error / max_gradient > FIXED_POINT_CHECK_TOLERANCE || max_partial_error / max_gradient > FIXED_POINT_CHECK_TOLERANCE)
+    {
+        printf("FAILED: fixed-point gradients differ from the float gradients\n");
+    }
+
+    free_gradients(gradients);
+    free_fixed_gradients(fixed_gradients, fixed_model);
+    free_fixed_partial_gradients(partial_gradients, fixed_model, target_layer);
+}
+
+/* Trains the fixed-point model on the same batches as trainer */
+void fixed_trainer(FixedModel *fixed_model)
+{
+    int batches = 13;
+    fixed_t(*samples_x)[INPUT_SIZE] = malloc(BATCH_SIZE * sizeof(*samples_x));
+    fixed_t(*samples_y)[OUTPUT_SIZE] = malloc(BATCH_SIZE * sizeof(*samples_y));
+    for (int i = 0; i < batches; i++)
+    {
+        for (int j = 0; j < BATCH_SIZE; j++)
+        {
+            float_to_fixed_array(ft_samples_x[i * BATCH_SIZE + j], samples_x[j], INPUT_SIZE);
+            float_to_fixed_array(ft_samples_y[i * BATCH_SIZE + j], samples_y[j], OUTPUT_SIZE);
+        }
+        fc_fixed_model_train(fixed_model, samples_x, samples_y);
+    }
+    free(samples_x);
+    free(samples_y);
+}
+
+/* Compares the loss of the fixed-point model on the 168 test samples with the float model, both trained on the same batches */
+void fixed_point_check(Model *model, FixedModel *fixed_model)
+{
+    float sum = 0;
+    float fixed_sum = 0;
+    fixed_t *workspace = (fixed_t *)malloc(fixed_workspace_size(fixed_model) * sizeof(fixed_t));
+    fixed_t input[INPUT_SIZE];
+    fixed_t output[OUTPUT_SIZE];
+    for (int i = FT_N_SAMPLES - 168; i < FT_N_SAMPLES; i++)
+    {
+        float *float_output = fc_model_predict(model, ft_samples_x[i]);
+        float_to_fixed_array(ft_samples_x[i], input, INPUT_SIZE);
+        fc_fixed_model_predict_into(fixed_model, workspace, input, output);
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            float t = float_output[j] - ft_samples_y[i][j];
+            float fixed_error = fixed_to_float(output[j]) - ft_samples_y[i][j];
+            sum += t * t;
+            fixed_sum += fixed_error * fixed_error;
+        }
+        free(float_output);
+    }
+    free(workspace);
+    printf("MSE error fixed-point: %f, float: %f \n", fixed_sum / 168, sum / 168);
+    if (fabs(fixed_sum - sum) / 168 > FIXED_POINT_CHECK_TOLERANCE)
+    {
+        printf("FAILED: fixed-point training diverged from the float path\n");
+    }
+}
+#endif
+#ifdef SPARSE_LAYERS
+/* Checks the sparse kernels against a dense INPUT_MAJOR copy of the model, with the pruned weights set to zero */
+void sparse_check(Model *model)
+{
+    float tolerance = 1e-4;
+    float *dense_weights[N_LAYERS];
+    int kept = 0;
+    int total = 0;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int out_size = model->layers_size[i];
+        SparseLayer *sparse = getSparseLayer(model, i);
+        dense_weights[i] = (float *)calloc(out_size * size, sizeof(float));
+        for (int r = 0; r < out_size; r++)
+        {
+            if (sparse != NULL)
+            {
+                for (int k = sparse->row_offsets[r]; k < sparse->row_offsets[r + 1]; k++)
+                {
+                    dense_weights[i][r + sparse->columns[k] * out_size] = model->layers_weights[i][k];
+                }
+                continue;
+            }
+            for (int c = 0; c < size; c++)
+            {
+                dense_weights[i][r + c * out_size] = (model->weights_layout == OUTPUT_MAJOR_PACKED) ? model->layers_weights[i][r * FC_PACKED_STRIDE(size) + c]
+                                                                                                  : model->layers_weights[i][r + c * out_size];
+            }
+        }
+        kept += (sparse != NULL) ? sparse->nnz : out_size * size;
+        total += out_size * size;
+        size = out_size;
+    }
+    Model *dense = createAndSetModel(N_LAYERS, INPUT_SIZE, OUTPUT_SIZE, layers_size, dense_weights, layers_biases, layers_activation);
+
+    float *batch_outputs = (float *)malloc(EQCHECK_N_SAMPLES * OUTPUT_SIZE * sizeof(float));
+    fc_model_predict_batch(model, eqcheck_samples_x[0], EQCHECK_N_SAMPLES, batch_outputs);
+    for (int i = 0; i < EQCHECK_N_SAMPLES; i++)
+    {
+        float *output = fc_model_predict(dense, eqcheck_samples_x[i]);
+        for (int j = 0; j < OUTPUT_SIZE; j++)
+        {
+            if (fabs(batch_outputs[i * OUTPUT_SIZE + j] - output[j]) > tolerance)
+            {
+                printf("FAILED: sparse check for prediction, dense: %f but sparse: %f\n", output[j], batch_outputs[i * OUTPUT_SIZE + j]);
+                break;
+            }
+        }
+        free(output);
+    }
+    free(batch_outputs);
+
+    Gradients *sparse_gradients = allocate_gradients(model);
+    Gradients *dense_gradients = allocate_gradients(dense);
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], sparse_gradients);
+        fc_calc_gradients(dense, ft_samples_x[i], ft_samples_y[i], dense_gradients);
+    }
+    size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int out_size = model->layers_size[i];
+        SparseLayer *sparse = getSparseLayer(model, i);
+        for (int r = 0; r < out_size; r++)
+        {
+            int end = (sparse != NULL) ? sparse->row_offsets[r + 1] : size;
+            for (int k = (sparse != NULL) ? sparse->row_offsets[r] : 0; k < end; k++)
+            {
+                int c = (sparse != NULL) ? sparse->columns[k] : k;
+                int index = (sparse != NULL) ? k : ((model->weights_layout == OUTPUT_MAJOR_PACKED) ? r * FC_PACKED_STRIDE(size) + c : r + c * out_size);
+                float expected = dense_gradients->weights[i][r + c * out_size];
+                if (fabs(sparse_gradients->weights[i][index] - expected) > tolerance * (1 + fabs(expected)))
+                {
+                    printf("FAILED: sparse check for weight gradient in layer %d, dense: %f but sparse: %f\n", i, expected, sparse_gradients->weights[i][index]);
+                    r = out_size;
+                    break;
+                }
+            }
+        }
+        for (int j = 0; j < out_size; j++)
+        {
+            if (fabs(sparse_gradients->biases[i][j] - dense_gradients->biases[i][j]) > tolerance * (1 + fabs(dense_gradients->biases[i][j])))
+            {
+                printf("FAILED: sparse check for bias gradient in layer %d, dense: %f but sparse: %f\n", i, dense_gradients->biases[i][j], sparse_gradients->biases[i][j]);
+                break;
+            }
+        }
+        size = out_size;
+    }
+    free_gradients(sparse_gradients);
+    free_gradients(dense_gradients);
+    freeModel(dense);
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        free(dense_weights[i]);
+    }
+    printf("Sparse check completed, %d of %d weights kept! \n", kept, total);
+}
+#endif
+
+#ifdef ENABLE_PARALLEL_TRAINING
+/* The gradients the pool sums over a minibatch have to match fc_calc_gradients over the same samples, up to the order
+    of the additions. The weights of the model are restored afterwards. */
+void parallel_check(Model *model)
+{
+    printf("start parallel training check..\n");
+    Gradients *serial = allocate_gradients(model);
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        fc_calc_gradients(model, ft_samples_x[i], ft_samples_y[i], serial);
+    }
+    TrainPool *pool = create_train_pool(model, N_TRAIN_THREADS);
+    if (pool == NULL)
+    {
+        printf("FAILED: could not start the training threads\n");
+        free_gradients(serial);
+        return;
+    }
+
+    int n_values = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        n_values += getLayerWeightsCount(model, i) + model->layers_size[i];
+    }
+    float *saved = (float *)malloc(n_values * sizeof(float));
+    float *values = saved;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        memcpy(values, model->layers_weights[i], getLayerWeightsCount(model, i) * sizeof(float));
+        values += getLayerWeightsCount(model, i);
+        memcpy(values, model->layers_biases[i], model->layers_size[i] * sizeof(float));
+        values += model->layers_size[i];
+    }
+    fc_model_train_parallel(pool, NULL, ft_samples_x, ft_samples_y);
+    // worker 0 keeps the summed gradients after the update
+    Gradients *parallel = pool->workers[0].gradients;
+    for (int j = 0; j < serial->n_params; j++)
+    {
+        if (fabs(parallel->params[j] - serial->params[j]) > 0.0001 * (1 + fabs(serial->params[j])))
+        {
+            printf("FAILED: parallel training gradient %d, serial: %f but parallel: %f\n", j, serial->params[j], parallel->params[j]);
+            break;
+        }
+    }
+    values = saved;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        memcpy(model->layers_weights[i], values, getLayerWeightsCount(model, i) * sizeof(float));
+        values += getLayerWeightsCount(model, i);
+        memcpy(model->layers_biases[i], values, model->layers_size[i] * sizeof(float));
+        values += model->layers_size[i];
+    }
+    free(saved);
+    free_train_pool(pool);
+    free_gradients(serial);
+    printf("parallel training check completed! \n");
+}
+#endif
+
 void trainer(Model *model)
 {
     int batches = 13;
+    Optimizer *optimizer = create_optimizer(model, OPTIMIZER);
+#ifdef ENABLE_PARALLEL_TRAINING
+    TrainPool *pool = create_train_pool(model, N_TRAIN_THREADS);
+    if (pool == NULL)
+    {
+        printf("FAILED: could not start the training threads\n");
+        batches = 0;
+    }
+#endif
+#ifdef ENABLE_DATA_LOADER
+    DataLoader *loader = create_data_loader(DATASET_PATH, BATCH_SIZE, DATA_SHUFFLE_SEED);
+    if (loader == NULL)
+    {
+        batches = 0;
+    }
+#endif
     for (int i = 0; i < batches; i++)
     {
+#ifdef ENABLE_DATA_LOADER
+        float *samples_x;
+        float *samples_y;
+        // a 0 marks the end of an epoch, the next call starts a new one
+        if (!data_loader_next_batch(loader, &samples_x, &samples_y) && !data_loader_next_batch(loader, &samples_x, &samples_y))
+        {
+            printf("FAILED: data loader returned no batch\n");
+            break;
+        }
+        float(*batch_x)[INPUT_SIZE] = (float(*)[INPUT_SIZE])samples_x;
+        float(*batch_y)[OUTPUT_SIZE] = (float(*)[OUTPUT_SIZE])samples_y;
+#else
+        float(*batch_x)[INPUT_SIZE] = ft_samples_x + (i * BATCH_SIZE);
+        float(*batch_y)[OUTPUT_SIZE] = ft_samples_y + (i * BATCH_SIZE);
+#endif
         /* Enable one of the functions */
-        fc_model_train(model, ft_samples_x + (i * BATCH_SIZE), ft_samples_y + (i * BATCH_SIZE));
+#ifdef ENABLE_PARALLEL_TRAINING
+        fc_model_train_parallel(pool, optimizer, batch_x, batch_y);
+#else
+        fc_model_train(model, optimizer, batch_x, batch_y);
+#endif
 
-        // fc_model_train_layer(model, ft_samples_x + (i * BATCH_SIZE), ft_samples_y + (i * BATCH_SIZE), 1);
+        // fc_model_train_layer(model, NULL, batch_x, batch_y, 1);
 
-        // fc_model_train_partial_layer(model, ft_samples_x + (i * BATCH_SIZE), ft_samples_y + (i * BATCH_SIZE), 1,1,0);
+        // fc_model_train_partial_layer(model, NULL, batch_x, batch_y, 1,1,0);
+    }
+#ifdef ENABLE_DATA_LOADER
+    if (loader != NULL)
+    {
+        free_data_loader(loader);
+    }
+#endif
+#ifdef ENABLE_PARALLEL_TRAINING
+    if (pool != NULL)
+    {
+        free_train_pool(pool);
     }
+#endif
+    free_optimizer(optimizer);
 }
 int main()
 {
     // Test data input to output from eqcheck
+#if defined(WEIGHTS_LAYOUT)
+    // weights written by the converter are already stored in their final layout
+    Model *model = createAndSetModelWithLayout(N_LAYERS, INPUT_SIZE, OUTPUT_SIZE, layers_size, layers_weights, layers_biases, layers_activation, WEIGHTS_LAYOUT);
+#elif defined(PACK_WEIGHTS) && !defined(SPARSE_LAYERS)
+    Model *model = createAndSetPackedModel(N_LAYERS, INPUT_SIZE, OUTPUT_SIZE, layers_size, layers_weights, layers_biases, layers_activation);
+#else
     Model *model = createAndSetModel(N_LAYERS, INPUT_SIZE, OUTPUT_SIZE, layers_size, layers_weights, layers_biases, layers_activation);
+#endif
+#ifdef SPARSE_LAYERS
+    // the sparse layers have to be bound before the dense ones are packed
+    setSparseLayers(model, layers_sparse);
+#ifdef PACK_WEIGHTS
+    packModelWeights(model);
+#endif
+#endif
     eqcheck(model);
+    simd_check(model);
+    checkpoint_check(model);
+    top_k_check(model);
+    masked_check(model);
+    optimizer_check(model);
+    feature_cache_check(model);
+#ifdef SPARSE_LAYERS
+    sparse_check(model);
+#endif
+#ifdef ENABLE_SPECIALIZED_MODEL
+    specialized_check(model);
+#endif
+#ifdef ENABLE_MODEL_FILE
+    model_file_check(model);
+#endif
+#ifdef ENABLE_DATA_LOADER
+    data_loader_check();
+#endif
+#ifdef ENABLE_QUANT_MODEL
+    quant_eqcheck();
+#endif
+#ifdef ENABLE_HALF_MODEL
+    half_eqcheck(model);
+#endif
+#ifdef ENABLE_PARALLEL_TRAINING
+    parallel_check(model);
+#endif
 
     compare_true(model);
     printf("Start training... \n \n");
+#ifdef ENABLE_FIXED_POINT_TRAINING
+    FixedModel *fixed_model = createFixedModel(model);
+    if (fixed_model != NULL)
+    {
+        fixed_gradient_check(model, fixed_model);
+        fixed_trainer(fixed_model);
+    }
+#endif
     trainer(model);
 
     compare_true(model);
+#ifdef ENABLE_PROFILING
+    profiling_check(model);
+#endif
+#ifdef ENABLE_FIXED_POINT_TRAINING
+    if (fixed_model != NULL)
+    {
+        fixed_point_check(model, fixed_model);
+        freeFixedModel(fixed_model);
+    }
+#endif
 
+#ifdef ENABLE_TRACK_MEMORY
     // perform memory testing
     printf("Starting memory tests... \n\n");
     memory_tester(model);
+#endif
+#ifdef ENABLE_HEAP_EMULATION
+    heap_emulation_check(model);
+#endif
     return 0;
 }
\ No newline at end of file
@@ -21,6 +21,16 @@ float relu_deriv(float x);
 #define LINEAR_DERIV_MACRO(x) (1)
 #define RELU_DERIV_MACRO(x) ((x > 0) ? 1 : 0)
 
+/* Vector versions used in the epilogue of the SIMD kernels, written with the SIMD_* operations of
+   simd_kernels_template.h. Every activation in ACTIVATION_MACRO_LIST needs one. */
+#define LINEAR_SIMD_MACRO(v) (v)
+#define RELU_SIMD_MACRO(v) SIMD_MAX(v, SIMD_ZERO())
+
+/* Versions for the int8 kernels, applied to the requantized output x with output zero point zp.
+   Every activation in ACTIVATION_MACRO_LIST needs one. */
+#define LINEAR_Q_MACRO(x, zp) (x)
+#define RELU_Q_MACRO(x, zp) ((x > zp) ? x : zp)
+
 #define ACTIVATION_MACRO_LIST                   \
     X(LINEAR, LINEAR_MACRO, LINEAR_DERIV_MACRO) \
     X(RELU, RELU_MACRO, RELU_DERIV_MACRO)
@@ -3,6 +3,8 @@
 #include <string.h>
 #include <stdio.h>
 #include "config.h"
+#include "weight_layout.h"
+#include "simd_dispatch.h"
 #include <math.h>
 /* Back propagation function for one layer, updates the output neurons with gradients
     @param input_gradient: pointer to input gradients (going backwards)
@@ -48,40 +50,91 @@ void fc_back_prop(float *input_gradient, float *net_inputs, float *weights,
     return;
 }
 
-#define GENERATE_FC_BACK_PROP_VARIANTS(act, func, func_deriv)                           \
-    void fc_back_prop_##act(float *input_gradient, float *net_inputs, float *weights,   \
-                            int input_size, int net_inputs_size,                        \
-                            float *gradient_weights, float *gradient_biases)            \
-    {                                                                                   \
-        float *temp = calloc(net_inputs_size, sizeof(float));                           \
-        for (int i = 0; i < input_size; i++)                                            \
-        {                                                                               \
-            float gradient = input_gradient[i];                                         \
-            gradient_biases[i] += gradient;                                             \
-            for (int j = 0; j < net_inputs_size; j++)                                   \
-            {                                                                           \
-                gradient_weights[i + j * input_size] += gradient * func(net_inputs[j]); \
-                temp[j] += weights[i + j * input_size] * gradient;                      \
-            }                                                                           \
-        }                                                                               \
-        for (int j = 0; j < net_inputs_size; j++)                                       \
-        {                                                                               \
-            net_inputs[j] = temp[j] * func_deriv(net_inputs[j]);                        \
-        }                                                                               \
-        free(temp);                                                                     \
-        return;                                                                         \
+/* Back propagation variants, the weight gradients use the activations cached by fc_forward_prop_t
+    @param activations: activations of the previous layer
+    @param net_inputs: net inputs of the previous layer, overwritten with their gradients
+*/
+#define GENERATE_FC_BACK_PROP_VARIANTS(act, func, func_deriv) \
+    void fc_back_prop_##act(float *input_gradient, float *activations, float *net_inputs, float *weights, \
+                            int input_size, int net_inputs_size, \
+                            float *gradient_weights, float *gradient_biases) \
+    { \
+        for (int i = 0; i < input_size; i++) \
+        { \
+            gradient_biases[i] += input_gradient[i]; \
+        } \
+        for (int j = 0; j < net_inputs_size; j++) \
+        { \
+            float activation = activations[j]; \
+            float *w = weights + j * input_size; \
+            float *gw = gradient_weights + j * input_size; \
+            float sum = 0; \
+            for (int i = 0; i < input_size; i++) \
+            { \
+                gw[i] += input_gradient[i] * activation; \
+                sum += w[i] * input_gradient[i]; \
+            } \
+            net_inputs[j] = sum * func_deriv(net_inputs[j]); \
+        } \
+        return; \
     }
 
 #define X(act, func, func_deriv) GENERATE_FC_BACK_PROP_VARIANTS(act, func, func_deriv)
 ACTIVATION_MACRO_LIST
 #undef X
 
+/* Back propagation variants for the OUTPUT_MAJOR_PACKED layout, see weight_layout.h.
+    gradient_weights has to use the same packed layout as the weights.
+    The gradients of the previous layer are summed over the rows FC_PACKED_WIDTH at a time on the stack, so the rows are read contiguously without a heap buffer.
+*/
+#define GENERATE_FC_BACK_PROP_PACKED_VARIANTS(act, func, func_deriv) \
+    void fc_back_prop_packed_##act(float *input_gradient, float *activations, float *net_inputs, float *weights, \
+                                   int input_size, int net_inputs_size, \
+                                   float *gradient_weights, float *gradient_biases) \
+    { \
+        int stride = FC_PACKED_STRIDE(net_inputs_size); \
+        for (int i = 0; i < input_size; i++) \
+        { \
+            gradient_biases[i] += input_gradient[i]; \
+        } \
+        for (int j0 = 0; j0 < net_inputs_size; j0 += FC_PACKED_WIDTH) \
+        { \
+            int n = (net_inputs_size - j0 < FC_PACKED_WIDTH) ? net_inputs_size - j0 : FC_PACKED_WIDTH; \
+            float temp[FC_PACKED_WIDTH] = {0}; \
+            for (int i = 0; i < input_size; i++) \
+            { \
+                float gradient = input_gradient[i]; \
+                float *w_row = weights + i * stride + j0; \
+                float *gw_row = gradient_weights + i * stride + j0; \
+                for (int j = 0; j < n; j++) \
+                { \
+                    gw_row[j] += gradient * activations[j0 + j]; \
+                    temp[j] += w_row[j] * gradient; \
+                } \
+            } \
+            for (int j = 0; j < n; j++) \
+            { \
+                net_inputs[j0 + j] = temp[j] * func_deriv(net_inputs[j0 + j]); \
+            } \
+        } \
+        return; \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_BACK_PROP_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
 #define X(act, func, func_deriv) \
     case act:                    \
         return fc_back_prop_##act;
 
 BackProp get_fc_back_prop_variant(enum ActivationType activationType)
 {
+    BackProp simd_variant = get_fc_back_prop_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
     switch (activationType)
     {
         ACTIVATION_MACRO_LIST
@@ -92,13 +145,13 @@ BackProp get_fc_back_prop_variant(enum ActivationType activationType)
 }
 #undef X
 /* Will backpropagate under the partial training conditions. Meaning it uses the derivative values.
-    @return gradients when backpropagating to the output layer
+    @param deriv_mask: activation derivatives of the output layer as a bit mask, see deriv_mask.h
+    @param output: where the output_layer_size gradients of the output layer are stored
 */
-float *fc_light_back_prop(float *input_gradient, float *weights,
-                          int input_size, int output_layer_size, uint8_t *deriv_activation_val)
+void fc_light_back_prop_into(float *input_gradient, float *weights,
+                             int input_size, int output_layer_size, uint32_t *deriv_mask, float *output)
 {
-    float *output = calloc(output_layer_size, sizeof(float));
-
+    memset(output, 0, output_layer_size * sizeof(float));
     for (int i = 0; i < input_size; i++)
     {
         float gradient = input_gradient[i];
@@ -107,11 +160,45 @@ float *fc_light_back_prop(float *input_gradient, float *weights,
             output[j] += weights[i + j * input_size] * gradient;
         }
     }
-    for (int j = 0; j < output_layer_size; j++)
+    deriv_mask_apply(output, deriv_mask, output_layer_size);
+}
+
+/* fc_light_back_prop_into for the OUTPUT_MAJOR_PACKED layout */
+void fc_light_back_prop_packed_into(float *input_gradient, float *weights,
+                                    int input_size, int output_layer_size, uint32_t *deriv_mask, float *output)
+{
+    int stride = FC_PACKED_STRIDE(output_layer_size);
+    memset(output, 0, output_layer_size * sizeof(float));
+
+    for (int i = 0; i < input_size; i++)
     {
-        output[j] *= deriv_activation_val[j];
+        float gradient = input_gradient[i];
+        float *w_row = weights + i * stride;
+        for (int j = 0; j < output_layer_size; j++)
+        {
+            output[j] += w_row[j] * gradient;
+        }
     }
+    deriv_mask_apply(output, deriv_mask, output_layer_size);
+}
+
+/* fc_light_back_prop_into with an allocated output
+    @return gradients when backpropagating to the output layer
+*/
+float *fc_light_back_prop(float *input_gradient, float *weights,
+                          int input_size, int output_layer_size, uint32_t *deriv_mask)
+{
+    float *output = malloc(output_layer_size * sizeof(float));
+    fc_light_back_prop_into(input_gradient, weights, input_size, output_layer_size, deriv_mask, output);
+    return output;
+}
 
+/* fc_light_back_prop_packed_into with an allocated output */
+float *fc_light_back_prop_packed(float *input_gradient, float *weights,
+                                 int input_size, int output_layer_size, uint32_t *deriv_mask)
+{
+    float *output = malloc(output_layer_size * sizeof(float));
+    fc_light_back_prop_packed_into(input_gradient, weights, input_size, output_layer_size, deriv_mask, output);
     return output;
 }
 
@@ -137,37 +224,86 @@ void fc_specific_back_prop(float *input_gradient, float *net_inputs,
     return;
 }
 
-#define GENERATE_FC_SPECIFIC_BACK_PROP_VARIANTS(act, func, func_deriv)                                               \
-    void fc_specific_back_prop_##act(float *input_gradient, float *net_inputs,                                       \
-                                     int layer_size, float *gradient_weights, float *gradient_biases, int n_neurons) \
-    {                                                                                                                \
-        for (int i = 0; i < layer_size; i++)                                                                         \
-        {                                                                                                            \
-            float gradient = input_gradient[i];                                                                      \
-            gradient_biases[i] += gradient;                                                                          \
-            for (int j = 0; j < n_neurons; j++)                                                                      \
-            {                                                                                                        \
-                gradient_weights[i + j * layer_size] += gradient * func(net_inputs[j]);                              \
-            }                                                                                                        \
-        }                                                                                                            \
-        return;                                                                                                      \
+/* Backprop of the chosen weights using the cached activations, does not calculate gradients for the next layer.
+    With the activations cached the kernel does not depend on the activation type.
+    @param input_gradient: gradients of the layer outputs
+    @param activations: activations feeding the chosen weights
+    @param layer_size: size of the layer
+    @param gradient_weights: gradients of the chosen weights, gradient_weights[i + j * gradient_stride]
+    @param gradient_biases: gradients of the layer biases
+    @param n_neurons: number of chosen inputs per neuron
+    @param gradient_stride: distance between the gradients of two consecutive inputs, layer_size for a whole INPUT_MAJOR layer
+*/
+void fc_specific_back_prop_cached(float *input_gradient, float *activations, int layer_size,
+                                  float *gradient_weights, float *gradient_biases, int n_neurons, int gradient_stride)
+{
+    for (int i = 0; i < layer_size; i++)
+    {
+        float gradient = input_gradient[i];
+        gradient_biases[i] += gradient;
+        for (int j = 0; j < n_neurons; j++)
+        {
+            gradient_weights[i + j * gradient_stride] += gradient * activations[j];
+        }
     }
+}
 
-#define X(act, func, func_deriv) GENERATE_FC_SPECIFIC_BACK_PROP_VARIANTS(act, func, func_deriv)
-ACTIVATION_MACRO_LIST
-#undef X
+/* fc_specific_back_prop_cached for the OUTPUT_MAJOR_PACKED layout, gradient_weights[i * gradient_stride + j] */
+void fc_specific_back_prop_cached_packed(float *input_gradient, float *activations, int layer_size,
+                                         float *gradient_weights, float *gradient_biases, int n_neurons, int gradient_stride)
+{
+    for (int i = 0; i < layer_size; i++)
+    {
+        float gradient = input_gradient[i];
+        float *gw_row = gradient_weights + i * gradient_stride;
+        gradient_biases[i] += gradient;
+        for (int j = 0; j < n_neurons; j++)
+        {
+            gw_row[j] += gradient * activations[j];
+        }
+    }
+}
 
 #define X(act, func, func_deriv) \
     case act:                    \
-        return fc_specific_back_prop_##act;
-SpecificBackProp get_fc_specific_back_prop_variant(enum ActivationType activationType)
+        return fc_back_prop_packed_##act;
+BackProp get_fc_back_prop_packed_variant(enum ActivationType activationType)
 {
+    BackProp simd_variant = get_fc_back_prop_packed_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
     switch (activationType)
     {
         ACTIVATION_MACRO_LIST
     default:
         printf("Error unknown activation type: defaulting to LINEAR\n");
-        return fc_specific_back_prop_LINEAR;
+        return fc_back_prop_packed_LINEAR;
+    }
+}
+#undef X
+
+/* Cached specific back propagation for a weights layout, SIMD when available */
+SpecificBackProp get_fc_specific_back_prop_cached_variant(enum WeightLayout layout)
+{
+    SpecificBackProp simd_variant;
+    if (layout == OUTPUT_MAJOR_PACKED)
+    {
+        simd_variant = get_fc_specific_back_prop_cached_packed_simd_variant();
+        return (simd_variant != NULL) ? simd_variant : fc_specific_back_prop_cached_packed;
+    }
+    simd_variant = get_fc_specific_back_prop_cached_simd_variant();
+    return (simd_variant != NULL) ? simd_variant : fc_specific_back_prop_cached;
+}
+
+/* Light back propagation for a weights layout, SIMD for OUTPUT_MAJOR_PACKED when available */
+LightBackProp get_fc_light_back_prop_variant(enum WeightLayout layout)
+{
+    if (layout == OUTPUT_MAJOR_PACKED)
+    {
+        LightBackProp simd_variant = get_fc_light_back_prop_packed_into_simd_variant();
+        return (simd_variant != NULL) ? simd_variant : fc_light_back_prop_packed_into;
     }
+    return fc_light_back_prop_into;
 }
-#undef X
\ No newline at end of file
@@ -2,11 +2,20 @@
 #ifdef ENABLE_TRACK_MEMORY
 #include "track_memory.h"
 #endif
+#include "profiler.h"
 
 #ifndef MAX_BLOCKS
 #define MAX_BLOCKS 2500
 #endif
 
+#ifndef MAX_ALLOC_SITES
+#define MAX_ALLOC_SITES 128
+#endif
+
+#ifndef HEAP_ARENA_SIZE
+#define HEAP_ARENA_SIZE 65536
+#endif
+
 #ifndef BATCH_SIZE
 #define BATCH_SIZE 64
 #endif
@@ -18,3 +27,75 @@
 #ifndef LEARNING_RATE
 #define LEARNING_RATE 0.001
 #endif
+
+#ifndef FC_BATCH_TILE_SAMPLES
+#define FC_BATCH_TILE_SAMPLES 8
+#endif
+
+#ifndef FC_BATCH_TILE_OUTPUTS
+#define FC_BATCH_TILE_OUTPUTS 64
+#endif
+
+#ifndef FC_BATCH_TILE_INPUTS
+#define FC_BATCH_TILE_INPUTS 128
+#endif
+
+#ifndef FC_BATCH_MAX_SAMPLES
+#define FC_BATCH_MAX_SAMPLES 256
+#endif
+
+#ifndef GRADIENT_CHECKPOINT_BUDGET
+#define GRADIENT_CHECKPOINT_BUDGET 0
+#endif
+
+#ifndef N_TRAIN_THREADS
+#define N_TRAIN_THREADS 4
+#endif
+
+#ifndef QUANT_EQCHECK_TOLERANCE
+#define QUANT_EQCHECK_TOLERANCE 0.1
+#endif
+
+#ifndef HALF_MODEL_FORMAT
+#define HALF_MODEL_FORMAT HALF_FP16
+#endif
+
+#ifndef HALF_EQCHECK_TOLERANCE
+#define HALF_EQCHECK_TOLERANCE 0.01
+#endif
+
+#ifndef FIXED_POINT_CHECK_TOLERANCE
+#define FIXED_POINT_CHECK_TOLERANCE 0.05
+#endif
+
+#ifndef MODEL_FILE_PATH
+#define MODEL_FILE_PATH "model/model.bin"
+#endif
+
+#ifndef DATASET_PATH
+#define DATASET_PATH "data/ft_data.bin"
+#endif
+
+#ifndef DATA_SHUFFLE_SEED
+#define DATA_SHUFFLE_SEED 1
+#endif
+
+#ifndef PROFILE_MAX_LAYERS
+#define PROFILE_MAX_LAYERS 16
+#endif
+
+#ifndef OPTIMIZER
+#define OPTIMIZER SGD
+#endif
+
+#ifndef OPTIMIZER_BETA1
+#define OPTIMIZER_BETA1 0.9
+#endif
+
+#ifndef OPTIMIZER_BETA2
+#define OPTIMIZER_BETA2 0.999
+#endif
+
+#ifndef OPTIMIZER_EPSILON
+#define OPTIMIZER_EPSILON 1e-7
+#endif
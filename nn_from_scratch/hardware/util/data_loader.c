@@ -0,0 +1,280 @@
+#define _POSIX_C_SOURCE 200809L
+#include "data_loader.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#define DATA_LOADER_FSEEKO
+#endif
+
+static int seek_file(FILE *file, uint64_t offset)
+{
+#ifdef DATA_LOADER_FSEEKO
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#else
+    return fseek(file, (long)offset, SEEK_SET);
+#endif
+}
+
+static uint32_t next_random(DataLoader *loader)
+{
+    uint32_t x = loader->shuffle_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    loader->shuffle_state = x;
+    return x;
+}
+
+/* Fisher-Yates shuffle of order[0..n), the identity order when shuffling is disabled */
+static void shuffle_order(DataLoader *loader, int *order, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    if (loader->shuffle_state == 0)
+    {
+        return;
+    }
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = (int)(next_random(loader) % (uint32_t)(i + 1));
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+static void start_epoch(DataLoader *loader)
+{
+    shuffle_order(loader, loader->chunk_order, loader->n_chunks);
+    loader->chunk_pos = -1;
+    loader->chunk_size = 0;
+    loader->sample_pos = 0;
+    loader->batch_pos = 0;
+}
+
+/* Reads the next chunk of the epoch into the chunk buffer with one read */
+static int read_next_chunk(DataLoader *loader)
+{
+    loader->chunk_pos++;
+    int chunk = loader->chunk_order[loader->chunk_pos];
+    uint64_t first = (uint64_t)chunk * loader->chunk_samples;
+    uint64_t remaining = loader->n_samples - first;
+    int size = remaining < (uint64_t)loader->chunk_samples ? (int)remaining : loader->chunk_samples;
+    size_t record_size = (size_t)(loader->input_size + loader->output_size);
+
+    if (seek_file(loader->file, loader->data_offset + first * record_size * sizeof(float)) != 0 ||
+        fread(loader->chunk, sizeof(float) * record_size, size, loader->file) != (size_t)size)
+    {
+        printf("Error data loader: could not read chunk %d\n", chunk);
+        return -1;
+    }
+    loader->chunk_size = size;
+    loader->sample_pos = 0;
+    shuffle_order(loader, loader->sample_order, size);
+    return 0;
+}
+
+/* Gathers the next batch of the epoch into batch_x and batch_y.
+    Returns 1 for a batch and 0 at the end of an epoch, after which the next epoch is started.
+*/
+static int produce_batch(DataLoader *loader, float *batch_x, float *batch_y)
+{
+    if (loader->batch_pos == loader->n_batches)
+    {
+        start_epoch(loader);
+        return 0;
+    }
+    int record_size = loader->input_size + loader->output_size;
+    for (int i = 0; i < loader->batch_size; i++)
+    {
+        if (loader->sample_pos == loader->chunk_size && read_next_chunk(loader) != 0)
+        {
+            start_epoch(loader);
+            return 0;
+        }
+        float *record = loader->chunk + (size_t)loader->sample_order[loader->sample_pos++] * record_size;
+        memcpy(batch_x + i * loader->input_size, record, loader->input_size * sizeof(float));
+        memcpy(batch_y + i * loader->output_size, record + loader->input_size, loader->output_size * sizeof(float));
+    }
+    loader->batch_pos++;
+    return 1;
+}
+
+#ifdef ENABLE_DATA_PREFETCH
+/* Fills the two batch buffers in turn, waiting while both hold batches that were not handed out and released */
+static void *prefetch_thread(void *arg)
+{
+    DataLoader *loader = (DataLoader *)arg;
+    pthread_mutex_lock(&loader->mutex);
+    while (1)
+    {
+        while (!loader->exit && loader->filled[loader->fill] != 0)
+        {
+            pthread_cond_wait(&loader->cond, &loader->mutex);
+        }
+        if (loader->exit)
+        {
+            break;
+        }
+        int buffer = loader->fill;
+        pthread_mutex_unlock(&loader->mutex);
+
+        int result = produce_batch(loader, loader->batches_x[buffer], loader->batches_y[buffer]);
+
+        pthread_mutex_lock(&loader->mutex);
+        loader->filled[buffer] = result ? 1 : -1;
+        loader->fill = 1 - buffer;
+        pthread_cond_broadcast(&loader->cond);
+    }
+    pthread_mutex_unlock(&loader->mutex);
+    return NULL;
+}
+#endif
+
+/* Opens a dataset file written by data_converter.py for training with batches of batch_size samples.
+    @param seed: seed of the per-epoch shuffling, 0 reads the samples in file order
+    Returns NULL on error.
+*/
+DataLoader *create_data_loader(const char *path, int batch_size, uint32_t seed)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Error data loader: could not open %s\n", path);
+        return NULL;
+    }
+    DatasetFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, DATASET_FILE_MAGIC, 4) != 0 ||
+        header.version != DATASET_FILE_VERSION || header.byte_order != DATASET_FILE_BYTE_ORDER)
+    {
+        printf("Error data loader: %s is not a dataset file of version %d\n", path, DATASET_FILE_VERSION);
+        fclose(file);
+        return NULL;
+    }
+    if (header.header_size < sizeof(header) || header.input_size == 0 || header.output_size == 0 || header.chunk_samples == 0 || batch_size <= 0 ||
+        header.n_samples < (uint64_t)batch_size)
+    {
+        printf("Error data loader: %s has fewer samples than a batch of %d\n", path, batch_size);
+        fclose(file);
+        return NULL;
+    }
+    // chunks are read straight into the chunk buffer, stdio buffering would only add a copy
+    setvbuf(file, NULL, _IONBF, 0);
+
+    DataLoader *loader = (DataLoader *)malloc(sizeof(DataLoader));
+    loader->file = file;
+    loader->data_offset = header.header_size;
+    loader->input_size = (int)header.input_size;
+    loader->output_size = (int)header.output_size;
+    loader->batch_size = batch_size;
+    loader->chunk_samples = (int)header.chunk_samples;
+    loader->n_samples = header.n_samples;
+    loader->n_chunks = (int)((header.n_samples + header.chunk_samples - 1) / header.chunk_samples);
+    loader->n_batches = (int)(header.n_samples / batch_size);
+    loader->shuffle_state = seed;
+
+#ifdef ENABLE_DATA_PREFETCH
+    int n_buffers = 2;
+#else
+    int n_buffers = 1;
+#endif
+    size_t record_size = header.input_size + header.output_size;
+    size_t n_floats = loader->chunk_samples * record_size + n_buffers * batch_size * record_size;
+    size_t n_ints = loader->n_chunks + loader->chunk_samples;
+    loader->memory = malloc(n_floats * sizeof(float) + n_ints * sizeof(int));
+    float *data = (float *)loader->memory;
+    loader->chunk = data;
+    data += loader->chunk_samples * record_size;
+    for (int i = 0; i < 2; i++)
+    {
+        float *batch = data + (i % n_buffers) * batch_size * record_size;
+        loader->batches_x[i] = batch;
+        loader->batches_y[i] = batch + batch_size * loader->input_size;
+    }
+    data += n_buffers * batch_size * record_size;
+    loader->chunk_order = (int *)data;
+    loader->sample_order = loader->chunk_order + loader->n_chunks;
+    loader->current = -1;
+    start_epoch(loader);
+
+#ifdef ENABLE_DATA_PREFETCH
+    loader->filled[0] = 0;
+    loader->filled[1] = 0;
+    loader->fill = 0;
+    loader->take = 0;
+    loader->exit = 0;
+    pthread_mutex_init(&loader->mutex, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+    if (pthread_create(&loader->thread, NULL, prefetch_thread, loader) != 0)
+    {
+        printf("Error data loader: could not start the prefetch thread\n");
+        pthread_mutex_destroy(&loader->mutex);
+        pthread_cond_destroy(&loader->cond);
+        fclose(file);
+        free(loader->memory);
+        free(loader);
+        return NULL;
+    }
+#endif
+    return loader;
+}
+
+/* Hands out the next batch as batch_size rows of input_size and output_size floats.
+    The batch stays valid until the next call, which releases it to the prefetch thread.
+    Returns 1 for a batch and 0 at the end of an epoch, the following call starts the next epoch.
+*/
+int data_loader_next_batch(DataLoader *loader, float **samples_x, float **samples_y)
+{
+#ifdef ENABLE_DATA_PREFETCH
+    pthread_mutex_lock(&loader->mutex);
+    if (loader->current >= 0)
+    {
+        loader->filled[loader->current] = 0;
+        loader->current = -1;
+        pthread_cond_broadcast(&loader->cond);
+    }
+    int buffer = loader->take;
+    while (loader->filled[buffer] == 0)
+    {
+        pthread_cond_wait(&loader->cond, &loader->mutex);
+    }
+    loader->take = 1 - buffer;
+    int result = loader->filled[buffer] == 1;
+    if (result)
+    {
+        loader->current = buffer;
+    }
+    else
+    {
+        loader->filled[buffer] = 0;
+        pthread_cond_broadcast(&loader->cond);
+    }
+    pthread_mutex_unlock(&loader->mutex);
+#else
+    int buffer = 0;
+    int result = produce_batch(loader, loader->batches_x[0], loader->batches_y[0]);
+    loader->current = result ? 0 : -1;
+#endif
+    *samples_x = loader->batches_x[buffer];
+    *samples_y = loader->batches_y[buffer];
+    return result;
+}
+
+void free_data_loader(DataLoader *loader)
+{
+#ifdef ENABLE_DATA_PREFETCH
+    pthread_mutex_lock(&loader->mutex);
+    loader->exit = 1;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->mutex);
+    pthread_join(loader->thread, NULL);
+    pthread_mutex_destroy(&loader->mutex);
+    pthread_cond_destroy(&loader->cond);
+#endif
+    fclose(loader->file);
+    free(loader->memory);
+    free(loader);
+}
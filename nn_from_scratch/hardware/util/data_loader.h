@@ -0,0 +1,74 @@
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+#include "config.h"
+#include <stdio.h>
+#include <stdint.h>
+#ifdef ENABLE_DATA_PREFETCH
+#include <pthread.h>
+#endif
+
+/* Binary dataset file written by data_converter.py, little endian: a DatasetFileHeader padded to header_size bytes,
+   then one record per sample with the input_size input floats followed by the output_size output floats.
+   Records are grouped in chunks of chunk_samples, the last chunk may be shorter.
+*/
+#define DATASET_FILE_MAGIC "NNDS"
+#define DATASET_FILE_VERSION 1
+#define DATASET_FILE_BYTE_ORDER 0x01020304u
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t input_size;
+    uint32_t output_size;
+    uint32_t chunk_samples;
+    uint32_t reserved;
+    uint64_t n_samples;
+} DatasetFileHeader;
+
+/* Streams batches from a dataset file, only one chunk and two batches are in memory so the file can be larger than RAM.
+   Every epoch visits the chunks in a new random order and the samples of a chunk in a new random order, the samples
+   that do not fill a whole batch at the end of an epoch are skipped. With ENABLE_DATA_PREFETCH a thread reads and
+   shuffles the next batch while the current one is trained on.
+*/
+typedef struct
+{
+    FILE *file;
+    uint64_t data_offset; // file offset of the first record
+    int input_size;
+    int output_size;
+    int batch_size;
+    int chunk_samples;
+    uint64_t n_samples;
+    int n_chunks;
+    int n_batches; // per epoch
+    uint32_t shuffle_state; // xorshift state, 0 keeps the samples in file order
+    int *chunk_order;
+    int *sample_order;
+    float *chunk;   // records of the chunk being split into batches
+    int chunk_pos;  // position in chunk_order of the chunk in the buffer
+    int chunk_size; // samples in the buffered chunk
+    int sample_pos; // next sample of the buffered chunk
+    int batch_pos;  // batches produced in the current epoch
+    float *batches_x[2];
+    float *batches_y[2];
+    int current; // batch handed out by the last data_loader_next_batch, -1 if none
+#ifdef ENABLE_DATA_PREFETCH
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int filled[2]; // 1 when a batch is ready, -1 when it marks the end of an epoch
+    int fill;      // next buffer the thread fills
+    int take;      // next buffer handed out
+    int exit;
+#endif
+    void *memory; // owned allocation backing the orders and buffers
+} DataLoader;
+
+DataLoader *create_data_loader(const char *path, int batch_size, uint32_t seed);
+int data_loader_next_batch(DataLoader *loader, float **samples_x, float **samples_y);
+void free_data_loader(DataLoader *loader);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef DERIV_MASK_H
+#define DERIV_MASK_H
+#include <stdint.h>
+#include <string.h>
+
+/* Activation derivatives stored by the partial training paths, one bit per neuron in 32-bit words.
+   Only exact for activations whose derivative is 0 or 1 (LINEAR, RELU), a non zero derivative sets the bit.
+*/
+#define DERIV_MASK_WORDS(n) (((n) + 31) / 32)
+
+static inline void deriv_mask_set(uint32_t *mask, int j, int bit)
+{
+    uint32_t word = mask[j >> 5] & ~(1u << (j & 31));
+    mask[j >> 5] = word | ((uint32_t)(bit != 0) << (j & 31));
+}
+
+/* all ones when the bit of neuron j is set, else zero */
+static inline uint32_t deriv_mask_select(const uint32_t *mask, int j)
+{
+    return 0u - ((mask[j >> 5] >> (j & 31)) & 1u);
+}
+
+/* Multiplies values by the 0/1 derivatives without branches by clearing the bits of the masked floats */
+static inline void deriv_mask_apply(float *values, const uint32_t *mask, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &values[j], sizeof(bits));
+        bits &= deriv_mask_select(mask, j);
+        memcpy(&values[j], &bits, sizeof(bits));
+    }
+}
+
+#endif
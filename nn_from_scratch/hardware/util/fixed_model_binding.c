@@ -0,0 +1,89 @@
+#include "fixed_model_binding.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Creates a fixed-point copy of a float model, the float model is left untouched.
+    Values outside the range of FIXED_FRAC_BITS saturate.
+    @return NULL if the model does not use the INPUT_MAJOR layout or has sparse layers
+*/
+FixedModel *createFixedModel(Model *model)
+{
+    if (model->weights_layout != INPUT_MAJOR)
+    {
+        printf("Fixed-point models need the INPUT_MAJOR weights layout! \n");
+        return NULL;
+    }
+    if (model->layers_sparse != NULL)
+    {
+        printf("Fixed-point models do not support sparse layers! \n");
+        return NULL;
+    }
+
+    int n_values = 0;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        n_values += model->layers_size[i] * (size + 1);
+        size = model->layers_size[i];
+    }
+
+    FixedModel *fixed_model = (FixedModel *)malloc(sizeof(FixedModel));
+    fixed_model->n_layers = model->n_layers;
+    fixed_model->input_size = model->input_size;
+    fixed_model->output_size = model->output_size;
+    fixed_model->layers_size = model->layers_size;
+    fixed_model->layers_activation = model->layers_activation;
+    fixed_model->rounding_state = 0x9E3779B9u;
+    fixed_model->layers_weights = (fixed_t **)malloc(model->n_layers * sizeof(fixed_t *));
+    fixed_model->layers_biases = (fixed_t **)malloc(model->n_layers * sizeof(fixed_t *));
+    fixed_model->memory = malloc(n_values * sizeof(fixed_t));
+
+    fixed_t *values = (fixed_t *)fixed_model->memory;
+    size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int n_weights = model->layers_size[i] * size;
+        fixed_model->layers_weights[i] = values;
+        float_to_fixed_array(model->layers_weights[i], values, n_weights);
+        values += n_weights;
+        fixed_model->layers_biases[i] = values;
+        float_to_fixed_array(model->layers_biases[i], values, model->layers_size[i]);
+        values += model->layers_size[i];
+        size = model->layers_size[i];
+    }
+    return fixed_model;
+}
+
+/* Writes the weights and biases of a fixed-point model back into the float model it was created from */
+void fixedModelToModel(FixedModel *fixed_model, Model *model)
+{
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        fixed_to_float_array(fixed_model->layers_weights[i], model->layers_weights[i], model->layers_size[i] * size);
+        fixed_to_float_array(fixed_model->layers_biases[i], model->layers_biases[i], model->layers_size[i]);
+        size = model->layers_size[i];
+    }
+}
+
+void freeFixedModel(FixedModel *model)
+{
+    free(model->memory);
+    free(model->layers_weights);
+    free(model->layers_biases);
+    free(model);
+}
+
+/* Number of fixed_t values needed for the inference workspace, two buffers of the widest layer */
+int fixed_workspace_size(FixedModel *model)
+{
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (model->layers_size[i] > max_size)
+        {
+            max_size = model->layers_size[i];
+        }
+    }
+    return 2 * max_size;
+}
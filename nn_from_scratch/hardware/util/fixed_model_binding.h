@@ -0,0 +1,32 @@
+#ifndef FIXED_MODEL_BINDING_H
+#define FIXED_MODEL_BINDING_H
+#include "activation_functions.h"
+#include "fixed_point.h"
+#include "model_binding.h"
+#include <stdint.h>
+
+/* Fixed-point copy of a model for training without an FPU, see fixed_point.h.
+   Weights are stored INPUT_MAJOR like the float model they were converted from.
+*/
+typedef struct
+{
+    int n_layers;
+    int input_size;
+    int output_size;
+    int *layers_size;
+    fixed_t **layers_weights;
+    fixed_t **layers_biases;
+    enum ActivationType *layers_activation;
+    uint32_t rounding_state; // xorshift state for stochastic rounding of the gradient steps
+    void *memory;            // owned allocation backing the weights and biases
+} FixedModel;
+
+FixedModel *createFixedModel(Model *model);
+
+void fixedModelToModel(FixedModel *fixed_model, Model *model);
+
+void freeFixedModel(FixedModel *model);
+
+int fixed_workspace_size(FixedModel *model);
+
+#endif
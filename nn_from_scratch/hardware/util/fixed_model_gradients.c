@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include "config.h"
+#include "fixed_model_gradients.h"
+FixedGradients *allocate_fixed_gradients(FixedModel *model)
+{
+    FixedGradients *gradients = (FixedGradients *)malloc(sizeof(FixedGradients));
+
+    gradients->biases = (fixed_acc_t **)malloc(model->n_layers * sizeof(fixed_acc_t *));
+    gradients->weights = (fixed_acc_t **)malloc(model->n_layers * sizeof(fixed_acc_t *));
+    gradients->net_inputs = (fixed_t **)malloc(model->n_layers * sizeof(fixed_t *));
+
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int prev_size = (i == 0) ? model->input_size : model->layers_size[i - 1];
+        gradients->biases[i] = (fixed_acc_t *)calloc(model->layers_size[i], sizeof(fixed_acc_t));
+        gradients->net_inputs[i] = (fixed_t *)malloc(model->layers_size[i] * sizeof(fixed_t));
+        gradients->weights[i] = (fixed_acc_t *)calloc(model->layers_size[i] * prev_size, sizeof(fixed_acc_t));
+    }
+
+    return gradients;
+}
+
+void free_fixed_gradients(FixedGradients *gradients, FixedModel *model)
+{
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        free(gradients->biases[i]);
+        free(gradients->weights[i]);
+        free(gradients->net_inputs[i]);
+    }
+    free(gradients->biases);
+    free(gradients->weights);
+    free(gradients->net_inputs);
+    free(gradients);
+}
+
+FixedPartialGradients *allocate_fixed_partial_gradients(FixedModel *model, int target_layer, int n_neurons)
+{
+    FixedPartialGradients *gradients = (FixedPartialGradients *)malloc(sizeof(FixedPartialGradients));
+
+    gradients->biases = (fixed_acc_t *)calloc(model->layers_size[target_layer], sizeof(fixed_acc_t));
+    gradients->deriv_activations = (uint32_t **)malloc((model->n_layers - target_layer) * sizeof(uint32_t *));
+    gradients->weights = (fixed_acc_t *)calloc(n_neurons * model->layers_size[target_layer], sizeof(fixed_acc_t));
+    gradients->net_input = (fixed_t *)malloc(n_neurons * sizeof(fixed_t));
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        max_size = (model->layers_size[i] > max_size) ? model->layers_size[i] : max_size;
+    }
+    gradients->buffers[0] = (fixed_t *)malloc(2 * max_size * sizeof(fixed_t));
+    gradients->buffers[1] = gradients->buffers[0] + max_size;
+
+    for (int i = 0; i < model->n_layers - target_layer; i++)
+    {
+        gradients->deriv_activations[i] = (uint32_t *)malloc(DERIV_MASK_WORDS(model->layers_size[i + target_layer]) * sizeof(uint32_t));
+    }
+
+    return gradients;
+}
+
+void free_fixed_partial_gradients(FixedPartialGradients *gradients, FixedModel *model, int target_layer)
+{
+    free(gradients->biases);
+    free(gradients->weights);
+    for (int i = 0; i < model->n_layers - target_layer; i++)
+    {
+        free(gradients->deriv_activations[i]);
+    }
+    free(gradients->deriv_activations);
+    free(gradients->net_input);
+    free(gradients->buffers[0]);
+    free(gradients);
+}
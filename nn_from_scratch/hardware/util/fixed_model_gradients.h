@@ -0,0 +1,32 @@
+#ifndef FIXED_MODEL_GRADIENTS_H
+#define FIXED_MODEL_GRADIENTS_H
+#include "fixed_model_binding.h"
+#include <stdint.h>
+#include "deriv_mask.h"
+
+/* Fixed-point counterparts of Gradients and PartialGradients.
+   Weight and bias gradients are summed over the batch in accumulators (2 * FIXED_FRAC_BITS fractional bits).
+*/
+typedef struct
+{
+    fixed_acc_t **weights;
+    fixed_acc_t **biases;
+    fixed_t **net_inputs;
+} FixedGradients;
+
+typedef struct
+{
+    fixed_acc_t *weights;
+    fixed_acc_t *biases;
+    fixed_t *net_input;
+    uint32_t **deriv_activations; // bit masks of the activation derivatives, see deriv_mask.h
+    fixed_t *buffers[2];          // scratch of the widest layer, net inputs and gradients ping-pong between them
+} FixedPartialGradients;
+
+FixedGradients *allocate_fixed_gradients(FixedModel *model);
+void free_fixed_gradients(FixedGradients *gradients, FixedModel *model);
+
+FixedPartialGradients *allocate_fixed_partial_gradients(FixedModel *model, int target_layer, int n_neurons);
+void free_fixed_partial_gradients(FixedPartialGradients *gradients, FixedModel *model, int target_layer);
+
+#endif
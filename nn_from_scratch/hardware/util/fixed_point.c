@@ -0,0 +1,38 @@
+#include <math.h>
+#include "fixed_point.h"
+
+/* converts a float to fixed_t, rounding to nearest and saturating */
+fixed_t float_to_fixed(float x)
+{
+    float scaled = x * FIXED_ONE;
+    if (scaled >= INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (scaled <= INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (fixed_t)lroundf(scaled);
+}
+
+float fixed_to_float(fixed_t x)
+{
+    return (float)x / FIXED_ONE;
+}
+
+void float_to_fixed_array(float *input, fixed_t *output, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        output[i] = float_to_fixed(input[i]);
+    }
+}
+
+void fixed_to_float_array(fixed_t *input, float *output, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        output[i] = fixed_to_float(input[i]);
+    }
+}
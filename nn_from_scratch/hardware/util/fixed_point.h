@@ -0,0 +1,69 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+#include <stdint.h>
+
+/* Fixed-point arithmetic for training on targets without an FPU.
+   Weights, activations and gradients are 16 bit with FIXED_FRAC_BITS fractional bits (FIXED_FRAC_BITS 15 is
+   plain Q15, the default Q3.12 leaves headroom for hidden activations above 1). Products are kept in 32 bit
+   accumulators with 2 * FIXED_FRAC_BITS fractional bits, and every accumulation saturates instead of wrapping.
+*/
+#ifndef FIXED_FRAC_BITS
+#define FIXED_FRAC_BITS 12
+#endif
+
+/* Gradient step as a right shift, replaces the LEARNING_RATE / BATCH_SIZE division of the float path.
+   The default of 16 matches 0.001 / 64. FIXED_FRAC_BITS + FIXED_GRADIENT_SHIFT has to stay below 32.
+*/
+#ifndef FIXED_GRADIENT_SHIFT
+#define FIXED_GRADIENT_SHIFT 16
+#endif
+
+/* Most steps are smaller than one weight LSB, rounding them stochastically keeps them from vanishing.
+   Set to 0 to round to nearest. */
+#ifndef FIXED_STOCHASTIC_ROUNDING
+#define FIXED_STOCHASTIC_ROUNDING 1
+#endif
+
+typedef int16_t fixed_t;     // weights, activations and gradients
+typedef int32_t fixed_acc_t; // accumulators with 2 * FIXED_FRAC_BITS fractional bits
+
+#define FIXED_ONE (1 << FIXED_FRAC_BITS)
+
+/* saturates a 32 bit value to fixed_t */
+static inline fixed_t fixed_saturate(int32_t x)
+{
+    return (fixed_t)(x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x));
+}
+
+/* saturating 32 bit addition */
+static inline fixed_acc_t fixed_acc_add(fixed_acc_t a, fixed_acc_t b)
+{
+    int64_t sum = (int64_t)a + b;
+    return (fixed_acc_t)(sum > INT32_MAX ? INT32_MAX : (sum < INT32_MIN ? INT32_MIN : sum));
+}
+
+/* multiply-accumulate of two fixed_t values into an accumulator */
+static inline fixed_acc_t fixed_mac(fixed_acc_t acc, fixed_t a, fixed_t b)
+{
+    return fixed_acc_add(acc, (int32_t)a * b);
+}
+
+/* rounds an accumulator back to fixed_t */
+static inline fixed_t fixed_from_acc(fixed_acc_t acc)
+{
+    return fixed_saturate((int32_t)(((int64_t)acc + (1 << (FIXED_FRAC_BITS - 1))) >> FIXED_FRAC_BITS));
+}
+
+/* widens a fixed_t value to the accumulator format */
+static inline fixed_acc_t fixed_to_acc(fixed_t x)
+{
+    return (fixed_acc_t)x * FIXED_ONE;
+}
+
+/* Conversions, only needed on the host or when loading a float model */
+fixed_t float_to_fixed(float x);
+float fixed_to_float(fixed_t x);
+void float_to_fixed_array(float *input, fixed_t *output, int size);
+void fixed_to_float_array(fixed_t *input, float *output, int size);
+
+#endif
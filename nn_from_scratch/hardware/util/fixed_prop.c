@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "fixed_prop.h"
+#include "config.h"
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return func(x);
+/* applies an activation to a fixed-point value without going through float */
+fixed_t fixed_activation(enum ActivationType activationType, fixed_t x)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return x;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return func_deriv(x);
+/* derivative of an activation for a fixed-point value, 0 or 1 */
+uint8_t fixed_activation_deriv(enum ActivationType activationType, fixed_t x)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return 1;
+    }
+}
+#undef X
+
+/* Fixed-point forward propagation storing the net inputs, see fc_forward_prop_t.
+    The activation of the previous layer is applied to the input on the fly.
+*/
+#define GENERATE_FC_FORWARD_PROP_T_FIXED_VARIANTS(act, func, func_deriv)                                     \
+    fixed_t *fc_forward_prop_t_fixed_##act(fixed_t *input, int input_size, fixed_t *output, int output_size, \
+                                           fixed_t *weights, fixed_t *biases)                                \
+    {                                                                                                        \
+        for (int i = 0; i < output_size; i++)                                                                \
+        {                                                                                                    \
+            fixed_acc_t sum = fixed_to_acc(biases[i]);                                                       \
+            for (int j = 0; j < input_size; j++)                                                             \
+            {                                                                                                \
+                sum = fixed_mac(sum, func(input[j]), weights[i + j * output_size]);                          \
+            }                                                                                                \
+            output[i] = fixed_from_acc(sum);                                                                 \
+        }                                                                                                    \
+        return output;                                                                                       \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_T_FIXED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+/* Fixed-point back propagation for one layer, see fc_back_prop.
+    The derivative macros return 0 or 1, so they scale the propagated gradient without a shift.
+    @param input_gradient: gradients of the layer outputs
+    @param net_inputs: stored net inputs of the previous layer, overwritten with their gradients
+    @param weights: weights of the layer
+    @param input_size: size of the layer
+    @param net_inputs_size: size of the previous layer
+    @param gradient_weights: weight gradient accumulators of the layer
+    @param gradient_biases: bias gradient accumulators of the layer
+*/
+#define GENERATE_FC_BACK_PROP_FIXED_VARIANTS(act, func, func_deriv)                                                                    \
+    void fc_back_prop_fixed_##act(fixed_t *input_gradient, fixed_t *net_inputs, fixed_t *weights,                                      \
+                                  int input_size, int net_inputs_size,                                                                 \
+                                  fixed_acc_t *gradient_weights, fixed_acc_t *gradient_biases)                                         \
+    {                                                                                                                                  \
+        for (int i = 0; i < input_size; i++)                                                                                           \
+        {                                                                                                                              \
+            fixed_t gradient = input_gradient[i];                                                                                      \
+            gradient_biases[i] = fixed_acc_add(gradient_biases[i], fixed_to_acc(gradient));                                            \
+            for (int j = 0; j < net_inputs_size; j++)                                                                                  \
+            {                                                                                                                          \
+                gradient_weights[i + j * input_size] = fixed_mac(gradient_weights[i + j * input_size], gradient, func(net_inputs[j])); \
+            }                                                                                                                          \
+        }                                                                                                                              \
+        for (int j = 0; j < net_inputs_size; j++)                                                                                      \
+        {                                                                                                                              \
+            fixed_acc_t sum = 0;                                                                                                       \
+            for (int i = 0; i < input_size; i++)                                                                                       \
+            {                                                                                                                          \
+                sum = fixed_mac(sum, weights[i + j * input_size], input_gradient[i]);                                                  \
+            }                                                                                                                          \
+            net_inputs[j] = fixed_from_acc(sum) * func_deriv(net_inputs[j]);                                                           \
+        }                                                                                                                              \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_BACK_PROP_FIXED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+/* Fixed-point fc_light_back_prop_into, propagates the gradient using the stored activation derivative mask
+    @param output: where the output_layer_size gradients of the previous layer are stored
+*/
+void fc_light_back_prop_fixed_into(fixed_t *input_gradient, fixed_t *weights,
+                                   int input_size, int output_layer_size, uint32_t *deriv_mask, fixed_t *output)
+{
+    for (int j = 0; j < output_layer_size; j++)
+    {
+        fixed_acc_t sum = 0;
+        for (int i = 0; i < input_size; i++)
+        {
+            sum = fixed_mac(sum, weights[i + j * input_size], input_gradient[i]);
+        }
+        output[j] = (fixed_t)(fixed_from_acc(sum) & (fixed_t)deriv_mask_select(deriv_mask, j));
+    }
+}
+
+/* Fixed-point fc_specific_back_prop, accumulates the gradients of a layer without propagating further */
+#define GENERATE_FC_SPECIFIC_BACK_PROP_FIXED_VARIANTS(act, func, func_deriv)                                                           \
+    void fc_specific_back_prop_fixed_##act(fixed_t *input_gradient, fixed_t *net_inputs, int layer_size,                               \
+                                           fixed_acc_t *gradient_weights, fixed_acc_t *gradient_biases, int n_neurons)                 \
+    {                                                                                                                                  \
+        for (int i = 0; i < layer_size; i++)                                                                                           \
+        {                                                                                                                              \
+            fixed_t gradient = input_gradient[i];                                                                                      \
+            gradient_biases[i] = fixed_acc_add(gradient_biases[i], fixed_to_acc(gradient));                                            \
+            for (int j = 0; j < n_neurons; j++)                                                                                        \
+            {                                                                                                                          \
+                gradient_weights[i + j * layer_size] = fixed_mac(gradient_weights[i + j * layer_size], gradient, func(net_inputs[j])); \
+            }                                                                                                                          \
+        }                                                                                                                              \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_SPECIFIC_BACK_PROP_FIXED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_t_fixed_##act;
+ForwardPropTFixed get_fc_forward_prop_t_fixed_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_t_fixed_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_back_prop_fixed_##act;
+BackPropFixed get_fc_back_prop_fixed_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_back_prop_fixed_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_specific_back_prop_fixed_##act;
+SpecificBackPropFixed get_fc_specific_back_prop_fixed_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_specific_back_prop_fixed_LINEAR;
+    }
+}
+#undef X
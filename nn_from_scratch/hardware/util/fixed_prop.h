@@ -0,0 +1,36 @@
+#ifndef FIXED_PROP_H
+#define FIXED_PROP_H
+#include "activation_functions.h"
+#include "fixed_point.h"
+#include "deriv_mask.h"
+#include <stdint.h>
+
+/* Fixed-point counterparts of the training kernels in forward_prop.c and back_prop.c, INPUT_MAJOR weights only */
+typedef fixed_t *(*ForwardPropTFixed)(fixed_t *, int, fixed_t *, int, fixed_t *, fixed_t *);
+typedef void (*BackPropFixed)(fixed_t *, fixed_t *, fixed_t *, int, int, fixed_acc_t *, fixed_acc_t *);
+typedef void (*SpecificBackPropFixed)(fixed_t *, fixed_t *, int, fixed_acc_t *, fixed_acc_t *, int);
+
+ForwardPropTFixed get_fc_forward_prop_t_fixed_variant(enum ActivationType activationType);
+BackPropFixed get_fc_back_prop_fixed_variant(enum ActivationType activationType);
+SpecificBackPropFixed get_fc_specific_back_prop_fixed_variant(enum ActivationType activationType);
+
+fixed_t fixed_activation(enum ActivationType activationType, fixed_t x);
+uint8_t fixed_activation_deriv(enum ActivationType activationType, fixed_t x);
+
+void fc_light_back_prop_fixed_into(fixed_t *input_gradient, fixed_t *weights,
+                                   int input_size, int output_layer_size, uint32_t *deriv_mask, fixed_t *output);
+
+#define GENERATE_FC_FIXED_PROTOTYPE_VARIANTS(act, func, func_deriv)                                          \
+    fixed_t *fc_forward_prop_t_fixed_##act(fixed_t *input, int input_size, fixed_t *output, int output_size, \
+                                           fixed_t *weights, fixed_t *biases);                               \
+    void fc_back_prop_fixed_##act(fixed_t *input_gradient, fixed_t *net_inputs, fixed_t *weights,            \
+                                  int input_size, int net_inputs_size,                                       \
+                                  fixed_acc_t *gradient_weights, fixed_acc_t *gradient_biases);              \
+    void fc_specific_back_prop_fixed_##act(fixed_t *input_gradient, fixed_t *net_inputs, int layer_size,     \
+                                           fixed_acc_t *gradient_weights, fixed_acc_t *gradient_biases, int n_neurons);
+
+#define X(act, func, func_deriv) GENERATE_FC_FIXED_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#endif
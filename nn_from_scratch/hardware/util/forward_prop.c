@@ -4,6 +4,8 @@
 #include <string.h>
 #include <stdio.h>
 #include "config.h"
+#include "weight_layout.h"
+#include "simd_dispatch.h"
 /* forward propagation allocates output memory
     @result returns activation result for output for layer, and allocate memory from each layer
 
@@ -62,48 +64,280 @@ float *fc_forward_prop_t(float *input, int input_size, float *output, int output
     return output;
 }
 
-#define GENERATE_FC_FORWARD_PROP_VARIANTS(act, func, func_deriv)              \
-    float *fc_forward_prop_##act(float *input, float *weights, float *biases, \
-                                 int input_size, int output_size)             \
-    {                                                                         \
-        float *output = (float *)malloc(output_size * sizeof(float));         \
-        for (int i = 0; i < output_size; i++)                                 \
-        {                                                                     \
-            float sum = 0;                                                    \
-            for (int j = 0; j < input_size; j++)                              \
-            {                                                                 \
-                sum += input[j] * weights[i + j * output_size];               \
-            }                                                                 \
-            sum += biases[i];                                                 \
-            output[i] = func(sum);                                            \
-        }                                                                     \
-        return output;                                                        \
-    }
-
-#define GENERATE_FC_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)                                                              \
-    float *fc_forward_prop_t_##act(float *input, int input_size, float *output, int output_size, float *weights, float *biases) \
-    {                                                                                                                           \
-        for (int i = 0; i < output_size; i++)                                                                                   \
-        {                                                                                                                       \
-            float sum = 0;                                                                                                      \
-            for (int j = 0; j < input_size; j++)                                                                                \
-            {                                                                                                                   \
-                sum += func(input[j]) * weights[i + j * output_size];                                                           \
-            }                                                                                                                   \
-            sum += biases[i];                                                                                                   \
-            output[i] = sum;                                                                                                    \
-        }                                                                                                                       \
-        return output;                                                                                                          \
+#define GENERATE_FC_FORWARD_PROP_INTO_VARIANTS(act, func, func_deriv)               \
+    void fc_forward_prop_into_##act(float *input, float *weights, float *biases,    \
+                                    int input_size, int output_size, float *output) \
+    {                                                                               \
+        for (int i = 0; i < output_size; i++)                                       \
+        {                                                                           \
+            float sum = 0;                                                          \
+            for (int j = 0; j < input_size; j++)                                    \
+            {                                                                       \
+                sum += input[j] * weights[i + j * output_size];                     \
+            }                                                                       \
+            sum += biases[i];                                                       \
+            output[i] = func(sum);                                                  \
+        }                                                                           \
     }
 
+#define GENERATE_FC_FORWARD_PROP_VARIANTS(act, func, func_deriv)               \
+    float *fc_forward_prop_##act(float *input, float *weights, float *biases,  \
+                                 int input_size, int output_size)              \
+    {                                                                          \
+        float *output = (float *)malloc(output_size * sizeof(float));          \
+        ForwardPropInto forward_prop = get_fc_forward_prop_into_variant(act);  \
+        forward_prop(input, weights, biases, input_size, output_size, output); \
+        return output;                                                         \
+    }
+
+/* Training forward propagation, stores the net inputs of the layer in output and their activations in activations.
+    The input is already activated, so the inner loop is a pure multiply-add.
+    @return activations, the input of the next layer
+*/
+#define GENERATE_FC_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)                               \
+    float *fc_forward_prop_t_##act(float *input, int input_size, float *output, int output_size, \
+                                   float *weights, float *biases, float *activations)            \
+    {                                                                                            \
+        for (int i = 0; i < output_size; i++)                                                    \
+        {                                                                                        \
+            float sum = 0;                                                                       \
+            for (int j = 0; j < input_size; j++)                                                 \
+            {                                                                                    \
+                sum += input[j] * weights[i + j * output_size];                                  \
+            }                                                                                    \
+            sum += biases[i];                                                                    \
+            output[i] = sum;                                                                     \
+            activations[i] = func(sum);                                                          \
+        }                                                                                        \
+        return activations;                                                                      \
+    }
+
+/* Net inputs of a batch as a register-blocked matrix multiply: output = input * weights + biases, row-wise.
+    4 samples x 4 outputs stay in accumulators over all inputs, so every weight loaded is used for 4 samples and every
+    input for 4 outputs. The SIMD variants block whole vectors of outputs the same way, see simd_kernels_template.h.
+*/
+static void fc_forward_prop_batch_sums(float *restrict input, float *restrict weights, float *restrict biases,
+                                       int input_size, int output_size, int n_samples, float *restrict output)
+{
+    int i = 0;
+    for (; i + 4 <= output_size; i += 4)
+    {
+        int s = 0;
+        for (; s + 4 <= n_samples; s += 4)
+        {
+            float acc[4][4];
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    acc[r][c] = biases[i + c];
+                }
+            }
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                float *w = weights + i + j * output_size;
+                for (int r = 0; r < 4; r++)
+                {
+                    float x = in[r * input_size + j];
+                    for (int c = 0; c < 4; c++)
+                    {
+                        acc[r][c] += x * w[c];
+                    }
+                }
+            }
+            for (int r = 0; r < 4; r++)
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    output[(s + r) * output_size + i + c] = acc[r][c];
+                }
+            }
+        }
+        for (; s < n_samples; s++)
+        {
+            float acc[4] = {biases[i], biases[i + 1], biases[i + 2], biases[i + 3]};
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                float *w = weights + i + j * output_size;
+                for (int c = 0; c < 4; c++)
+                {
+                    acc[c] += in[j] * w[c];
+                }
+            }
+            for (int c = 0; c < 4; c++)
+            {
+                output[s * output_size + i + c] = acc[c];
+            }
+        }
+    }
+    for (; i < output_size; i++)
+    {
+        for (int s = 0; s < n_samples; s++)
+        {
+            float sum = biases[i];
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                sum += in[j] * weights[i + j * output_size];
+            }
+            output[s * output_size + i] = sum;
+        }
+    }
+}
+
+/* Batched forward propagation: output = func(input * weights + biases)
+
+    @param input: input samples for the layer, stored row-wise (n_samples x input_size)
+    @param weights: weights pointer for the layer
+    @param biases: biases pointer for the layer
+    @param input_size: size of the input for the layer
+    @param output_size: size of the output for the layer
+    @param n_samples: number of samples in the batch
+    @param output: pointer to where the outputs will be stored row-wise (n_samples x output_size)
+*/
+#define GENERATE_FC_FORWARD_PROP_BATCH_VARIANTS(act, func, func_deriv)                                  \
+    void fc_forward_prop_batch_##act(float *input, float *weights, float *biases,                       \
+                                     int input_size, int output_size, int n_samples, float *output)     \
+    {                                                                                                   \
+        fc_forward_prop_batch_sums(input, weights, biases, input_size, output_size, n_samples, output); \
+        for (int i = 0; i < n_samples * output_size; i++)                                               \
+        {                                                                                               \
+            output[i] = func(output[i]);                                                                \
+        }                                                                                               \
+    }
+
+/* Forward propagation variants for the OUTPUT_MAJOR_PACKED layout, see weight_layout.h.
+    Same parameters as the INPUT_MAJOR variants, every output is a contiguous dot product.
+*/
+#define GENERATE_FC_FORWARD_PROP_INTO_PACKED_VARIANTS(act, func, func_deriv)               \
+    void fc_forward_prop_into_packed_##act(float *input, float *weights, float *biases,    \
+                                           int input_size, int output_size, float *output) \
+    {                                                                                      \
+        int stride = FC_PACKED_STRIDE(input_size);                                         \
+        for (int i = 0; i < output_size; i++)                                              \
+        {                                                                                  \
+            float *w_row = weights + i * stride;                                           \
+            float sum = 0;                                                                 \
+            for (int j = 0; j < input_size; j++)                                           \
+            {                                                                              \
+                sum += input[j] * w_row[j];                                                \
+            }                                                                              \
+            sum += biases[i];                                                              \
+            output[i] = func(sum);                                                         \
+        }                                                                                  \
+    }
+
+#define GENERATE_FC_FORWARD_PROP_PACKED_VARIANTS(act, func, func_deriv)                             \
+    float *fc_forward_prop_packed_##act(float *input, float *weights, float *biases,                \
+                                        int input_size, int output_size)                            \
+    {                                                                                               \
+        float *output = (float *)malloc(output_size * sizeof(float));                               \
+        fc_forward_prop_into_packed_##act(input, weights, biases, input_size, output_size, output); \
+        return output;                                                                              \
+    }
+
+#define GENERATE_FC_FORWARD_PROP_T_PACKED_VARIANTS(act, func, func_deriv)                               \
+    float *fc_forward_prop_t_packed_##act(float *input, int input_size, float *output, int output_size, \
+                                          float *weights, float *biases, float *activations)            \
+    {                                                                                                   \
+        int stride = FC_PACKED_STRIDE(input_size);                                                      \
+        for (int i = 0; i < output_size; i++)                                                           \
+        {                                                                                               \
+            float *w_row = weights + i * stride;                                                        \
+            float sum = 0;                                                                              \
+            for (int j = 0; j < input_size; j++)                                                        \
+            {                                                                                           \
+                sum += input[j] * w_row[j];                                                             \
+            }                                                                                           \
+            sum += biases[i];                                                                           \
+            output[i] = sum;                                                                            \
+            activations[i] = func(sum);                                                                 \
+        }                                                                                               \
+        return activations;                                                                             \
+    }
+
+#define GENERATE_FC_FORWARD_PROP_BATCH_PACKED_VARIANTS(act, func, func_deriv)                                   \
+    void fc_forward_prop_batch_packed_##act(float *input, float *weights, float *biases,                        \
+                                            int input_size, int output_size, int n_samples, float *output)      \
+    {                                                                                                           \
+        int stride = FC_PACKED_STRIDE(input_size);                                                              \
+        for (int o0 = 0; o0 < output_size; o0 += FC_BATCH_TILE_OUTPUTS)                                         \
+        {                                                                                                       \
+            int o1 = (o0 + FC_BATCH_TILE_OUTPUTS < output_size) ? o0 + FC_BATCH_TILE_OUTPUTS : output_size;     \
+            for (int s0 = 0; s0 < n_samples; s0 += FC_BATCH_TILE_SAMPLES)                                       \
+            {                                                                                                   \
+                int s1 = (s0 + FC_BATCH_TILE_SAMPLES < n_samples) ? s0 + FC_BATCH_TILE_SAMPLES : n_samples;     \
+                for (int s = s0; s < s1; s++)                                                                   \
+                {                                                                                               \
+                    for (int o = o0; o < o1; o++)                                                               \
+                    {                                                                                           \
+                        output[s * output_size + o] = biases[o];                                                \
+                    }                                                                                           \
+                }                                                                                               \
+                for (int k0 = 0; k0 < input_size; k0 += FC_BATCH_TILE_INPUTS)                                   \
+                {                                                                                               \
+                    int k1 = (k0 + FC_BATCH_TILE_INPUTS < input_size) ? k0 + FC_BATCH_TILE_INPUTS : input_size; \
+                    for (int o = o0; o < o1; o++)                                                               \
+                    {                                                                                           \
+                        float *w_row = weights + o * stride;                                                    \
+                        for (int s = s0; s < s1; s++)                                                           \
+                        {                                                                                       \
+                            float *in_row = input + s * input_size;                                             \
+                            float sum = 0;                                                                      \
+                            for (int k = k0; k < k1; k++)                                                       \
+                            {                                                                                   \
+                                sum += in_row[k] * w_row[k];                                                    \
+                            }                                                                                   \
+                            output[s * output_size + o] += sum;                                                 \
+                        }                                                                                       \
+                    }                                                                                           \
+                }                                                                                               \
+                for (int s = s0; s < s1; s++)                                                                   \
+                {                                                                                               \
+                    for (int o = o0; o < o1; o++)                                                               \
+                    {                                                                                           \
+                        float sum = output[s * output_size + o];                                                \
+                        output[s * output_size + o] = func(sum);                                                \
+                    }                                                                                           \
+                }                                                                                               \
+            }                                                                                                   \
+        }                                                                                                       \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_INTO_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
 #define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_VARIANTS(act, func, func_deriv)
 ACTIVATION_MACRO_LIST
 #undef X
 
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_BATCH_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
 #define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)
 ACTIVATION_MACRO_LIST
 #undef X
 
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_INTO_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_T_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_BATCH_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
 #define X(act, func, func_deriv) \
     case act:                    \
         return fc_forward_prop_##act;
@@ -124,6 +358,11 @@ ForwardProp get_fc_forward_prop_variant(enum ActivationType activationType)
         return fc_forward_prop_t_##act;
 ForwardPropT get_fc_forward_prop_t_variant(enum ActivationType activationType)
 {
+    ForwardPropT simd_variant = get_fc_forward_prop_t_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
     switch (activationType)
     {
         ACTIVATION_MACRO_LIST
@@ -133,3 +372,118 @@ ForwardPropT get_fc_forward_prop_t_variant(enum ActivationType activationType)
     }
 }
 #undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_batch_##act;
+ForwardPropBatch get_fc_forward_prop_batch_variant(enum ActivationType activationType)
+{
+    ForwardPropBatch simd_variant = get_fc_forward_prop_batch_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_batch_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_into_##act;
+ForwardPropInto get_fc_forward_prop_into_variant(enum ActivationType activationType)
+{
+    ForwardPropInto simd_variant = get_fc_forward_prop_into_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_into_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_packed_##act;
+ForwardProp get_fc_forward_prop_packed_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_packed_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_t_packed_##act;
+ForwardPropT get_fc_forward_prop_t_packed_variant(enum ActivationType activationType)
+{
+    ForwardPropT simd_variant = get_fc_forward_prop_t_packed_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_t_packed_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_into_packed_##act;
+ForwardPropInto get_fc_forward_prop_into_packed_variant(enum ActivationType activationType)
+{
+    ForwardPropInto simd_variant = get_fc_forward_prop_into_packed_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_into_packed_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_batch_packed_##act;
+ForwardPropBatch get_fc_forward_prop_batch_packed_variant(enum ActivationType activationType)
+{
+    ForwardPropBatch simd_variant = get_fc_forward_prop_batch_packed_simd_variant(activationType);
+    if (simd_variant != NULL)
+    {
+        return simd_variant;
+    }
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_batch_packed_LINEAR;
+    }
+}
+#undef X
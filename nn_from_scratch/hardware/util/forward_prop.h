@@ -1,3 +1,5 @@
+#ifndef FORWARD_PROP_H
+#define FORWARD_PROP_H
 
 #include "activation_functions.h"
 #include <stdint.h>
@@ -7,15 +9,32 @@ extern float *fc_forward_prop(float *input, float *layer_weights, float *layer_b
 extern float *fc_forward_prop_t(float *input, int input_size, float *output, int output_size, float *weights, float *biases, ActivationFunc activation_func);
 
 typedef float *(*ForwardProp)(float *, float *, float *, int, int);
-typedef float *(*ForwardPropT)(float *, int, float *, int, float *, float *);
+typedef float *(*ForwardPropT)(float *, int, float *, int, float *, float *, float *);
+typedef void (*ForwardPropInto)(float *, float *, float *, int, int, float *);
+typedef void (*ForwardPropBatch)(float *, float *, float *, int, int, int, float *);
 ForwardProp get_fc_forward_prop_variant(enum ActivationType activationType);
 ForwardPropT get_fc_forward_prop_t_variant(enum ActivationType activationType);
+ForwardPropInto get_fc_forward_prop_into_variant(enum ActivationType activationType);
+ForwardPropBatch get_fc_forward_prop_batch_variant(enum ActivationType activationType);
+ForwardProp get_fc_forward_prop_packed_variant(enum ActivationType activationType);
+ForwardPropT get_fc_forward_prop_t_packed_variant(enum ActivationType activationType);
+ForwardPropInto get_fc_forward_prop_into_packed_variant(enum ActivationType activationType);
+ForwardPropBatch get_fc_forward_prop_batch_packed_variant(enum ActivationType activationType);
 
 #define GENERATE_FC_FORWARD_PROP_PROTOTYPE_VARIANTS(act, func, func_deriv) \
     float *fc_forward_prop_##act(float *input, float *weights, float *biases, int input_size, int output_size);
 
-#define GENERATE_FC_FORWARD_PROP_T_PROTOTYPE_VARIANTS(act, func, func_deriv) \
-    float *fc_forward_prop_t_##act(float *input, int input_size, float *output, int output_size, float *weights, float *biases);
+#define GENERATE_FC_FORWARD_PROP_INTO_PROTOTYPE_VARIANTS(act, func, func_deriv)                  \
+    void fc_forward_prop_into_##act(float *input, float *weights, float *biases, int input_size, \
+                                    int output_size, float *output);
+
+#define GENERATE_FC_FORWARD_PROP_T_PROTOTYPE_VARIANTS(act, func, func_deriv)                                     \
+    float *fc_forward_prop_t_##act(float *input, int input_size, float *output, int output_size, float *weights, \
+                                   float *biases, float *activations);
+
+#define GENERATE_FC_FORWARD_PROP_BATCH_PROTOTYPE_VARIANTS(act, func, func_deriv)                  \
+    void fc_forward_prop_batch_##act(float *input, float *weights, float *biases, int input_size, \
+                                     int output_size, int n_samples, float *output);
 
 #define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_PROTOTYPE_VARIANTS(act, func, func_deriv)
 ACTIVATION_MACRO_LIST
@@ -23,4 +42,25 @@ ACTIVATION_MACRO_LIST
 #define X(act, func, func_deriv) \
     GENERATE_FC_FORWARD_PROP_T_PROTOTYPE_VARIANTS(act, func, func_deriv)
 ACTIVATION_MACRO_LIST
-#undef X
\ No newline at end of file
+#undef X
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_BATCH_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_INTO_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define GENERATE_FC_FORWARD_PROP_PACKED_PROTOTYPE_VARIANTS(act, func, func_deriv)                                       \
+    float *fc_forward_prop_packed_##act(float *input, float *weights, float *biases, int input_size, int output_size);  \
+    float *fc_forward_prop_t_packed_##act(float *input, int input_size, float *output, int output_size, float *weights, \
+                                          float *biases, float *activations);                                           \
+    void fc_forward_prop_into_packed_##act(float *input, float *weights, float *biases, int input_size,                 \
+                                           int output_size, float *output);                                             \
+    void fc_forward_prop_batch_packed_##act(float *input, float *weights, float *biases, int input_size,                \
+                                            int output_size, int n_samples, float *output);
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_PACKED_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#endif
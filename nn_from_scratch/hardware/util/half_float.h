@@ -0,0 +1,117 @@
+#ifndef HALF_FLOAT_H
+#define HALF_FLOAT_H
+#include <stdint.h>
+#include <string.h>
+
+/* 16 bit storage of floats, computation stays in float. The conversions round to nearest even and keep infinities and NaN.
+   HALF_FP16 is IEEE 754 half precision: 1 sign, 5 exponent and 10 mantissa bits, so about 3 decimal digits and a range
+   up to 65504, with subnormals. HALF_BF16 (bfloat16) is the upper half of a float: the range of float with 8 mantissa bits.
+*/
+typedef uint16_t half_t;
+
+enum HalfFormat
+{
+    HALF_FP16,
+    HALF_BF16
+};
+
+static inline half_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t abs = bits & 0x7fffffffu;
+    if (abs >= 0x7f800000u) // infinity or NaN, NaN stays quiet
+    {
+        return (half_t)(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0));
+    }
+    if (abs >= 0x477ff000u) // rounds above 65504
+    {
+        return (half_t)(sign | 0x7c00u);
+    }
+    if (abs < 0x38800000u) // below 2^-14, a subnormal half or zero
+    {
+        if (abs < 0x33000000u) // below half of the smallest subnormal
+        {
+            return (half_t)sign;
+        }
+        uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+        int shift = 126 - (int)(abs >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        half += (rest > halfway || (rest == halfway && (half & 1)));
+        return (half_t)(sign | half);
+    }
+    // rebias the exponent and round the 13 dropped mantissa bits, a carry rolls over into the exponent
+    uint32_t half = (abs - 0x38000000u) >> 13;
+    uint32_t rest = abs & 0x1fffu;
+    half += (rest > 0x1000u || (rest == 0x1000u && (half & 1)));
+    return (half_t)(sign | half);
+}
+
+static inline float half_to_float(half_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0x1fu)
+    {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        // normalize the subnormal
+        exponent = 113;
+        while (!(mantissa & 0x400u))
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline half_t float_to_bf16(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u) // NaN, keeps the sign and stays quiet
+    {
+        return (half_t)((bits >> 16) | 0x40u);
+    }
+    bits += 0x7fffu + ((bits >> 16) & 1); // a carry rolls over into the exponent, up to infinity
+    return (half_t)(bits >> 16);
+}
+
+static inline float bf16_to_float(half_t half)
+{
+    uint32_t bits = (uint32_t)half << 16;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline half_t float_to_half_format(float value, enum HalfFormat format)
+{
+    return (format == HALF_BF16) ? float_to_bf16(value) : float_to_half(value);
+}
+
+static inline float half_format_to_float(half_t half, enum HalfFormat format)
+{
+    return (format == HALF_BF16) ? bf16_to_float(half) : half_to_float(half);
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include "half_model_binding.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Creates a 16 bit copy of a float model, the float model is left untouched.
+    Weights outside the range of fp16 become infinite, bf16 has the range of float.
+    @return NULL if the model does not use the INPUT_MAJOR layout or has sparse layers
+*/
+HalfModel *createHalfModel(Model *model, enum HalfFormat format)
+{
+    if (model->weights_layout != INPUT_MAJOR)
+    {
+        printf("Half precision models need the INPUT_MAJOR weights layout! \n");
+        return NULL;
+    }
+    if (model->layers_sparse != NULL)
+    {
+        printf("Half precision models do not support sparse layers! \n");
+        return NULL;
+    }
+
+    int n_weights = 0;
+    int n_biases = 0;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        n_weights += model->layers_size[i] * size;
+        n_biases += model->layers_size[i];
+        size = model->layers_size[i];
+    }
+
+    HalfModel *half_model = (HalfModel *)malloc(sizeof(HalfModel));
+    half_model->n_layers = model->n_layers;
+    half_model->input_size = model->input_size;
+    half_model->output_size = model->output_size;
+    half_model->layers_size = model->layers_size;
+    half_model->layers_activation = model->layers_activation;
+    half_model->format = format;
+    half_model->master_weights = NULL;
+    half_model->master_layer = -1;
+    half_model->master_n_weights = 0;
+    half_model->master_offset = 0;
+    half_model->layers_weights = (half_t **)malloc(model->n_layers * sizeof(half_t *));
+    half_model->layers_biases = (float **)malloc(model->n_layers * sizeof(float *));
+    // the biases come first, so they stay aligned for floats
+    half_model->memory = malloc(n_biases * sizeof(float) + n_weights * sizeof(half_t));
+
+    float *biases = (float *)half_model->memory;
+    half_t *weights = (half_t *)(biases + n_biases);
+    size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int layer_weights = model->layers_size[i] * size;
+        half_model->layers_weights[i] = weights;
+        for (int j = 0; j < layer_weights; j++)
+        {
+            weights[j] = float_to_half_format(model->layers_weights[i][j], format);
+        }
+        weights += layer_weights;
+        half_model->layers_biases[i] = biases;
+        for (int j = 0; j < model->layers_size[i]; j++)
+        {
+            biases[j] = model->layers_biases[i][j];
+        }
+        biases += model->layers_size[i];
+        size = model->layers_size[i];
+    }
+    return half_model;
+}
+
+/* Keeps an fp32 master copy of n_weights weights per neuron of the target layer starting at offset, the slice trained by
+    fc_half_model_train_partial_layer. A previous master copy is rounded into the weights and replaced.
+    @return 1 on success, 0 when the slice does not fit the layer
+*/
+int setHalfTrainableSlice(HalfModel *model, int target_layer, int n_weights, int offset)
+{
+    if (target_layer < 0 || target_layer >= model->n_layers || offset < 0 || n_weights < 1 ||
+        n_weights + offset > (target_layer == 0 ? model->input_size : model->layers_size[target_layer - 1]))
+    {
+        printf("Invalid slice for the master weights! \n");
+        return 0;
+    }
+    if (model->master_layer == target_layer && model->master_n_weights == n_weights && model->master_offset == offset)
+    {
+        return 1;
+    }
+    free(model->master_weights); // the stored weights already hold the rounded master copy
+
+    // INPUT_MAJOR: the slice is one contiguous block of the layer
+    int n_values = n_weights * model->layers_size[target_layer];
+    half_t *weights = model->layers_weights[target_layer] + offset * model->layers_size[target_layer];
+    model->master_weights = (float *)malloc(n_values * sizeof(float));
+    for (int j = 0; j < n_values; j++)
+    {
+        model->master_weights[j] = half_format_to_float(weights[j], model->format);
+    }
+    model->master_layer = target_layer;
+    model->master_n_weights = n_weights;
+    model->master_offset = offset;
+    return 1;
+}
+
+/* Writes the weights and biases of a half precision model back into the float model it was created from,
+    the trained slice from its master copy */
+void halfModelToModel(HalfModel *half_model, Model *model)
+{
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        for (int j = 0; j < model->layers_size[i] * size; j++)
+        {
+            model->layers_weights[i][j] = half_format_to_float(half_model->layers_weights[i][j], half_model->format);
+        }
+        for (int j = 0; j < model->layers_size[i]; j++)
+        {
+            model->layers_biases[i][j] = half_model->layers_biases[i][j];
+        }
+        size = model->layers_size[i];
+    }
+    if (half_model->master_weights != NULL)
+    {
+        int layer_size = model->layers_size[half_model->master_layer];
+        float *weights = model->layers_weights[half_model->master_layer] + half_model->master_offset * layer_size;
+        for (int j = 0; j < half_model->master_n_weights * layer_size; j++)
+        {
+            weights[j] = half_model->master_weights[j];
+        }
+    }
+}
+
+void freeHalfModel(HalfModel *model)
+{
+    free(model->master_weights);
+    free(model->memory);
+    free(model->layers_weights);
+    free(model->layers_biases);
+    free(model);
+}
+
+/* Number of floats needed for the inference workspace, two buffers of the widest layer */
+int half_workspace_size(HalfModel *model)
+{
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (model->layers_size[i] > max_size)
+        {
+            max_size = model->layers_size[i];
+        }
+    }
+    return 2 * max_size;
+}
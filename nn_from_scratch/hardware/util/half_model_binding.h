@@ -0,0 +1,41 @@
+#ifndef HALF_MODEL_BINDING_H
+#define HALF_MODEL_BINDING_H
+#include "activation_functions.h"
+#include "half_float.h"
+#include "model_binding.h"
+#include <stdint.h>
+
+/* Mixed-precision copy of a model: weights stored as fp16 or bf16 in the INPUT_MAJOR layout, see half_float.h, which halves
+   their memory and bandwidth. The kernels widen them to float as they are loaded and accumulate in float.
+   Biases stay float, they are a small part of the model and are added once per output.
+   Training updates an fp32 master copy of the trained slice only and rounds it back into the 16 bit weights,
+   so steps below the rounding step of the stored weights still add up.
+*/
+typedef struct
+{
+    int n_layers;
+    int input_size;
+    int output_size;
+    int *layers_size;
+    half_t **layers_weights;
+    float **layers_biases;
+    enum ActivationType *layers_activation;
+    enum HalfFormat format;
+    float *master_weights; // fp32 weights of the trained slice, NULL until a slice is set
+    int master_layer;
+    int master_n_weights;
+    int master_offset;
+    void *memory; // owned allocation backing the weights and biases
+} HalfModel;
+
+HalfModel *createHalfModel(Model *model, enum HalfFormat format);
+
+int setHalfTrainableSlice(HalfModel *model, int target_layer, int n_weights, int offset);
+
+void halfModelToModel(HalfModel *half_model, Model *model);
+
+void freeHalfModel(HalfModel *model);
+
+int half_workspace_size(HalfModel *model);
+
+#endif
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include "half_prop.h"
+#include "simd_dispatch.h"
+
+/* Sums of one output at a time, the tail of the vector kernels */
+static void fc_half_accumulate_scalar(float *input, half_t *weights, float *biases, int input_size, int output_size,
+                                      enum HalfFormat format, int first_output, float *output)
+{
+    for (int i = first_output; i < output_size; i++)
+    {
+        float sum = 0;
+        for (int j = 0; j < input_size; j++)
+        {
+            sum += input[j] * half_format_to_float(weights[i + j * output_size], format);
+        }
+        output[i] = sum + biases[i];
+    }
+}
+
+/* Vector sums over a block of outputs, HALF_LOAD(p) widens the weights of the block for one input to a vector of floats */
+#define HALF_ACCUMULATE_VECTORS(width, HALF_LOAD, SET1, ZERO, FMADD, LOAD, ADD, STORE)     \
+    for (; i + width <= output_size; i += width)                                          \
+    {                                                                                     \
+        acc = ZERO();                                                                     \
+        for (int j = 0; j < input_size; j++)                                              \
+        {                                                                                 \
+            acc = FMADD(SET1(input[j]), HALF_LOAD(weights + i + j * output_size), acc);   \
+        }                                                                                 \
+        STORE(output + i, ADD(acc, LOAD(biases + i)));                                    \
+    }
+
+#if defined(FC_SIMD_X86)
+#include <immintrin.h>
+
+#define FP16_LOAD_F16C(p) _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(p)))
+#define BF16_LOAD_AVX2(p) _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(p))), 16))
+#define X86_FMADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+
+__attribute__((target("avx2,fma,f16c"))) static void fc_half_accumulate_f16c(float *input, half_t *weights, float *biases, int input_size,
+                                                                              int output_size, enum HalfFormat format, float *output)
+{
+    int i = 0;
+    __m256 acc;
+    if (format == HALF_BF16)
+    {
+        HALF_ACCUMULATE_VECTORS(8, BF16_LOAD_AVX2, _mm256_set1_ps, _mm256_setzero_ps, X86_FMADD, _mm256_loadu_ps, _mm256_add_ps, _mm256_storeu_ps)
+    }
+    else
+    {
+        HALF_ACCUMULATE_VECTORS(8, FP16_LOAD_F16C, _mm256_set1_ps, _mm256_setzero_ps, X86_FMADD, _mm256_loadu_ps, _mm256_add_ps, _mm256_storeu_ps)
+    }
+    fc_half_accumulate_scalar(input, weights, biases, input_size, output_size, format, i, output);
+}
+
+/* F16C came with AVX2 on every CPU, it is checked on its own for emulators that leave it out */
+static int half_vector_kernels(void)
+{
+    static int f16c = -1;
+    if (f16c < 0)
+    {
+        __builtin_cpu_init();
+        f16c = __builtin_cpu_supports("f16c");
+    }
+    return f16c && get_simd_level() >= SIMD_AVX2;
+}
+#define fc_half_accumulate_vector fc_half_accumulate_f16c
+
+#elif defined(FC_SIMD_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+
+#define FP16_LOAD_NEON(p) vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p)))
+#define BF16_LOAD_NEON(p) vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(p), 16))
+#define NEON_FMADD(a, b, c) vfmaq_f32(c, a, b)
+#define NEON_ZERO() vdupq_n_f32(0)
+
+static void fc_half_accumulate_neon(float *input, half_t *weights, float *biases, int input_size, int output_size,
+                                    enum HalfFormat format, float *output)
+{
+    int i = 0;
+    float32x4_t acc;
+    if (format == HALF_BF16)
+    {
+        HALF_ACCUMULATE_VECTORS(4, BF16_LOAD_NEON, vdupq_n_f32, NEON_ZERO, NEON_FMADD, vld1q_f32, vaddq_f32, vst1q_f32)
+    }
+    else
+    {
+        HALF_ACCUMULATE_VECTORS(4, FP16_LOAD_NEON, vdupq_n_f32, NEON_ZERO, NEON_FMADD, vld1q_f32, vaddq_f32, vst1q_f32)
+    }
+    fc_half_accumulate_scalar(input, weights, biases, input_size, output_size, format, i, output);
+}
+
+static int half_vector_kernels(void)
+{
+    return get_simd_level() != SIMD_SCALAR;
+}
+#define fc_half_accumulate_vector fc_half_accumulate_neon
+
+#elif defined(FC_SIMD_HELIUM)
+#include <arm_mve.h>
+
+// the widening load puts every half into the bottom 16 bits of a 32 bit lane
+#define FP16_LOAD_HELIUM(p) vcvtbq_f32_f16(vreinterpretq_f16_u32(vldrhq_u32(p)))
+#define BF16_LOAD_HELIUM(p) vreinterpretq_f32_u32(vshlq_n_u32(vldrhq_u32(p), 16))
+#define HELIUM_FMADD(a, b, c) vfmaq_f32(c, a, b)
+#define HELIUM_ZERO() vdupq_n_f32(0)
+
+static void fc_half_accumulate_helium(float *input, half_t *weights, float *biases, int input_size, int output_size,
+                                      enum HalfFormat format, float *output)
+{
+    int i = 0;
+    float32x4_t acc;
+    if (format == HALF_BF16)
+    {
+        HALF_ACCUMULATE_VECTORS(4, BF16_LOAD_HELIUM, vdupq_n_f32, HELIUM_ZERO, HELIUM_FMADD, vld1q_f32, vaddq_f32, vst1q_f32)
+    }
+    else
+    {
+        HALF_ACCUMULATE_VECTORS(4, FP16_LOAD_HELIUM, vdupq_n_f32, HELIUM_ZERO, HELIUM_FMADD, vld1q_f32, vaddq_f32, vst1q_f32)
+    }
+    fc_half_accumulate_scalar(input, weights, biases, input_size, output_size, format, i, output);
+}
+
+static int half_vector_kernels(void)
+{
+    return get_simd_level() != SIMD_SCALAR;
+}
+#define fc_half_accumulate_vector fc_half_accumulate_helium
+#endif
+
+/* Net inputs of a layer with 16 bit weights: output[i] = sum_j input[j] * weights[i + j * output_size] + biases[i],
+    accumulated in float. Uses the vector kernel unless the SIMD level is set to SIMD_SCALAR.
+*/
+void fc_half_accumulate(float *input, half_t *weights, float *biases, int input_size, int output_size, enum HalfFormat format,
+                        float *output)
+{
+#ifdef fc_half_accumulate_vector
+    if (half_vector_kernels())
+    {
+        fc_half_accumulate_vector(input, weights, biases, input_size, output_size, format, output);
+        return;
+    }
+#endif
+    fc_half_accumulate_scalar(input, weights, biases, input_size, output_size, format, 0, output);
+}
+
+/* fc_light_back_prop_into for 16 bit weights, the weights of each input are contiguous so every gradient is a dot product */
+void fc_light_back_prop_half_into(float *input_gradient, half_t *weights, int input_size, int output_layer_size,
+                                  enum HalfFormat format, uint32_t *deriv_mask, float *output)
+{
+    for (int j = 0; j < output_layer_size; j++)
+    {
+        half_t *row = weights + j * input_size;
+        float sum = 0;
+        for (int i = 0; i < input_size; i++)
+        {
+            sum += half_format_to_float(row[i], format) * input_gradient[i];
+        }
+        output[j] = sum;
+    }
+    deriv_mask_apply(output, deriv_mask, output_layer_size);
+}
+
+/* Inference forward propagation of a layer with 16 bit weights
+    @param format: storage format of the weights
+    @param output: pointer to where the output_size activations will be stored
+*/
+#define GENERATE_FC_FORWARD_PROP_HALF_VARIANTS(act, func, func_deriv)                                                \
+    void fc_forward_prop_half_##act(float *input, half_t *weights, float *biases, int input_size, int output_size, \
+                                    enum HalfFormat format, float *output)                                         \
+    {                                                                                                              \
+        fc_half_accumulate(input, weights, biases, input_size, output_size, format, output);                       \
+        for (int i = 0; i < output_size; i++)                                                                      \
+        {                                                                                                          \
+            output[i] = func(output[i]);                                                                           \
+        }                                                                                                          \
+    }
+
+/* Training forward propagation of a layer with 16 bit weights, keeps the net inputs for the derivatives
+    @return activations, the input of the next layer
+*/
+#define GENERATE_FC_FORWARD_PROP_T_HALF_VARIANTS(act, func, func_deriv)                                                  \
+    float *fc_forward_prop_t_half_##act(float *input, half_t *weights, float *biases, int input_size, int output_size, \
+                                        enum HalfFormat format, float *net_inputs, float *activations)                 \
+    {                                                                                                                  \
+        fc_half_accumulate(input, weights, biases, input_size, output_size, format, net_inputs);                       \
+        for (int i = 0; i < output_size; i++)                                                                          \
+        {                                                                                                              \
+            activations[i] = func(net_inputs[i]);                                                                      \
+        }                                                                                                              \
+        return activations;                                                                                            \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_HALF_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_T_HALF_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_half_##act;
+ForwardPropHalf get_fc_forward_prop_half_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_half_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_t_half_##act;
+ForwardPropTHalf get_fc_forward_prop_t_half_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_t_half_LINEAR;
+    }
+}
+#undef X
@@ -0,0 +1,32 @@
+#ifndef HALF_PROP_H
+#define HALF_PROP_H
+#include "activation_functions.h"
+#include "half_float.h"
+#include "deriv_mask.h"
+#include <stdint.h>
+
+/* Kernels for 16 bit INPUT_MAJOR weights, the counterparts of forward_prop.c and back_prop.c for a HalfModel.
+   Weights are widened to float as they are loaded, with F16C on x86 and the fp16 conversions of NEON (AArch64) and
+   Helium, and all sums are accumulated in float.
+*/
+void fc_half_accumulate(float *input, half_t *weights, float *biases, int input_size, int output_size, enum HalfFormat format,
+                        float *output);
+void fc_light_back_prop_half_into(float *input_gradient, half_t *weights, int input_size, int output_layer_size,
+                                  enum HalfFormat format, uint32_t *deriv_mask, float *output);
+
+typedef void (*ForwardPropHalf)(float *, half_t *, float *, int, int, enum HalfFormat, float *);
+typedef float *(*ForwardPropTHalf)(float *, half_t *, float *, int, int, enum HalfFormat, float *, float *);
+ForwardPropHalf get_fc_forward_prop_half_variant(enum ActivationType activationType);
+ForwardPropTHalf get_fc_forward_prop_t_half_variant(enum ActivationType activationType);
+
+#define GENERATE_FC_HALF_PROTOTYPE_VARIANTS(act, func, func_deriv)                                                         \
+    void fc_forward_prop_half_##act(float *input, half_t *weights, float *biases, int input_size, int output_size,        \
+                                    enum HalfFormat format, float *output);                                               \
+    float *fc_forward_prop_t_half_##act(float *input, half_t *weights, float *biases, int input_size, int output_size,    \
+                                        enum HalfFormat format, float *net_inputs, float *activations);
+
+#define X(act, func, func_deriv) GENERATE_FC_HALF_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#endif
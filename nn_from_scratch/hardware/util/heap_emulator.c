@@ -0,0 +1,389 @@
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#ifdef ENABLE_HEAP_EMULATION
+#ifndef ENABLE_TRACK_MEMORY
+#error "ENABLE_HEAP_EMULATION needs ENABLE_TRACK_MEMORY, the tracked allocators are the ones carving from the arena"
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "heap_emulator.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+static pthread_mutex_t heap_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define HEAP_LOCK() pthread_mutex_lock(&heap_mutex)
+#define HEAP_UNLOCK() pthread_mutex_unlock(&heap_mutex)
+#else
+#define HEAP_LOCK()
+#define HEAP_UNLOCK()
+#endif
+
+#define HEAP_HEADER_SIZE 8
+#define HEAP_MIN_CHUNK 16
+#define HEAP_SMALL_LIMIT 512
+#define HEAP_N_BINS 88 // 64 exact bins of 8 bytes, then one per power of two up to 2^31
+#define HEAP_NONE UINT32_MAX
+#define HEAP_IN_USE 1u
+
+/* Chunks are addressed by their offset in the arena, so the links take 4 bytes like on the target */
+typedef struct
+{
+    uint32_t prev_size; // size of the chunk before, 0 for the first
+    uint32_t size;      // size with the header, HEAP_IN_USE is set while allocated
+    uint32_t next_free; // the links of free chunks overlap the payload
+    uint32_t prev_free;
+} HeapChunk;
+
+static union
+{
+    double align;
+    unsigned char bytes[HEAP_ARENA_SIZE];
+} arena;
+
+static enum HeapPolicy policy = HEAP_FIRST_FIT;
+static int active = 0;
+static uint32_t heap_size = 0;
+static uint32_t free_lists[HEAP_N_BINS];
+static size_t used_bytes = 0;
+static size_t peak_used_bytes = 0;
+static float peak_fragmentation = 0;
+static size_t min_largest_free = 0;
+static size_t failed_allocations = 0;
+static size_t first_failed_size = 0;
+static const char *first_failed_file = NULL;
+static int first_failed_line = 0;
+static const char *first_failed_function = NULL;
+static size_t first_failed_largest_free = 0;
+
+static HeapChunk *chunk(uint32_t offset)
+{
+    return (HeapChunk *)(arena.bytes + offset);
+}
+
+static int bin_index(uint32_t size)
+{
+    if (policy != HEAP_BINS)
+    {
+        return 0;
+    }
+    if (size < HEAP_SMALL_LIMIT)
+    {
+        return (int)(size >> 3);
+    }
+    int bin = HEAP_SMALL_LIMIT >> 3;
+    for (size /= HEAP_SMALL_LIMIT; size > 1 && bin < HEAP_N_BINS - 1; size >>= 1)
+    {
+        bin++;
+    }
+    return bin;
+}
+
+/* Bins take freed chunks first in, first fit like dlmalloc, the single list of the other policies is kept in address order */
+static void insert_free(uint32_t offset)
+{
+    HeapChunk *c = chunk(offset);
+    int bin = bin_index(c->size);
+    uint32_t prev = HEAP_NONE;
+    uint32_t next = free_lists[bin];
+    if (policy != HEAP_BINS)
+    {
+        while (next != HEAP_NONE && next < offset)
+        {
+            prev = next;
+            next = chunk(next)->next_free;
+        }
+    }
+    c->prev_free = prev;
+    c->next_free = next;
+    if (prev == HEAP_NONE)
+    {
+        free_lists[bin] = offset;
+    }
+    else
+    {
+        chunk(prev)->next_free = offset;
+    }
+    if (next != HEAP_NONE)
+    {
+        chunk(next)->prev_free = offset;
+    }
+}
+
+static void remove_free(uint32_t offset)
+{
+    HeapChunk *c = chunk(offset);
+    if (c->prev_free == HEAP_NONE)
+    {
+        free_lists[bin_index(c->size)] = c->next_free;
+    }
+    else
+    {
+        chunk(c->prev_free)->next_free = c->next_free;
+    }
+    if (c->next_free != HEAP_NONE)
+    {
+        chunk(c->next_free)->prev_free = c->prev_free;
+    }
+}
+
+static uint32_t find_fit(uint32_t size)
+{
+    uint32_t best = HEAP_NONE;
+    for (int bin = bin_index(size); bin < HEAP_N_BINS && best == HEAP_NONE; bin++)
+    {
+        for (uint32_t i = free_lists[bin]; i != HEAP_NONE; i = chunk(i)->next_free)
+        {
+            uint32_t chunk_size = chunk(i)->size;
+            if (chunk_size >= size && (best == HEAP_NONE || chunk_size < chunk(best)->size))
+            {
+                best = i;
+                if (policy == HEAP_FIRST_FIT || chunk_size == size)
+                {
+                    break;
+                }
+            }
+        }
+        if (policy != HEAP_BINS)
+        {
+            break;
+        }
+    }
+    return best;
+}
+
+/* payload of the largest free chunk and of all free chunks */
+static void scan_free(size_t *largest, size_t *total)
+{
+    *largest = 0;
+    *total = 0;
+    for (int bin = 0; bin < HEAP_N_BINS; bin++)
+    {
+        for (uint32_t i = free_lists[bin]; i != HEAP_NONE; i = chunk(i)->next_free)
+        {
+            size_t payload = chunk(i)->size - HEAP_HEADER_SIZE;
+            *total += payload;
+            if (payload > *largest)
+            {
+                *largest = payload;
+            }
+        }
+    }
+}
+
+static float fragmentation(size_t largest, size_t total)
+{
+    return total == 0 ? 0.0f : 1.0f - (float)largest / (float)total;
+}
+
+/* Starts carving the tracked allocations out of the first arena_size bytes of the arena with a fresh heap.
+    @return 0 when blocks of the last emulation are still in use or arena_size does not fit in HEAP_ARENA_SIZE
+*/
+int start_heap_emulation(size_t arena_size, enum HeapPolicy heap_policy)
+{
+    HEAP_LOCK();
+    if (used_bytes != 0)
+    {
+        HEAP_UNLOCK();
+        printf("Error heap: Could not start the heap emulation, %zu bytes of the arena still in use\n", used_bytes);
+        return 0;
+    }
+    if (arena_size > HEAP_ARENA_SIZE || arena_size < HEAP_MIN_CHUNK || (int)heap_policy < 0 || heap_policy >= HEAP_N_POLICIES)
+    {
+        HEAP_UNLOCK();
+        printf("Error heap: Arena of %zu bytes is not between %d and HEAP_ARENA_SIZE %d bytes or unknown policy\n", arena_size,
+               HEAP_MIN_CHUNK, HEAP_ARENA_SIZE);
+        return 0;
+    }
+    policy = heap_policy;
+    heap_size = (uint32_t)(arena_size & ~(size_t)7);
+    for (int bin = 0; bin < HEAP_N_BINS; bin++)
+    {
+        free_lists[bin] = HEAP_NONE;
+    }
+    chunk(0)->prev_size = 0;
+    chunk(0)->size = heap_size;
+    insert_free(0);
+    peak_used_bytes = 0;
+    peak_fragmentation = 0;
+    min_largest_free = heap_size - HEAP_HEADER_SIZE;
+    failed_allocations = 0;
+    first_failed_size = 0;
+    first_failed_file = NULL;
+    first_failed_line = 0;
+    first_failed_function = NULL;
+    first_failed_largest_free = 0;
+    active = 1;
+    HEAP_UNLOCK();
+    return 1;
+}
+
+/* Sends new allocations back to the system allocator, blocks still in the arena can be freed later */
+void stop_heap_emulation(void)
+{
+    HEAP_LOCK();
+    active = 0;
+    HEAP_UNLOCK();
+}
+
+/* @return the block in the arena, NULL when the emulation is stopped or the allocation did not fit */
+void *heap_malloc(size_t size, const char *file, int line, const char *function)
+{
+    HEAP_LOCK();
+    if (!active)
+    {
+        HEAP_UNLOCK();
+        return NULL;
+    }
+    uint32_t offset = HEAP_NONE;
+    uint32_t need = 0;
+    if (size <= heap_size)
+    {
+        need = (uint32_t)((size + HEAP_HEADER_SIZE + 7) & ~(size_t)7);
+        need = need < HEAP_MIN_CHUNK ? HEAP_MIN_CHUNK : need;
+        offset = find_fit(need);
+    }
+    size_t largest, total;
+    if (offset == HEAP_NONE)
+    {
+        failed_allocations++;
+        if (first_failed_size == 0)
+        {
+            scan_free(&largest, &total);
+            first_failed_size = size;
+            first_failed_file = file;
+            first_failed_line = line;
+            first_failed_function = function;
+            first_failed_largest_free = largest;
+            printf("Error heap: %zu bytes at %s:%d (%s) do not fit, largest free block %zu of %zu free bytes\n", size, file, line,
+                   function, largest, total);
+        }
+        HEAP_UNLOCK();
+        return NULL;
+    }
+
+    remove_free(offset);
+    HeapChunk *c = chunk(offset);
+    if (c->size - need >= HEAP_MIN_CHUNK)
+    {
+        uint32_t rest = offset + need;
+        chunk(rest)->prev_size = need;
+        chunk(rest)->size = c->size - need;
+        if (rest + chunk(rest)->size < heap_size)
+        {
+            chunk(rest + chunk(rest)->size)->prev_size = chunk(rest)->size;
+        }
+        c->size = need;
+        insert_free(rest);
+    }
+    used_bytes += c->size;
+    c->size |= HEAP_IN_USE;
+
+    scan_free(&largest, &total);
+    if (largest < min_largest_free)
+    {
+        min_largest_free = largest;
+    }
+    if (used_bytes > peak_used_bytes)
+    {
+        peak_used_bytes = used_bytes;
+        peak_fragmentation = fragmentation(largest, total);
+    }
+    HEAP_UNLOCK();
+    return arena.bytes + offset + HEAP_HEADER_SIZE;
+}
+
+/* Frees a block of the arena and merges it with free neighbours.
+    @return 0 when ptr is not in the arena, so it belongs to the system allocator
+*/
+int heap_free(void *ptr)
+{
+    uintptr_t address = (uintptr_t)ptr;
+    if (address < (uintptr_t)arena.bytes + HEAP_HEADER_SIZE || address >= (uintptr_t)arena.bytes + HEAP_ARENA_SIZE)
+    {
+        return 0;
+    }
+    HEAP_LOCK();
+    uint32_t offset = (uint32_t)(address - (uintptr_t)arena.bytes - HEAP_HEADER_SIZE);
+    uint32_t size = chunk(offset)->size & ~HEAP_IN_USE;
+    used_bytes -= size;
+    uint32_t next = offset + size;
+    if (next < heap_size && !(chunk(next)->size & HEAP_IN_USE))
+    {
+        remove_free(next);
+        size += chunk(next)->size;
+    }
+    if (offset > 0)
+    {
+        uint32_t prev = offset - chunk(offset)->prev_size;
+        if (!(chunk(prev)->size & HEAP_IN_USE))
+        {
+            remove_free(prev);
+            size += chunk(prev)->size;
+            offset = prev;
+        }
+    }
+    chunk(offset)->size = size;
+    if (offset + size < heap_size)
+    {
+        chunk(offset + size)->prev_size = size;
+    }
+    insert_free(offset);
+    HEAP_UNLOCK();
+    return 1;
+}
+
+void get_heap_stats(HeapStats *stats)
+{
+    HEAP_LOCK();
+    memset(stats, 0, sizeof(HeapStats));
+    stats->arena_size = heap_size;
+    stats->used_bytes = used_bytes;
+    stats->peak_used_bytes = peak_used_bytes;
+    stats->peak_fragmentation = peak_fragmentation;
+    scan_free(&stats->largest_free_block, &stats->free_bytes);
+    stats->min_largest_free_block = min_largest_free;
+    stats->fragmentation = fragmentation(stats->largest_free_block, stats->free_bytes);
+    stats->failed_allocations = failed_allocations;
+    stats->first_failed_size = first_failed_size;
+    stats->first_failed_file = first_failed_file;
+    stats->first_failed_line = first_failed_line;
+    stats->first_failed_function = first_failed_function;
+    stats->first_failed_largest_free = first_failed_largest_free;
+    HEAP_UNLOCK();
+}
+
+void print_heap_report(void)
+{
+    HeapStats stats;
+    get_heap_stats(&stats);
+    printf("Heap emulation: %s, %zu byte arena\n", get_heap_policy_name(policy), stats.arena_size);
+    printf("Peak used: %zu bytes with headers, fragmentation %.3f at the peak\n", stats.peak_used_bytes, stats.peak_fragmentation);
+    printf("Smallest largest free block: %zu bytes\n", stats.min_largest_free_block);
+    printf("In use: %zu bytes, free: %zu bytes, largest free block: %zu bytes, fragmentation %.3f\n", stats.used_bytes,
+           stats.free_bytes, stats.largest_free_block, stats.fragmentation);
+    if (stats.failed_allocations == 0)
+    {
+        printf("Every allocation fit in the arena\n");
+        return;
+    }
+    printf("Failed allocations: %zu, first: %zu bytes at %s:%d (%s) with a largest free block of %zu bytes\n",
+           stats.failed_allocations, stats.first_failed_size, stats.first_failed_file, stats.first_failed_line,
+           stats.first_failed_function, stats.first_failed_largest_free);
+}
+
+const char *get_heap_policy_name(enum HeapPolicy heap_policy)
+{
+    switch (heap_policy)
+    {
+    case HEAP_FIRST_FIT:
+        return "first fit";
+    case HEAP_BEST_FIT:
+        return "best fit";
+    case HEAP_BINS:
+        return "bins";
+    default:
+        return "unknown";
+    }
+}
+#endif
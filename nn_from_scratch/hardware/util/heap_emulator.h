@@ -0,0 +1,44 @@
+#ifndef HEAP_EMULATOR_H
+#define HEAP_EMULATOR_H
+#include <stddef.h>
+
+/* Fixed-size heap of a microcontroller, enabled with ENABLE_HEAP_EMULATION on top of ENABLE_TRACK_MEMORY.
+   While the emulation is started the tracked allocators carve their blocks out of a static arena of HEAP_ARENA_SIZE bytes,
+   with the chunk layout of a 32-bit target: an 8 byte header, 8 byte alignment and 16 byte minimum chunks, coalesced on free.
+   An allocation that does not fit is recorded and served by the system allocator instead, so the run goes on and every
+   failure of a training mode shows up in one pass.
+*/
+enum HeapPolicy
+{
+    HEAP_FIRST_FIT, // lowest address that fits, like newlib-nano
+    HEAP_BEST_FIT,  // smallest chunk that fits
+    HEAP_BINS,      // exact bins below 512 bytes and power of two bins above, best fit in a bin, like newlib's dlmalloc
+    HEAP_N_POLICIES
+};
+
+typedef struct
+{
+    size_t arena_size;
+    size_t used_bytes; // chunks in use, with headers and padding
+    size_t peak_used_bytes;
+    float peak_fragmentation; // fragmentation when the peak was reached
+    size_t free_bytes;        // payload of the free chunks
+    size_t largest_free_block;
+    size_t min_largest_free_block; // the largest allocation that would have fit at any time
+    float fragmentation;           // 1 - largest free block / free bytes
+    size_t failed_allocations;
+    size_t first_failed_size; // the first allocation that did not fit, 0 when every allocation fit
+    const char *first_failed_file;
+    int first_failed_line;
+    const char *first_failed_function;
+    size_t first_failed_largest_free; // largest free block when it failed
+} HeapStats;
+
+int start_heap_emulation(size_t arena_size, enum HeapPolicy policy);
+void stop_heap_emulation(void);
+void *heap_malloc(size_t size, const char *file, int line, const char *function);
+int heap_free(void *ptr);
+void get_heap_stats(HeapStats *stats);
+void print_heap_report(void);
+const char *get_heap_policy_name(enum HeapPolicy policy);
+#endif
@@ -0,0 +1,45 @@
+#include <stdlib.h>
+#include "config.h"
+#include "inference_workspace.h"
+
+/* Number of floats needed for the workspace of a model, i.e. two buffers of the widest layer */
+int inference_workspace_size(Model *model)
+{
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (model->layers_size[i] > max_size)
+        {
+            max_size = model->layers_size[i];
+        }
+    }
+    return 2 * max_size;
+}
+
+/* Binds a caller-provided buffer of at least inference_workspace_size(model) floats to the workspace.
+    Useful on device, where the buffer can be statically allocated.
+*/
+void set_inference_workspace(InferenceWorkspace *workspace, Model *model, float *buffer)
+{
+    workspace->buffer_size = inference_workspace_size(model) / 2;
+    workspace->buffers[0] = buffer;
+    workspace->buffers[1] = buffer + workspace->buffer_size;
+    workspace->memory = NULL;
+}
+
+/* Allocates a workspace for a model, done once and reused for every prediction */
+InferenceWorkspace *allocate_inference_workspace(Model *model)
+{
+    InferenceWorkspace *workspace = (InferenceWorkspace *)malloc(sizeof(InferenceWorkspace));
+    float *buffer = (float *)malloc(inference_workspace_size(model) * sizeof(float));
+    set_inference_workspace(workspace, model, buffer);
+    workspace->memory = buffer;
+    return workspace;
+}
+
+/* Frees a workspace created by allocate_inference_workspace */
+void free_inference_workspace(InferenceWorkspace *workspace)
+{
+    free(workspace->memory);
+    free(workspace);
+}
@@ -0,0 +1,20 @@
+#ifndef INFERENCE_WORKSPACE_H
+#define INFERENCE_WORKSPACE_H
+#include "model_binding.h"
+
+/* Scratch memory for heap-free inference: two ping-pong buffers sized for the widest layer */
+typedef struct
+{
+    float *buffers[2];
+    int buffer_size;
+    float *memory; // owned memory, NULL when the buffer is provided by the caller
+} InferenceWorkspace;
+
+int inference_workspace_size(Model *model);
+
+InferenceWorkspace *allocate_inference_workspace(Model *model);
+void free_inference_workspace(InferenceWorkspace *workspace);
+
+void set_inference_workspace(InferenceWorkspace *workspace, Model *model, float *buffer);
+
+#endif
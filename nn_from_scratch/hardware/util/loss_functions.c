@@ -1,5 +1,7 @@
 #include <math.h>
 #include <stdio.h>
+#include "loss_functions.h"
+#include "fixed_prop.h"
 float MSE(float *predicted, float *actual, int size)
 {
     float error = 0.0;
@@ -22,3 +24,16 @@ float MSE_derivative(float *predicted, float *actual, int size)
     }
     return error / size;
 }
+/* fixed-point MSE_derivative of the activated net outputs, saturates instead of overflowing.
+    The outputs are activated on the fly, so the net inputs stay in place for the back propagation.
+*/
+fixed_t fixed_MSE_derivative(fixed_t *net_outputs, fixed_t *actual, int size, enum ActivationType activation)
+{
+    int32_t error = 0;
+    for (int i = 0; i < size; i++)
+    {
+        int32_t diff = (int32_t)fixed_activation(activation, net_outputs[i]) - actual[i];
+        error = fixed_acc_add(error, 2 * (diff < 0 ? -diff : diff));
+    }
+    return fixed_saturate(error / size);
+}
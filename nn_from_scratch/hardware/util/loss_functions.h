@@ -1,6 +1,9 @@
 
 #ifndef LOSS_FUNCTIONS_H
 #define LOSS_FUNCTIONS_H
+#include "fixed_point.h"
+#include "activation_functions.h"
 extern float MSE(float *predicted, float *actual, int size);
 extern float MSE_derivative(float *predicted, float *actual, int size);
+extern fixed_t fixed_MSE_derivative(fixed_t *net_outputs, fixed_t *actual, int size, enum ActivationType activation);
 #endif
\ No newline at end of file
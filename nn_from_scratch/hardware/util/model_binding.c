@@ -12,6 +12,10 @@ void setModel(Model *model, int n_layers, int input_size, int output_size, int *
     model->input_size = input_size;
     model->layers_activation = layers_activation;
     model->output_size = output_size;
+    model->weights_layout = INPUT_MAJOR;
+    model->packed_weights = NULL;
+    model->packed_memory = NULL;
+    model->layers_sparse = NULL;
 }
 
 /* Create Model and sets the model*/
@@ -24,8 +28,143 @@ Model *createAndSetModel(int n_layers, int input_size, int output_size, int *lay
     return model;
 }
 
+/* Create Model and sets the model, for weights that are already stored in the given layout (e.g. packed by the converter) */
+Model *createAndSetModelWithLayout(int n_layers, int input_size, int output_size, int *layers_size, float **layers_weights,
+                                   float **layers_biases, enum ActivationType *layers_activation, enum WeightLayout weights_layout)
+{
+    Model *model = createAndSetModel(n_layers, input_size, output_size, layers_size, layers_weights, layers_biases, layers_activation);
+    model->weights_layout = weights_layout;
+
+    return model;
+}
+
+/* Create Model from INPUT_MAJOR weights and repacks them into the OUTPUT_MAJOR_PACKED layout */
+Model *createAndSetPackedModel(int n_layers, int input_size, int output_size, int *layers_size, float **layers_weights,
+                               float **layers_biases, enum ActivationType *layers_activation)
+{
+    Model *model = createAndSetModel(n_layers, input_size, output_size, layers_size, layers_weights, layers_biases, layers_activation);
+    packModelWeights(model);
+
+    return model;
+}
+
+/* Copies the INPUT_MAJOR weights of a model into one aligned block in the OUTPUT_MAJOR_PACKED layout.
+    The model then points to the packed copy, the original weights are left untouched.
+*/
+void packModelWeights(Model *model)
+{
+    if (model->weights_layout == OUTPUT_MAJOR_PACKED)
+    {
+        return;
+    }
+
+    // every row is a multiple of FC_PACKED_WIDTH floats, so only the block itself has to be aligned
+    size_t total = 0;
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (getSparseLayer(model, i) == NULL)
+        {
+            total += (size_t)model->layers_size[i] * FC_PACKED_STRIDE(size);
+        }
+        size = model->layers_size[i];
+    }
+    model->packed_memory = malloc(total * sizeof(float) + FC_PACKED_ALIGNMENT);
+    float *block = (float *)(((uintptr_t)model->packed_memory + FC_PACKED_ALIGNMENT - 1) & ~(uintptr_t)(FC_PACKED_ALIGNMENT - 1));
+    model->packed_weights = (float **)malloc(model->n_layers * sizeof(float *));
+
+    size = model->input_size;
+    for (int l = 0; l < model->n_layers; l++)
+    {
+        int out_size = model->layers_size[l];
+        int stride = FC_PACKED_STRIDE(size);
+        float *weights = model->layers_weights[l];
+        if (getSparseLayer(model, l) != NULL) // compressed rows are the same in both layouts
+        {
+            model->packed_weights[l] = weights;
+            size = out_size;
+            continue;
+        }
+        for (int i = 0; i < out_size; i++)
+        {
+            for (int j = 0; j < stride; j++)
+            {
+                block[i * stride + j] = (j < size) ? weights[i + j * out_size] : 0;
+            }
+        }
+        model->packed_weights[l] = block;
+        block += out_size * stride;
+        size = out_size;
+    }
+    model->layers_weights = model->packed_weights;
+    model->weights_layout = OUTPUT_MAJOR_PACKED;
+}
+
+/* Binds the CSR structure of the pruned layers to a model, their weights have to hold the stored values only.
+    @param layers_sparse: n_layers entries, row_offsets is NULL for the layers that stay dense
+    Has to be called before packModelWeights, which then keeps the sparse layers as they are.
+    @return 1 on success, 0 with the model left dense when a layer does not fit its sizes
+*/
+int setSparseLayers(Model *model, SparseLayer *layers_sparse)
+{
+    if (model->packed_memory != NULL)
+    {
+        printf("Error: Sparse layers have to be set before packing the weights, the model stays dense\n");
+        return 0;
+    }
+    int size = model->input_size;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        SparseLayer *sparse = &layers_sparse[i];
+        if (sparse->row_offsets != NULL)
+        {
+            int valid = sparse->row_offsets[0] == 0 && sparse->row_offsets[model->layers_size[i]] == sparse->nnz;
+            for (int j = 0; j < model->layers_size[i] && valid; j++)
+            {
+                valid = sparse->row_offsets[j] <= sparse->row_offsets[j + 1];
+            }
+            for (int k = 0; k < sparse->nnz && valid; k++)
+            {
+                valid = sparse->columns[k] < size;
+            }
+            if (!valid)
+            {
+                printf("Error: Sparse layer %d does not match its sizes, the model stays dense\n", i);
+                return 0;
+            }
+        }
+        size = model->layers_size[i];
+    }
+    model->layers_sparse = layers_sparse;
+    return 1;
+}
+
+/* @return the CSR structure of a layer, NULL when it is dense */
+SparseLayer *getSparseLayer(Model *model, int layer)
+{
+    if (model->layers_sparse == NULL || model->layers_sparse[layer].row_offsets == NULL)
+    {
+        return NULL;
+    }
+    return &model->layers_sparse[layer];
+}
+
+/* Number of stored weights of a layer, with the padding of packed rows and only the kept weights of sparse layers */
+int getLayerWeightsCount(Model *model, int layer)
+{
+    SparseLayer *sparse = getSparseLayer(model, layer);
+    if (sparse != NULL)
+    {
+        return sparse->nnz;
+    }
+    int prev_size = (layer == 0) ? model->input_size : model->layers_size[layer - 1];
+    return model->layers_size[layer] * ((model->weights_layout == OUTPUT_MAJOR_PACKED) ? FC_PACKED_STRIDE(prev_size) : prev_size);
+}
+
 /* Frees a model, should especially be used when tracking memory. As the model binding is excluded from memory tracking */
 void freeModel(Model *model)
 {
+    free(model->packed_weights);
+    free(model->packed_memory);
     free(model);
 }
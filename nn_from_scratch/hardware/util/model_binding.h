@@ -1,7 +1,20 @@
 #ifndef MODEL_BINDING_H
 #define MODEL_BINDING_H
 #include "activation_functions.h"
+#include "weight_layout.h"
 #include <stdint.h>
+
+/* Compressed sparse rows of a pruned layer, one row per neuron. The weights of a sparse layer hold only its nnz stored
+   values, neuron i owns weights[row_offsets[i]] up to weights[row_offsets[i + 1]] with their inputs in columns.
+   The rows are the same in both weight layouts.
+*/
+typedef struct
+{
+    int nnz;
+    int *row_offsets; // layer_size + 1 offsets, NULL for a dense layer
+    uint16_t *columns;
+} SparseLayer;
+
 typedef struct
 {
     int n_layers;
@@ -11,6 +24,10 @@ typedef struct
     float **layers_weights;
     float **layers_biases;
     enum ActivationType *layers_activation;
+    enum WeightLayout weights_layout;
+    float **packed_weights; // owned layer pointers into packed_memory, NULL if weights are not repacked
+    void *packed_memory;    // owned unaligned allocation backing the packed weights
+    SparseLayer *layers_sparse; // CSR structure of every layer, NULL when all layers are dense
 } Model;
 
 void setModel(Model *model, int n_layers, int input_size, int output_size, int *layers_size, float **layers_weights,
@@ -19,6 +36,18 @@ void setModel(Model *model, int n_layers, int input_size, int output_size, int *
 Model *createAndSetModel(int n_layers, int input_size, int output_size, int *layers_size, float **layers_weights,
                          float **layers_biases, enum ActivationType *layers_activation);
 
+Model *createAndSetModelWithLayout(int n_layers, int input_size, int output_size, int *layers_size, float **layers_weights,
+                                   float **layers_biases, enum ActivationType *layers_activation, enum WeightLayout weights_layout);
+
+Model *createAndSetPackedModel(int n_layers, int input_size, int output_size, int *layers_size, float **layers_weights,
+                               float **layers_biases, enum ActivationType *layers_activation);
+
+void packModelWeights(Model *model);
+
+int setSparseLayers(Model *model, SparseLayer *layers_sparse);
+SparseLayer *getSparseLayer(Model *model, int layer);
+int getLayerWeightsCount(Model *model, int layer);
+
 void freeModel(Model *model);
 
 #endif
@@ -0,0 +1,244 @@
+#define _POSIX_C_SOURCE 200809L
+#include "model_file.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MODEL_FILE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static int check_array(const ModelFile *file, const ModelFileHeader *header, uint64_t offset, uint64_t n_floats, int layer)
+{
+    if (offset % header->alignment != 0 || offset > file->size || n_floats * sizeof(float) > file->size - offset)
+    {
+        printf("Error model file: layer %d points outside the file or is misaligned\n", layer);
+        return -1;
+    }
+    return 0;
+}
+
+/* Checks the header and layer table of the file contents in data and binds file->model to them.
+    The weights and biases are used in place, only the small layer tables of the Model are allocated.
+    data has to be aligned to the file's alignment (a mapping is page aligned) and stay valid while the model is used.
+    Returns 0 on success, -1 if the contents are not a model file this build can use.
+*/
+int bindModelFile(ModelFile *file, void *data, size_t size)
+{
+    file->data = data;
+    file->size = size;
+    file->mapped = 0;
+    file->owned = NULL;
+    file->tables = NULL;
+    file->model.packed_weights = NULL;
+    file->model.packed_memory = NULL;
+
+    const ModelFileHeader *header = (const ModelFileHeader *)data;
+    if (size < sizeof(ModelFileHeader) || memcmp(header->magic, MODEL_FILE_MAGIC, 4) != 0)
+    {
+        printf("Error model file: not a model file\n");
+        return -1;
+    }
+    if (header->version != MODEL_FILE_VERSION || header->byte_order != MODEL_FILE_BYTE_ORDER)
+    {
+        printf("Error model file: unsupported version %u or byte order\n", (unsigned)header->version);
+        return -1;
+    }
+    if (header->file_size != size || header->n_layers == 0 ||
+        header->header_size < sizeof(ModelFileHeader) + header->n_layers * sizeof(ModelFileLayer) || header->header_size > size)
+    {
+        printf("Error model file: truncated or inconsistent header\n");
+        return -1;
+    }
+    if (header->weights_layout != INPUT_MAJOR && header->weights_layout != OUTPUT_MAJOR_PACKED)
+    {
+        printf("Error model file: unknown weights layout %u\n", (unsigned)header->weights_layout);
+        return -1;
+    }
+    if (header->alignment == 0 || header->alignment % sizeof(float) != 0)
+    {
+        printf("Error model file: invalid alignment %u\n", (unsigned)header->alignment);
+        return -1;
+    }
+    if (header->weights_layout == OUTPUT_MAJOR_PACKED &&
+        (header->packed_width != FC_PACKED_WIDTH || header->alignment % FC_PACKED_ALIGNMENT != 0 ||
+         (uintptr_t)data % FC_PACKED_ALIGNMENT != 0))
+    {
+        printf("Error model file: packed weights do not match FC_PACKED_WIDTH %d and FC_PACKED_ALIGNMENT %d\n", FC_PACKED_WIDTH, FC_PACKED_ALIGNMENT);
+        return -1;
+    }
+
+    int n_layers = (int)header->n_layers;
+    const ModelFileLayer *layers = (const ModelFileLayer *)((const char *)data + sizeof(ModelFileHeader));
+    uint64_t prev_size = header->input_size;
+    for (int i = 0; i < n_layers; i++)
+    {
+        uint64_t row = (header->weights_layout == OUTPUT_MAJOR_PACKED) ? (uint64_t)FC_PACKED_STRIDE(prev_size) : prev_size;
+        if (layers[i].size == 0 ||
+            check_array(file, header, layers[i].weights_offset, row * layers[i].size, i) != 0 ||
+            check_array(file, header, layers[i].biases_offset, layers[i].size, i) != 0)
+        {
+            printf("Error model file: invalid layer %d\n", i);
+            return -1;
+        }
+        prev_size = layers[i].size;
+    }
+    if (prev_size != header->output_size)
+    {
+        printf("Error model file: output size %u does not match the last layer\n", (unsigned)header->output_size);
+        return -1;
+    }
+
+    // sizes and activations are converted to the C types, the weights and biases stay in the file
+    size_t pointers_size = 2 * n_layers * sizeof(float *);
+    file->tables = malloc(pointers_size + n_layers * (sizeof(int) + sizeof(enum ActivationType)));
+    float **layers_weights = (float **)file->tables;
+    float **layers_biases = layers_weights + n_layers;
+    int *layers_size = (int *)((char *)file->tables + pointers_size);
+    enum ActivationType *layers_activation = (enum ActivationType *)(layers_size + n_layers);
+    for (int i = 0; i < n_layers; i++)
+    {
+        layers_weights[i] = (float *)((char *)data + layers[i].weights_offset);
+        layers_biases[i] = (float *)((char *)data + layers[i].biases_offset);
+        layers_size[i] = (int)layers[i].size;
+        layers_activation[i] = (enum ActivationType)layers[i].activation;
+    }
+    setModel(&file->model, n_layers, (int)header->input_size, (int)header->output_size, layers_size, layers_weights,
+             layers_biases, layers_activation);
+    file->model.weights_layout = (enum WeightLayout)header->weights_layout;
+    return 0;
+}
+
+#ifdef MODEL_FILE_MMAP
+static void *map_file(const char *path, enum ModelFileMode mode, size_t *size)
+{
+    int fd = open(path, mode == MODEL_FILE_WRITE_BACK ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Error model file: could not open %s\n", path);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        printf("Error model file: could not stat %s\n", path);
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+
+    int prot = (mode == MODEL_FILE_READ_ONLY) ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = (mode == MODEL_FILE_PRIVATE) ? MAP_PRIVATE : MAP_SHARED;
+    void *data = mmap(NULL, *size, prot, flags, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    if (data == MAP_FAILED)
+    {
+        printf("Error model file: could not map %s\n", path);
+        return NULL;
+    }
+    return data;
+}
+#else
+/* Reads the whole file into an allocation aligned to FC_PACKED_ALIGNMENT, for platforms without mmap */
+static void *read_file(const char *path, void **owned, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        printf("Error model file: could not open %s\n", path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (length <= 0)
+    {
+        printf("Error model file: could not read %s\n", path);
+        fclose(f);
+        return NULL;
+    }
+    *size = (size_t)length;
+    *owned = malloc(*size + FC_PACKED_ALIGNMENT);
+    void *data = (void *)(((uintptr_t)*owned + FC_PACKED_ALIGNMENT - 1) & ~(uintptr_t)(FC_PACKED_ALIGNMENT - 1));
+    size_t n_read = fread(data, 1, *size, f);
+    fclose(f);
+    if (n_read != *size)
+    {
+        printf("Error model file: could not read %s\n", path);
+        free(*owned);
+        *owned = NULL;
+        return NULL;
+    }
+    return data;
+}
+#endif
+
+/* Opens a model file written by model_converter.py --binary, the weights of the returned file->model point into
+    a mapping of the file so opening does not depend on the model size. Without mmap the file is read into memory
+    and MODEL_FILE_WRITE_BACK falls back to a private copy. Returns NULL on error.
+*/
+ModelFile *openModelFile(const char *path, enum ModelFileMode mode)
+{
+    size_t size = 0;
+    void *owned = NULL;
+    void *data = NULL;
+    int mapped = 0;
+#ifdef MODEL_FILE_MMAP
+    data = map_file(path, mode, &size);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    mapped = 1;
+#else
+    if (mode == MODEL_FILE_WRITE_BACK)
+    {
+        printf("Error model file: writing back needs mmap, opening a private copy of %s\n", path);
+    }
+    data = read_file(path, &owned, &size);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+#endif
+
+    ModelFile *file = (ModelFile *)malloc(sizeof(ModelFile));
+    if (bindModelFile(file, data, size) != 0)
+    {
+        file->mapped = mapped;
+        file->owned = owned;
+        closeModelFile(file);
+        return NULL;
+    }
+    file->mapped = mapped;
+    file->owned = owned;
+    return file;
+}
+
+/* Frees what a model file owns without freeing the ModelFile itself, for files set up with bindModelFile */
+void releaseModelFile(ModelFile *file)
+{
+#ifdef MODEL_FILE_MMAP
+    if (file->mapped)
+    {
+        munmap(file->data, file->size); // shared writable mappings are written back by the kernel
+    }
+#endif
+    free(file->owned);
+    free(file->tables);
+    free(file->model.packed_weights);
+    free(file->model.packed_memory);
+    file->data = NULL;
+    file->owned = NULL;
+    file->tables = NULL;
+}
+
+void closeModelFile(ModelFile *file)
+{
+    releaseModelFile(file);
+    free(file);
+}
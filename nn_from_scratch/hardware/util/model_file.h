@@ -0,0 +1,64 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+#include "model_binding.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Binary model file written by model_converter.py --binary, little endian:
+   a ModelFileHeader, one ModelFileLayer per layer, then the weights and biases of every layer as float arrays.
+   Each array starts at a multiple of the header's alignment, so a mapping of the file can be used by the
+   kernels in place and loading costs no parsing or copying of the weights.
+*/
+#define MODEL_FILE_MAGIC "NNFC"
+#define MODEL_FILE_VERSION 1
+#define MODEL_FILE_BYTE_ORDER 0x01020304u
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order; // MODEL_FILE_BYTE_ORDER as written, catches files from a machine with another endianness
+    uint32_t header_size; // header and layer table in bytes
+    uint32_t n_layers;
+    uint32_t input_size;
+    uint32_t output_size;
+    uint32_t weights_layout; // enum WeightLayout
+    uint32_t packed_width;   // row padding of OUTPUT_MAJOR_PACKED weights, has to match FC_PACKED_WIDTH
+    uint32_t alignment;      // in bytes, of every weight and bias array
+    uint64_t file_size;
+} ModelFileHeader;
+
+typedef struct
+{
+    uint32_t size;
+    uint32_t activation; // enum ActivationType
+    uint64_t weights_offset;
+    uint64_t biases_offset;
+} ModelFileLayer;
+
+enum ModelFileMode
+{
+    MODEL_FILE_READ_ONLY,  // shared read-only mapping for inference, processes serving the same file share its pages
+    MODEL_FILE_PRIVATE,    // copy-on-write mapping, training only copies the pages it changes
+    MODEL_FILE_WRITE_BACK  // shared writable mapping, training updates end up in the file
+};
+
+typedef struct
+{
+    Model model;
+    void *data;  // file contents the weights and biases point into
+    size_t size;
+    int mapped;  // 1 if data is a mapping of the file, 0 if it was read into memory or bound by the caller
+    void *owned; // owned allocation of the read contents, NULL if mapped or bound
+    void *tables; // owned allocation of the layer sizes, activations and pointers of the model
+} ModelFile;
+
+int bindModelFile(ModelFile *file, void *data, size_t size);
+
+ModelFile *openModelFile(const char *path, enum ModelFileMode mode);
+
+void releaseModelFile(ModelFile *file);
+
+void closeModelFile(ModelFile *file);
+
+#endif
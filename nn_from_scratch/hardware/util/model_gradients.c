@@ -1,73 +1,413 @@
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
 #include "config.h"
 #include "model_gradients.h"
+
+static int max_layer_size(Model *model)
+{
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (model->layers_size[i] > max_size)
+        {
+            max_size = model->layers_size[i];
+        }
+    }
+    return max_size;
+}
+
+/* Number of bytes needed for the gradients of a model, see set_gradients */
+size_t gradients_memory_size(Model *model)
+{
+    return checkpointed_gradients_memory_size(model, 1);
+}
+
+/* Binds a caller-provided block of at least gradients_memory_size(model) bytes to the gradients and clears them.
+    The block must be aligned for pointers, as returned by malloc.
+*/
+void set_gradients(Gradients *gradients, Model *model, void *buffer)
+{
+    set_checkpointed_gradients(gradients, model, 1, buffer);
+}
+
 Gradients *allocate_gradients(Model *model)
 {
-    Gradients *gradients = (Gradients *)malloc(sizeof(Gradients));
+    return allocate_checkpointed_gradients(model, 1);
+}
+
+static int checkpoint_layer(Model *model, int interval, int layer)
+{
+    return (layer + 1) % interval == 0 || layer == model->n_layers - 1;
+}
+
+/* 1 when the layer keeps its net inputs and activations through back propagation */
+int is_checkpoint_layer(Gradients *gradients, Model *model, int layer)
+{
+    return checkpoint_layer(model, gradients->checkpoint_interval, layer);
+}
 
-    gradients->biases = (float **)malloc(model->n_layers * sizeof(float *));
-    gradients->weights = (float **)malloc(model->n_layers * sizeof(float *));
-    gradients->net_inputs = (float **)malloc(model->n_layers * sizeof(float *));
+/* First layer recomputed before back propagating through a layer, the layer itself when nothing is recomputed.
+    The segment below a checkpoint is recomputed from the checkpoint before it, unless no layer above shares the scratch
+    segment: the forward pass leaves the last segment it wrote in place.
+*/
+int checkpoint_recompute_from(Gradients *gradients, Model *model, int layer)
+{
+    // a checkpoint below the second to last layer has a non-checkpoint layer right above it
+    if (layer >= model->n_layers - 2 || !is_checkpoint_layer(gradients, model, layer))
+    {
+        return layer;
+    }
+    return (layer / gradients->checkpoint_interval) * gradients->checkpoint_interval;
+}
 
+/* Number of bytes needed for the gradients when only every interval-th layer is checkpointed, see set_checkpointed_gradients */
+size_t checkpointed_gradients_memory_size(Model *model, int interval)
+{
+    size_t n_floats = 0;
+    size_t segment = 0;
+    size_t max_segment = 0;
     for (int i = 0; i < model->n_layers; i++)
     {
-        gradients->biases[i] = (float *)calloc(model->layers_size[i], sizeof(float));
-        gradients->net_inputs[i] = (float *)malloc(model->layers_size[i] * sizeof(float));
-        if (i == 0)
+        // weights and biases
+        n_floats += (size_t)getLayerWeightsCount(model, i) + model->layers_size[i];
+        // net inputs and activations, checkpoints own them and the layers between share the widest segment
+        if (checkpoint_layer(model, interval, i))
         {
-            gradients->weights[i] = (float *)calloc(model->layers_size[i] * model->input_size, sizeof(float));
+            n_floats += 2 * (size_t)model->layers_size[i];
+            segment = 0;
         }
         else
         {
-            gradients->weights[i] = (float *)calloc(model->layers_size[i] * model->layers_size[i - 1], sizeof(float));
+            segment += 2 * (size_t)model->layers_size[i];
+            max_segment = segment > max_segment ? segment : max_segment;
+        }
+    }
+    return 4 * model->n_layers * sizeof(float *) + (n_floats + max_segment) * sizeof(float);
+}
+
+/* Binds a caller-provided block of at least checkpointed_gradients_memory_size bytes to the gradients and clears them.
+    The block must be aligned for pointers, as returned by malloc.
+    @param interval: every interval-th layer and the output layer keep their activations, 1 keeps all of them
+*/
+void set_checkpointed_gradients(Gradients *gradients, Model *model, int interval, void *buffer)
+{
+    float **pointers = (float **)buffer;
+    gradients->weights = pointers;
+    gradients->biases = pointers + model->n_layers;
+    gradients->net_inputs = pointers + 2 * model->n_layers;
+    gradients->activations = pointers + 3 * model->n_layers;
+
+    float *data = (float *)(pointers + 4 * model->n_layers);
+    gradients->params = data;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        gradients->weights[i] = data;
+        data += getLayerWeightsCount(model, i);
+    }
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        gradients->biases[i] = data;
+        data += model->layers_size[i];
+    }
+    gradients->n_params = (int)(data - gradients->params);
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (checkpoint_layer(model, interval, i))
+        {
+            gradients->net_inputs[i] = data;
+            gradients->activations[i] = data + model->layers_size[i];
+            data += 2 * model->layers_size[i];
+        }
+    }
+    float *segment = data;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (checkpoint_layer(model, interval, i))
+        {
+            segment = data;
+            continue;
         }
+        gradients->net_inputs[i] = segment;
+        gradients->activations[i] = segment + model->layers_size[i];
+        segment += 2 * model->layers_size[i];
     }
+    gradients->checkpoint_interval = interval;
+    gradients->memory = NULL;
+    clear_gradients(gradients);
+}
 
+Gradients *allocate_checkpointed_gradients(Model *model, int interval)
+{
+    Gradients *gradients = (Gradients *)malloc(sizeof(Gradients));
+    void *buffer = malloc(checkpointed_gradients_memory_size(model, interval));
+    set_checkpointed_gradients(gradients, model, interval, buffer);
+    gradients->memory = buffer;
     return gradients;
 }
-/* Free's allocated memory for gradient*/
-void free_gradients(Gradients *gradients, Model *model)
+
+/* Smallest checkpoint interval, so the least recomputation, whose gradients fit in budget bytes.
+    @return the interval, or the one needing the least memory when none fits
+*/
+int checkpoint_interval_for_budget(Model *model, size_t budget)
+{
+    int best = 1;
+    for (int interval = 1; interval <= model->n_layers; interval++)
+    {
+        size_t size = checkpointed_gradients_memory_size(model, interval);
+        if (size <= budget)
+        {
+            return interval;
+        }
+        if (size < checkpointed_gradients_memory_size(model, best))
+        {
+            best = interval;
+        }
+    }
+    return best;
+}
+
+/* Zeroes the weight and bias gradients before a new batch */
+void clear_gradients(Gradients *gradients)
 {
+    memset(gradients->params, 0, gradients->n_params * sizeof(float));
+}
 
-    for (int i = 0; i < model->n_layers; i++)
+/* Free's allocated memory for gradient*/
+void free_gradients(Gradients *gradients)
+{
+    if (gradients->memory != NULL)
     {
-        free(gradients->biases[i]);
-        free(gradients->weights[i]);
-        free(gradients->net_inputs[i]);
+        free(gradients->memory);
     }
-    free(gradients->biases);
-    free(gradients->weights);
-    free(gradients->net_inputs);
     free(gradients);
 }
 
+/* Number of bytes needed for the partial gradients when training n_neurons weights of every neuron in target_layer */
+size_t partial_gradients_memory_size(Model *model, int target_layer, int n_neurons)
+{
+    return top_k_partial_gradients_memory_size(model, target_layer, n_neurons, 0);
+}
+
+/* Binds a caller-provided block of at least partial_gradients_memory_size bytes to the partial gradients and clears them.
+    The block must be aligned for pointers, as returned by malloc.
+*/
+void set_partial_gradients(PartialGradients *gradients, Model *model, int target_layer, int n_neurons, void *buffer)
+{
+    set_top_k_partial_gradients(gradients, model, target_layer, n_neurons, 0, buffer);
+}
+
 PartialGradients *allocate_partial_gradients(Model *model, int target_layer, int n_neurons)
 {
-    PartialGradients *gradients = (PartialGradients *)malloc(sizeof(PartialGradients));
+    return allocate_top_k_partial_gradients(model, target_layer, n_neurons, 0);
+}
+
+/* Bytes of the partial gradients of top-k updates, the residuals of the error feedback and the selected indices come on top.
+    @param top_k: parameters written per batch, 0 for the whole slice
+*/
+size_t top_k_partial_gradients_memory_size(Model *model, int target_layer, int n_neurons, int top_k)
+{
+    int n_masks = model->n_layers - target_layer;
+    size_t n_params = (size_t)model->layers_size[target_layer] * (n_neurons + 1);
+    size_t n_floats = n_params + n_neurons + 3 * max_layer_size(model);
+    size_t n_words = 0;
+    for (int i = target_layer; i < model->n_layers; i++)
+    {
+        n_words += DERIV_MASK_WORDS(model->layers_size[i]);
+    }
+    size_t size = n_masks * sizeof(uint32_t *) + n_floats * sizeof(float) + n_words * sizeof(uint32_t);
+    if (top_k > 0)
+    {
+        size += n_params * sizeof(float) + top_k * sizeof(int);
+    }
+    return size;
+}
 
-    gradients->biases = (float *)calloc(model->layers_size[target_layer], sizeof(float)); // biases updated for the targets and for prev layer
-    gradients->deriv_activations = (uint8_t **)malloc((model->n_layers - target_layer) * sizeof(uint8_t *));
-    gradients->weights = (float *)calloc(n_neurons * model->layers_size[target_layer], sizeof(float));
-    gradients->net_input = (float *)malloc(n_neurons * sizeof(float));
+/* Binds a caller-provided block of at least top_k_partial_gradients_memory_size bytes to the partial gradients,
+    clears them and zeroes the residuals.
+*/
+void set_top_k_partial_gradients(PartialGradients *gradients, Model *model, int target_layer, int n_neurons, int top_k, void *buffer)
+{
+    int n_masks = model->n_layers - target_layer;
+    gradients->deriv_activations = (uint32_t **)buffer;
+
+    float *data = (float *)(gradients->deriv_activations + n_masks);
+    gradients->weights = data;
+    data += n_neurons * model->layers_size[target_layer];
+    gradients->biases = data; // biases updated for the targets and for prev layer
+    data += model->layers_size[target_layer];
+    gradients->n_params = (int)(data - gradients->weights);
+    gradients->net_input = data;
+    data += n_neurons;
+    int max_size = max_layer_size(model);
+    for (int i = 0; i < 3; i++)
+    {
+        gradients->buffers[i] = data;
+        data += max_size;
+    }
 
     // neurons will be set when forward propagating
-    for (int i = 0; i < model->n_layers - target_layer; i++)
+    uint32_t *masks = (uint32_t *)data;
+    for (int i = 0; i < n_masks; i++)
     {
-        gradients->deriv_activations[i] = (uint8_t *)malloc(model->layers_size[i + target_layer] * sizeof(uint8_t));
+        gradients->deriv_activations[i] = masks;
+        masks += DERIV_MASK_WORDS(model->layers_size[i + target_layer]);
     }
 
+    gradients->top_k = top_k;
+    gradients->residuals = NULL;
+    gradients->selected = NULL;
+    if (top_k > 0)
+    {
+        gradients->residuals = (float *)masks;
+        memset(gradients->residuals, 0, gradients->n_params * sizeof(float));
+        gradients->selected = (int *)(gradients->residuals + gradients->n_params);
+    }
+    gradients->memory = NULL;
+    clear_partial_gradients(gradients);
+}
+
+PartialGradients *allocate_top_k_partial_gradients(Model *model, int target_layer, int n_neurons, int top_k)
+{
+    PartialGradients *gradients = (PartialGradients *)malloc(sizeof(PartialGradients));
+    void *buffer = malloc(top_k_partial_gradients_memory_size(model, target_layer, n_neurons, top_k));
+    set_top_k_partial_gradients(gradients, model, target_layer, n_neurons, top_k, buffer);
+    gradients->memory = buffer;
     return gradients;
 }
 
-void free_partial_gradients(PartialGradients *gradients, Model *model, int target_layer)
+/* Zeroes the weight and bias gradients before a new batch */
+void clear_partial_gradients(PartialGradients *gradients)
 {
-    free(gradients->biases);
-    free(gradients->weights);
-    for (int i = 0; i < model->n_layers - target_layer; i++)
+    memset(gradients->weights, 0, gradients->n_params * sizeof(float));
+}
+
+void free_partial_gradients(PartialGradients *gradients)
+{
+    if (gradients->memory != NULL)
     {
-        free(gradients->deriv_activations[i]);
+        free(gradients->memory);
     }
-    free(gradients->deriv_activations);
-    free(gradients->net_input);
     free(gradients);
-}
\ No newline at end of file
+}
+
+/* checks a freeze mask, at least one layer and only layers of the model have to be set
+    @return 1 when the mask is valid
+*/
+int check_trainable_layers(Model *model, uint32_t trainable_layers)
+{
+    if (model->n_layers > MAX_MASKED_LAYERS || trainable_layers == 0 ||
+        (model->n_layers < MAX_MASKED_LAYERS && (trainable_layers >> model->n_layers) != 0))
+    {
+        printf("Invalid freeze mask for masked training! \n");
+        return 0;
+    }
+    return 1;
+}
+
+static int first_trainable_layer(uint32_t trainable_layers)
+{
+    int layer = 0;
+    while (!(trainable_layers & LAYER_MASK(layer)))
+    {
+        layer++;
+    }
+    return layer;
+}
+
+/* Number of bytes needed for the gradients when only the layers set in trainable_layers are trained, see set_masked_gradients */
+size_t masked_gradients_memory_size(Model *model, uint32_t trainable_layers)
+{
+    int first = first_trainable_layer(trainable_layers);
+    size_t n_floats = 3 * (size_t)max_layer_size(model);
+    size_t n_words = 0;
+    for (int i = first; i < model->n_layers; i++)
+    {
+        if (trainable_layers & LAYER_MASK(i))
+        {
+            n_floats += (size_t)getLayerWeightsCount(model, i) + model->layers_size[i];
+            n_floats += (i > 0) ? model->layers_size[i - 1] : 0; // the first layer reads the sample in place
+        }
+        n_words += DERIV_MASK_WORDS(model->layers_size[i]);
+    }
+    return (3 * model->n_layers + model->n_layers - first) * sizeof(float *) + n_floats * sizeof(float) + n_words * sizeof(uint32_t);
+}
+
+/* Binds a caller-provided block of at least masked_gradients_memory_size bytes to the masked gradients and clears them.
+    The block must be aligned for pointers, as returned by malloc.
+*/
+void set_masked_gradients(MaskedGradients *gradients, Model *model, uint32_t trainable_layers, void *buffer)
+{
+    int first = first_trainable_layer(trainable_layers);
+    float **pointers = (float **)buffer;
+    gradients->weights = pointers;
+    gradients->biases = pointers + model->n_layers;
+    gradients->inputs = pointers + 2 * model->n_layers;
+    gradients->deriv_activations = (uint32_t **)(pointers + 3 * model->n_layers);
+
+    float *data = (float *)(gradients->deriv_activations + model->n_layers - first);
+    gradients->params = data;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        gradients->weights[i] = NULL;
+        gradients->biases[i] = NULL;
+        gradients->inputs[i] = NULL;
+        if (trainable_layers & LAYER_MASK(i))
+        {
+            gradients->weights[i] = data;
+            data += getLayerWeightsCount(model, i);
+            gradients->biases[i] = data;
+            data += model->layers_size[i];
+        }
+    }
+    gradients->n_params = (int)(data - gradients->params);
+    for (int i = 1; i < model->n_layers; i++)
+    {
+        if (trainable_layers & LAYER_MASK(i))
+        {
+            gradients->inputs[i] = data;
+            data += model->layers_size[i - 1];
+        }
+    }
+    int max_size = max_layer_size(model);
+    for (int i = 0; i < 3; i++)
+    {
+        gradients->buffers[i] = data;
+        data += max_size;
+    }
+
+    uint32_t *masks = (uint32_t *)data;
+    for (int i = first; i < model->n_layers; i++)
+    {
+        gradients->deriv_activations[i - first] = masks;
+        masks += DERIV_MASK_WORDS(model->layers_size[i]);
+    }
+    gradients->trainable_layers = trainable_layers;
+    gradients->first_trainable = first;
+    gradients->memory = NULL;
+    clear_masked_gradients(gradients);
+}
+
+MaskedGradients *allocate_masked_gradients(Model *model, uint32_t trainable_layers)
+{
+    MaskedGradients *gradients = (MaskedGradients *)malloc(sizeof(MaskedGradients));
+    void *buffer = malloc(masked_gradients_memory_size(model, trainable_layers));
+    set_masked_gradients(gradients, model, trainable_layers, buffer);
+    gradients->memory = buffer;
+    return gradients;
+}
+
+/* Zeroes the weight and bias gradients before a new batch */
+void clear_masked_gradients(MaskedGradients *gradients)
+{
+    memset(gradients->params, 0, gradients->n_params * sizeof(float));
+}
+
+void free_masked_gradients(MaskedGradients *gradients)
+{
+    if (gradients->memory != NULL)
+    {
+        free(gradients->memory);
+    }
+    free(gradients);
+}
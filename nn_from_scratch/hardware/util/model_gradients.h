@@ -1,28 +1,91 @@
-
 #ifndef MODEL_GRADIENTS_H
 #define MODEL_GRADIENTS_H
 #include "activation_functions.h"
 #include <stdint.h>
+#include <stddef.h>
 #include "model_binding.h"
+#include "deriv_mask.h"
+
+/* Gradients and scratch of the training paths. All arrays live in one memory block, with the
+   weight and bias gradients first so a batch is cleared with a single memset.
+   With a checkpoint interval k above 1 only every k-th layer and the output layer keep their net inputs and activations,
+   the layers in between share one scratch segment and fc_calc_gradients recomputes them from the checkpoint below during
+   back propagation. That trades at most one more forward pass per sample for activations that no longer grow with depth.
+*/
 typedef struct
 {
     float **weights;
     float **biases;
     float **net_inputs;
+    float **activations; // activations of net_inputs, cached by the forward pass
+    float *params;       // start of the weight and bias gradients
+    int n_params;
+    int checkpoint_interval; // 1 keeps the net inputs and activations of every layer
+    void *memory;            // owned memory, NULL when the block is provided by the caller
 } Gradients;
 
 typedef struct
 {
     float *weights;
     float *biases;
-    float *net_input;
-    uint8_t **deriv_activations;
+    float *net_input;             // cached activations feeding the trained weights
+    uint32_t **deriv_activations; // bit masks of the activation derivatives, see deriv_mask.h
+    float *buffers[3];            // scratch of the widest layer: activations and gradients ping-pong in two, net inputs in the third
+    int n_params;                 // weights and biases, starting at weights
+    int top_k;                    // parameters written per batch by top-k updates, 0 writes the whole slice
+    float *residuals;             // n_params summed gradients held back by top-k updates, kept across batches
+    int *selected;                // top_k indices of the parameters written in a batch
+    void *memory;
 } PartialGradients;
 
+/* Gradients of masked training, where only the layers set in a freeze mask are trained, see masked_model_fc.h.
+   Back propagation stops at the first trainable layer. Layers from there up keep the bit masks of their activation
+   derivatives, the trainable ones also keep the activations feeding them and get weight and bias gradients.
+   Frozen layers get no storage, the other activations ping-pong in the scratch buffers.
+*/
+typedef struct
+{
+    float **weights;              // per layer, NULL for frozen layers
+    float **biases;               // per layer, NULL for frozen layers
+    float **inputs;               // cached activations feeding each trainable layer, NULL for frozen layers and layer 0
+    uint32_t **deriv_activations; // bit masks of the activation derivatives from the first trainable layer up
+    float *buffers[3];            // scratch of the widest layer: activations and gradients ping-pong in two, net inputs in the third
+    float *params;                // start of the weight and bias gradients
+    int n_params;
+    uint32_t trainable_layers; // bit l set when layer l is trained
+    int first_trainable;
+    void *memory; // owned memory, NULL when the block is provided by the caller
+} MaskedGradients;
+
+#define LAYER_MASK(layer) (1u << (layer))
+#define MAX_MASKED_LAYERS 32
+
+size_t gradients_memory_size(Model *model);
+void set_gradients(Gradients *gradients, Model *model, void *buffer);
 Gradients *allocate_gradients(Model *model);
-void free_gradients(Gradients *gradients, Model *model);
+void clear_gradients(Gradients *gradients);
+void free_gradients(Gradients *gradients);
+size_t checkpointed_gradients_memory_size(Model *model, int interval);
+void set_checkpointed_gradients(Gradients *gradients, Model *model, int interval, void *buffer);
+Gradients *allocate_checkpointed_gradients(Model *model, int interval);
+int checkpoint_interval_for_budget(Model *model, size_t budget);
+int is_checkpoint_layer(Gradients *gradients, Model *model, int layer);
+int checkpoint_recompute_from(Gradients *gradients, Model *model, int layer);
 
+size_t partial_gradients_memory_size(Model *model, int target_layer, int n_neurons);
+void set_partial_gradients(PartialGradients *gradients, Model *model, int target_layer, int n_neurons, void *buffer);
 PartialGradients *allocate_partial_gradients(Model *model, int target_layer, int n_neurons);
-void free_partial_gradients(PartialGradients *gradients, Model *model, int target_layer);
+size_t top_k_partial_gradients_memory_size(Model *model, int target_layer, int n_neurons, int top_k);
+void set_top_k_partial_gradients(PartialGradients *gradients, Model *model, int target_layer, int n_neurons, int top_k, void *buffer);
+PartialGradients *allocate_top_k_partial_gradients(Model *model, int target_layer, int n_neurons, int top_k);
+void clear_partial_gradients(PartialGradients *gradients);
+void free_partial_gradients(PartialGradients *gradients);
+
+int check_trainable_layers(Model *model, uint32_t trainable_layers);
+size_t masked_gradients_memory_size(Model *model, uint32_t trainable_layers);
+void set_masked_gradients(MaskedGradients *gradients, Model *model, uint32_t trainable_layers, void *buffer);
+MaskedGradients *allocate_masked_gradients(Model *model, uint32_t trainable_layers);
+void clear_masked_gradients(MaskedGradients *gradients);
+void free_masked_gradients(MaskedGradients *gradients);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "config.h"
+#include "optimizer.h"
+
+/* Fused update kernels: one pass over the parameters, their summed batch gradients and the optimizer state.
+    @param optimizer: optimizer holding the hyperparameters
+    @param params: parameters to update
+    @param gradients: gradients summed over the batch
+    @param first_moments: first moment state of the parameters, unused by SGD
+    @param second_moments: second moment state of the parameters, ADAM only
+    @param n: number of parameters
+*/
+void optimizer_update_SGD(Optimizer *optimizer, float *params, float *gradients, float *first_moments, float *second_moments, int n)
+{
+    (void)first_moments;
+    (void)second_moments;
+    float step_size = optimizer->step_size;
+    for (int i = 0; i < n; i++)
+    {
+        params[i] -= step_size * (gradients[i] / BATCH_SIZE);
+    }
+}
+
+void optimizer_update_SGD_MOMENTUM(Optimizer *optimizer, float *params, float *gradients, float *first_moments, float *second_moments, int n)
+{
+    (void)second_moments;
+    float step_size = optimizer->step_size;
+    float momentum = optimizer->beta1;
+    for (int i = 0; i < n; i++)
+    {
+        float velocity = momentum * first_moments[i] - step_size * (gradients[i] / BATCH_SIZE);
+        first_moments[i] = velocity;
+        params[i] += velocity;
+    }
+}
+
+void optimizer_update_ADAM(Optimizer *optimizer, float *params, float *gradients, float *first_moments, float *second_moments, int n)
+{
+    float step_size = optimizer->step_size;
+    float beta1 = optimizer->beta1;
+    float beta2 = optimizer->beta2;
+    float epsilon = optimizer->epsilon;
+    for (int i = 0; i < n; i++)
+    {
+        float gradient = gradients[i] / BATCH_SIZE;
+        float m = beta1 * first_moments[i] + (1 - beta1) * gradient;
+        float v = beta2 * second_moments[i] + (1 - beta2) * gradient * gradient;
+        first_moments[i] = m;
+        second_moments[i] = v;
+        params[i] -= step_size * m / (sqrtf(v) + epsilon);
+    }
+}
+
+OptimizerUpdate get_optimizer_update_variant(enum OptimizerType optimizerType)
+{
+    switch (optimizerType)
+    {
+    case SGD:
+        return optimizer_update_SGD;
+    case SGD_MOMENTUM:
+        return optimizer_update_SGD_MOMENTUM;
+    case ADAM:
+        return optimizer_update_ADAM;
+    default:
+        printf("Error unknown optimizer type: defaulting to SGD\n");
+        return optimizer_update_SGD;
+    }
+}
+
+/* allocates the optimizer with zeroed state for groups of the given sizes */
+Optimizer *allocate_optimizer(enum OptimizerType type, int n_groups, int *groups_size)
+{
+    Optimizer *optimizer = (Optimizer *)malloc(sizeof(Optimizer));
+    optimizer->type = type;
+    optimizer->learning_rate = LEARNING_RATE;
+    optimizer->beta1 = OPTIMIZER_BETA1;
+    optimizer->beta2 = OPTIMIZER_BETA2;
+    optimizer->epsilon = OPTIMIZER_EPSILON;
+    optimizer->step = 0;
+    optimizer->step_size = LEARNING_RATE;
+    optimizer->n_groups = n_groups;
+    optimizer->groups_size = groups_size;
+    optimizer->first_moments = NULL;
+    optimizer->second_moments = NULL;
+
+    if (type == SGD_MOMENTUM || type == ADAM)
+    {
+        optimizer->first_moments = (float **)malloc(n_groups * sizeof(float *));
+        for (int i = 0; i < n_groups; i++)
+        {
+            optimizer->first_moments[i] = (float *)calloc(groups_size[i], sizeof(float));
+        }
+    }
+    if (type == ADAM)
+    {
+        optimizer->second_moments = (float **)malloc(n_groups * sizeof(float *));
+        for (int i = 0; i < n_groups; i++)
+        {
+            optimizer->second_moments[i] = (float *)calloc(groups_size[i], sizeof(float));
+        }
+    }
+    return optimizer;
+}
+
+/* Creates an optimizer for training the whole model, see fc_model_train */
+Optimizer *create_optimizer(Model *model, enum OptimizerType type)
+{
+    int *groups_size = (int *)malloc(2 * model->n_layers * sizeof(int));
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        // packed weights are updated with their padding, so the state is padded as well, sparse layers only keep their stored weights
+        groups_size[2 * i] = getLayerWeightsCount(model, i);
+        groups_size[2 * i + 1] = model->layers_size[i];
+    }
+    return allocate_optimizer(type, 2 * model->n_layers, groups_size);
+}
+
+/* Creates an optimizer for masked training, see fc_model_train_masked. It keeps the groups of the whole model,
+    but only the trainable layers get state.
+*/
+Optimizer *create_masked_optimizer(Model *model, enum OptimizerType type, uint32_t trainable_layers)
+{
+    int *groups_size = (int *)malloc(2 * model->n_layers * sizeof(int));
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        int trainable = (trainable_layers >> i) & 1u;
+        groups_size[2 * i] = trainable ? getLayerWeightsCount(model, i) : 0;
+        groups_size[2 * i + 1] = trainable ? model->layers_size[i] : 0;
+    }
+    return allocate_optimizer(type, 2 * model->n_layers, groups_size);
+}
+
+/* Creates an optimizer for training n_weights weights per neuron of the target layer, see fc_model_train_partial_layer.
+    Only the trained slice gets state.
+*/
+Optimizer *create_partial_optimizer(Model *model, enum OptimizerType type, int target_layer, int n_weights)
+{
+    int *groups_size = (int *)malloc(2 * sizeof(int));
+    groups_size[0] = model->layers_size[target_layer] * n_weights;
+    groups_size[1] = model->layers_size[target_layer];
+    return allocate_optimizer(type, 2, groups_size);
+}
+
+void free_optimizer(Optimizer *optimizer)
+{
+    if (optimizer->first_moments != NULL)
+    {
+        for (int i = 0; i < optimizer->n_groups; i++)
+        {
+            free(optimizer->first_moments[i]);
+        }
+        free(optimizer->first_moments);
+    }
+    if (optimizer->second_moments != NULL)
+    {
+        for (int i = 0; i < optimizer->n_groups; i++)
+        {
+            free(optimizer->second_moments[i]);
+        }
+        free(optimizer->second_moments);
+    }
+    free(optimizer->groups_size);
+    free(optimizer);
+}
+
+/* Plain SGD with LEARNING_RATE, used by the training functions when no optimizer is given.
+    Returned by value, so each call site steps its own copy and nothing is shared between calls or threads.
+*/
+Optimizer get_default_optimizer(void)
+{
+    Optimizer sgd = {SGD, LEARNING_RATE, 0, 0, 0, 0, LEARNING_RATE, 0, NULL, NULL, NULL};
+    return sgd;
+}
+
+/* Starts the update of a new batch, call once before the optimizer_update calls of the batch */
+void optimizer_next_step(Optimizer *optimizer)
+{
+    optimizer->step++;
+    optimizer->step_size = optimizer->learning_rate;
+    if (optimizer->type == ADAM)
+    {
+        optimizer->step_size *= sqrtf(1 - powf(optimizer->beta2, optimizer->step)) / (1 - powf(optimizer->beta1, optimizer->step));
+    }
+}
+
+/* Updates n parameters of a group, starting at offset within the group's state
+    @param optimizer: optimizer, its state has to cover the group
+    @param group: parameter group, see Optimizer
+    @param offset: index of params[0] within the group
+    @param params: parameters to update
+    @param gradients: gradients summed over the batch, same layout as params
+    @param n: number of parameters
+*/
+void optimizer_update(Optimizer *optimizer, int group, int offset, float *params, float *gradients, int n)
+{
+    float *first_moments = optimizer->first_moments != NULL ? optimizer->first_moments[group] + offset : NULL;
+    float *second_moments = optimizer->second_moments != NULL ? optimizer->second_moments[group] + offset : NULL;
+    OptimizerUpdate update = get_optimizer_update_variant(optimizer->type);
+    update(optimizer, params, gradients, first_moments, second_moments, n);
+}
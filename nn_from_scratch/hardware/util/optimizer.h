@@ -0,0 +1,45 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+#include "model_binding.h"
+
+enum OptimizerType
+{
+    SGD,
+    SGD_MOMENTUM,
+    ADAM
+};
+
+/* Optimizer with state for each trainable parameter.
+   Parameters are split in groups, for a whole model group 2 * l holds the weights and 2 * l + 1 the biases of layer l.
+   A partial optimizer only covers the trained slice: group 0 the weights and group 1 the biases of the target layer.
+   A masked optimizer keeps the groups of the whole model, with empty groups for the frozen layers.
+*/
+typedef struct
+{
+    enum OptimizerType type;
+    float learning_rate;
+    float beta1;     // momentum for SGD_MOMENTUM, first moment decay for ADAM
+    float beta2;     // second moment decay, ADAM only
+    float epsilon;   // ADAM only
+    int step;        // number of batches applied
+    float step_size; // learning rate of the current step, bias corrected for ADAM
+    int n_groups;
+    int *groups_size;
+    float **first_moments;  // velocity for SGD_MOMENTUM, per group, NULL for SGD
+    float **second_moments; // per group, ADAM only
+} Optimizer;
+
+typedef void (*OptimizerUpdate)(Optimizer *, float *, float *, float *, float *, int);
+
+Optimizer *create_optimizer(Model *model, enum OptimizerType type);
+Optimizer *create_partial_optimizer(Model *model, enum OptimizerType type, int target_layer, int n_weights);
+Optimizer *create_masked_optimizer(Model *model, enum OptimizerType type, uint32_t trainable_layers);
+void free_optimizer(Optimizer *optimizer);
+
+Optimizer get_default_optimizer(void);
+void optimizer_next_step(Optimizer *optimizer);
+void optimizer_update(Optimizer *optimizer, int group, int offset, float *params, float *gradients, int n);
+
+OptimizerUpdate get_optimizer_update_variant(enum OptimizerType optimizerType);
+
+#endif
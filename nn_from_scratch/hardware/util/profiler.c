@@ -0,0 +1,154 @@
+#define _POSIX_C_SOURCE 200809L
+#include "config.h"
+#ifdef ENABLE_PROFILING
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if !defined(PROFILE_DWT) && !defined(PROFILE_USE_CLOCK) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILE_RDTSC
+#endif
+
+#ifdef PROFILE_DWT
+#define PROFILE_DEMCR (*(volatile uint32_t *)0xE000EDFCu)
+#define PROFILE_DWT_CTRL (*(volatile uint32_t *)0xE0001000u)
+#define PROFILE_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004u)
+#endif
+
+static ProfileCounter counters[PROFILE_MAX_LAYERS][PROFILE_N_PHASES];
+
+static const char *phase_names[PROFILE_N_PHASES] = {"predict", "forward", "loss", "backward", "apply"};
+
+profile_tick_t profile_now(void)
+{
+#if defined(PROFILE_DWT)
+    return PROFILE_DWT_CYCCNT;
+#elif defined(PROFILE_RDTSC)
+    return __builtin_ia32_rdtsc();
+#elif defined(__unix__) || defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (profile_tick_t)ts.tv_sec * 1000000000u + (profile_tick_t)ts.tv_nsec;
+#else
+    return (profile_tick_t)clock();
+#endif
+}
+
+const char *profile_unit(void)
+{
+#if defined(PROFILE_DWT)
+    return "cycles";
+#elif defined(PROFILE_RDTSC)
+    return "tsc";
+#elif defined(__unix__) || defined(__APPLE__)
+    return "ns";
+#else
+    return "clock";
+#endif
+}
+
+/* Adds one call of a phase of a layer, layers beyond PROFILE_MAX_LAYERS are not recorded */
+void profile_record(int layer, enum ProfilePhase phase, profile_tick_t ticks, uint64_t macs, uint64_t bytes)
+{
+    if (layer < 0 || layer >= PROFILE_MAX_LAYERS)
+    {
+        return;
+    }
+    ProfileCounter *counter = &counters[layer][phase];
+    counter->calls++;
+    counter->ticks += ticks;
+    counter->macs += macs;
+    counter->bytes += bytes;
+}
+
+/* Clears all counters. On Cortex-M it also starts the DWT cycle counter, so call it once before profiling. */
+void profile_reset(void)
+{
+    memset(counters, 0, sizeof(counters));
+#ifdef PROFILE_DWT
+    PROFILE_DEMCR |= (1u << 24); // TRCENA
+    PROFILE_DWT_CYCCNT = 0;
+    PROFILE_DWT_CTRL |= 1u; // CYCCNTENA
+#endif
+}
+
+/* Counters of a phase of a layer, NULL when the layer is out of range */
+const ProfileCounter *profile_get(int layer, enum ProfilePhase phase)
+{
+    if (layer < 0 || layer >= PROFILE_MAX_LAYERS || (int)phase < 0 || (int)phase >= PROFILE_N_PHASES)
+    {
+        return NULL;
+    }
+    return &counters[layer][phase];
+}
+
+/* appends like snprintf, pos keeps counting past size so the needed length is known */
+static void append(char *buffer, size_t size, size_t *pos, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(*pos < size ? buffer + *pos : NULL, *pos < size ? size - *pos : 0, format, args);
+    va_end(args);
+    *pos += n > 0 ? (size_t)n : 0;
+}
+
+static void append_counter(char *buffer, size_t size, size_t *pos, const char *name, const ProfileCounter *counter)
+{
+    append(buffer, size, pos, "\"%s\": {\"calls\": %llu, \"ticks\": %llu, \"macs\": %llu, \"bytes\": %llu}", name,
+           (unsigned long long)counter->calls, (unsigned long long)counter->ticks, (unsigned long long)counter->macs,
+           (unsigned long long)counter->bytes);
+}
+
+/* Writes the per-layer breakdown as JSON into buffer, truncated to size bytes including the terminating 0.
+    Layers hold the phases they were called in, phases holds the totals of every phase over the layers.
+    @return the length of the whole JSON like snprintf, call with size 0 to get the size of the buffer
+*/
+int profile_to_json(char *buffer, size_t size)
+{
+    size_t pos = 0;
+    ProfileCounter totals[PROFILE_N_PHASES];
+    memset(totals, 0, sizeof(totals));
+    append(buffer, size, &pos, "{\"unit\": \"%s\", \"layers\": [", profile_unit());
+    int first_layer = 1;
+    for (int i = 0; i < PROFILE_MAX_LAYERS; i++)
+    {
+        int first_phase = 1;
+        for (int p = 0; p < PROFILE_N_PHASES; p++)
+        {
+            const ProfileCounter *counter = &counters[i][p];
+            if (counter->calls == 0)
+            {
+                continue;
+            }
+            if (first_phase)
+            {
+                append(buffer, size, &pos, "%s{\"layer\": %d, ", first_layer ? "" : ", ", i);
+                first_layer = 0;
+            }
+            else
+            {
+                append(buffer, size, &pos, ", ");
+            }
+            append_counter(buffer, size, &pos, phase_names[p], counter);
+            first_phase = 0;
+            totals[p].calls += counter->calls;
+            totals[p].ticks += counter->ticks;
+            totals[p].macs += counter->macs;
+            totals[p].bytes += counter->bytes;
+        }
+        if (!first_phase)
+        {
+            append(buffer, size, &pos, "}");
+        }
+    }
+    append(buffer, size, &pos, "], \"phases\": {");
+    for (int p = 0; p < PROFILE_N_PHASES; p++)
+    {
+        append(buffer, size, &pos, "%s", p == 0 ? "" : ", ");
+        append_counter(buffer, size, &pos, phase_names[p], &totals[p]);
+    }
+    append(buffer, size, &pos, "}}");
+    return (int)pos;
+}
+#endif
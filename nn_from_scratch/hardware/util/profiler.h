@@ -0,0 +1,59 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-layer profiling counters of the hot paths, enabled with ENABLE_PROFILING.
+   fc_model_predict, fc_model_predict_into, fc_calc_gradients, partial_calc_gradients and the apply functions time every
+   layer of every phase and count its multiply-accumulates and the bytes of weights, gradients and activations it has to
+   read and write at least. Without ENABLE_PROFILING the PROFILE_ macros expand to nothing.
+   Ticks are DWT CYCCNT cycles on Cortex-M, TSC ticks on x86 and nanoseconds elsewhere, see profile_unit.
+*/
+enum ProfilePhase
+{
+    PROFILE_PREDICT,
+    PROFILE_FORWARD,
+    PROFILE_LOSS, // recorded for the output layer
+    PROFILE_BACKWARD,
+    PROFILE_APPLY,
+    PROFILE_N_PHASES
+};
+
+#ifdef ENABLE_PROFILING
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__) || defined(__ARM_ARCH_8_1M_MAIN__)
+#define PROFILE_DWT
+typedef uint32_t profile_tick_t; // wraps, differences stay correct for intervals below 2^32 cycles
+#else
+typedef uint64_t profile_tick_t;
+#endif
+
+typedef struct
+{
+    uint64_t calls;
+    uint64_t ticks;
+    uint64_t macs;
+    uint64_t bytes;
+} ProfileCounter;
+
+profile_tick_t profile_now(void);
+void profile_record(int layer, enum ProfilePhase phase, profile_tick_t ticks, uint64_t macs, uint64_t bytes);
+void profile_reset(void);
+const ProfileCounter *profile_get(int layer, enum ProfilePhase phase);
+const char *profile_unit(void);
+int profile_to_json(char *buffer, size_t size);
+
+/* stored weights of a layer, including the padding of packed rows */
+#define PROFILE_FC_WEIGHTS(model, layer) ((uint64_t)getLayerWeightsCount(model, layer))
+/* multiply-accumulates of a layer with input_size inputs, only the stored weights of sparse layers */
+#define PROFILE_FC_MACS(model, layer, input_size) \
+    (getSparseLayer(model, layer) != NULL ? (uint64_t)getSparseLayer(model, layer)->nnz : (uint64_t)(model)->layers_size[layer] * (uint64_t)(input_size))
+
+#define PROFILE_BEGIN(start) profile_tick_t start = profile_now()
+#define PROFILE_END(start, layer, phase, macs, bytes) \
+    profile_record((layer), (phase), (profile_tick_t)(profile_now() - (start)), (uint64_t)(macs), (uint64_t)(bytes))
+#else
+#define PROFILE_BEGIN(start)
+#define PROFILE_END(start, layer, phase, macs, bytes)
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "quant_forward_prop.h"
+
+/* Rescales an int32 accumulator by multiplier * 2^-(31 + shift), rounding to nearest.
+    multiplier is a Q31 value in [0.5, 1), so only integer arithmetic is needed.
+*/
+int32_t fc_requantize(int32_t acc, int32_t multiplier, int32_t shift)
+{
+    int total_shift = 31 + shift;
+    int64_t product = (int64_t)acc * multiplier;
+    if (total_shift <= 0)
+    {
+        return (int32_t)(product << -total_shift);
+    }
+    int64_t rounding = (int64_t)1 << (total_shift - 1);
+    int64_t result = (product + rounding) >> total_shift;
+    if (result > INT32_MAX)
+    {
+        return INT32_MAX;
+    }
+    if (result < INT32_MIN)
+    {
+        return INT32_MIN;
+    }
+    return (int32_t)result;
+}
+
+/* int8 forward propagation, integer only
+    @param input: int8 input for the layer
+    @param weights: int8 weights for the layer (INPUT_MAJOR), zero point 0
+    @param biases: int32 biases in the scale of input * weights
+    @param input_size: size of the input for the layer
+    @param output_size: size of the output for the layer
+    @param input_zero_point: zero point of the input
+    @param output_zero_point: zero point of the output
+    @param multipliers: Q31 requantization multipliers, one per output channel if per_channel, else one
+    @param shifts: right shifts matching multipliers
+    @param per_channel: 1 if multipliers and shifts are per output channel
+    @param output: pointer to where the int8 output will be stored
+*/
+#define GENERATE_FC_FORWARD_PROP_Q_VARIANTS(act, func, func_deriv)                                                 \
+    void fc_forward_prop_q_##act(int8_t *input, int8_t *weights, int32_t *biases, int input_size, int output_size, \
+                                 int32_t input_zero_point, int32_t output_zero_point,                              \
+                                 int32_t *multipliers, int32_t *shifts, int per_channel, int8_t *output)           \
+    {                                                                                                              \
+        for (int i = 0; i < output_size; i++)                                                                      \
+        {                                                                                                          \
+            int32_t acc = biases[i];                                                                               \
+            for (int j = 0; j < input_size; j++)                                                                   \
+            {                                                                                                      \
+                acc += ((int32_t)input[j] - input_zero_point) * weights[i + j * output_size];                      \
+            }                                                                                                      \
+            int c = per_channel ? i : 0;                                                                           \
+            int32_t out = output_zero_point + fc_requantize(acc, multipliers[c], shifts[c]);                       \
+            out = act##_Q_MACRO(out, output_zero_point);                                                           \
+            out = out > INT8_MAX ? INT8_MAX : out;                                                                 \
+            out = out < INT8_MIN ? INT8_MIN : out;                                                                 \
+            output[i] = (int8_t)out;                                                                               \
+        }                                                                                                          \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_Q_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_forward_prop_q_##act;
+ForwardPropQ get_fc_forward_prop_q_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_forward_prop_q_LINEAR;
+    }
+}
+#undef X
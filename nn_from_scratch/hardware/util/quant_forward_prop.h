@@ -0,0 +1,20 @@
+#ifndef QUANT_FORWARD_PROP_H
+#define QUANT_FORWARD_PROP_H
+#include "activation_functions.h"
+#include <stdint.h>
+
+int32_t fc_requantize(int32_t acc, int32_t multiplier, int32_t shift);
+
+typedef void (*ForwardPropQ)(int8_t *, int8_t *, int32_t *, int, int, int32_t, int32_t, int32_t *, int32_t *, int, int8_t *);
+ForwardPropQ get_fc_forward_prop_q_variant(enum ActivationType activationType);
+
+#define GENERATE_FC_FORWARD_PROP_Q_PROTOTYPE_VARIANTS(act, func, func_deriv)                                       \
+    void fc_forward_prop_q_##act(int8_t *input, int8_t *weights, int32_t *biases, int input_size, int output_size, \
+                                 int32_t input_zero_point, int32_t output_zero_point,                              \
+                                 int32_t *multipliers, int32_t *shifts, int per_channel, int8_t *output);
+
+#define X(act, func, func_deriv) GENERATE_FC_FORWARD_PROP_Q_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#endif
@@ -0,0 +1,56 @@
+#include "quant_model_binding.h"
+#include <stdlib.h>
+
+/* binds values for a quantized model to a QuantModel */
+void setQuantModel(QuantModel *model, int n_layers, int input_size, int output_size, int *layers_size,
+                   int8_t **layers_weights, int32_t **layers_biases, int32_t **layers_multipliers, int32_t **layers_shifts,
+                   int *layers_per_channel, int32_t *zero_points, enum ActivationType *layers_activation,
+                   float input_scale, float output_scale)
+{
+    model->n_layers = n_layers;
+    model->input_size = input_size;
+    model->output_size = output_size;
+    model->layers_size = layers_size;
+    model->layers_weights = layers_weights;
+    model->layers_biases = layers_biases;
+    model->layers_multipliers = layers_multipliers;
+    model->layers_shifts = layers_shifts;
+    model->layers_per_channel = layers_per_channel;
+    model->zero_points = zero_points;
+    model->layers_activation = layers_activation;
+    model->input_scale = input_scale;
+    model->output_scale = output_scale;
+}
+
+/* Create QuantModel and sets the model*/
+QuantModel *createAndSetQuantModel(int n_layers, int input_size, int output_size, int *layers_size,
+                                   int8_t **layers_weights, int32_t **layers_biases, int32_t **layers_multipliers, int32_t **layers_shifts,
+                                   int *layers_per_channel, int32_t *zero_points, enum ActivationType *layers_activation,
+                                   float input_scale, float output_scale)
+{
+    QuantModel *model = (QuantModel *)malloc(sizeof(QuantModel));
+    setQuantModel(model, n_layers, input_size, output_size, layers_size, layers_weights, layers_biases, layers_multipliers,
+                  layers_shifts, layers_per_channel, zero_points, layers_activation, input_scale, output_scale);
+
+    return model;
+}
+
+/* Frees a quantized model, the bound arrays are not owned by it */
+void freeQuantModel(QuantModel *model)
+{
+    free(model);
+}
+
+/* Number of bytes needed for the inference workspace, two int8 buffers of the widest layer */
+int quant_workspace_size(QuantModel *model)
+{
+    int max_size = 0;
+    for (int i = 0; i < model->n_layers; i++)
+    {
+        if (model->layers_size[i] > max_size)
+        {
+            max_size = model->layers_size[i];
+        }
+    }
+    return 2 * max_size;
+}
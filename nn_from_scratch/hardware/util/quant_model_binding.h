@@ -0,0 +1,43 @@
+#ifndef QUANT_MODEL_BINDING_H
+#define QUANT_MODEL_BINDING_H
+#include "activation_functions.h"
+#include <stdint.h>
+
+/* int8 model, produced by quant_model_converter.py.
+   Weights are symmetric int8 in the INPUT_MAJOR layout, with one scale per layer or per output channel.
+   Activations are asymmetric int8: real = scale * (q - zero_point). Biases are int32 in the scale of
+   input * weights. Between layers the int32 accumulators are requantized with a Q31 multiplier and a
+   right shift, so inference needs no floating point.
+*/
+typedef struct
+{
+    int n_layers;
+    int input_size;
+    int output_size;
+    int *layers_size;
+    int8_t **layers_weights;
+    int32_t **layers_biases;
+    int32_t **layers_multipliers; // Q31 requantization multiplier, per channel or one per layer
+    int32_t **layers_shifts;      // right shift after the multiplier, same count as layers_multipliers
+    int *layers_per_channel;      // 1 if the layer has a multiplier per output channel
+    int32_t *zero_points;         // [0]: input zero point, [i + 1]: output zero point of layer i
+    enum ActivationType *layers_activation;
+    float input_scale;  // only used to quantize float inputs
+    float output_scale; // only used to dequantize to float outputs
+} QuantModel;
+
+void setQuantModel(QuantModel *model, int n_layers, int input_size, int output_size, int *layers_size,
+                   int8_t **layers_weights, int32_t **layers_biases, int32_t **layers_multipliers, int32_t **layers_shifts,
+                   int *layers_per_channel, int32_t *zero_points, enum ActivationType *layers_activation,
+                   float input_scale, float output_scale);
+
+QuantModel *createAndSetQuantModel(int n_layers, int input_size, int output_size, int *layers_size,
+                                   int8_t **layers_weights, int32_t **layers_biases, int32_t **layers_multipliers, int32_t **layers_shifts,
+                                   int *layers_per_channel, int32_t *zero_points, enum ActivationType *layers_activation,
+                                   float input_scale, float output_scale);
+
+void freeQuantModel(QuantModel *model);
+
+int quant_workspace_size(QuantModel *model);
+
+#endif
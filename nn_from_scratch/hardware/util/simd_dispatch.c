@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stddef.h>
+#include "simd_dispatch.h"
+
+static int simd_level_initialized = 0;
+static enum SimdLevel simd_level = SIMD_SCALAR;
+
+/* Best instruction set supported by this build and the CPU it runs on */
+enum SimdLevel get_best_simd_level(void)
+{
+#if defined(FC_SIMD_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return SIMD_SSE2;
+    }
+    return SIMD_SCALAR;
+#elif defined(FC_SIMD_HELIUM)
+    return SIMD_HELIUM;
+#elif defined(FC_SIMD_NEON)
+    return SIMD_NEON;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+/* Detects the active instruction set unless it is set already. The lazy detection in get_simd_level is not
+    thread-safe, so code starting threads that run kernels calls this first, see create_train_pool.
+*/
+void init_simd_level(void)
+{
+    if (!simd_level_initialized)
+    {
+        simd_level = get_best_simd_level();
+        simd_level_initialized = 1;
+    }
+}
+
+/* Active instruction set, detected on first use */
+enum SimdLevel get_simd_level(void)
+{
+    init_simd_level();
+    return simd_level;
+}
+
+/* Overrides the active instruction set, e.g. SIMD_SCALAR to run the reference kernels.
+    Levels above get_best_simd_level() are clamped to it.
+*/
+void set_simd_level(enum SimdLevel level)
+{
+    enum SimdLevel best = get_best_simd_level();
+    simd_level = (level > best) ? best : level;
+    simd_level_initialized = 1;
+}
+
+const char *get_simd_level_name(enum SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_SSE2:
+        return "SSE2";
+    case SIMD_AVX2:
+        return "AVX2";
+    case SIMD_AVX512:
+        return "AVX-512";
+    case SIMD_NEON:
+        return "NEON";
+    case SIMD_HELIUM:
+        return "Helium";
+    default:
+        return "scalar";
+    }
+}
+
+#define GENERATE_SIMD_DISPATCH(type, kernel)                             \
+    type get_##kernel##_simd_variant(enum ActivationType activationType) \
+    {                                                                    \
+        (void)activationType;                                            \
+        switch (get_simd_level())                                        \
+        {                                                                \
+            SIMD_DISPATCH_X86(kernel)                                    \
+            SIMD_DISPATCH_NEON(kernel)                                   \
+            SIMD_DISPATCH_HELIUM(kernel)                                 \
+        default:                                                         \
+            return NULL;                                                 \
+        }                                                                \
+    }
+
+#ifdef FC_SIMD_X86
+#define SIMD_DISPATCH_X86(kernel)                             \
+    case SIMD_AVX512:                                         \
+        return get_##kernel##_avx512_variant(activationType); \
+    case SIMD_AVX2:                                           \
+        return get_##kernel##_avx2_variant(activationType);   \
+    case SIMD_SSE2:                                           \
+        return get_##kernel##_sse2_variant(activationType);
+#else
+#define SIMD_DISPATCH_X86(kernel)
+#endif
+
+#ifdef FC_SIMD_NEON
+#define SIMD_DISPATCH_NEON(kernel) \
+    case SIMD_NEON:                \
+        return get_##kernel##_neon_variant(activationType);
+#else
+#define SIMD_DISPATCH_NEON(kernel)
+#endif
+
+#ifdef FC_SIMD_HELIUM
+#define SIMD_DISPATCH_HELIUM(kernel) \
+    case SIMD_HELIUM:                \
+        return get_##kernel##_helium_variant(activationType);
+#else
+#define SIMD_DISPATCH_HELIUM(kernel)
+#endif
+
+GENERATE_SIMD_DISPATCH(ForwardPropInto, fc_forward_prop_into)
+GENERATE_SIMD_DISPATCH(ForwardPropT, fc_forward_prop_t)
+GENERATE_SIMD_DISPATCH(BackProp, fc_back_prop)
+GENERATE_SIMD_DISPATCH(ForwardPropBatch, fc_forward_prop_batch)
+
+GENERATE_SIMD_DISPATCH(ForwardPropInto, fc_forward_prop_into_packed)
+GENERATE_SIMD_DISPATCH(ForwardPropT, fc_forward_prop_t_packed)
+GENERATE_SIMD_DISPATCH(BackProp, fc_back_prop_packed)
+GENERATE_SIMD_DISPATCH(ForwardPropBatch, fc_forward_prop_batch_packed)
+
+/* Kernels that do not depend on the activation, e.g. the cached specific back propagation */
+#define GENERATE_SIMD_KERNEL_DISPATCH(type, kernel) \
+    type get_##kernel##_simd_variant(void)          \
+    {                                               \
+        switch (get_simd_level())                   \
+        {                                           \
+            SIMD_KERNEL_DISPATCH_X86(kernel)        \
+            SIMD_KERNEL_DISPATCH_NEON(kernel)       \
+            SIMD_KERNEL_DISPATCH_HELIUM(kernel)     \
+        default:                                    \
+            return NULL;                            \
+        }                                           \
+    }
+
+#ifdef FC_SIMD_X86
+#define SIMD_KERNEL_DISPATCH_X86(kernel)        \
+    case SIMD_AVX512:                           \
+        return get_##kernel##_avx512_variant(); \
+    case SIMD_AVX2:                             \
+        return get_##kernel##_avx2_variant();   \
+    case SIMD_SSE2:                             \
+        return get_##kernel##_sse2_variant();
+#else
+#define SIMD_KERNEL_DISPATCH_X86(kernel)
+#endif
+
+#ifdef FC_SIMD_NEON
+#define SIMD_KERNEL_DISPATCH_NEON(kernel) \
+    case SIMD_NEON:                       \
+        return get_##kernel##_neon_variant();
+#else
+#define SIMD_KERNEL_DISPATCH_NEON(kernel)
+#endif
+
+#ifdef FC_SIMD_HELIUM
+#define SIMD_KERNEL_DISPATCH_HELIUM(kernel) \
+    case SIMD_HELIUM:                       \
+        return get_##kernel##_helium_variant();
+#else
+#define SIMD_KERNEL_DISPATCH_HELIUM(kernel)
+#endif
+
+GENERATE_SIMD_KERNEL_DISPATCH(SpecificBackProp, fc_specific_back_prop_cached)
+GENERATE_SIMD_KERNEL_DISPATCH(SpecificBackProp, fc_specific_back_prop_cached_packed)
+GENERATE_SIMD_KERNEL_DISPATCH(LightBackProp, fc_light_back_prop_packed_into)
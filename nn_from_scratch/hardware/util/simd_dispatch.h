@@ -0,0 +1,73 @@
+#ifndef SIMD_DISPATCH_H
+#define SIMD_DISPATCH_H
+#include "activation_functions.h"
+#include "forward_prop.h"
+#include "back_prop.h"
+
+/* Instruction sets the kernels are available for. x86 levels are picked at runtime from the CPU,
+   ARM levels are fixed at compile time by the target flags. */
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_NEON,
+    SIMD_HELIUM
+};
+
+#if !defined(FC_DISABLE_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FC_SIMD_X86
+#endif
+
+#if !defined(FC_DISABLE_SIMD) && defined(__ARM_FEATURE_MVE) && (__ARM_FEATURE_MVE & 2)
+#define FC_SIMD_HELIUM
+#elif !defined(FC_DISABLE_SIMD) && defined(__ARM_NEON)
+#define FC_SIMD_NEON
+#endif
+
+void init_simd_level(void);
+enum SimdLevel get_simd_level(void);
+enum SimdLevel get_best_simd_level(void);
+void set_simd_level(enum SimdLevel level);
+const char *get_simd_level_name(enum SimdLevel level);
+
+/* Return the kernel for the active SIMD level, or NULL when the scalar kernel should be used */
+ForwardPropInto get_fc_forward_prop_into_simd_variant(enum ActivationType activationType);
+ForwardPropT get_fc_forward_prop_t_simd_variant(enum ActivationType activationType);
+BackProp get_fc_back_prop_simd_variant(enum ActivationType activationType);
+ForwardPropBatch get_fc_forward_prop_batch_simd_variant(enum ActivationType activationType);
+SpecificBackProp get_fc_specific_back_prop_cached_simd_variant(void);
+ForwardPropInto get_fc_forward_prop_into_packed_simd_variant(enum ActivationType activationType);
+ForwardPropT get_fc_forward_prop_t_packed_simd_variant(enum ActivationType activationType);
+BackProp get_fc_back_prop_packed_simd_variant(enum ActivationType activationType);
+ForwardPropBatch get_fc_forward_prop_batch_packed_simd_variant(enum ActivationType activationType);
+SpecificBackProp get_fc_specific_back_prop_cached_packed_simd_variant(void);
+LightBackProp get_fc_light_back_prop_packed_into_simd_variant(void);
+
+#define GENERATE_SIMD_LOOKUP_PROTOTYPES(isa)                                                               \
+    ForwardPropInto get_fc_forward_prop_into_##isa##_variant(enum ActivationType activationType);          \
+    ForwardPropT get_fc_forward_prop_t_##isa##_variant(enum ActivationType activationType);                \
+    BackProp get_fc_back_prop_##isa##_variant(enum ActivationType activationType);                         \
+    ForwardPropBatch get_fc_forward_prop_batch_##isa##_variant(enum ActivationType activationType);        \
+    SpecificBackProp get_fc_specific_back_prop_cached_##isa##_variant(void);                               \
+    ForwardPropInto get_fc_forward_prop_into_packed_##isa##_variant(enum ActivationType activationType);   \
+    ForwardPropT get_fc_forward_prop_t_packed_##isa##_variant(enum ActivationType activationType);         \
+    BackProp get_fc_back_prop_packed_##isa##_variant(enum ActivationType activationType);                  \
+    ForwardPropBatch get_fc_forward_prop_batch_packed_##isa##_variant(enum ActivationType activationType); \
+    SpecificBackProp get_fc_specific_back_prop_cached_packed_##isa##_variant(void);                        \
+    LightBackProp get_fc_light_back_prop_packed_into_##isa##_variant(void);
+
+#ifdef FC_SIMD_X86
+GENERATE_SIMD_LOOKUP_PROTOTYPES(sse2)
+GENERATE_SIMD_LOOKUP_PROTOTYPES(avx2)
+GENERATE_SIMD_LOOKUP_PROTOTYPES(avx512)
+#endif
+#ifdef FC_SIMD_NEON
+GENERATE_SIMD_LOOKUP_PROTOTYPES(neon)
+#endif
+#ifdef FC_SIMD_HELIUM
+GENERATE_SIMD_LOOKUP_PROTOTYPES(helium)
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#include <stddef.h>
+#include "simd_dispatch.h"
+
+/* NEON and Helium (M-profile vector extension) instantiations of simd_kernels_template.h.
+    Only the instruction set enabled by the target flags is built, e.g. -mcpu=cortex-m55 for Helium.
+*/
+#if defined(FC_SIMD_NEON)
+#include <arm_neon.h>
+
+#define SIMD_ISA neon
+#define SIMD_TARGET
+#define SIMD_WIDTH 4
+#define simd_vec float32x4_t
+#define SIMD_LOAD(p) vld1q_f32(p)
+#define SIMD_STORE(p, v) vst1q_f32(p, v)
+#define SIMD_SET1(x) vdupq_n_f32(x)
+#define SIMD_ZERO() vdupq_n_f32(0)
+#define SIMD_ADD(a, b) vaddq_f32(a, b)
+#define SIMD_MAX(a, b) vmaxq_f32(a, b)
+#if defined(__aarch64__)
+#define SIMD_FMADD(a, b, c) vfmaq_f32(c, a, b)
+#define SIMD_HSUM(v) vaddvq_f32(v)
+#else
+#define SIMD_FMADD(a, b, c) vmlaq_f32(c, a, b)
+#define SIMD_HSUM(v) hsum_neon(v)
+
+static inline float hsum_neon(float32x4_t v)
+{
+    float32x2_t sum = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+#endif
+
+#include "simd_kernels_template.h"
+
+#elif defined(FC_SIMD_HELIUM)
+#include <arm_mve.h>
+
+#define SIMD_ISA helium
+#define SIMD_TARGET
+#define SIMD_WIDTH 4
+#define simd_vec float32x4_t
+#define SIMD_LOAD(p) vld1q_f32(p)
+#define SIMD_STORE(p, v) vst1q_f32(p, v)
+#define SIMD_SET1(x) vdupq_n_f32(x)
+#define SIMD_ZERO() vdupq_n_f32(0)
+#define SIMD_ADD(a, b) vaddq_f32(a, b)
+#define SIMD_MAX(a, b) vmaxnmq_f32(a, b)
+#define SIMD_FMADD(a, b, c) vfmaq_f32(c, a, b)
+#define SIMD_HSUM(v) hsum_helium(v)
+#define SIMD_BATCH_SAMPLES 2 // 8 vector registers
+
+static inline float hsum_helium(float32x4_t v)
+{
+    return (vgetq_lane_f32(v, 0) + vgetq_lane_f32(v, 1)) + (vgetq_lane_f32(v, 2) + vgetq_lane_f32(v, 3));
+}
+
+#include "simd_kernels_template.h"
+
+#endif
@@ -0,0 +1,763 @@
+/* Kernel template for the SIMD forward/back propagation variants.
+    Included once per instruction set, after defining:
+    SIMD_ISA: name used in the generated symbols (e.g. avx2)
+    SIMD_TARGET: function attribute enabling the instruction set, may be empty
+    SIMD_WIDTH: number of floats in a vector
+    simd_vec: vector type
+    SIMD_LOAD(p), SIMD_STORE(p, v), SIMD_SET1(x), SIMD_ZERO(), SIMD_ADD(a, b), SIMD_MAX(a, b),
+    SIMD_FMADD(a, b, c) (a * b + c) and SIMD_HSUM(v) (sum of all lanes)
+    SIMD_BATCH_SAMPLES: samples of a batched micro-kernel, optional, their 2 * SIMD_BATCH_SAMPLES accumulators have to fit
+    in the vector registers next to the weights
+
+    The INPUT_MAJOR kernels match the scalar kernels with the loops interchanged so that the vector lanes
+    run along contiguous weights, the OUTPUT_MAJOR_PACKED kernels reduce the dot products along the rows.
+*/
+#include "activation_functions.h"
+#include "forward_prop.h"
+#include "back_prop.h"
+#include "config.h"
+
+#define SIMD_FN_(name, isa, act) name##_##isa##_##act
+#define SIMD_FN_EXPAND(name, isa, act) SIMD_FN_(name, isa, act)
+#define SIMD_FN(name, act) SIMD_FN_EXPAND(name, SIMD_ISA, act)
+#define SIMD_KERNEL_(name, isa) name##_##isa
+#define SIMD_KERNEL_EXPAND(name, isa) SIMD_KERNEL_(name, isa)
+#define SIMD_KERNEL(name) SIMD_KERNEL_EXPAND(name, SIMD_ISA)
+#define SIMD_LOOKUP_(name, isa) get_##name##_##isa##_variant
+#define SIMD_LOOKUP_EXPAND(name, isa) SIMD_LOOKUP_(name, isa)
+#define SIMD_LOOKUP(name) SIMD_LOOKUP_EXPAND(name, SIMD_ISA)
+#ifndef SIMD_BATCH_SAMPLES
+#define SIMD_BATCH_SAMPLES 4
+#endif
+
+/* output[i] = act(sum_j input[j] * weights[i + j * output_size] + biases[i]), two vectors of outputs at a time */
+#define GENERATE_SIMD_FORWARD_PROP_INTO_VARIANTS(act, func, func_deriv)                                        \
+    SIMD_TARGET static void SIMD_FN(fc_forward_prop_into, act)(float *input, float *weights, float *biases,    \
+                                                               int input_size, int output_size, float *output) \
+    {                                                                                                          \
+        int i = 0;                                                                                             \
+        for (; i + 2 * SIMD_WIDTH <= output_size; i += 2 * SIMD_WIDTH)                                         \
+        {                                                                                                      \
+            simd_vec acc0 = SIMD_ZERO();                                                                       \
+            simd_vec acc1 = SIMD_ZERO();                                                                       \
+            for (int j = 0; j < input_size; j++)                                                               \
+            {                                                                                                  \
+                simd_vec in = SIMD_SET1(input[j]);                                                             \
+                float *w = weights + i + j * output_size;                                                      \
+                acc0 = SIMD_FMADD(in, SIMD_LOAD(w), acc0);                                                     \
+                acc1 = SIMD_FMADD(in, SIMD_LOAD(w + SIMD_WIDTH), acc1);                                        \
+            }                                                                                                  \
+            acc0 = SIMD_ADD(acc0, SIMD_LOAD(biases + i));                                                      \
+            acc1 = SIMD_ADD(acc1, SIMD_LOAD(biases + i + SIMD_WIDTH));                                         \
+            SIMD_STORE(output + i, act##_SIMD_MACRO(acc0));                                                    \
+            SIMD_STORE(output + i + SIMD_WIDTH, act##_SIMD_MACRO(acc1));                                       \
+        }                                                                                                      \
+        for (; i + SIMD_WIDTH <= output_size; i += SIMD_WIDTH)                                                 \
+        {                                                                                                      \
+            simd_vec acc = SIMD_ZERO();                                                                        \
+            for (int j = 0; j < input_size; j++)                                                               \
+            {                                                                                                  \
+                acc = SIMD_FMADD(SIMD_SET1(input[j]), SIMD_LOAD(weights + i + j * output_size), acc);          \
+            }                                                                                                  \
+            acc = SIMD_ADD(acc, SIMD_LOAD(biases + i));                                                        \
+            SIMD_STORE(output + i, act##_SIMD_MACRO(acc));                                                     \
+        }                                                                                                      \
+        for (; i < output_size; i++)                                                                           \
+        {                                                                                                      \
+            float sum = 0;                                                                                     \
+            for (int j = 0; j < input_size; j++)                                                               \
+            {                                                                                                  \
+                sum += input[j] * weights[i + j * output_size];                                                \
+            }                                                                                                  \
+            sum += biases[i];                                                                                  \
+            output[i] = func(sum);                                                                             \
+        }                                                                                                      \
+    }
+
+/* Training forward propagation, stores net inputs in output and their activations in activations */
+#define GENERATE_SIMD_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)                                                        \
+    SIMD_TARGET static float *SIMD_FN(fc_forward_prop_t, act)(float *input, int input_size, float *output, int output_size, \
+                                                              float *weights, float *biases, float *activations)            \
+    {                                                                                                                       \
+        int i = 0;                                                                                                          \
+        for (; i + SIMD_WIDTH <= output_size; i += SIMD_WIDTH)                                                              \
+        {                                                                                                                   \
+            simd_vec acc = SIMD_ZERO();                                                                                     \
+            for (int j = 0; j < input_size; j++)                                                                            \
+            {                                                                                                               \
+                acc = SIMD_FMADD(SIMD_SET1(input[j]), SIMD_LOAD(weights + i + j * output_size), acc);                       \
+            }                                                                                                               \
+            acc = SIMD_ADD(acc, SIMD_LOAD(biases + i));                                                                     \
+            SIMD_STORE(output + i, acc);                                                                                    \
+            SIMD_STORE(activations + i, act##_SIMD_MACRO(acc));                                                             \
+        }                                                                                                                   \
+        for (; i < output_size; i++)                                                                                        \
+        {                                                                                                                   \
+            float sum = 0;                                                                                                  \
+            for (int j = 0; j < input_size; j++)                                                                            \
+            {                                                                                                               \
+                sum += input[j] * weights[i + j * output_size];                                                             \
+            }                                                                                                               \
+            sum += biases[i];                                                                                               \
+            output[i] = sum;                                                                                                \
+            activations[i] = func(sum);                                                                                     \
+        }                                                                                                                   \
+        return activations;                                                                                                 \
+    }
+
+/* Back propagation, loops over the previous layer's neurons so that each neuron's weights and
+    weight gradients are contiguous. The gradient for the previous layer is a dot product per neuron,
+    so no temporary buffer is needed.
+*/
+#define GENERATE_SIMD_BACK_PROP_VARIANTS(act, func, func_deriv)                                                       \
+    SIMD_TARGET static void SIMD_FN(fc_back_prop, act)(float *input_gradient, float *activations, float *net_inputs,  \
+                                                       float *weights, int input_size, int net_inputs_size,           \
+                                                       float *gradient_weights, float *gradient_biases)               \
+    {                                                                                                                 \
+        int i = 0;                                                                                                    \
+        for (; i + SIMD_WIDTH <= input_size; i += SIMD_WIDTH)                                                         \
+        {                                                                                                             \
+            SIMD_STORE(gradient_biases + i, SIMD_ADD(SIMD_LOAD(gradient_biases + i), SIMD_LOAD(input_gradient + i))); \
+        }                                                                                                             \
+        for (; i < input_size; i++)                                                                                   \
+        {                                                                                                             \
+            gradient_biases[i] += input_gradient[i];                                                                  \
+        }                                                                                                             \
+        for (int j = 0; j < net_inputs_size; j++)                                                                     \
+        {                                                                                                             \
+            float activation = activations[j];                                                                        \
+            simd_vec activation_vec = SIMD_SET1(activation);                                                          \
+            float *w = weights + j * input_size;                                                                      \
+            float *gw = gradient_weights + j * input_size;                                                            \
+            simd_vec dot = SIMD_ZERO();                                                                               \
+            i = 0;                                                                                                    \
+            for (; i + SIMD_WIDTH <= input_size; i += SIMD_WIDTH)                                                     \
+            {                                                                                                         \
+                simd_vec gradient = SIMD_LOAD(input_gradient + i);                                                    \
+                SIMD_STORE(gw + i, SIMD_FMADD(gradient, activation_vec, SIMD_LOAD(gw + i)));                          \
+                dot = SIMD_FMADD(SIMD_LOAD(w + i), gradient, dot);                                                    \
+            }                                                                                                         \
+            float sum = SIMD_HSUM(dot);                                                                               \
+            for (; i < input_size; i++)                                                                               \
+            {                                                                                                         \
+                gw[i] += input_gradient[i] * activation;                                                              \
+                sum += w[i] * input_gradient[i];                                                                      \
+            }                                                                                                         \
+            net_inputs[j] = sum * func_deriv(net_inputs[j]);                                                          \
+        }                                                                                                             \
+    }
+
+/* Back propagation of the chosen weights with cached activations, does not calculate gradients for the next layer */
+SIMD_TARGET static void SIMD_KERNEL(fc_specific_back_prop_cached)(float *input_gradient, float *activations, int layer_size,
+                                                                      float *gradient_weights, float *gradient_biases,
+                                                                      int n_neurons, int gradient_stride)
+{
+    int i = 0;
+    for (; i + SIMD_WIDTH <= layer_size; i += SIMD_WIDTH)
+    {
+        SIMD_STORE(gradient_biases + i, SIMD_ADD(SIMD_LOAD(gradient_biases + i), SIMD_LOAD(input_gradient + i)));
+    }
+    for (; i < layer_size; i++)
+    {
+        gradient_biases[i] += input_gradient[i];
+    }
+    for (int j = 0; j < n_neurons; j++)
+    {
+        float activation = activations[j];
+        simd_vec activation_vec = SIMD_SET1(activation);
+        float *gw = gradient_weights + j * gradient_stride;
+        i = 0;
+        for (; i + SIMD_WIDTH <= layer_size; i += SIMD_WIDTH)
+        {
+            SIMD_STORE(gw + i, SIMD_FMADD(SIMD_LOAD(input_gradient + i), activation_vec, SIMD_LOAD(gw + i)));
+        }
+        for (; i < layer_size; i++)
+        {
+            gw[i] += input_gradient[i] * activation;
+        }
+    }
+}
+
+/* Net inputs of a batch as a register-blocked matrix multiply: output = input * weights + biases, row-wise.
+    SIMD_BATCH_SAMPLES samples x two vectors of outputs stay in accumulators over all inputs, so every weight vector
+    loaded is used for all of those samples and the outputs are stored once.
+*/
+SIMD_TARGET static void SIMD_KERNEL(fc_forward_prop_batch_sums)(float *restrict input, float *restrict weights, float *restrict biases,
+                                                                int input_size, int output_size, int n_samples, float *restrict output)
+{
+    int i = 0;
+    for (; i + 2 * SIMD_WIDTH <= output_size; i += 2 * SIMD_WIDTH)
+    {
+        int s = 0;
+        for (; s + SIMD_BATCH_SAMPLES <= n_samples; s += SIMD_BATCH_SAMPLES)
+        {
+            simd_vec acc0[SIMD_BATCH_SAMPLES];
+            simd_vec acc1[SIMD_BATCH_SAMPLES];
+            for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+            {
+                acc0[r] = SIMD_LOAD(biases + i);
+                acc1[r] = SIMD_LOAD(biases + i + SIMD_WIDTH);
+            }
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                simd_vec w0 = SIMD_LOAD(weights + i + j * output_size);
+                simd_vec w1 = SIMD_LOAD(weights + i + j * output_size + SIMD_WIDTH);
+                for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+                {
+                    simd_vec x = SIMD_SET1(in[r * input_size + j]);
+                    acc0[r] = SIMD_FMADD(x, w0, acc0[r]);
+                    acc1[r] = SIMD_FMADD(x, w1, acc1[r]);
+                }
+            }
+            for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+            {
+                SIMD_STORE(output + (s + r) * output_size + i, acc0[r]);
+                SIMD_STORE(output + (s + r) * output_size + i + SIMD_WIDTH, acc1[r]);
+            }
+        }
+        for (; s < n_samples; s++)
+        {
+            simd_vec acc0 = SIMD_LOAD(biases + i);
+            simd_vec acc1 = SIMD_LOAD(biases + i + SIMD_WIDTH);
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                simd_vec x = SIMD_SET1(in[j]);
+                acc0 = SIMD_FMADD(x, SIMD_LOAD(weights + i + j * output_size), acc0);
+                acc1 = SIMD_FMADD(x, SIMD_LOAD(weights + i + j * output_size + SIMD_WIDTH), acc1);
+            }
+            SIMD_STORE(output + s * output_size + i, acc0);
+            SIMD_STORE(output + s * output_size + i + SIMD_WIDTH, acc1);
+        }
+    }
+    for (; i + SIMD_WIDTH <= output_size; i += SIMD_WIDTH)
+    {
+        for (int s = 0; s < n_samples; s++)
+        {
+            simd_vec acc = SIMD_LOAD(biases + i);
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                acc = SIMD_FMADD(SIMD_SET1(in[j]), SIMD_LOAD(weights + i + j * output_size), acc);
+            }
+            SIMD_STORE(output + s * output_size + i, acc);
+        }
+    }
+    for (; i < output_size; i++)
+    {
+        for (int s = 0; s < n_samples; s++)
+        {
+            float sum = 0;
+            float *in = input + s * input_size;
+            for (int j = 0; j < input_size; j++)
+            {
+                sum += in[j] * weights[i + j * output_size];
+            }
+            output[s * output_size + i] = sum + biases[i];
+        }
+    }
+}
+
+/* Batched forward propagation, fc_forward_prop_batch_sums followed by the activation in place */
+#define GENERATE_SIMD_FORWARD_PROP_BATCH_VARIANTS(act, func, func_deriv)                                                     \
+    SIMD_TARGET static void SIMD_FN(fc_forward_prop_batch, act)(float *input, float *weights, float *biases, int input_size, \
+                                                                int output_size, int n_samples, float *output)               \
+    {                                                                                                                        \
+        SIMD_KERNEL(fc_forward_prop_batch_sums)(input, weights, biases, input_size, output_size, n_samples, output);         \
+        int n = n_samples * output_size;                                                                                     \
+        int i = 0;                                                                                                           \
+        for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)                                                                         \
+        {                                                                                                                    \
+            SIMD_STORE(output + i, act##_SIMD_MACRO(SIMD_LOAD(output + i)));                                                 \
+        }                                                                                                                    \
+        for (; i < n; i++)                                                                                                   \
+        {                                                                                                                    \
+            output[i] = func(output[i]);                                                                                     \
+        }                                                                                                                    \
+    }
+
+/* OUTPUT_MAJOR_PACKED kernels, see weight_layout.h. The lanes run along a neuron's padded row and the dot
+    products are reduced with SIMD_HSUM. They need whole vectors in a row, else the lookups return NULL.
+*/
+#if FC_PACKED_WIDTH % SIMD_WIDTH == 0
+#define SIMD_PACKED_VECTORS (FC_PACKED_WIDTH / SIMD_WIDTH)
+
+/* output[i] = weights row i . input + biases[i], 4 rows share every input vector loaded.
+    The input tail is zero padded into a vector, the rows are padded with zeros already.
+*/
+SIMD_TARGET static void SIMD_KERNEL(fc_forward_prop_packed_sums)(float *restrict input, float *restrict weights, float *restrict biases,
+                                                                 int input_size, int output_size, float *restrict output)
+{
+    int stride = FC_PACKED_STRIDE(input_size);
+    int n_full = input_size / SIMD_WIDTH * SIMD_WIDTH;
+    float tail[SIMD_WIDTH] = {0};
+    for (int j = n_full; j < input_size; j++)
+    {
+        tail[j - n_full] = input[j];
+    }
+    simd_vec x_tail = SIMD_LOAD(tail);
+    int i = 0;
+    for (; i + 4 <= output_size; i += 4)
+    {
+        float *w = weights + i * stride;
+        simd_vec acc[4];
+        for (int r = 0; r < 4; r++)
+        {
+            acc[r] = SIMD_ZERO();
+        }
+        for (int j = 0; j < n_full; j += SIMD_WIDTH)
+        {
+            simd_vec x = SIMD_LOAD(input + j);
+            for (int r = 0; r < 4; r++)
+            {
+                acc[r] = SIMD_FMADD(x, SIMD_LOAD(w + r * stride + j), acc[r]);
+            }
+        }
+        for (int r = 0; r < 4; r++)
+        {
+            if (n_full < input_size)
+            {
+                acc[r] = SIMD_FMADD(x_tail, SIMD_LOAD(w + r * stride + n_full), acc[r]);
+            }
+            output[i + r] = SIMD_HSUM(acc[r]) + biases[i + r];
+        }
+    }
+    for (; i < output_size; i++)
+    {
+        float *w = weights + i * stride;
+        simd_vec acc = SIMD_ZERO();
+        for (int j = 0; j < n_full; j += SIMD_WIDTH)
+        {
+            acc = SIMD_FMADD(SIMD_LOAD(input + j), SIMD_LOAD(w + j), acc);
+        }
+        if (n_full < input_size)
+        {
+            acc = SIMD_FMADD(x_tail, SIMD_LOAD(w + n_full), acc);
+        }
+        output[i] = SIMD_HSUM(acc) + biases[i];
+    }
+}
+
+/* Net inputs of a batch, 2 rows x SIMD_BATCH_SAMPLES samples of dot products share their loads.
+    The rows are tiled by FC_BATCH_TILE_OUTPUTS so that a tile stays in cache over all samples.
+    A short last block of samples repeats its last sample instead of reading past the input.
+*/
+SIMD_TARGET static void SIMD_KERNEL(fc_forward_prop_batch_packed_sums)(float *restrict input, float *restrict weights, float *restrict biases,
+                                                                       int input_size, int output_size, int n_samples, float *restrict output)
+{
+    int stride = FC_PACKED_STRIDE(input_size);
+    int n_full = input_size / SIMD_WIDTH * SIMD_WIDTH;
+    for (int o0 = 0; o0 < output_size; o0 += FC_BATCH_TILE_OUTPUTS)
+    {
+        int o1 = (o0 + FC_BATCH_TILE_OUTPUTS < output_size) ? o0 + FC_BATCH_TILE_OUTPUTS : output_size;
+        for (int s0 = 0; s0 < n_samples; s0 += SIMD_BATCH_SAMPLES)
+        {
+            int n = (n_samples - s0 < SIMD_BATCH_SAMPLES) ? n_samples - s0 : SIMD_BATCH_SAMPLES;
+            float *in[SIMD_BATCH_SAMPLES];
+            float tail[SIMD_BATCH_SAMPLES][SIMD_WIDTH];
+            for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+            {
+                in[r] = input + (s0 + ((r < n) ? r : n - 1)) * input_size;
+                for (int j = 0; j < SIMD_WIDTH; j++)
+                {
+                    tail[r][j] = (n_full + j < input_size) ? in[r][n_full + j] : 0.0f;
+                }
+            }
+            int o = o0;
+            for (; o + 2 <= o1; o += 2)
+            {
+                float *w0 = weights + o * stride;
+                float *w1 = w0 + stride;
+                simd_vec acc0[SIMD_BATCH_SAMPLES];
+                simd_vec acc1[SIMD_BATCH_SAMPLES];
+                for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+                {
+                    acc0[r] = SIMD_ZERO();
+                    acc1[r] = SIMD_ZERO();
+                }
+                for (int j = 0; j < n_full; j += SIMD_WIDTH)
+                {
+                    simd_vec wv0 = SIMD_LOAD(w0 + j);
+                    simd_vec wv1 = SIMD_LOAD(w1 + j);
+                    for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+                    {
+                        simd_vec x = SIMD_LOAD(in[r] + j);
+                        acc0[r] = SIMD_FMADD(x, wv0, acc0[r]);
+                        acc1[r] = SIMD_FMADD(x, wv1, acc1[r]);
+                    }
+                }
+                if (n_full < input_size)
+                {
+                    for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+                    {
+                        simd_vec x = SIMD_LOAD(tail[r]);
+                        acc0[r] = SIMD_FMADD(x, SIMD_LOAD(w0 + n_full), acc0[r]);
+                        acc1[r] = SIMD_FMADD(x, SIMD_LOAD(w1 + n_full), acc1[r]);
+                    }
+                }
+                for (int r = 0; r < n; r++)
+                {
+                    output[(s0 + r) * output_size + o] = SIMD_HSUM(acc0[r]) + biases[o];
+                    output[(s0 + r) * output_size + o + 1] = SIMD_HSUM(acc1[r]) + biases[o + 1];
+                }
+            }
+            for (; o < o1; o++)
+            {
+                float *w0 = weights + o * stride;
+                simd_vec acc[SIMD_BATCH_SAMPLES];
+                for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+                {
+                    acc[r] = SIMD_ZERO();
+                }
+                for (int j = 0; j < n_full; j += SIMD_WIDTH)
+                {
+                    simd_vec wv0 = SIMD_LOAD(w0 + j);
+                    for (int r = 0; r < SIMD_BATCH_SAMPLES; r++)
+                    {
+                        acc[r] = SIMD_FMADD(SIMD_LOAD(in[r] + j), wv0, acc[r]);
+                    }
+                }
+                for (int r = 0; r < n; r++)
+                {
+                    if (n_full < input_size)
+                    {
+                        acc[r] = SIMD_FMADD(SIMD_LOAD(tail[r]), SIMD_LOAD(w0 + n_full), acc[r]);
+                    }
+                    output[(s0 + r) * output_size + o] = SIMD_HSUM(acc[r]) + biases[o];
+                }
+            }
+        }
+    }
+}
+
+#define GENERATE_SIMD_FORWARD_PROP_INTO_PACKED_VARIANTS(act, func, func_deriv)                                        \
+    SIMD_TARGET static void SIMD_FN(fc_forward_prop_into_packed, act)(float *input, float *weights, float *biases,    \
+                                                                      int input_size, int output_size, float *output) \
+    {                                                                                                                 \
+        SIMD_KERNEL(fc_forward_prop_packed_sums)(input, weights, biases, input_size, output_size, output);            \
+        for (int i = 0; i < output_size; i++)                                                                         \
+        {                                                                                                             \
+            output[i] = func(output[i]);                                                                              \
+        }                                                                                                             \
+    }
+
+#define GENERATE_SIMD_FORWARD_PROP_T_PACKED_VARIANTS(act, func, func_deriv)                                                        \
+    SIMD_TARGET static float *SIMD_FN(fc_forward_prop_t_packed, act)(float *input, int input_size, float *output, int output_size, \
+                                                                     float *weights, float *biases, float *activations)            \
+    {                                                                                                                              \
+        SIMD_KERNEL(fc_forward_prop_packed_sums)(input, weights, biases, input_size, output_size, output);                         \
+        for (int i = 0; i < output_size; i++)                                                                                      \
+        {                                                                                                                          \
+            activations[i] = func(output[i]);                                                                                      \
+        }                                                                                                                          \
+        return activations;                                                                                                        \
+    }
+
+#define GENERATE_SIMD_FORWARD_PROP_BATCH_PACKED_VARIANTS(act, func, func_deriv)                                                     \
+    SIMD_TARGET static void SIMD_FN(fc_forward_prop_batch_packed, act)(float *input, float *weights, float *biases, int input_size, \
+                                                                       int output_size, int n_samples, float *output)               \
+    {                                                                                                                               \
+        SIMD_KERNEL(fc_forward_prop_batch_packed_sums)(input, weights, biases, input_size, output_size, n_samples, output);         \
+        int n = n_samples * output_size;                                                                                            \
+        int i = 0;                                                                                                                  \
+        for (; i + SIMD_WIDTH <= n; i += SIMD_WIDTH)                                                                                \
+        {                                                                                                                           \
+            SIMD_STORE(output + i, act##_SIMD_MACRO(SIMD_LOAD(output + i)));                                                        \
+        }                                                                                                                           \
+        for (; i < n; i++)                                                                                                          \
+        {                                                                                                                           \
+            output[i] = func(output[i]);                                                                                            \
+        }                                                                                                                           \
+    }
+
+/* Packed back propagation over FC_PACKED_WIDTH columns at a time like the scalar kernel, the gradients of the
+    previous layer stay in accumulators. A partial last block uses the scalar loop so the padding is never written.
+*/
+#define GENERATE_SIMD_BACK_PROP_PACKED_VARIANTS(act, func, func_deriv)                                                      \
+    SIMD_TARGET static void SIMD_FN(fc_back_prop_packed, act)(float *input_gradient, float *activations, float *net_inputs, \
+                                                              float *weights, int input_size, int net_inputs_size,          \
+                                                              float *gradient_weights, float *gradient_biases)              \
+    {                                                                                                                       \
+        int stride = FC_PACKED_STRIDE(net_inputs_size);                                                                     \
+        int i = 0;                                                                                                          \
+        for (; i + SIMD_WIDTH <= input_size; i += SIMD_WIDTH)                                                               \
+        {                                                                                                                   \
+            SIMD_STORE(gradient_biases + i, SIMD_ADD(SIMD_LOAD(gradient_biases + i), SIMD_LOAD(input_gradient + i)));       \
+        }                                                                                                                   \
+        for (; i < input_size; i++)                                                                                         \
+        {                                                                                                                   \
+            gradient_biases[i] += input_gradient[i];                                                                        \
+        }                                                                                                                   \
+        int j0 = 0;                                                                                                         \
+        for (; j0 + FC_PACKED_WIDTH <= net_inputs_size; j0 += FC_PACKED_WIDTH)                                              \
+        {                                                                                                                   \
+            simd_vec a[SIMD_PACKED_VECTORS];                                                                                \
+            simd_vec sum[SIMD_PACKED_VECTORS];                                                                              \
+            for (int v = 0; v < SIMD_PACKED_VECTORS; v++)                                                                   \
+            {                                                                                                               \
+                a[v] = SIMD_LOAD(activations + j0 + v * SIMD_WIDTH);                                                        \
+                sum[v] = SIMD_ZERO();                                                                                       \
+            }                                                                                                               \
+            for (i = 0; i < input_size; i++)                                                                                \
+            {                                                                                                               \
+                simd_vec gradient = SIMD_SET1(input_gradient[i]);                                                           \
+                float *w_row = weights + i * stride + j0;                                                                   \
+                float *gw_row = gradient_weights + i * stride + j0;                                                         \
+                for (int v = 0; v < SIMD_PACKED_VECTORS; v++)                                                               \
+                {                                                                                                           \
+                    float *gw = gw_row + v * SIMD_WIDTH;                                                                    \
+                    SIMD_STORE(gw, SIMD_FMADD(gradient, a[v], SIMD_LOAD(gw)));                                              \
+                    sum[v] = SIMD_FMADD(SIMD_LOAD(w_row + v * SIMD_WIDTH), gradient, sum[v]);                               \
+                }                                                                                                           \
+            }                                                                                                               \
+            float temp[FC_PACKED_WIDTH];                                                                                    \
+            for (int v = 0; v < SIMD_PACKED_VECTORS; v++)                                                                   \
+            {                                                                                                               \
+                SIMD_STORE(temp + v * SIMD_WIDTH, sum[v]);                                                                  \
+            }                                                                                                               \
+            for (int j = 0; j < FC_PACKED_WIDTH; j++)                                                                       \
+            {                                                                                                               \
+                net_inputs[j0 + j] = temp[j] * func_deriv(net_inputs[j0 + j]);                                              \
+            }                                                                                                               \
+        }                                                                                                                   \
+        if (j0 < net_inputs_size)                                                                                           \
+        {                                                                                                                   \
+            int n = net_inputs_size - j0;                                                                                   \
+            float temp[FC_PACKED_WIDTH] = {0};                                                                              \
+            for (i = 0; i < input_size; i++)                                                                                \
+            {                                                                                                               \
+                float gradient = input_gradient[i];                                                                         \
+                float *w_row = weights + i * stride + j0;                                                                   \
+                float *gw_row = gradient_weights + i * stride + j0;                                                         \
+                for (int j = 0; j < n; j++)                                                                                 \
+                {                                                                                                           \
+                    gw_row[j] += gradient * activations[j0 + j];                                                            \
+                    temp[j] += w_row[j] * gradient;                                                                         \
+                }                                                                                                           \
+            }                                                                                                               \
+            for (int j = 0; j < n; j++)                                                                                     \
+            {                                                                                                               \
+                net_inputs[j0 + j] = temp[j] * func_deriv(net_inputs[j0 + j]);                                              \
+            }                                                                                                               \
+        }                                                                                                                   \
+    }
+
+/* Packed light back propagation, FC_PACKED_WIDTH gradients of the output layer at a time in accumulators.
+    Only reads the padding of the last block, whose zero weights do not change the kept sums.
+*/
+SIMD_TARGET static void SIMD_KERNEL(fc_light_back_prop_packed_into)(float *input_gradient, float *weights, int input_size,
+                                                                    int output_layer_size, uint32_t *deriv_mask, float *output)
+{
+    int stride = FC_PACKED_STRIDE(output_layer_size);
+    for (int j0 = 0; j0 < output_layer_size; j0 += FC_PACKED_WIDTH)
+    {
+        simd_vec sum[SIMD_PACKED_VECTORS];
+        for (int v = 0; v < SIMD_PACKED_VECTORS; v++)
+        {
+            sum[v] = SIMD_ZERO();
+        }
+        for (int i = 0; i < input_size; i++)
+        {
+            simd_vec gradient = SIMD_SET1(input_gradient[i]);
+            float *w_row = weights + i * stride + j0;
+            for (int v = 0; v < SIMD_PACKED_VECTORS; v++)
+            {
+                sum[v] = SIMD_FMADD(SIMD_LOAD(w_row + v * SIMD_WIDTH), gradient, sum[v]);
+            }
+        }
+        if (j0 + FC_PACKED_WIDTH <= output_layer_size)
+        {
+            for (int v = 0; v < SIMD_PACKED_VECTORS; v++)
+            {
+                SIMD_STORE(output + j0 + v * SIMD_WIDTH, sum[v]);
+            }
+        }
+        else
+        {
+            float temp[FC_PACKED_WIDTH];
+            for (int v = 0; v < SIMD_PACKED_VECTORS; v++)
+            {
+                SIMD_STORE(temp + v * SIMD_WIDTH, sum[v]);
+            }
+            for (int j = 0; j < output_layer_size - j0; j++)
+            {
+                output[j0 + j] = temp[j];
+            }
+        }
+    }
+    deriv_mask_apply(output, deriv_mask, output_layer_size);
+}
+#endif
+
+/* fc_specific_back_prop_cached for the OUTPUT_MAJOR_PACKED layout, the lanes run along a gradient row */
+SIMD_TARGET static void SIMD_KERNEL(fc_specific_back_prop_cached_packed)(float *input_gradient, float *activations, int layer_size,
+                                                                         float *gradient_weights, float *gradient_biases,
+                                                                         int n_neurons, int gradient_stride)
+{
+    int i = 0;
+    for (; i + SIMD_WIDTH <= layer_size; i += SIMD_WIDTH)
+    {
+        SIMD_STORE(gradient_biases + i, SIMD_ADD(SIMD_LOAD(gradient_biases + i), SIMD_LOAD(input_gradient + i)));
+    }
+    for (; i < layer_size; i++)
+    {
+        gradient_biases[i] += input_gradient[i];
+    }
+    for (i = 0; i < layer_size; i++)
+    {
+        float gradient = input_gradient[i];
+        simd_vec gradient_vec = SIMD_SET1(gradient);
+        float *gw_row = gradient_weights + i * gradient_stride;
+        int j = 0;
+        for (; j + SIMD_WIDTH <= n_neurons; j += SIMD_WIDTH)
+        {
+            SIMD_STORE(gw_row + j, SIMD_FMADD(gradient_vec, SIMD_LOAD(activations + j), SIMD_LOAD(gw_row + j)));
+        }
+        for (; j < n_neurons; j++)
+        {
+            gw_row[j] += gradient * activations[j];
+        }
+    }
+}
+
+#define GENERATE_SIMD_LOOKUP(type, kernel)                       \
+    type SIMD_LOOKUP(kernel)(enum ActivationType activationType) \
+    {                                                            \
+        switch (activationType)                                  \
+        {                                                        \
+            ACTIVATION_MACRO_LIST                                \
+        default:                                                 \
+            return NULL;                                         \
+        }                                                        \
+    }
+
+#define X(act, func, func_deriv) GENERATE_SIMD_FORWARD_PROP_INTO_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_SIMD_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_SIMD_BACK_PROP_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_SIMD_FORWARD_PROP_BATCH_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_forward_prop_into, act);
+GENERATE_SIMD_LOOKUP(ForwardPropInto, fc_forward_prop_into)
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_forward_prop_t, act);
+GENERATE_SIMD_LOOKUP(ForwardPropT, fc_forward_prop_t)
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_back_prop, act);
+GENERATE_SIMD_LOOKUP(BackProp, fc_back_prop)
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_forward_prop_batch, act);
+GENERATE_SIMD_LOOKUP(ForwardPropBatch, fc_forward_prop_batch)
+#undef X
+
+SpecificBackProp SIMD_LOOKUP(fc_specific_back_prop_cached)(void)
+{
+    return SIMD_KERNEL(fc_specific_back_prop_cached);
+}
+
+SpecificBackProp SIMD_LOOKUP(fc_specific_back_prop_cached_packed)(void)
+{
+    return SIMD_KERNEL(fc_specific_back_prop_cached_packed);
+}
+
+#if FC_PACKED_WIDTH % SIMD_WIDTH == 0
+#define X(act, func, func_deriv) GENERATE_SIMD_FORWARD_PROP_INTO_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_SIMD_FORWARD_PROP_T_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_SIMD_FORWARD_PROP_BATCH_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_SIMD_BACK_PROP_PACKED_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_forward_prop_into_packed, act);
+GENERATE_SIMD_LOOKUP(ForwardPropInto, fc_forward_prop_into_packed)
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_forward_prop_t_packed, act);
+GENERATE_SIMD_LOOKUP(ForwardPropT, fc_forward_prop_t_packed)
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_forward_prop_batch_packed, act);
+GENERATE_SIMD_LOOKUP(ForwardPropBatch, fc_forward_prop_batch_packed)
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return SIMD_FN(fc_back_prop_packed, act);
+GENERATE_SIMD_LOOKUP(BackProp, fc_back_prop_packed)
+#undef X
+
+LightBackProp SIMD_LOOKUP(fc_light_back_prop_packed_into)(void)
+{
+    return SIMD_KERNEL(fc_light_back_prop_packed_into);
+}
+#else
+#define X(act, func, func_deriv)
+GENERATE_SIMD_LOOKUP(ForwardPropInto, fc_forward_prop_into_packed)
+GENERATE_SIMD_LOOKUP(ForwardPropT, fc_forward_prop_t_packed)
+GENERATE_SIMD_LOOKUP(ForwardPropBatch, fc_forward_prop_batch_packed)
+GENERATE_SIMD_LOOKUP(BackProp, fc_back_prop_packed)
+#undef X
+
+LightBackProp SIMD_LOOKUP(fc_light_back_prop_packed_into)(void)
+{
+    return NULL;
+}
+#endif
+
+#undef SIMD_FN_
+#undef SIMD_FN_EXPAND
+#undef SIMD_FN
+#undef SIMD_KERNEL_
+#undef SIMD_KERNEL_EXPAND
+#undef SIMD_KERNEL
+#undef SIMD_LOOKUP_
+#undef SIMD_LOOKUP_EXPAND
+#undef SIMD_LOOKUP
+#undef GENERATE_SIMD_FORWARD_PROP_INTO_VARIANTS
+#undef GENERATE_SIMD_FORWARD_PROP_T_VARIANTS
+#undef GENERATE_SIMD_BACK_PROP_VARIANTS
+#undef GENERATE_SIMD_FORWARD_PROP_BATCH_VARIANTS
+#undef GENERATE_SIMD_FORWARD_PROP_INTO_PACKED_VARIANTS
+#undef GENERATE_SIMD_FORWARD_PROP_T_PACKED_VARIANTS
+#undef GENERATE_SIMD_FORWARD_PROP_BATCH_PACKED_VARIANTS
+#undef GENERATE_SIMD_BACK_PROP_PACKED_VARIANTS
+#undef SIMD_PACKED_VECTORS
+#undef SIMD_BATCH_SAMPLES
+#undef GENERATE_SIMD_LOOKUP
@@ -0,0 +1,101 @@
+#include <stddef.h>
+#include "simd_dispatch.h"
+
+/* SSE2, AVX2 (+FMA) and AVX-512 instantiations of simd_kernels_template.h.
+    The instruction sets are enabled per function, so this file builds without -m flags and the
+    dispatcher in simd_dispatch.c only calls a variant after checking the CPU supports it.
+*/
+#ifdef FC_SIMD_X86
+#include <immintrin.h>
+
+/* SSE2 */
+#define SIMD_ISA sse2
+#define SIMD_TARGET __attribute__((target("sse2")))
+#define SIMD_WIDTH 4
+#define simd_vec __m128
+#define SIMD_LOAD(p) _mm_loadu_ps(p)
+#define SIMD_STORE(p, v) _mm_storeu_ps(p, v)
+#define SIMD_SET1(x) _mm_set1_ps(x)
+#define SIMD_ZERO() _mm_setzero_ps()
+#define SIMD_ADD(a, b) _mm_add_ps(a, b)
+#define SIMD_MAX(a, b) _mm_max_ps(a, b)
+#define SIMD_FMADD(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define SIMD_HSUM(v) hsum_sse2(v)
+
+SIMD_TARGET static inline float hsum_sse2(__m128 v)
+{
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+#include "simd_kernels_template.h"
+
+#undef SIMD_ISA
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+#undef simd_vec
+#undef SIMD_LOAD
+#undef SIMD_STORE
+#undef SIMD_SET1
+#undef SIMD_ZERO
+#undef SIMD_ADD
+#undef SIMD_MAX
+#undef SIMD_FMADD
+#undef SIMD_HSUM
+
+/* AVX2 + FMA */
+#define SIMD_ISA avx2
+#define SIMD_TARGET __attribute__((target("avx2,fma")))
+#define SIMD_WIDTH 8
+#define simd_vec __m256
+#define SIMD_LOAD(p) _mm256_loadu_ps(p)
+#define SIMD_STORE(p, v) _mm256_storeu_ps(p, v)
+#define SIMD_SET1(x) _mm256_set1_ps(x)
+#define SIMD_ZERO() _mm256_setzero_ps()
+#define SIMD_ADD(a, b) _mm256_add_ps(a, b)
+#define SIMD_MAX(a, b) _mm256_max_ps(a, b)
+#define SIMD_FMADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+#define SIMD_HSUM(v) hsum_avx2(v)
+
+SIMD_TARGET static inline float hsum_avx2(__m256 v)
+{
+    __m128 low = _mm256_castps256_ps128(v);
+    __m128 high = _mm256_extractf128_ps(v, 1);
+    return hsum_sse2(_mm_add_ps(low, high));
+}
+
+#include "simd_kernels_template.h"
+
+#undef SIMD_ISA
+#undef SIMD_TARGET
+#undef SIMD_WIDTH
+#undef simd_vec
+#undef SIMD_LOAD
+#undef SIMD_STORE
+#undef SIMD_SET1
+#undef SIMD_ZERO
+#undef SIMD_ADD
+#undef SIMD_MAX
+#undef SIMD_FMADD
+#undef SIMD_HSUM
+
+/* AVX-512F */
+#define SIMD_ISA avx512
+#define SIMD_TARGET __attribute__((target("avx512f")))
+#define SIMD_WIDTH 16
+#define simd_vec __m512
+#define SIMD_LOAD(p) _mm512_loadu_ps(p)
+#define SIMD_STORE(p, v) _mm512_storeu_ps(p, v)
+#define SIMD_SET1(x) _mm512_set1_ps(x)
+#define SIMD_ZERO() _mm512_setzero_ps()
+#define SIMD_ADD(a, b) _mm512_add_ps(a, b)
+#define SIMD_MAX(a, b) _mm512_max_ps(a, b)
+#define SIMD_FMADD(a, b, c) _mm512_fmadd_ps(a, b, c)
+#define SIMD_HSUM(v) _mm512_reduce_add_ps(v)
+
+#include "simd_kernels_template.h"
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+#include "sparse_prop.h"
+#include "deriv_mask.h"
+
+/* Inference forward propagation of a sparse layer, the counterpart of fc_forward_prop_into
+    @param input: activations of the previous layer
+    @param output: pointer to where the output_size activations will be stored
+*/
+#define GENERATE_FC_SPARSE_FORWARD_PROP_INTO_VARIANTS(act, func, func_deriv)                                    \
+    void fc_sparse_forward_prop_into_##act(float *input, float *weights, SparseLayer *sparse, float *biases,   \
+                                           int output_size, float *output)                                     \
+    {                                                                                                           \
+        for (int i = 0; i < output_size; i++)                                                                   \
+        {                                                                                                       \
+            float sum = 0;                                                                                      \
+            for (int k = sparse->row_offsets[i]; k < sparse->row_offsets[i + 1]; k++)                           \
+            {                                                                                                   \
+                sum += input[sparse->columns[k]] * weights[k];                                                  \
+            }                                                                                                   \
+            sum += biases[i];                                                                                   \
+            output[i] = func(sum);                                                                              \
+        }                                                                                                       \
+    }
+
+/* Training forward propagation of a sparse layer, the counterpart of fc_forward_prop_t
+    @return activations, the input of the next layer
+*/
+#define GENERATE_FC_SPARSE_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)                                       \
+    float *fc_sparse_forward_prop_t_##act(float *input, float *weights, SparseLayer *sparse, float *biases,    \
+                                          int output_size, float *net_inputs, float *activations)              \
+    {                                                                                                           \
+        for (int i = 0; i < output_size; i++)                                                                   \
+        {                                                                                                       \
+            float sum = 0;                                                                                      \
+            for (int k = sparse->row_offsets[i]; k < sparse->row_offsets[i + 1]; k++)                           \
+            {                                                                                                   \
+                sum += input[sparse->columns[k]] * weights[k];                                                  \
+            }                                                                                                   \
+            sum += biases[i];                                                                                   \
+            net_inputs[i] = sum;                                                                                \
+            activations[i] = func(sum);                                                                         \
+        }                                                                                                       \
+        return activations;                                                                                     \
+    }
+
+/* Back propagation of a sparse layer, the counterpart of fc_back_prop.
+    Pruned weights get no gradient, so they stay zero when the gradients are applied.
+    @param activations: activations of the previous layer, no longer needed afterwards and overwritten as the
+        accumulator of the scattered gradients
+    @param net_inputs: net inputs of the previous layer, overwritten with their gradients
+*/
+#define GENERATE_FC_SPARSE_BACK_PROP_VARIANTS(act, func, func_deriv)                                                       \
+    void fc_sparse_back_prop_##act(float *input_gradient, float *activations, float *net_inputs, float *weights,          \
+                                   SparseLayer *sparse, int input_size, int net_inputs_size, float *gradient_weights,      \
+                                   float *gradient_biases)                                                                 \
+    {                                                                                                                      \
+        fc_sparse_gradients(input_gradient, activations, sparse, input_size, gradient_weights, gradient_biases);         \
+        memset(activations, 0, net_inputs_size * sizeof(float));                                                           \
+        for (int i = 0; i < input_size; i++)                                                                               \
+        {                                                                                                                  \
+            float gradient = input_gradient[i];                                                                            \
+            for (int k = sparse->row_offsets[i]; k < sparse->row_offsets[i + 1]; k++)                                      \
+            {                                                                                                              \
+                activations[sparse->columns[k]] += weights[k] * gradient;                                                  \
+            }                                                                                                              \
+        }                                                                                                                  \
+        for (int j = 0; j < net_inputs_size; j++)                                                                          \
+        {                                                                                                                  \
+            net_inputs[j] = activations[j] * func_deriv(net_inputs[j]);                                                    \
+        }                                                                                                                  \
+    }
+
+#define X(act, func, func_deriv) GENERATE_FC_SPARSE_FORWARD_PROP_INTO_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_FC_SPARSE_FORWARD_PROP_T_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#define X(act, func, func_deriv) GENERATE_FC_SPARSE_BACK_PROP_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+/* Gradients of the stored weights and the biases of a sparse layer, does not calculate gradients for the previous layer
+    @param input_gradient: gradients of the layer outputs
+    @param activations: activations feeding the layer
+*/
+void fc_sparse_gradients(float *input_gradient, float *activations, SparseLayer *sparse, int layer_size,
+                         float *gradient_weights, float *gradient_biases)
+{
+    for (int i = 0; i < layer_size; i++)
+    {
+        float gradient = input_gradient[i];
+        gradient_biases[i] += gradient;
+        for (int k = sparse->row_offsets[i]; k < sparse->row_offsets[i + 1]; k++)
+        {
+            gradient_weights[k] += gradient * activations[sparse->columns[k]];
+        }
+    }
+}
+
+/* fc_light_back_prop_into for a sparse layer
+    @param input_size: size of the sparse layer
+    @param output_layer_size: size of the previous layer, whose gradients are stored in output
+*/
+void fc_sparse_light_back_prop_into(float *input_gradient, float *weights, SparseLayer *sparse,
+                                    int input_size, int output_layer_size, uint32_t *deriv_mask, float *output)
+{
+    memset(output, 0, output_layer_size * sizeof(float));
+    for (int i = 0; i < input_size; i++)
+    {
+        float gradient = input_gradient[i];
+        for (int k = sparse->row_offsets[i]; k < sparse->row_offsets[i + 1]; k++)
+        {
+            output[sparse->columns[k]] += weights[k] * gradient;
+        }
+    }
+    deriv_mask_apply(output, deriv_mask, output_layer_size);
+}
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_sparse_forward_prop_into_##act;
+SparseForwardPropInto get_fc_sparse_forward_prop_into_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_sparse_forward_prop_into_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_sparse_forward_prop_t_##act;
+SparseForwardPropT get_fc_sparse_forward_prop_t_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_sparse_forward_prop_t_LINEAR;
+    }
+}
+#undef X
+
+#define X(act, func, func_deriv) \
+    case act:                    \
+        return fc_sparse_back_prop_##act;
+SparseBackProp get_fc_sparse_back_prop_variant(enum ActivationType activationType)
+{
+    switch (activationType)
+    {
+        ACTIVATION_MACRO_LIST
+    default:
+        printf("Error unknown activation type: defaulting to LINEAR\n");
+        return fc_sparse_back_prop_LINEAR;
+    }
+}
+#undef X
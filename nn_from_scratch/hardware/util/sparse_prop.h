@@ -0,0 +1,35 @@
+#ifndef SPARSE_PROP_H
+#define SPARSE_PROP_H
+#include <stdint.h>
+#include "activation_functions.h"
+#include "model_binding.h"
+
+/* Kernels of layers stored as compressed sparse rows, see SparseLayer. They only visit the stored weights, so the
+   multiply-accumulates drop with the sparsity. weights are the nnz values of the layer, gradient_weights has the same size.
+*/
+void fc_sparse_gradients(float *input_gradient, float *activations, SparseLayer *sparse, int layer_size,
+                         float *gradient_weights, float *gradient_biases);
+void fc_sparse_light_back_prop_into(float *input_gradient, float *weights, SparseLayer *sparse,
+                                    int input_size, int output_layer_size, uint32_t *deriv_mask, float *output);
+
+typedef void (*SparseForwardPropInto)(float *, float *, SparseLayer *, float *, int, float *);
+typedef float *(*SparseForwardPropT)(float *, float *, SparseLayer *, float *, int, float *, float *);
+typedef void (*SparseBackProp)(float *, float *, float *, float *, SparseLayer *, int, int, float *, float *);
+SparseForwardPropInto get_fc_sparse_forward_prop_into_variant(enum ActivationType activationType);
+SparseForwardPropT get_fc_sparse_forward_prop_t_variant(enum ActivationType activationType);
+SparseBackProp get_fc_sparse_back_prop_variant(enum ActivationType activationType);
+
+#define GENERATE_FC_SPARSE_PROP_PROTOTYPE_VARIANTS(act, func, func_deriv)                                             \
+    void fc_sparse_forward_prop_into_##act(float *input, float *weights, SparseLayer *sparse, float *biases,         \
+                                           int output_size, float *output);                                           \
+    float *fc_sparse_forward_prop_t_##act(float *input, float *weights, SparseLayer *sparse, float *biases,          \
+                                          int output_size, float *net_inputs, float *activations);                   \
+    void fc_sparse_back_prop_##act(float *input_gradient, float *activations, float *net_inputs, float *weights,     \
+                                   SparseLayer *sparse, int input_size, int net_inputs_size, float *gradient_weights, \
+                                   float *gradient_biases);
+
+#define X(act, func, func_deriv) GENERATE_FC_SPARSE_PROP_PROTOTYPE_VARIANTS(act, func, func_deriv)
+ACTIVATION_MACRO_LIST
+#undef X
+
+#endif
@@ -1,167 +1,376 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "track_memory.h"
+#ifdef ENABLE_HEAP_EMULATION
+#include "heap_emulator.h"
+#endif
 // undef to avoid recursive loop-call, when macro is defined from header
 #undef malloc
 #undef free
 #undef calloc
 
-// Define global variables to track memory allocation
-size_t total_allocated = 0;
-size_t total_freed = 0;
-size_t peak_allocated = 0;
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+static pthread_mutex_t tracker_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define TRACKER_LOCK() pthread_mutex_lock(&tracker_mutex)
+#define TRACKER_UNLOCK() pthread_mutex_unlock(&tracker_mutex)
+#else
+#define TRACKER_LOCK()
+#define TRACKER_UNLOCK()
+#endif
 
-size_t num_blocks = 0;
-size_t occupied_blocks = 0;
-MemoryBlock *headBlock = NULL;
-MemoryBlock *currBlock = NULL;
-void *tracked_malloc(size_t size)
+// twice the live blocks, so linear probing stays short
+#define BLOCK_SLOTS (2 * MAX_BLOCKS)
+#define SITE_SLOTS (2 * MAX_ALLOC_SITES)
+#define SIZE_BUCKETS 32
+
+typedef struct
 {
-    void *ptr = malloc(size);
-    if (ptr != NULL)
+    void *ptr; // NULL for an empty slot
+    size_t size;
+    int site; // index into sites, -1 when the site table was full
+} TrackedBlock;
+
+typedef struct
+{
+    const char *file; // NULL for an empty slot
+    const char *function;
+    int line;
+    size_t allocations;
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t total_bytes;
+} AllocSite;
+
+static TrackedBlock blocks[BLOCK_SLOTS];
+static AllocSite sites[SITE_SLOTS];
+static size_t size_histogram[SIZE_BUCKETS]; // bucket i counts sizes in [2^(i-1), 2^i), the last one everything larger
+
+static size_t total_allocated = 0;
+static size_t total_freed = 0;
+static size_t peak_allocated = 0;
+static size_t num_blocks = 0;
+static size_t occupied_blocks = 0;
+static int table_full_reported = 0;
+static size_t untracked_blocks = 0; // live blocks that did not fit in the table, still released by tracked_free
+
+static size_t hash_pointer(const void *ptr)
+{
+    uintptr_t x = (uintptr_t)ptr >> 3;
+    x ^= x >> 15;
+    x *= (uintptr_t)2654435761u;
+    x ^= x >> 13;
+    return (size_t)(x % BLOCK_SLOTS);
+}
+
+static size_t hash_site(const char *file, int line)
+{
+    uint32_t x = 2166136261u; // FNV-1a over the file name, then the line
+    for (const char *c = file; *c != '\0'; c++)
     {
-        MemoryBlock *block = (MemoryBlock *)malloc(sizeof(MemoryBlock));
-        block->ptr = ptr;
-        block->size = size;
-        block->next = NULL;
+        x = (x ^ (unsigned char)*c) * 16777619u;
+    }
+    x = (x ^ (uint32_t)line) * 16777619u;
+    return (size_t)(x % SITE_SLOTS);
+}
 
-        if (headBlock == NULL)
+/* finds or adds the site, -1 when the table is full. Literals of the same file are not always merged, so names are compared. */
+static int get_site(const char *file, int line, const char *function)
+{
+    size_t i = hash_site(file, line);
+    for (int n = 0; n < SITE_SLOTS; n++)
+    {
+        AllocSite *site = &sites[i];
+        if (site->file == NULL)
         {
-            headBlock = block;
-            currBlock = headBlock;
+            site->file = file;
+            site->function = function;
+            site->line = line;
+            return (int)i;
         }
-        else
+        if (site->line == line && (site->file == file || strcmp(site->file, file) == 0))
         {
-            currBlock->next = block;
-            currBlock = block;
+            return (int)i;
         }
-        occupied_blocks++;
-        num_blocks++;
-        total_allocated += size;
+        i = (i + 1 == SITE_SLOTS) ? 0 : i + 1;
+    }
+    return -1;
+}
 
-        if (total_allocated - total_freed > peak_allocated)
+static int size_bucket(size_t size)
+{
+    int bucket = 0;
+    while (size > 0 && bucket < SIZE_BUCKETS - 1)
+    {
+        size >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void track_block(void *ptr, size_t size, const char *file, int line, const char *function)
+{
+    TRACKER_LOCK();
+    size_t i = hash_pointer(ptr);
+    size_t probes = 0;
+    while (blocks[i].ptr != NULL && probes < BLOCK_SLOTS)
+    {
+        i = (i + 1 == BLOCK_SLOTS) ? 0 : i + 1;
+        probes++;
+    }
+    if (occupied_blocks >= MAX_BLOCKS || probes == BLOCK_SLOTS)
+    {
+        if (!table_full_reported)
         {
-            peak_allocated = total_allocated - total_freed;
+            fprintf(stderr, "Error: More than %d blocks in use, %s:%d is not tracked, increase MAX_BLOCKS\n", MAX_BLOCKS, file, line);
+            table_full_reported = 1;
         }
+        untracked_blocks++;
+        TRACKER_UNLOCK();
+        return;
     }
-    return ptr;
+    int site = get_site(file, line, function);
+    blocks[i].ptr = ptr;
+    blocks[i].size = size;
+    blocks[i].site = site;
+    if (site >= 0)
+    {
+        sites[site].allocations++;
+        sites[site].total_bytes += size;
+        sites[site].live_bytes += size;
+        if (sites[site].live_bytes > sites[site].peak_bytes)
+        {
+            sites[site].peak_bytes = sites[site].live_bytes;
+        }
+    }
+    size_histogram[size_bucket(size)]++;
+    occupied_blocks++;
+    num_blocks++;
+    total_allocated += size;
+    if (total_allocated - total_freed > peak_allocated)
+    {
+        peak_allocated = total_allocated - total_freed;
+    }
+    TRACKER_UNLOCK();
 }
 
-void *tracked_calloc(size_t num, size_t size)
+/* Removes the block from the table with backward shift deletion, so no tombstones build up in long runs.
+    A block missing from the table while blocks overflowed it is taken as one of those.
+    @return 1 when the block was tracked or overflowed the table
+*/
+static int untrack_block(void *ptr)
 {
-    void *ptr = calloc(num, size);
-    if (ptr != NULL)
+    TRACKER_LOCK();
+    size_t i = hash_pointer(ptr);
+    size_t probes = 0;
+    while (blocks[i].ptr != ptr)
+    {
+        if (blocks[i].ptr == NULL || ++probes == BLOCK_SLOTS)
+        {
+            int overflowed = untracked_blocks > 0;
+            untracked_blocks -= overflowed;
+            TRACKER_UNLOCK();
+            return overflowed;
+        }
+        i = (i + 1 == BLOCK_SLOTS) ? 0 : i + 1;
+    }
+    total_freed += blocks[i].size;
+    occupied_blocks--;
+    if (blocks[i].site >= 0)
     {
-        MemoryBlock *block = (MemoryBlock *)malloc(sizeof(MemoryBlock));
-        block->ptr = ptr;
-        block->size = size * num;
-        block->next = NULL;
+        sites[blocks[i].site].live_bytes -= blocks[i].size;
+    }
 
-        if (headBlock == NULL)
+    size_t j = i;
+    while (1)
+    {
+        j = (j + 1 == BLOCK_SLOTS) ? 0 : j + 1;
+        if (blocks[j].ptr == NULL)
         {
-            headBlock = block;
-            currBlock = headBlock;
+            break;
         }
-        else
+        // move the entry into the hole unless its home slot lies cyclically in (i, j]
+        size_t home = hash_pointer(blocks[j].ptr);
+        int stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays)
         {
-            currBlock->next = block;
-            currBlock = block;
+            blocks[i] = blocks[j];
+            i = j;
         }
+    }
+    blocks[i].ptr = NULL;
+    TRACKER_UNLOCK();
+    return 1;
+}
 
-        occupied_blocks++;
-        num_blocks++;
-        total_allocated += size * num;
+/* the system allocator serves everything while no heap emulation runs, and what did not fit in the emulated heap */
+static void *allocate(size_t size, const char *file, int line, const char *function)
+{
+#ifdef ENABLE_HEAP_EMULATION
+    void *ptr = heap_malloc(size, file, line, function);
+    if (ptr != NULL)
+    {
+        return ptr;
+    }
+#else
+    (void)file;
+    (void)line;
+    (void)function;
+#endif
+    return malloc(size);
+}
 
-        if (total_allocated - total_freed > peak_allocated)
-        {
-            peak_allocated = total_allocated - total_freed;
-        }
+void *tracked_malloc(size_t size, const char *file, int line, const char *function)
+{
+    void *ptr = allocate(size, file, line, function);
+    if (ptr != NULL)
+    {
+        track_block(ptr, size, file, line, function);
     }
     return ptr;
 }
-void tracked_free(void *ptr)
+
+void *tracked_calloc(size_t num, size_t size, const char *file, int line, const char *function)
 {
-    MemoryBlock *block = headBlock;
-    MemoryBlock *prevBlock = NULL;
+#ifdef ENABLE_HEAP_EMULATION
+    if (size != 0 && num > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+    void *ptr = allocate(num * size, file, line, function);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, num * size);
+    }
+#else
+    void *ptr = calloc(num, size);
+#endif
+    if (ptr != NULL)
+    {
+        track_block(ptr, size * num, file, line, function);
+    }
+    return ptr;
+}
 
-    if (block == NULL)
+void tracked_free(void *ptr, const char *file, int line, const char *function)
+{
+    if (ptr == NULL)
     {
-        printf("Error: Attempted to free unallocated memory at address %p\n", ptr);
         return;
     }
-
-    // If the block to be freed is the first block
-    if (block->ptr == ptr)
+    // untracked before the memory is released, so another thread cannot get the address back while it is still in the table
+    if (!untrack_block(ptr))
     {
-        headBlock = block->next;
-        total_freed += block->size;
-        occupied_blocks--;
-        if (total_allocated - total_freed > peak_allocated)
-        {
-            peak_allocated = total_allocated - total_freed;
-        }
-        free(ptr);
-        free(block);
+        fprintf(stderr, "Error: Attempted to free untracked memory at address %p in %s (%s:%d)\n", ptr, function, file, line);
         return;
     }
-
-    // Traverse the linked list to find the block to free
-    while (block != NULL)
+#ifdef ENABLE_HEAP_EMULATION
+    if (heap_free(ptr))
     {
-        if (block->ptr == ptr)
-        {
-            // Update bookkeeping information
-            total_freed += block->size;
-            occupied_blocks--;
-
-            if (total_allocated - total_freed > peak_allocated)
-            {
-                peak_allocated = total_allocated - total_freed;
-            }
-
-            // Update the previous block's next pointer
-            prevBlock->next = block->next;
-
-            // If the current block is the current allocation block,
-            // update the currBlock pointer
-            if (block == currBlock)
-            {
-                currBlock = prevBlock;
-            }
-
-            // Free the memory block and the allocated memory
-            free(ptr);
-            free(block);
-            return;
-        }
-        prevBlock = block;
-        block = block->next;
+        return;
     }
-
-    // If the pointer does not match any tracked memory block
-    printf("Error: Attempted to free untracked memory at address %p\n", ptr);
+#endif
+    free(ptr);
 }
 
 /* Will reset memory tracking numbers, if everything is freed*/
 void reset_memory_tracking()
 {
-    if (headBlock != NULL)
+    TRACKER_LOCK();
+    if (occupied_blocks != 0)
     {
-        printf("Error: Could not reset memory tracking, blocks still being used! \n");
+        TRACKER_UNLOCK();
+        fprintf(stderr, "Error: Could not reset memory tracking, blocks still being used! \n");
         return;
     }
     total_allocated = 0;
     total_freed = 0;
     num_blocks = 0;
-    occupied_blocks = 0;
     peak_allocated = 0;
+    table_full_reported = 0;
+    memset(sites, 0, sizeof(sites));
+    memset(size_histogram, 0, sizeof(size_histogram));
+    TRACKER_UNLOCK();
 }
+/* Peak of the memory in use since the tracking or the peak was last reset, in bytes */
+size_t get_peak_memory()
+{
+    TRACKER_LOCK();
+    size_t peak = peak_allocated;
+    TRACKER_UNLOCK();
+    return peak;
+}
+
+/* Restarts the peak from the memory in use, to measure the peak of a single phase */
+void reset_peak_memory()
+{
+    TRACKER_LOCK();
+    peak_allocated = total_allocated - total_freed;
+    TRACKER_UNLOCK();
+}
+
 void print_memory()
 {
     // Print memory usage
+    TRACKER_LOCK();
     printf("Peak allocated memory: %zu bytes\n", peak_allocated);
     printf("Total allocated memory: %zu bytes\n", total_allocated);
     printf("Total freed memory: %zu bytes\n", total_freed);
-    printf("Number of memory blocks used: %d\n", num_blocks);
-    printf("Total blocks still being used: %d\n", occupied_blocks);
+    printf("Number of memory blocks used: %zu\n", num_blocks);
+    printf("Total blocks still being used: %zu\n", occupied_blocks);
+    if (untracked_blocks > 0)
+    {
+        printf("Blocks in use that did not fit in the table: %zu\n", untracked_blocks);
+    }
+    TRACKER_UNLOCK();
+}
+
+static int compare_site_peak(const void *a, const void *b)
+{
+    size_t peak_a = sites[*(const int *)a].peak_bytes;
+    size_t peak_b = sites[*(const int *)b].peak_bytes;
+    return (peak_a < peak_b) - (peak_a > peak_b);
+}
+
+/* Prints print_memory, then the call sites by peak live bytes and a histogram of the allocation sizes */
+void print_memory_report()
+{
+    print_memory();
+    TRACKER_LOCK();
+    static int order[SITE_SLOTS];
+    int n_sites = 0;
+    for (int i = 0; i < SITE_SLOTS; i++)
+    {
+        if (sites[i].file != NULL)
+        {
+            order[n_sites++] = i;
+        }
+    }
+    qsort(order, n_sites, sizeof(int), compare_site_peak);
+    printf("Call sites by peak live memory:\n");
+    for (int i = 0; i < n_sites; i++)
+    {
+        AllocSite *site = &sites[order[i]];
+        printf("  %s:%d (%s): peak %zu bytes, live %zu bytes, %zu allocations of %zu bytes\n", site->file, site->line,
+               site->function, site->peak_bytes, site->live_bytes, site->allocations, site->total_bytes);
+    }
+    printf("Allocation sizes:\n");
+    for (int i = 0; i < SIZE_BUCKETS; i++)
+    {
+        if (size_histogram[i] == 0)
+        {
+            continue;
+        }
+        if (i == SIZE_BUCKETS - 1)
+        {
+            printf("  >= %zu bytes: %zu\n", (size_t)1 << (SIZE_BUCKETS - 2), size_histogram[i]);
+        }
+        else
+        {
+            printf("  < %zu bytes: %zu\n", (size_t)1 << i, size_histogram[i]);
+        }
+    }
+    TRACKER_UNLOCK();
 }
@@ -3,20 +3,23 @@
 #include "config.h"
 #include <stddef.h>
 #include <stdint.h>
-void tracked_free(void *ptr);
-void *tracked_calloc(size_t num, size_t size);
-void *tracked_malloc(size_t size);
+#include <stdlib.h> // declared before the macros below rename malloc, calloc and free
+/* Memory tracker replacing malloc, calloc and free with ENABLE_TRACK_MEMORY.
+   Live blocks are kept in an open-addressing hash table of MAX_BLOCKS entries, so tracking and freeing take constant time.
+   Every block is attributed to the call site that allocated it, and the bookkeeping is guarded by a mutex where pthreads
+   are available, so tracking can stay on in parallel training and long runs.
+*/
+void tracked_free(void *ptr, const char *file, int line, const char *function);
+void *tracked_calloc(size_t num, size_t size, const char *file, int line, const char *function);
+void *tracked_malloc(size_t size, const char *file, int line, const char *function);
 void print_memory();
+void print_memory_report();
 void reset_memory_tracking();
+size_t get_peak_memory();
+void reset_peak_memory();
 #ifdef ENABLE_TRACK_MEMORY
-#define malloc(size) tracked_malloc(size)
-#define calloc(num, size) tracked_calloc(num, size)
-#define free(ptr) tracked_free(ptr)
+#define malloc(size) tracked_malloc(size, __FILE__, __LINE__, __func__)
+#define calloc(num, size) tracked_calloc(num, size, __FILE__, __LINE__, __func__)
+#define free(ptr) tracked_free(ptr, __FILE__, __LINE__, __func__)
 #endif
-typedef struct MemoryBlock
-{
-    void *ptr;
-    size_t size;
-    struct MemoryBlock *next;
-} MemoryBlock;
 #endif
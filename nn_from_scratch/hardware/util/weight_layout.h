@@ -0,0 +1,25 @@
+#ifndef WEIGHT_LAYOUT_H
+#define WEIGHT_LAYOUT_H
+
+/* INPUT_MAJOR: weights[i + j * output_size], as exported from Keras.
+   OUTPUT_MAJOR_PACKED: weights[i * FC_PACKED_STRIDE(input_size) + j], so each neuron's input weights are
+   contiguous. Rows are zero padded to FC_PACKED_WIDTH floats and the layers of a model share one block
+   aligned to FC_PACKED_ALIGNMENT bytes.
+*/
+enum WeightLayout
+{
+    INPUT_MAJOR,
+    OUTPUT_MAJOR_PACKED
+};
+
+#ifndef FC_PACKED_WIDTH
+#define FC_PACKED_WIDTH 16
+#endif
+
+#ifndef FC_PACKED_ALIGNMENT
+#define FC_PACKED_ALIGNMENT 64
+#endif
+
+#define FC_PACKED_STRIDE(n) ((((n) + FC_PACKED_WIDTH - 1) / FC_PACKED_WIDTH) * FC_PACKED_WIDTH)
+
+#endif
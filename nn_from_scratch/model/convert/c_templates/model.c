@@ -3,6 +3,7 @@
 
 {layer_weights}
 {layer_biases}
+{layer_sparse}
 
 int layers_size[N_LAYERS] = {{layers_size}};
 float* layers_weights[N_LAYERS] = {{layers_weights}};
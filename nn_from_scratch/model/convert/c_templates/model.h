@@ -2,11 +2,12 @@
 #define MODEL_H
 
 #include <cstdint>
+#include "../util/weight_layout.h"
 
 #define INPUT_SIZE {input_size}
 #define OUTPUT_SIZE {output_size}
 #define N_LAYERS {n_layers}
-
+{weights_layout}
 {layers_size}
 
 enum ActivationType {
@@ -19,4 +20,6 @@ extern float* layers_weights[N_LAYERS];     // shape: (n_layers)(input_size * ou
 extern float* layers_biases[N_LAYERS];      // shape: (n_layers)(output_size)
 extern enum ActivationType layers_activation[N_LAYERS];
 
+{sparse_layers}
+
 #endif
@@ -0,0 +1,7 @@
+#include "model_specialized.h"
+#include "../util/activation_functions.h"
+
+{weights_declarations}
+void specialized_model_predict(float *input, float *output)
+{
+{predict_body}}
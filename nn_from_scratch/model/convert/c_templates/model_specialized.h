@@ -0,0 +1,18 @@
+#ifndef MODEL_SPECIALIZED_H
+#define MODEL_SPECIALIZED_H
+
+#include "../util/optimizer.h"
+
+/* Kernels generated for this model by model_codegen.py. Layer sizes are compile time constants and the
+   activations are inlined. They work on the {weights_layout} weights of model.c and keep their scratch in
+   static buffers, so they are not reentrant.
+*/
+#define S_INPUT_SIZE {input_size}
+#define S_OUTPUT_SIZE {output_size}
+#define S_N_LAYERS {n_layers}
+
+void specialized_model_predict(float *input, float *output);
+void specialized_model_calc_gradients(float *input, float *actual, float **gradients_weights, float **gradients_biases);
+void specialized_model_train(Optimizer *optimizer, float (*samples_x)[S_INPUT_SIZE], float (*samples_y)[S_OUTPUT_SIZE]);
+
+#endif
@@ -0,0 +1,15 @@
+#include <string.h>
+#include "model_specialized.h"
+#include "../util/activation_functions.h"
+#include "../util/loss_functions.h"
+#include "../util/config.h"
+
+{weights_declarations}
+{scratch_declarations}
+void specialized_model_calc_gradients(float *input, float *actual, float **gradients_weights, float **gradients_biases)
+{
+{calc_gradients_body}}
+
+void specialized_model_train(Optimizer *optimizer, float (*samples_x)[S_INPUT_SIZE], float (*samples_y)[S_OUTPUT_SIZE])
+{
+{train_body}}
@@ -0,0 +1,13 @@
+#include <stdint.h>
+#include "quant_model.h"
+
+{layer_arrays}
+
+int q_layers_size[Q_N_LAYERS] = {{layers_size}};
+int8_t* q_layers_weights[Q_N_LAYERS] = {{layers_weights}};
+int32_t* q_layers_biases[Q_N_LAYERS] = {{layers_biases}};
+int32_t* q_layers_multipliers[Q_N_LAYERS] = {{layers_multipliers}};
+int32_t* q_layers_shifts[Q_N_LAYERS] = {{layers_shifts}};
+int q_layers_per_channel[Q_N_LAYERS] = {{layers_per_channel}};
+int32_t q_zero_points[Q_N_LAYERS + 1] = {{zero_points}};
+enum ActivationType q_layers_activation[Q_N_LAYERS] = {{layers_activation}};
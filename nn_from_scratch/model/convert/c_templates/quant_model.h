@@ -0,0 +1,22 @@
+#ifndef QUANT_MODEL_H
+#define QUANT_MODEL_H
+
+#include <stdint.h>
+#include "../util/activation_functions.h"
+
+#define Q_INPUT_SIZE {input_size}
+#define Q_OUTPUT_SIZE {output_size}
+#define Q_N_LAYERS {n_layers}
+#define Q_INPUT_SCALE {input_scale}f
+#define Q_OUTPUT_SCALE {output_scale}f
+
+extern int q_layers_size[Q_N_LAYERS];
+extern int8_t* q_layers_weights[Q_N_LAYERS];        // shape: (n_layers)(input_size * output_size)
+extern int32_t* q_layers_biases[Q_N_LAYERS];        // shape: (n_layers)(output_size)
+extern int32_t* q_layers_multipliers[Q_N_LAYERS];   // shape: (n_layers)(output_size if per channel else 1)
+extern int32_t* q_layers_shifts[Q_N_LAYERS];        // shape: (n_layers)(output_size if per channel else 1)
+extern int q_layers_per_channel[Q_N_LAYERS];
+extern int32_t q_zero_points[Q_N_LAYERS + 1];       // input zero point, then the output zero point of each layer
+extern enum ActivationType q_layers_activation[Q_N_LAYERS];
+
+#endif
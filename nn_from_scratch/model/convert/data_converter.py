@@ -1,9 +1,17 @@
 import argparse
 import os
+import struct
 
 import numpy as np
 import tensorflow as tf
 
+# binary dataset file, see util/data_loader.h
+DATASET_FILE_MAGIC = b"NNDS"
+DATASET_FILE_VERSION = 1
+DATASET_FILE_BYTE_ORDER = 0x01020304
+DATASET_FILE_HEADER = struct.Struct("<4s7IQ")
+DATASET_FILE_HEADER_SIZE = 64
+
 
 def convert_data_to_c(data_x, data_y, templates_dir, save_dir, file_name="data", var_name="samples"):
     """
@@ -50,11 +58,53 @@ def convert_data_to_c(data_x, data_y, templates_dir, save_dir, file_name="data",
         f.write(data_c)
 
 
+def convert_data_to_binary(data_x, data_y, save_path, chunk_samples=1024, append=False):
+    """
+    Write the data to the binary dataset file streamed by the data loader in util/data_loader.c.
+    Samples are stored as records of the input followed by the output, grouped in chunks of chunk_samples records.
+    The loader shuffles the order of the chunks and of the samples within a chunk, so a chunk should be much larger
+    than a batch but small enough to be read at once.
+
+    Args:
+        data_x (np.ndarray): Input data.
+        data_y (np.ndarray): Output data.
+        save_path (str): Path of the binary file to write.
+        chunk_samples (int): Number of samples per chunk.
+        append (bool): Whether to append the samples to an existing file with the same shape, for datasets too
+            large to convert at once.
+    """
+    assert data_x.shape[0] == data_y.shape[0], "The number of samples in data_x and data_y should be equal"
+    assert data_x.ndim == 2, "data_x should be a 2D array"
+    assert data_y.ndim == 2, "data_y should be a 2D array"
+
+    records = np.concatenate([data_x, data_y], axis=1).astype("<f4")
+    n_samples = records.shape[0]
+    if append and os.path.exists(save_path):
+        with open(save_path, "rb") as f:
+            fields = DATASET_FILE_HEADER.unpack(f.read(DATASET_FILE_HEADER.size))
+        if fields[0] != DATASET_FILE_MAGIC or fields[4] != data_x.shape[1] or fields[5] != data_y.shape[1]:
+            raise ValueError("{} is not a dataset file with the same shape".format(save_path))
+        chunk_samples = fields[6]
+        n_samples += fields[8]
+        mode = "r+b"
+    else:
+        os.makedirs(os.path.dirname(save_path) or ".", exist_ok=True)
+        mode = "wb"
+
+    header = DATASET_FILE_HEADER.pack(DATASET_FILE_MAGIC, DATASET_FILE_VERSION, DATASET_FILE_BYTE_ORDER, DATASET_FILE_HEADER_SIZE,
+                                      data_x.shape[1], data_y.shape[1], chunk_samples, 0, n_samples)
+    with open(save_path, mode) as f:
+        f.write(header.ljust(DATASET_FILE_HEADER_SIZE, b"\0"))
+        f.seek(0, os.SEEK_END)
+        f.write(records.tobytes())
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--model_path", type=str, required=True, help="Path to the model")
     parser.add_argument("--templates_dir", type=str, default="nn_from_scratch/model/c_templates", help="Path to the directory with the templates")
     parser.add_argument("--save_dir", type=str, default="c_files", help="Path to the directory to save the converted model")
+    parser.add_argument("--binary", action="store_true", help="Also write the samples to the binary dataset file data.bin")
     args = parser.parse_args()
 
     model = tf.keras.models.load_model(args.model_path)
@@ -64,3 +114,5 @@ if __name__ == "__main__":
     random_data_y = model.predict(random_data_x)
 
     convert_data_to_c(random_data_x, random_data_y, args.templates_dir, args.save_dir)
+    if args.binary:
+        convert_data_to_binary(random_data_x, random_data_y, os.path.join(args.save_dir, "data.bin"))
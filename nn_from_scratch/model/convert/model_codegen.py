@@ -0,0 +1,315 @@
+import argparse
+import os
+
+import tensorflow as tf
+
+
+def get_layers_shape(model):
+    """
+    Extract the shape of the dense layers of the model.
+
+    Args:
+        model (tf.keras.Model): The model.
+
+    Returns:
+        list[dict]: For each layer the input size, the number of neurons and the activation.
+    """
+    layers_shape = []
+    input_size = model.layers[0].input.shape[1]
+    for layer in model.layers:
+        if not isinstance(layer, tf.keras.layers.Dense):
+            raise ValueError("Only Dense layers are supported")
+        if layer.activation.__name__ not in ["linear", "relu"]:
+            raise ValueError("Only linear and relu activations are supported")
+
+        layers_shape.append({"in": input_size, "n": layer.units, "activation": layer.activation.__name__.upper()})
+        input_size = layer.units
+    return layers_shape
+
+
+class LayerCode:
+    """
+    Indexing of the weights of one layer in the layout emitted by model_converter.py.
+
+    INPUT_MAJOR: weights[i + j * n]. OUTPUT_MAJOR_PACKED: weights[i * stride + j], rows padded to packed_width.
+    i is the neuron of the layer and j its input.
+    """
+
+    def __init__(self, index, layer, packed, packed_width, packed_offset):
+        self.index = index
+        self.n_in = layer["in"]
+        self.n = layer["n"]
+        self.activation = layer["activation"]
+        self.packed = packed
+        self.stride = (self.n_in + packed_width - 1) // packed_width * packed_width if packed else self.n_in
+        self.offset = packed_offset if packed else 0
+        self.array = "layers_weights_packed" if packed else "layer_{}_weights".format(index)
+        self.weights = "{} + {}".format(self.array, self.offset) if self.offset else self.array
+        self.biases = "layer_{}_biases".format(index)
+
+    @property
+    def n_weights(self):
+        return self.n * self.stride
+
+    def flat_index(self, i, j, offset=0):
+        """C index of (i, j) plus offset, i is a C expression and j a C expression or an int that is folded."""
+        if self.packed:
+            terms = ["{} * {}".format(i, self.stride)]
+            constant = offset + (j if isinstance(j, int) else 0)
+        else:
+            terms = [i]
+            constant = offset + (j * self.n if isinstance(j, int) else 0)
+        if not isinstance(j, int):
+            terms.append(j if self.packed else "{} * {}".format(j, self.n))
+        if constant:
+            terms.append(str(constant))
+        return " + ".join(terms)
+
+    def weight(self, i, j):
+        """C expression of weight (i, j)"""
+        return "{}[{}]".format(self.array, self.flat_index(i, j, self.offset))
+
+    def gradient(self, i, j):
+        """C expression of the gradient of weight (i, j), the gradients of a layer use the layout of its weights"""
+        return "gradients_weights[{}][{}]".format(self.index, self.flat_index(i, j))
+
+
+def emit_forward(code, input_name, net_name, output_name, unroll_max, indent="    "):
+    """
+    Forward pass of one layer. When net_name is given the net inputs are stored as well (training).
+    Inputs are unrolled when there are at most unroll_max of them, then each neuron is one expression.
+    """
+    act = code.activation
+    c = ""
+    if code.n_in <= unroll_max:
+        # every term of a neuron is a constant offset, the loop over the neurons vectorizes for INPUT_MAJOR
+        c += indent + "for (int i = 0; i < {}; i++)\n".format(code.n)
+        c += indent + "{\n"
+        c += indent + "    float sum = {}[i];\n".format(code.biases)
+        for j in range(code.n_in):
+            c += indent + "    sum += {}[{}] * {};\n".format(input_name, j, code.weight("i", j))
+        if net_name is not None:
+            c += indent + "    {}[i] = sum;\n".format(net_name)
+        c += indent + "    {}[i] = {}_MACRO(sum);\n".format(output_name, act)
+        c += indent + "}\n"
+    elif code.packed:
+        # rows are contiguous, one dot product per neuron
+        c += indent + "for (int i = 0; i < {}; i++)\n".format(code.n)
+        c += indent + "{\n"
+        c += indent + "    float sum = 0;\n"
+        c += indent + "    for (int j = 0; j < {}; j++)\n".format(code.n_in)
+        c += indent + "    {\n"
+        c += indent + "        sum += {}[j] * {};\n".format(input_name, code.weight("i", "j"))
+        c += indent + "    }\n"
+        c += indent + "    sum += {}[i];\n".format(code.biases)
+        if net_name is not None:
+            c += indent + "    {}[i] = sum;\n".format(net_name)
+        c += indent + "    {}[i] = {}_MACRO(sum);\n".format(output_name, act)
+        c += indent + "}\n"
+    else:
+        # columns are contiguous, accumulate one input at a time over all neurons
+        acc = net_name if net_name is not None else output_name
+        c += indent + "for (int i = 0; i < {}; i++)\n".format(code.n)
+        c += indent + "{\n"
+        c += indent + "    {}[i] = {}[i];\n".format(acc, code.biases)
+        c += indent + "}\n"
+        c += indent + "for (int j = 0; j < {}; j++)\n".format(code.n_in)
+        c += indent + "{\n"
+        c += indent + "    float x = {}[j];\n".format(input_name)
+        c += indent + "    for (int i = 0; i < {}; i++)\n".format(code.n)
+        c += indent + "    {\n"
+        c += indent + "        {}[i] += x * {};\n".format(acc, code.weight("i", "j"))
+        c += indent + "    }\n"
+        c += indent + "}\n"
+        c += indent + "for (int i = 0; i < {}; i++)\n".format(code.n)
+        c += indent + "{\n"
+        c += indent + "    {}[i] = {}_MACRO({}[i]);\n".format(output_name, act, acc)
+        c += indent + "}\n"
+    return c
+
+
+def emit_backward(code, prev_code, delta_name, prev_activations, prev_delta_name, indent="    "):
+    """
+    Gradients of one layer from its deltas. When prev_code is given the deltas of the previous layer are computed
+    into prev_delta_name, which holds its net inputs on entry.
+    """
+    c = ""
+    gb = "gradients_biases[{}]".format(code.index)
+    c += indent + "for (int i = 0; i < {}; i++)\n".format(code.n)
+    c += indent + "{\n"
+    c += indent + "    {}[i] += {}[i];\n".format(gb, delta_name)
+    c += indent + "}\n"
+    if not code.packed:
+        # one contiguous column of weights per input
+        c += indent + "for (int j = 0; j < {}; j++)\n".format(code.n_in)
+        c += indent + "{\n"
+        c += indent + "    float activation = {}[j];\n".format(prev_activations)
+        if prev_code is not None:
+            c += indent + "    float sum = 0;\n"
+        c += indent + "    for (int i = 0; i < {}; i++)\n".format(code.n)
+        c += indent + "    {\n"
+        c += indent + "        {} += {}[i] * activation;\n".format(code.gradient("i", "j"), delta_name)
+        if prev_code is not None:
+            c += indent + "        sum += {} * {}[i];\n".format(code.weight("i", "j"), delta_name)
+        c += indent + "    }\n"
+        if prev_code is not None:
+            c += indent + "    {0}[j] = sum * {1}_DERIV_MACRO({0}[j]);\n".format(prev_delta_name, prev_code.activation)
+        c += indent + "}\n"
+        return c
+
+    # one contiguous row of weights per neuron, the deltas of the previous layer are summed over the rows
+    if prev_code is not None:
+        c += indent + "memset(delta_sum, 0, {} * sizeof(float));\n".format(code.n_in)
+    c += indent + "for (int i = 0; i < {}; i++)\n".format(code.n)
+    c += indent + "{\n"
+    c += indent + "    float gradient = {}[i];\n".format(delta_name)
+    c += indent + "    for (int j = 0; j < {}; j++)\n".format(code.n_in)
+    c += indent + "    {\n"
+    c += indent + "        {} += gradient * {}[j];\n".format(code.gradient("i", "j"), prev_activations)
+    if prev_code is not None:
+        c += indent + "        delta_sum[j] += {} * gradient;\n".format(code.weight("i", "j"))
+    c += indent + "    }\n"
+    c += indent + "}\n"
+    if prev_code is not None:
+        c += indent + "for (int j = 0; j < {}; j++)\n".format(code.n_in)
+        c += indent + "{\n"
+        c += indent + "    {0}[j] = delta_sum[j] * {1}_DERIV_MACRO({0}[j]);\n".format(prev_delta_name, prev_code.activation)
+        c += indent + "}\n"
+    return c
+
+
+def generate_specialized_c(model_path, templates_dir, save_dir, packed=False, packed_width=16, unroll_max=16, verbose=True,
+                           sparse=False, sparse_layers=None):
+    """
+    Generate C kernels specialized for the model (model_predict.c, model_train.c and model_specialized.h).
+    They use the weights emitted by model_converter.py, so convert_model_to_c has to be run with the same layout.
+    The kernels index the weights of every layer densely, models converted with sparse layers are rejected.
+
+    Args:
+        model_path (str): Path to the model.
+        templates_dir (str): Path to the directory with the templates.
+        save_dir (str): Path to the directory to save the generated code.
+        packed (bool): Whether the weights were converted in the packed output-major layout.
+        packed_width (int): Row padding of the packed layout, has to match the converter and FC_PACKED_WIDTH.
+        unroll_max (int): Layers with at most this many inputs get the loop over their inputs unrolled.
+        verbose (bool): Whether to print the generated files.
+        sparse (bool): Whether convert_model_to_c was run with sparse, which may store layers as compressed sparse rows.
+        sparse_layers (list): The sparse_layers convert_model_to_c was run with.
+    """
+    if sparse or sparse_layers:
+        raise ValueError("The specialized kernels need dense weights, convert the model without sparse layers")
+    model = tf.keras.models.load_model(model_path)
+    layers_shape = get_layers_shape(model)
+
+    codes = []
+    packed_offset = 0
+    for i, layer in enumerate(layers_shape):
+        code = LayerCode(i, layer, packed, packed_width, packed_offset)
+        packed_offset += code.n_weights
+        codes.append(code)
+    n_layers = len(codes)
+    input_size = codes[0].n_in
+    output_size = codes[-1].n
+
+    if packed:
+        weights_declarations = "extern float layers_weights_packed[];\n"
+    else:
+        weights_declarations = "".join("extern float layer_{}_weights[];\n".format(i) for i in range(n_layers))
+    weights_declarations += "".join("extern float layer_{}_biases[];\n".format(i) for i in range(n_layers))
+
+    # prediction: hidden layers write to stack buffers, the last layer to the output
+    predict_body = ""
+    for code in codes[:-1]:
+        predict_body += "    float layer_{}_output[{}];\n".format(code.index, code.n)
+    for code in codes:
+        input_name = "input" if code.index == 0 else "layer_{}_output".format(code.index - 1)
+        output_name = "output" if code.index == n_layers - 1 else "layer_{}_output".format(code.index)
+        predict_body += "    // layer {}: {} -> {}, {}\n".format(code.index, code.n_in, code.n, code.activation)
+        predict_body += emit_forward(code, input_name, None, output_name, unroll_max)
+
+    # training: net inputs (overwritten with the deltas) and activations of every layer in static buffers
+    scratch_declarations = ""
+    for code in codes:
+        scratch_declarations += "static float layer_{0}_net[{1}];\nstatic float layer_{0}_activations[{1}];\n".format(code.index, code.n)
+    if packed and n_layers > 1:
+        scratch_declarations += "static float delta_sum[{}];\n".format(max(code.n_in for code in codes[1:]))
+    for code in codes:
+        scratch_declarations += "static float layer_{}_gradient_weights[{}];\n".format(code.index, code.n_weights)
+        scratch_declarations += "static float layer_{}_gradient_biases[{}];\n".format(code.index, code.n)
+    scratch_declarations += "static float *batch_gradients_weights[S_N_LAYERS] = {{{}}};\n".format(
+        ", ".join("layer_{}_gradient_weights".format(i) for i in range(n_layers)))
+    scratch_declarations += "static float *batch_gradients_biases[S_N_LAYERS] = {{{}}};\n".format(
+        ", ".join("layer_{}_gradient_biases".format(i) for i in range(n_layers)))
+
+    calc_gradients_body = ""
+    for code in codes:
+        input_name = "input" if code.index == 0 else "layer_{}_activations".format(code.index - 1)
+        calc_gradients_body += "    // layer {}: {} -> {}, {}\n".format(code.index, code.n_in, code.n, code.activation)
+        calc_gradients_body += emit_forward(code, input_name, "layer_{}_net".format(code.index),
+                                            "layer_{}_activations".format(code.index), unroll_max)
+    last = codes[-1]
+    calc_gradients_body += "\n    float loss_deriv = MSE_derivative(layer_{}_activations, actual, {});\n".format(last.index, output_size)
+    calc_gradients_body += "    for (int i = 0; i < {}; i++)\n    {{\n".format(output_size)
+    calc_gradients_body += "        layer_{0}_net[i] = loss_deriv * {1}_DERIV_MACRO(layer_{0}_net[i]);\n    }}\n".format(last.index, last.activation)
+    for code in reversed(codes):
+        prev_code = codes[code.index - 1] if code.index > 0 else None
+        prev_activations = "layer_{}_activations".format(code.index - 1) if prev_code is not None else "input"
+        prev_delta = "layer_{}_net".format(code.index - 1) if prev_code is not None else None
+        calc_gradients_body += "    // gradients of layer {}\n".format(code.index)
+        calc_gradients_body += emit_backward(code, prev_code, "layer_{}_net".format(code.index), prev_activations, prev_delta)
+
+    train_body = ""
+    for code in codes:
+        train_body += "    memset(layer_{0}_gradient_weights, 0, sizeof(layer_{0}_gradient_weights));\n".format(code.index)
+        train_body += "    memset(layer_{0}_gradient_biases, 0, sizeof(layer_{0}_gradient_biases));\n".format(code.index)
+    train_body += "    for (int s = 0; s < BATCH_SIZE; s++)\n    {\n"
+    train_body += "        specialized_model_calc_gradients(samples_x[s], samples_y[s], batch_gradients_weights, batch_gradients_biases);\n    }\n"
+    train_body += "    Optimizer default_optimizer;\n    if (optimizer == NULL)\n    {\n"
+    train_body += "        default_optimizer = get_default_optimizer();\n        optimizer = &default_optimizer;\n    }\n"
+    train_body += "    optimizer_next_step(optimizer);\n"
+    for code in codes:
+        train_body += "    optimizer_update(optimizer, {}, 0, {}, layer_{}_gradient_biases, {});\n".format(
+            2 * code.index + 1, code.biases, code.index, code.n)
+        train_body += "    optimizer_update(optimizer, {}, 0, {}, layer_{}_gradient_weights, {});\n".format(
+            2 * code.index, code.weights, code.index, code.n_weights)
+
+    with open(os.path.join(templates_dir, "model_specialized.h"), "r") as f:
+        model_h = f.read()
+    with open(os.path.join(templates_dir, "model_predict.c"), "r") as f:
+        predict_c = f.read()
+    with open(os.path.join(templates_dir, "model_train.c"), "r") as f:
+        train_c = f.read()
+
+    model_h = model_h.replace("{input_size}", str(input_size))
+    model_h = model_h.replace("{output_size}", str(output_size))
+    model_h = model_h.replace("{n_layers}", str(n_layers))
+    model_h = model_h.replace("{weights_layout}", "OUTPUT_MAJOR_PACKED" if packed else "INPUT_MAJOR")
+    predict_c = predict_c.replace("{weights_declarations}", weights_declarations)
+    predict_c = predict_c.replace("{predict_body}", predict_body)
+    train_c = train_c.replace("{weights_declarations}", weights_declarations)
+    train_c = train_c.replace("{scratch_declarations}", scratch_declarations)
+    train_c = train_c.replace("{calc_gradients_body}", calc_gradients_body)
+    train_c = train_c.replace("{train_body}", train_body)
+
+    os.makedirs(save_dir, exist_ok=True)
+    for name, content in [("model_specialized.h", model_h), ("model_predict.c", predict_c), ("model_train.c", train_c)]:
+        with open(os.path.join(save_dir, name), "w") as f:
+            f.write(content)
+        if verbose:
+            print("Generated {}".format(os.path.join(save_dir, name)))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--model_path", type=str, required=True, help="Path to the model")
+    parser.add_argument("--templates_dir", type=str, default="nn_from_scratch/model/c_templates", help="Path to the directory with the templates")
+    parser.add_argument("--save_dir", type=str, default="c_files", help="Path to the directory to save the generated code")
+    parser.add_argument("--packed", action="store_true", help="The weights were converted in the packed output-major layout")
+    parser.add_argument("--packed_width", type=int, default=16, help="Row padding of the packed layout (FC_PACKED_WIDTH)")
+    parser.add_argument("--unroll_max", type=int, default=16, help="Unroll the inputs of layers with at most this many inputs")
+    parser.add_argument("--sparse", action="store_true", help="The model was converted with --sparse, rejected")
+    parser.add_argument("--sparse_layers", type=int, nargs="+", default=None, help="The model was converted with --sparse_layers, rejected")
+    args = parser.parse_args()
+
+    generate_specialized_c(args.model_path, args.templates_dir, args.save_dir, packed=args.packed, packed_width=args.packed_width,
+                           unroll_max=args.unroll_max, sparse=args.sparse, sparse_layers=args.sparse_layers)
@@ -1,23 +1,118 @@
 import argparse
 import os
+import struct
 
 import numpy as np
 import tensorflow as tf
 
+# values of enum ActivationType and enum WeightLayout in the C code
+ACTIVATION_IDS = {"linear": 0, "relu": 1}
+INPUT_MAJOR = 0
+OUTPUT_MAJOR_PACKED = 1
 
-def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True):
+# binary model file, see util/model_file.h
+MODEL_FILE_MAGIC = b"NNFC"
+MODEL_FILE_VERSION = 1
+MODEL_FILE_BYTE_ORDER = 0x01020304
+MODEL_FILE_HEADER = struct.Struct("<4s9IQ")
+MODEL_FILE_LAYER = struct.Struct("<IIQQ")
+
+
+def pack_weights(weights, packed_width=16):
     """
-    Convert the model to C format and save it to the specified directory.
+    Pack the weights of a layer in the output-major layout used by the C code (OUTPUT_MAJOR_PACKED).
+    Each neuron's input weights are stored contiguously and zero padded to a multiple of packed_width.
+
+    Args:
+        weights (np.ndarray): Weights of the layer with shape (input_size, n).
+        packed_width (int): Number of floats each row is padded to a multiple of.
+
+    Returns:
+        np.ndarray: Packed weights with shape (n, padded_input_size).
+    """
+    input_size, n = weights.shape
+    stride = (input_size + packed_width - 1) // packed_width * packed_width
+    packed = np.zeros((n, stride), dtype=weights.dtype)
+    packed[:, :input_size] = weights.T
+    return packed
+
+
+def prune_weights(weights, sparsity):
+    """
+    Magnitude pruning, zero the given fraction of the weights with the smallest absolute values.
+
+    Args:
+        weights (np.ndarray): Weights of a layer.
+        sparsity (float): Fraction of the weights to zero, between 0 and 1.
+
+    Returns:
+        np.ndarray: Pruned copy of the weights with the same shape.
+    """
+    pruned = np.array(weights).flatten()
+    n_pruned = int(sparsity * pruned.size)
+    if n_pruned > 0:
+        pruned[np.argsort(np.abs(pruned), kind="stable")[:n_pruned]] = 0
+    return pruned.reshape(np.shape(weights))
+
+
+def prune_model(model, sparsity):
+    """
+    Prune the weights of every Dense layer of a Keras model in place, see prune_weights.
+    Pruning the Keras model itself keeps every output derived from it, like the equality check data, consistent with the C model.
+
+    Args:
+        model (tf.keras.Model): The model to prune.
+        sparsity (float): Fraction of the weights of each layer to zero.
+    """
+    for layer in model.layers:
+        if isinstance(layer, tf.keras.layers.Dense):
+            weights, biases = layer.get_weights()
+            layer.set_weights([prune_weights(weights, sparsity), biases])
+
+
+def to_csr(weights):
+    """
+    Compress the weights of a layer to the rows of the SparseLayer struct in util/model_binding.h, one row per neuron.
+
+    Args:
+        weights (np.ndarray): Weights of the layer with shape (input_size, n).
+
+    Returns:
+        tuple: The nnz non-zero values, the n + 1 row offsets and the nnz input indices of the values.
+    """
+    rows = weights.T
+    row_offsets = np.zeros(rows.shape[0] + 1, dtype=np.int64)
+    columns = []
+    for i, row in enumerate(rows):
+        columns.append(np.nonzero(row)[0])
+        row_offsets[i + 1] = row_offsets[i] + columns[-1].size
+    columns = np.concatenate(columns)
+    values = rows[np.repeat(np.arange(rows.shape[0]), np.diff(row_offsets)), columns]
+    return values, row_offsets, columns
+
+
+def sparse_bytes(weights):
+    """Size in bytes of a layer stored as compressed sparse rows: float values, uint16_t columns and int row offsets."""
+    return np.count_nonzero(weights) * (4 + 2) + (weights.shape[1] + 1) * 4
+
+
+def load_layers_info(model_path, verbose=True, sparsity=0.0):
+    """
+    Load a Keras model and extract the size, activation, weights and biases of its Dense layers.
 
     Args:
         model_path (str): Path to the model.
-        templates_dir (str): Path to the directory with the templates.
-        save_dir (str): Path to the directory to save the converted model.
         verbose (bool): Whether to print the summary of the model.
+        sparsity (float): Fraction of the weights of each layer to prune by magnitude, 0 keeps the weights as they are.
+
+    Returns:
+        tuple: The input size of the model and a list with a dict per layer.
     """
     model = tf.keras.models.load_model(model_path)
     if verbose:
         model.summary()
+    if sparsity > 0:
+        prune_model(model, sparsity)
 
     input_size = model.layers[0].input.shape[1]
 
@@ -25,7 +120,7 @@ def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True):
     for layer in model.layers:
         if not isinstance(layer, tf.keras.layers.Dense):
             raise ValueError("Only Dense layers are supported")
-        if layer.activation.__name__ not in ["linear", "relu"]:
+        if layer.activation.__name__ not in ACTIVATION_IDS:
             raise ValueError("Only linear and relu activations are supported")
 
         layer_info = {}
@@ -36,6 +131,29 @@ def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True):
 
         layers_info.append(layer_info)
 
+    return input_size, layers_info
+
+
+def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True, packed=False, packed_width=16, packed_alignment=64,
+                       sparsity=0.0, sparse=False, sparse_layers=None):
+    """
+    Convert the model to C format and save it to the specified directory.
+    Sparse layers are written as compressed sparse rows, which are the same in both layouts, and are left out of the packed block.
+
+    Args:
+        model_path (str): Path to the model.
+        templates_dir (str): Path to the directory with the templates.
+        save_dir (str): Path to the directory to save the converted model.
+        verbose (bool): Whether to print the summary of the model.
+        packed (bool): Whether to emit the weights in the packed output-major layout, as one aligned block.
+        packed_width (int): Row padding of the packed layout, has to match FC_PACKED_WIDTH in the C code.
+        packed_alignment (int): Alignment in bytes of the packed block, has to match FC_PACKED_ALIGNMENT in the C code.
+        sparsity (float): Fraction of the weights of each layer to prune by magnitude before the conversion.
+        sparse (bool): Whether to store the layers that get smaller as compressed sparse rows.
+        sparse_layers (list): Indices of the layers to store as compressed sparse rows, overrides the choice of sparse.
+    """
+    input_size, layers_info = load_layers_info(model_path, verbose, sparsity)
+
     with open(os.path.join(templates_dir, "model.h"), "r") as f:
         model_h = f.read()
     with open(os.path.join(templates_dir, "model.c"), "r") as f:
@@ -44,6 +162,8 @@ def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True):
     model_h = model_h.replace("{input_size}", str(input_size))
     model_h = model_h.replace("{output_size}", str(layers_info[-1]["n"]))
     model_h = model_h.replace("{n_layers}", str(len(layers_info)))
+    # only packed weights are already in their final layout, INPUT_MAJOR models may still be packed at runtime
+    model_h = model_h.replace("{weights_layout}", "#define WEIGHTS_LAYOUT OUTPUT_MAJOR_PACKED\n" if packed else "")
 
     layers_size_h = ""
     layers_size_c = ""
@@ -52,24 +172,72 @@ def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True):
     layers_weights = ""
     layers_biases = ""
     layers_activation = ""
+    layer_sparse = ""
+    layers_sparse = ""
+    n_sparse = 0
+    packed_weights = []
+    packed_offset = 0
     for i, layer_info in enumerate(layers_info):
         layers_size_h += "#define LAYER_{}_SIZE {}\n".format(i, layer_info["n"])
         layers_size_c += "LAYER_{}_SIZE, ".format(i)
 
-        layer_weights += "float layer_{}_weights[]".format(i) + " = {" + ", ".join(map(str, layer_info["weights"].flatten())) + "};\n"
-        layers_weights += "layer_{}_weights, ".format(i)
+        weights = layer_info["weights"]
+        dense_bytes = weights.shape[1] * (pack_weights(weights, packed_width).shape[1] if packed else weights.shape[0]) * 4
+        if sparse_layers is not None:
+            is_sparse = i in sparse_layers
+        else:
+            is_sparse = sparse and sparse_bytes(weights) < dense_bytes
+        if is_sparse and weights.shape[0] > 65536:
+            raise ValueError("Layer {} has more inputs than the uint16_t columns of a sparse layer can index".format(i))
+
+        if is_sparse:
+            values, row_offsets, columns = to_csr(weights)
+            layer_weights += "float layer_{}_weights[]".format(i) + " = {" + ", ".join(map(str, values)) + "};\n"
+            layer_sparse += "int layer_{}_row_offsets[]".format(i) + " = {" + ", ".join(map(str, row_offsets)) + "};\n"
+            layer_sparse += "uint16_t layer_{}_columns[]".format(i) + " = {" + ", ".join(map(str, columns)) + "};\n"
+            layers_weights += "layer_{}_weights, ".format(i)
+            layers_sparse += "{{{}, layer_{}_row_offsets, layer_{}_columns}}, ".format(values.size, i, i)
+            n_sparse += 1
+            if verbose:
+                print("Layer {}: sparse, {} of {} weights, {} instead of {} bytes".format(i, values.size, weights.size,
+                                                                                       sparse_bytes(weights), dense_bytes))
+        elif packed:
+            layer_packed = pack_weights(layer_info["weights"], packed_width).flatten()
+            packed_weights.append(layer_packed)
+            layers_weights += "layers_weights_packed + {}, ".format(packed_offset)
+            packed_offset += layer_packed.size
+        else:
+            layer_weights += "float layer_{}_weights[]".format(i) + " = {" + ", ".join(map(str, layer_info["weights"].flatten())) + "};\n"
+            layers_weights += "layer_{}_weights, ".format(i)
+        if not is_sparse:
+            layers_sparse += "{0, 0, 0}, "
 
         layer_biases += "float layer_{}_biases[]".format(i) + " = {" + ", ".join(map(str, layer_info["biases"])) + "};\n"
         layers_biases += "layer_{}_biases, ".format(i)
 
         layers_activation += "{}, ".format(layer_info["activation"].upper())
 
+    if packed and packed_weights:
+        # all dense layers share one aligned block, every layer starts at a multiple of packed_width floats
+        layer_weights += "float layers_weights_packed[] __attribute__((aligned({})))".format(packed_alignment) + \
+            " = {" + ", ".join(map(str, np.concatenate(packed_weights))) + "};\n"
+
+    sparse_layers_h = ""
+    if n_sparse > 0:
+        # SparseLayer is declared by the model binding, a copy here would conflict with it
+        sparse_layers_h = "#define SPARSE_LAYERS\n\n" + \
+            "#include \"../util/model_binding.h\"\n\n" + \
+            "extern SparseLayer layers_sparse[N_LAYERS];    // row_offsets is NULL for the dense layers\n"
+        layer_sparse += "\nSparseLayer layers_sparse[N_LAYERS] = {" + layers_sparse[:-2] + "};\n"
+
     layers_size_c = layers_size_c[:-2]    # remove the last comma
     layers_weights = layers_weights[:-2]    # remove the last comma
     layers_biases = layers_biases[:-2]    # remove the last comma
     layers_activation = layers_activation[:-2]    # remove the last comma
 
     model_h = model_h.replace("{layers_size}", layers_size_h)
+    model_h = model_h.replace("{sparse_layers}", sparse_layers_h)
+    model_c = model_c.replace("{layer_sparse}", layer_sparse)
     model_c = model_c.replace("{layers_size}", layers_size_c)
     model_c = model_c.replace("{layer_weights}", layer_weights)
     model_c = model_c.replace("{layers_weights}", layers_weights)
@@ -84,11 +252,74 @@ def convert_model_to_c(model_path, templates_dir, save_dir, verbose=True):
         f.write(model_c)
 
 
+def convert_model_to_binary(model_path, save_path, verbose=True, packed=False, packed_width=16, alignment=64, sparsity=0.0):
+    """
+    Convert the model to the binary model file loaded by openModelFile in util/model_file.c.
+    Every weight and bias array starts at a multiple of alignment, so the C code can use a mapping of the file in place.
+    The file format has no sparse layers, pruned weights are stored as zeros.
+
+    Args:
+        model_path (str): Path to the model.
+        save_path (str): Path of the binary file to write.
+        verbose (bool): Whether to print the summary of the model.
+        packed (bool): Whether to store the weights in the packed output-major layout.
+        packed_width (int): Row padding of the packed layout, has to match FC_PACKED_WIDTH in the C code.
+        alignment (int): Alignment in bytes of every array, a multiple of FC_PACKED_ALIGNMENT for packed weights.
+        sparsity (float): Fraction of the weights of each layer to prune by magnitude before the conversion.
+    """
+    input_size, layers_info = load_layers_info(model_path, verbose, sparsity)
+
+    def align(offset):
+        return (offset + alignment - 1) // alignment * alignment
+
+    header_size = MODEL_FILE_HEADER.size + len(layers_info) * MODEL_FILE_LAYER.size
+    offset = align(header_size)
+    arrays = []
+    layer_table = b""
+    for layer_info in layers_info:
+        weights = pack_weights(layer_info["weights"], packed_width) if packed else layer_info["weights"]
+        weights = np.ascontiguousarray(weights, dtype="<f4")
+        biases = np.ascontiguousarray(layer_info["biases"], dtype="<f4")
+
+        weights_offset = offset
+        offset = align(offset + weights.nbytes)
+        biases_offset = offset
+        offset = align(offset + biases.nbytes)
+
+        arrays += [(weights_offset, weights), (biases_offset, biases)]
+        layer_table += MODEL_FILE_LAYER.pack(layer_info["n"], ACTIVATION_IDS[layer_info["activation"]], weights_offset, biases_offset)
+
+    file_size = offset
+    header = MODEL_FILE_HEADER.pack(MODEL_FILE_MAGIC, MODEL_FILE_VERSION, MODEL_FILE_BYTE_ORDER, header_size, len(layers_info),
+                                    input_size, layers_info[-1]["n"], OUTPUT_MAJOR_PACKED if packed else INPUT_MAJOR,
+                                    packed_width, alignment, file_size)
+
+    data = bytearray(file_size)
+    data[:header_size] = header + layer_table
+    for array_offset, array in arrays:
+        data[array_offset:array_offset + array.nbytes] = array.tobytes()
+
+    os.makedirs(os.path.dirname(save_path) or ".", exist_ok=True)
+    with open(save_path, "wb") as f:
+        f.write(data)
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("--model_path", type=str, required=True, help="Path to the model")
     parser.add_argument("--templates_dir", type=str, default="nn_from_scratch/model/c_templates", help="Path to the directory with the templates")
     parser.add_argument("--save_dir", type=str, default="c_files", help="Path to the directory to save the converted model")
+    parser.add_argument("--packed", action="store_true", help="Emit the weights in the packed output-major layout")
+    parser.add_argument("--packed_width", type=int, default=16, help="Row padding of the packed layout (FC_PACKED_WIDTH)")
+    parser.add_argument("--binary", action="store_true", help="Also write the binary model file model.bin, see util/model_file.h")
+    parser.add_argument("--sparsity", type=float, default=0.0,
+                        help="Fraction of the weights of each layer to prune by magnitude, the model is not fine-tuned afterwards")
+    parser.add_argument("--sparse", action="store_true", help="Store the layers that get smaller as compressed sparse rows")
+    parser.add_argument("--sparse_layers", type=int, nargs="+", default=None, help="Indices of the layers to store as compressed sparse rows")
     args = parser.parse_args()
 
-    convert_model_to_c(args.model_path, args.templates_dir, args.save_dir)
+    convert_model_to_c(args.model_path, args.templates_dir, args.save_dir, packed=args.packed, packed_width=args.packed_width,
+                       sparsity=args.sparsity, sparse=args.sparse, sparse_layers=args.sparse_layers)
+    if args.binary:
+        convert_model_to_binary(args.model_path, os.path.join(args.save_dir, "model.bin"), verbose=False, packed=args.packed,
+                                packed_width=args.packed_width, sparsity=args.sparsity)
@@ -0,0 +1,208 @@
+import argparse
+import os
+
+import numpy as np
+import tensorflow as tf
+
+
+def get_layers_info(model):
+    """
+    Extract the dense layers of the model.
+
+    Args:
+        model (tf.keras.Model): The model.
+
+    Returns:
+        list[dict]: For each layer the number of neurons, activation, weights (input_size, n) and biases (n,).
+    """
+    layers_info = []
+    for layer in model.layers:
+        if not isinstance(layer, tf.keras.layers.Dense):
+            raise ValueError("Only Dense layers are supported")
+        if layer.activation.__name__ not in ["linear", "relu"]:
+            raise ValueError("Only linear and relu activations are supported")
+
+        layers_info.append({
+            "n": layer.units,
+            "activation": layer.activation.__name__,
+            "weights": np.array(layer.get_weights()[0], dtype=np.float64),
+            "biases": np.array(layer.get_weights()[1], dtype=np.float64),
+        })
+    return layers_info
+
+
+def calibrate_ranges(layers_info, calibration_x):
+    """
+    Run the float model on the calibration data and record the range of the input and of every layer output.
+
+    Args:
+        layers_info (list[dict]): Layers as returned by get_layers_info.
+        calibration_x (np.ndarray): Calibration inputs with shape (n_samples, input_size).
+
+    Returns:
+        list[tuple[float, float]]: (min, max) of the input followed by the output of each layer.
+    """
+    x = np.asarray(calibration_x, dtype=np.float64)
+    ranges = [(float(x.min()), float(x.max()))]
+    for layer_info in layers_info:
+        x = x @ layer_info["weights"] + layer_info["biases"]
+        if layer_info["activation"] == "relu":
+            x = np.maximum(x, 0)
+        ranges.append((float(x.min()), float(x.max())))
+    return ranges
+
+
+def choose_quant_params(min_val, max_val):
+    """
+    Asymmetric int8 parameters covering [min_val, max_val], the range always includes 0.
+
+    Returns:
+        tuple[float, int]: scale and zero point, real = scale * (q - zero_point).
+    """
+    min_val = min(min_val, 0.0)
+    max_val = max(max_val, 0.0)
+    scale = (max_val - min_val) / 255.0
+    if scale == 0:
+        scale = 1.0
+    zero_point = int(np.clip(round(-128 - min_val / scale), -128, 127))
+    return scale, zero_point
+
+
+def quantize_multiplier(real_multiplier):
+    """
+    Express a positive real multiplier as a Q31 multiplier in [0.5, 1) and a right shift.
+
+    Returns:
+        tuple[int, int]: multiplier and shift, real_multiplier ~= multiplier * 2**-(31 + shift).
+    """
+    if real_multiplier == 0:
+        return 0, 0
+    mantissa, exponent = np.frexp(real_multiplier)
+    multiplier = int(round(mantissa * (1 << 31)))
+    if multiplier == (1 << 31):
+        multiplier //= 2
+        exponent += 1
+    return multiplier, int(-exponent)
+
+
+def quantize_model(layers_info, calibration_x, per_channel=False):
+    """
+    Quantize the layers to int8 weights, int32 biases and integer requantization parameters.
+
+    Args:
+        layers_info (list[dict]): Layers as returned by get_layers_info.
+        calibration_x (np.ndarray): Calibration inputs used to find the activation ranges.
+        per_channel (bool): Whether to use one weight scale per output channel instead of one per layer.
+
+    Returns:
+        tuple[list[dict], list[float], list[int]]: Quantized layers, activation scales and zero points
+        (input first, then the output of each layer).
+    """
+    ranges = calibrate_ranges(layers_info, calibration_x)
+    scales = []
+    zero_points = []
+    for min_val, max_val in ranges:
+        scale, zero_point = choose_quant_params(min_val, max_val)
+        scales.append(scale)
+        zero_points.append(zero_point)
+
+    quant_layers = []
+    for i, layer_info in enumerate(layers_info):
+        weights = layer_info["weights"]
+        if per_channel:
+            weight_scales = np.abs(weights).max(axis=0) / 127.0
+        else:
+            weight_scales = np.array([np.abs(weights).max() / 127.0])
+        weight_scales[weight_scales == 0] = 1.0
+
+        q_weights = np.clip(np.round(weights / weight_scales), -127, 127).astype(np.int8)
+        bias_scales = scales[i] * (weight_scales if per_channel else weight_scales[0])
+        q_biases = np.round(layer_info["biases"] / bias_scales).astype(np.int64)
+        q_biases = np.clip(q_biases, -2**31, 2**31 - 1).astype(np.int32)
+        requant = [quantize_multiplier(scales[i] * ws / scales[i + 1]) for ws in weight_scales]
+
+        quant_layers.append({
+            "n": layer_info["n"],
+            "activation": layer_info["activation"],
+            "weights": q_weights,
+            "biases": q_biases,
+            "multipliers": [m for m, _ in requant],
+            "shifts": [s for _, s in requant],
+            "per_channel": int(per_channel),
+        })
+    return quant_layers, scales, zero_points
+
+
+def convert_quant_model_to_c(model_path, templates_dir, save_dir, calibration_x, per_channel=False, verbose=True):
+    """
+    Quantize the model to int8 and save it in C format to the specified directory.
+
+    Args:
+        model_path (str): Path to the model.
+        templates_dir (str): Path to the directory with the templates.
+        save_dir (str): Path to the directory to save the converted model.
+        calibration_x (np.ndarray): Inputs used to calibrate the activation ranges, e.g. the eqcheck and fine-tuning data.
+        per_channel (bool): Whether to use one weight scale per output channel instead of one per layer.
+        verbose (bool): Whether to print the memory used by the quantized weights.
+    """
+    model = tf.keras.models.load_model(model_path)
+    input_size = model.layers[0].input.shape[1]
+    layers_info = get_layers_info(model)
+    quant_layers, scales, zero_points = quantize_model(layers_info, calibration_x, per_channel)
+
+    with open(os.path.join(templates_dir, "quant_model.h"), "r") as f:
+        model_h = f.read()
+    with open(os.path.join(templates_dir, "quant_model.c"), "r") as f:
+        model_c = f.read()
+
+    model_h = model_h.replace("{input_size}", str(input_size))
+    model_h = model_h.replace("{output_size}", str(quant_layers[-1]["n"]))
+    model_h = model_h.replace("{n_layers}", str(len(quant_layers)))
+    model_h = model_h.replace("{input_scale}", repr(float(scales[0])))
+    model_h = model_h.replace("{output_scale}", repr(float(scales[-1])))
+
+    layer_arrays = ""
+    for i, layer in enumerate(quant_layers):
+        layer_arrays += "int8_t q_layer_{}_weights[] = {{{}}};\n".format(i, ", ".join(map(str, layer["weights"].flatten())))
+        layer_arrays += "int32_t q_layer_{}_biases[] = {{{}}};\n".format(i, ", ".join(map(str, layer["biases"])))
+        layer_arrays += "int32_t q_layer_{}_multipliers[] = {{{}}};\n".format(i, ", ".join(map(str, layer["multipliers"])))
+        layer_arrays += "int32_t q_layer_{}_shifts[] = {{{}}};\n".format(i, ", ".join(map(str, layer["shifts"])))
+
+    n_layers = len(quant_layers)
+    model_c = model_c.replace("{layer_arrays}", layer_arrays)
+    model_c = model_c.replace("{layers_size}", ", ".join(str(layer["n"]) for layer in quant_layers))
+    model_c = model_c.replace("{layers_weights}", ", ".join("q_layer_{}_weights".format(i) for i in range(n_layers)))
+    model_c = model_c.replace("{layers_biases}", ", ".join("q_layer_{}_biases".format(i) for i in range(n_layers)))
+    model_c = model_c.replace("{layers_multipliers}", ", ".join("q_layer_{}_multipliers".format(i) for i in range(n_layers)))
+    model_c = model_c.replace("{layers_shifts}", ", ".join("q_layer_{}_shifts".format(i) for i in range(n_layers)))
+    model_c = model_c.replace("{layers_per_channel}", ", ".join(str(layer["per_channel"]) for layer in quant_layers))
+    model_c = model_c.replace("{zero_points}", ", ".join(map(str, zero_points)))
+    model_c = model_c.replace("{layers_activation}", ", ".join(layer["activation"].upper() for layer in quant_layers))
+
+    if verbose:
+        n_weights = sum(layer["weights"].size for layer in quant_layers)
+        print("Quantized weights: {} bytes (float: {} bytes)".format(n_weights, 4 * n_weights))
+
+    os.makedirs(save_dir, exist_ok=True)
+    with open(os.path.join(save_dir, "quant_model.h"), "w") as f:
+        f.write(model_h)
+    with open(os.path.join(save_dir, "quant_model.c"), "w") as f:
+        f.write(model_c)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--model_path", type=str, required=True, help="Path to the model")
+    parser.add_argument("--calibration_path", type=str, default=None, help="Path to a .npy file with calibration inputs, random inputs in [0, 1) if not given")
+    parser.add_argument("--per_channel", action="store_true", help="Use one weight scale per output channel")
+    parser.add_argument("--templates_dir", type=str, default="nn_from_scratch/model/c_templates", help="Path to the directory with the templates")
+    parser.add_argument("--save_dir", type=str, default="c_files", help="Path to the directory to save the converted model")
+    args = parser.parse_args()
+
+    if args.calibration_path is not None:
+        calibration_x = np.load(args.calibration_path)
+    else:
+        model = tf.keras.models.load_model(args.model_path)
+        calibration_x = np.random.rand(100, model.layers[0].input.shape[1]).astype(np.float32)
+
+    convert_quant_model_to_c(args.model_path, args.templates_dir, args.save_dir, calibration_x, args.per_channel)
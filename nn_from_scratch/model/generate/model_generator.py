@@ -10,8 +10,10 @@ import wandb
 import yaml
 from omegaconf import OmegaConf
 
-from nn_from_scratch.model.convert.data_converter import convert_data_to_c
-from nn_from_scratch.model.convert.model_converter import convert_model_to_c
+from nn_from_scratch.model.convert.data_converter import convert_data_to_c, convert_data_to_binary
+from nn_from_scratch.model.convert.model_converter import convert_model_to_c, convert_model_to_binary, prune_model
+from nn_from_scratch.model.convert.quant_model_converter import convert_quant_model_to_c
+from nn_from_scratch.model.convert.model_codegen import generate_specialized_c
 from nn_from_scratch.model.generate.model import create_model, train_model, get_params_count, get_FLOPs, save_model, save_weights, log_model_to_wandb, measure_execution_time
 from nn_from_scratch.model.generate.utils import get_abs_path
 
@@ -85,6 +87,9 @@ def save_model_info(model_info, save_dir):
             config_name=os.path.splitext(os.path.basename(config_file_path))[0],
             version_base=None)
 def generate_models(cfg):
+    if cfg.specialize and cfg.sparsity > 0:
+        # checked before training, the specialized kernels index the weights densely
+        raise ValueError("specialize needs dense layers, it can not be combined with sparsity")
 
     for target in cfg.targets:
         cfg.target_buf = target
@@ -138,6 +143,12 @@ def generate_models(cfg):
         train_model(model, dataset.train_x, dataset.train_y, epochs, batch_size, dataset.test_x, dataset.test_y, tensorboard_log_dir, best_weights_dir, True, random_seed)
         print("")
 
+        if cfg.sparsity > 0:
+            # pruned before the evaluation and the conversions, so the equality check data matches the sparse C model
+            print("Pruning {:.0%} of the weights of every layer ...".format(cfg.sparsity), end=" ", flush=True)
+            prune_model(model, cfg.sparsity)
+            print("Done\n")
+
         # evaluate the model
         evaluation_result = None
         if cfg.evaluate_models:
@@ -161,7 +172,7 @@ def generate_models(cfg):
 
         # convert the model and data to C
         print("Converting the model to C ...", end=" ", flush=True)
-        convert_model_to_c(os.path.join(cfg.model_save_dir, "tf/model/keras_format/model.keras"), cfg.c_templates_dir, cfg.c_save_dir, verbose=False)
+        convert_model_to_c(os.path.join(cfg.model_save_dir, "tf/model/keras_format/model.keras"), cfg.c_templates_dir, cfg.c_save_dir, verbose=False, sparse=cfg.sparsity > 0)
         print("Done\n")
 
         if dataset.test_x is not None and dataset.test_y is not None:
@@ -183,6 +194,29 @@ def generate_models(cfg):
         convert_data_to_c(ft_data_x, ft_data_y, cfg.c_templates_dir, cfg.c_save_dir, file_name="ft_data", var_name="ft_samples")
         print("Done\n")
 
+        if cfg.binary_data:
+            # the whole fine-tuning set, streamed from the file instead of compiled in
+            print("Writing the binary fine-tuning data ...", end=" ", flush=True)
+            convert_data_to_binary(ft_dataset.train_x, ft_dataset.train_y, os.path.join(cfg.c_save_dir, "ft_data.bin"))
+            print("Done\n")
+
+        if cfg.quantize:
+            print("Converting the int8 quantized model to C ...", end=" ", flush=True)
+            calibration_x = np.concatenate([eq_data_x, ft_data_x])
+            convert_quant_model_to_c(os.path.join(cfg.model_save_dir, "tf/model/keras_format/model.keras"), cfg.c_templates_dir, cfg.c_save_dir, calibration_x, per_channel=cfg.quantize_per_channel, verbose=False)
+            print("Done\n")
+
+        if cfg.binary_model:
+            print("Writing the binary model file ...", end=" ", flush=True)
+            convert_model_to_binary(os.path.join(cfg.model_save_dir, "tf/model/keras_format/model.keras"), os.path.join(cfg.c_save_dir, "model.bin"), verbose=False)
+            print("Done\n")
+
+        if cfg.specialize:
+            print("Generating the specialized C kernels ...", end=" ", flush=True)
+            generate_specialized_c(os.path.join(cfg.model_save_dir, "tf/model/keras_format/model.keras"), cfg.c_templates_dir, cfg.c_save_dir, verbose=False,
+                                   sparse=cfg.sparsity > 0)
+            print("Done\n")
+
         # measure the execution time
         if cfg.measure_execution_time:
             print("Measuring execution time ...")